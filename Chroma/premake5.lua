@@ -12,6 +12,8 @@ project "Chroma"
       "../Walnut/vendor/imgui",
       "../Walnut/vendor/glfw/include",
       "../Walnut/vendor/glm",
+      "../Walnut/vendor/stb_image",
+      "../Walnut/vendor/glfw/deps",
 
       "../Walnut/Walnut/src",
 
@@ -26,6 +28,9 @@ project "Chroma"
    targetdir ("../bin/" .. outputdir .. "/%{prj.name}")
    objdir ("../bin-int/" .. outputdir .. "/%{prj.name}")
 
+   -- Kernels of every ISA level, see the root premake5.lua
+   ChromaKernelFlags()
+
    filter "system:windows"
       systemversion "latest"
       defines { "WL_PLATFORM_WINDOWS" }
@@ -43,7 +48,7 @@ project "Chroma"
 
    filter "configurations:Dist"
       kind "WindowedApp"
-      defines { "WL_DIST" }
+      defines { "WL_DIST", "CHROMA_STATS=0" }
       runtime "Release"
       optimize "On"
       symbols "Off"
\ No newline at end of file
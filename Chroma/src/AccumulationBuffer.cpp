@@ -0,0 +1,231 @@
+#include "AccumulationBuffer.h"
+#include "Memory.h"
+#include "Utils.h"
+
+#include <glm/gtc/packing.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+AccumulationBuffer::~AccumulationBuffer()
+{
+    Free();
+}
+
+void AccumulationBuffer::Free()
+{
+    Memory::FreePages(m_Data, GetSizeInBytes());
+    m_Data = nullptr;
+}
+
+uint32_t AccumulationBuffer::GetPixelSize(AccumulationFormat format)
+{
+    switch (format)
+    {
+        case AccumulationFormat::RGBFloat:  return sizeof(float) * 3;
+        case AccumulationFormat::RGBKahan:  return sizeof(KahanPixel);
+        case AccumulationFormat::RGBDouble: return sizeof(double) * 3;
+        case AccumulationFormat::RGBHalf:   return sizeof(uint16_t) * 3;
+    }
+    return 0;
+}
+
+size_t AccumulationBuffer::GetTileStride(uint32_t tileSize, AccumulationFormat format)
+{
+    // Edge tiles get a full block as well, which keeps indexing uniform
+    size_t tileBytes = (size_t)tileSize * tileSize * GetPixelSize(format);
+    return (tileBytes + Utils::CacheLineSize - 1) / Utils::CacheLineSize * Utils::CacheLineSize;
+}
+
+static uint32_t GetTileCount(uint32_t width, uint32_t height, uint32_t tileSize)
+{
+    uint32_t tilesX = (width + tileSize - 1) / tileSize;
+    uint32_t tilesY = (height + tileSize - 1) / tileSize;
+    return tilesX * tilesY;
+}
+
+void AccumulationBuffer::Allocate(uint32_t capacityWidth, uint32_t capacityHeight, uint32_t tileSize, AccumulationFormat format)
+{
+    Free();
+
+    m_Format = format;
+    m_TileSize = tileSize;
+    m_TileCapacity = GetTileCount(capacityWidth, capacityHeight, tileSize);
+    m_TileCount = m_TileCapacity;
+
+    m_TileStride = GetTileStride(tileSize, format);
+
+    m_Data = (uint8_t*)Memory::AllocatePages(m_TileStride * m_TileCapacity);
+}
+
+void AccumulationBuffer::Reserve(uint32_t capacityWidth, uint32_t capacityHeight)
+{
+    uint32_t tileCapacity = GetTileCount(capacityWidth, capacityHeight, m_TileSize);
+    uint8_t* data = (uint8_t*)Memory::AllocatePages(m_TileStride * tileCapacity);
+
+    // Kept tiles end up on the pages of the copying thread
+    uint32_t keptTiles = std::min(m_TileCount, tileCapacity);
+    if (m_Data)
+        memcpy(data, m_Data, m_TileStride * keptTiles);
+
+    Free();
+    m_Data = data;
+    m_TileCapacity = tileCapacity;
+    m_TileCount = keptTiles;
+}
+
+void AccumulationBuffer::Resize(uint32_t width, uint32_t height)
+{
+    m_TileCount = GetTileCount(width, height, m_TileSize);
+}
+
+void AccumulationBuffer::Add(uint32_t tileIndex, uint32_t pixelIndex, const glm::vec3& color, uint32_t sampleCount)
+{
+    uint8_t* tile = GetTileData(tileIndex);
+
+    switch (m_Format)
+    {
+        case AccumulationFormat::RGBFloat:
+        {
+            glm::vec3& sum = ((glm::vec3*)tile)[pixelIndex];
+            sum = sampleCount > 1 ? sum + color : color;
+            break;
+        }
+        case AccumulationFormat::RGBKahan:
+        {
+            // Relies on the compiler not reassociating float math (no /fp:fast)
+            KahanPixel& pixel = ((KahanPixel*)tile)[pixelIndex];
+            if (sampleCount <= 1)
+            {
+                pixel.Sum = color;
+                pixel.Compensation = glm::vec3(0.0f);
+                break;
+            }
+            glm::vec3 y = color - pixel.Compensation;
+            glm::vec3 t = pixel.Sum + y;
+            pixel.Compensation = (t - pixel.Sum) - y;
+            pixel.Sum = t;
+            break;
+        }
+        case AccumulationFormat::RGBDouble:
+        {
+            glm::dvec3& sum = ((glm::dvec3*)tile)[pixelIndex];
+            sum = sampleCount > 1 ? sum + glm::dvec3(color) : glm::dvec3(color);
+            break;
+        }
+        case AccumulationFormat::RGBHalf:
+        {
+            // A half sum would overflow after a few thousand bright samples, store the running mean instead
+            uint16_t* mean = (uint16_t*)tile + pixelIndex * 3;
+            if (sampleCount > MaxHalfSamples)
+                break;
+            if (sampleCount <= 1)
+            {
+                for (int c = 0; c < 3; c++)
+                    mean[c] = glm::packHalf1x16(color[c]);
+                break;
+            }
+            float weight = 1.0f / (float)sampleCount;
+            for (int c = 0; c < 3; c++)
+            {
+                float value = glm::unpackHalf1x16(mean[c]);
+                mean[c] = glm::packHalf1x16(value + (color[c] - value) * weight);
+            }
+            break;
+        }
+    }
+}
+
+void AccumulationBuffer::AddSum(uint32_t tileIndex, uint32_t pixelIndex, const glm::vec3& sum, uint32_t count, uint32_t sampleCount)
+{
+    if (m_Format != AccumulationFormat::RGBHalf)
+    {
+        // One add for all of them, which rounds a little differently than adding the samples one by one
+        Add(tileIndex, pixelIndex, sum, sampleCount > count ? sampleCount : 1);
+        return;
+    }
+
+    // Only the part of the sum up to MaxHalfSamples counts, the same as adding one by one
+    const uint32_t first = sampleCount - count;
+    if (first >= MaxHalfSamples)
+        return;
+    const uint32_t kept = std::min(sampleCount, MaxHalfSamples);
+    const glm::vec3 keptSum = sum * ((float)(kept - first) / (float)count);
+
+    uint16_t* mean = (uint16_t*)GetTileData(tileIndex) + pixelIndex * 3;
+    const float previous = (float)first;
+    for (int c = 0; c < 3; c++)
+    {
+        float value = previous > 0.0f ? glm::unpackHalf1x16(mean[c]) : 0.0f;
+        mean[c] = glm::packHalf1x16((value * previous + keptSum[c]) / (float)kept);
+    }
+}
+
+glm::vec3 AccumulationBuffer::Load(uint32_t tileIndex, uint32_t pixelIndex, uint32_t sampleCount) const
+{
+    const uint8_t* tile = GetTileData(tileIndex);
+
+    switch (m_Format)
+    {
+        case AccumulationFormat::RGBFloat:
+            return ((const glm::vec3*)tile)[pixelIndex];
+        case AccumulationFormat::RGBKahan:
+        {
+            const KahanPixel& pixel = ((const KahanPixel*)tile)[pixelIndex];
+            return pixel.Sum - pixel.Compensation;
+        }
+        case AccumulationFormat::RGBDouble:
+            return glm::vec3(((const glm::dvec3*)tile)[pixelIndex]);
+        case AccumulationFormat::RGBHalf:
+        {
+            const uint16_t* mean = (const uint16_t*)tile + pixelIndex * 3;
+            return glm::vec3(glm::unpackHalf1x16(mean[0]), glm::unpackHalf1x16(mean[1]),
+                glm::unpackHalf1x16(mean[2])) * (float)sampleCount;
+        }
+    }
+    return glm::vec3(0.0f);
+}
+
+void AccumulationBuffer::LoadRow(uint32_t tileIndex, uint32_t row, uint32_t count, uint32_t sampleCount, glm::vec4* out) const
+{
+    const uint8_t* tile = GetTileData(tileIndex);
+    const uint32_t first = row * m_TileSize;
+
+    switch (m_Format)
+    {
+        case AccumulationFormat::RGBFloat:
+        {
+            const glm::vec3* sums = (const glm::vec3*)tile + first;
+            for (uint32_t i = 0; i < count; i++)
+                out[i] = glm::vec4(sums[i], 1.0f);
+            break;
+        }
+        case AccumulationFormat::RGBKahan:
+        {
+            const KahanPixel* pixels = (const KahanPixel*)tile + first;
+            for (uint32_t i = 0; i < count; i++)
+                out[i] = glm::vec4(pixels[i].Sum - pixels[i].Compensation, 1.0f);
+            break;
+        }
+        case AccumulationFormat::RGBDouble:
+        {
+            const glm::dvec3* sums = (const glm::dvec3*)tile + first;
+            for (uint32_t i = 0; i < count; i++)
+                out[i] = glm::vec4(glm::vec3(sums[i]), 1.0f);
+            break;
+        }
+        case AccumulationFormat::RGBHalf:
+        {
+            const uint16_t* means = (const uint16_t*)tile + first * 3;
+            for (uint32_t i = 0; i < count; i++)
+            {
+                glm::vec3 mean(
+                    glm::unpackHalf1x16(means[i * 3 + 0]),
+                    glm::unpackHalf1x16(means[i * 3 + 1]),
+                    glm::unpackHalf1x16(means[i * 3 + 2]));
+                out[i] = glm::vec4(mean * (float)sampleCount, 1.0f);
+            }
+            break;
+        }
+    }
+}
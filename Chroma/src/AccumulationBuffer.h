@@ -0,0 +1,81 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cstdint>
+
+enum class AccumulationFormat
+{
+    RGBFloat = 0,   // 12 bytes per pixel, plain float sums
+    RGBKahan = 1,   // 24 bytes per pixel, Kahan-compensated float sums
+    RGBDouble = 2,  // 24 bytes per pixel, double sums
+    RGBHalf = 3     // 6 bytes per pixel, half-float running mean of the first MaxHalfSamples, for previews
+};
+
+// Per-pixel sample accumulation, stored in tile-sized blocks so that every worker
+// writes to its own contiguous, cache line aligned range of memory. The memory comes
+// straight from the OS and is never cleared up front, the first sample of a pixel
+// overwrites it. Pages are therefore first touched by the thread rendering the tile.
+class AccumulationBuffer
+{
+public:
+    // Past this many samples a step of the half running mean, (x - mean) / n, rounds away for most
+    // samples darker than the mean but not for the rare bright ones, and the mean drifts upwards
+    // (about 1% by 256 samples in the Cornell box). Later samples are dropped, the renderer counts
+    // such tiles as converged.
+    static constexpr uint32_t MaxHalfSamples = 64;
+
+    AccumulationBuffer() = default;
+    ~AccumulationBuffer();
+
+    AccumulationBuffer(const AccumulationBuffer&) = delete;
+    AccumulationBuffer& operator=(const AccumulationBuffer&) = delete;
+
+    // Reserves blocks for every tile of a capacityWidth x capacityHeight image
+    void Allocate(uint32_t capacityWidth, uint32_t capacityHeight, uint32_t tileSize, AccumulationFormat format);
+    // Changes the capacity, samples of the tiles in use are kept
+    void Reserve(uint32_t capacityWidth, uint32_t capacityHeight);
+    // Sets the size in use, has to fit into the allocated capacity. Tile blocks are independent
+    // of the image width, so this never moves memory around.
+    void Resize(uint32_t width, uint32_t height);
+
+    // sampleCount is the number of samples in the pixel including this one, 1 starts over
+    void Add(uint32_t tileIndex, uint32_t pixelIndex, const glm::vec3& color, uint32_t sampleCount);
+    // Adds the sum of count samples rendered elsewhere, sampleCount includes them
+    void AddSum(uint32_t tileIndex, uint32_t pixelIndex, const glm::vec3& sum, uint32_t count, uint32_t sampleCount);
+
+    // Summed radiance of a single pixel
+    glm::vec3 Load(uint32_t tileIndex, uint32_t pixelIndex, uint32_t sampleCount) const;
+
+    // Loads count pixels of a row within a tile as summed radiance, ready for the resolve
+    void LoadRow(uint32_t tileIndex, uint32_t row, uint32_t count, uint32_t sampleCount, glm::vec4* out) const;
+
+    // Tile blocks in use as they are stored, for saving the samples and loading them back
+    uint8_t* GetData() { return m_Data; }
+    const uint8_t* GetData() const { return m_Data; }
+    size_t GetUsedSizeInBytes() const { return m_TileStride * m_TileCount; }
+    size_t GetTileStride() const { return m_TileStride; }
+
+    AccumulationFormat GetFormat() const { return m_Format; }
+    size_t GetSizeInBytes() const { return m_TileStride * m_TileCapacity; }
+
+    static uint32_t GetPixelSize(AccumulationFormat format);
+    // Bytes per tile block of the format, 0 for an unknown one
+    static size_t GetTileStride(uint32_t tileSize, AccumulationFormat format);
+private:
+    struct KahanPixel
+    {
+        glm::vec3 Sum;
+        glm::vec3 Compensation;
+    };
+
+    uint8_t* GetTileData(uint32_t tileIndex) const { return m_Data + tileIndex * m_TileStride; }
+    void Free();
+private:
+    uint8_t* m_Data = nullptr;
+
+    AccumulationFormat m_Format = AccumulationFormat::RGBFloat;
+    uint32_t m_TileSize = 0;
+    uint32_t m_TileCount = 0;
+    uint32_t m_TileCapacity = 0;
+    size_t m_TileStride = 0; // Bytes per tile block, multiple of the cache line size
+};
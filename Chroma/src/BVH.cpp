@@ -0,0 +1,355 @@
+#include "BVH.h"
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+
+namespace {
+
+    constexpr uint32_t BinCount = 16;
+    constexpr uint32_t MaxLeafSize = 8;
+
+    // Relative cost of visiting a node compared to testing a primitive
+    constexpr float TraversalCost = 1.0f;
+
+    // Bounds are padded by this much so flat primitives (axis aligned triangles) still have volume
+    constexpr float BoundsPadding = 1e-4f;
+
+    // Refitted trees are rebuilt once their summed node area grew by more than this
+    constexpr float MaxRefitAreaGrowth = 1.5f;
+
+    constexpr uint32_t NoParent = ~0u;
+
+    struct AABB
+    {
+        glm::vec3 Min{ std::numeric_limits<float>::max() };
+        glm::vec3 Max{ -std::numeric_limits<float>::max() };
+
+        void Grow(const glm::vec3& point)
+        {
+            Min = glm::min(Min, point);
+            Max = glm::max(Max, point);
+        }
+
+        void Grow(const glm::vec3& min, const glm::vec3& max)
+        {
+            Min = glm::min(Min, min);
+            Max = glm::max(Max, max);
+        }
+
+        float GetHalfArea() const
+        {
+            glm::vec3 extent = Max - Min;
+            if (extent.x < 0.0f)
+                return 0.0f;
+            return extent.x * extent.y + extent.y * extent.z + extent.z * extent.x;
+        }
+    };
+
+    struct Bin
+    {
+        AABB Bounds;
+        uint32_t Count = 0;
+    };
+
+    // Unpadded bounds of a referenced shape
+    AABB GetShapeBounds(const Scene& scene, ShapeType type, uint32_t index)
+    {
+        AABB bounds;
+        switch (type)
+        {
+            case ShapeType::Sphere:
+            {
+                const Sphere& sphere = scene.Spheres[index];
+                bounds.Min = sphere.Position - glm::abs(sphere.Radius);
+                bounds.Max = sphere.Position + glm::abs(sphere.Radius);
+                break;
+            }
+            case ShapeType::Box:
+            {
+                const Box& box = scene.Boxes[index];
+                bounds.Min = glm::min(box.Min, box.Max);
+                bounds.Max = glm::max(box.Min, box.Max);
+                break;
+            }
+            case ShapeType::Triangle:
+            {
+                const Triangle& triangle = scene.Triangles[index];
+                bounds.Min = glm::min(triangle.v0, glm::min(triangle.v1, triangle.v2));
+                bounds.Max = glm::max(triangle.v0, glm::max(triangle.v1, triangle.v2));
+                break;
+            }
+            default:
+                break;
+        }
+        return bounds;
+    }
+
+    float GetHalfArea(const BVH::Node& node)
+    {
+        glm::vec3 extent = node.Max - node.Min;
+        return extent.x * extent.y + extent.y * extent.z + extent.z * extent.x;
+    }
+
+}
+
+bool BVH::GetBounds(glm::vec3& min, glm::vec3& max) const
+{
+    if (m_Nodes.empty())
+        return false;
+
+    min = m_Nodes[0].Min;
+    max = m_Nodes[0].Max;
+    return true;
+}
+
+void BVH::GetPrimitiveBounds(const Scene& scene, ShapeType type, uint32_t index, glm::vec3& min, glm::vec3& max)
+{
+    const AABB bounds = GetShapeBounds(scene, type, index);
+    min = bounds.Min;
+    max = bounds.Max;
+}
+
+void BVH::Clear()
+{
+    m_Nodes.clear();
+    m_References.clear();
+    m_Parents.clear();
+    m_Leaves.clear();
+    m_BuiltArea = 0.0f;
+    m_Area = 0.0f;
+}
+
+void BVH::Build(const Scene& scene)
+{
+    Clear();
+
+    m_BuildPrimitives.clear();
+    m_BuildPrimitives.reserve(scene.Spheres.size() + scene.Boxes.size() + scene.Triangles.size());
+
+    auto addPrimitives = [this, &scene](ShapeType type, size_t count)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            const AABB bounds = GetShapeBounds(scene, type, (uint32_t)i);
+            BuildPrimitive& primitive = m_BuildPrimitives.emplace_back();
+            primitive.Min = bounds.Min - BoundsPadding;
+            primitive.Max = bounds.Max + BoundsPadding;
+            primitive.Centroid = (bounds.Min + bounds.Max) * 0.5f;
+            primitive.Reference = MakeReference(type, (uint32_t)i);
+        }
+    };
+
+    addPrimitives(ShapeType::Sphere, scene.Spheres.size());
+    addPrimitives(ShapeType::Box, scene.Boxes.size());
+    addPrimitives(ShapeType::Triangle, scene.Triangles.size());
+
+    if (m_BuildPrimitives.empty())
+        return;
+
+    m_Nodes.reserve(m_BuildPrimitives.size() * 2);
+    m_Nodes.emplace_back();
+    Subdivide(0, 0, (uint32_t)m_BuildPrimitives.size(), 0);
+
+    m_References.resize(m_BuildPrimitives.size());
+    for (size_t i = 0; i < m_BuildPrimitives.size(); i++)
+        m_References[i] = m_BuildPrimitives[i].Reference;
+
+    m_BuildPrimitives.clear();
+    m_BuildPrimitives.shrink_to_fit();
+
+    for (const Node& node : m_Nodes)
+        m_BuiltArea += GetHalfArea(node);
+    m_Area = m_BuiltArea;
+
+    m_BoxSlots = (uint32_t)scene.Spheres.size();
+    m_TriangleSlots = m_BoxSlots + (uint32_t)scene.Boxes.size();
+    m_Parents.assign(m_Nodes.size(), NoParent);
+    m_Leaves.resize(m_References.size());
+    for (uint32_t i = 0; i < (uint32_t)m_Nodes.size(); i++)
+    {
+        const Node& node = m_Nodes[i];
+        if (node.Count == 0)
+        {
+            m_Parents[node.First] = i;
+            m_Parents[node.First + 1] = i;
+            continue;
+        }
+        for (uint32_t j = node.First; j < node.First + node.Count; j++)
+            m_Leaves[GetPrimitiveSlot(m_References[j])] = i;
+    }
+    m_RefitMarks.assign(m_Nodes.size(), 0);
+}
+
+void BVH::RefitNode(const Scene& scene, Node& node) const
+{
+    AABB bounds;
+    if (node.Count > 0)
+    {
+        for (uint32_t j = node.First; j < node.First + node.Count; j++)
+        {
+            const AABB primitive = GetShapeBounds(scene, GetType(m_References[j]), GetIndex(m_References[j]));
+            bounds.Grow(primitive.Min - BoundsPadding, primitive.Max + BoundsPadding);
+        }
+    }
+    else
+    {
+        bounds.Grow(m_Nodes[node.First].Min, m_Nodes[node.First].Max);
+        bounds.Grow(m_Nodes[node.First + 1].Min, m_Nodes[node.First + 1].Max);
+    }
+
+    node.Min = bounds.Min;
+    node.Max = bounds.Max;
+}
+
+bool BVH::Refit(const Scene& scene)
+{
+    // Children always come after their parent, walking backwards visits them first
+    float area = 0.0f;
+    for (size_t i = m_Nodes.size(); i-- > 0;)
+    {
+        RefitNode(scene, m_Nodes[i]);
+        area += GetHalfArea(m_Nodes[i]);
+    }
+
+    m_Area = area;
+    return area <= m_BuiltArea * MaxRefitAreaGrowth;
+}
+
+bool BVH::Refit(const Scene& scene, const std::vector<uint32_t>& references)
+{
+    // Checked before anything is marked, marks left behind would stop later walks short of the root
+    for (uint32_t reference : references)
+    {
+        if (GetPrimitiveSlot(reference) >= m_Leaves.size())
+            return Refit(scene);
+    }
+
+    // Walks up from every leaf until it meets a node an earlier one already took
+    m_RefitNodes.clear();
+    for (uint32_t reference : references)
+    {
+        const uint32_t slot = GetPrimitiveSlot(reference);
+        for (uint32_t node = m_Leaves[slot]; node != NoParent && !m_RefitMarks[node]; node = m_Parents[node])
+        {
+            m_RefitMarks[node] = 1;
+            m_RefitNodes.push_back(node);
+        }
+    }
+
+    // Children always come after their parent, the highest index goes first
+    std::sort(m_RefitNodes.begin(), m_RefitNodes.end(), std::greater<uint32_t>());
+    for (uint32_t i : m_RefitNodes)
+    {
+        Node& node = m_Nodes[i];
+        m_Area -= GetHalfArea(node);
+        RefitNode(scene, node);
+        m_Area += GetHalfArea(node);
+        m_RefitMarks[i] = 0;
+    }
+
+    return m_Area <= m_BuiltArea * MaxRefitAreaGrowth;
+}
+
+void BVH::Subdivide(uint32_t nodeIndex, uint32_t first, uint32_t count, uint32_t depth)
+{
+    AABB bounds, centroidBounds;
+    for (uint32_t i = first; i < first + count; i++)
+    {
+        bounds.Grow(m_BuildPrimitives[i].Min, m_BuildPrimitives[i].Max);
+        centroidBounds.Grow(m_BuildPrimitives[i].Centroid);
+    }
+
+    m_Nodes[nodeIndex].Min = bounds.Min;
+    m_Nodes[nodeIndex].Max = bounds.Max;
+    m_Nodes[nodeIndex].First = first;
+    m_Nodes[nodeIndex].Count = count;
+
+    if (count <= 2 || depth >= MaxDepth - 1)
+        return;
+
+    // Find the cheapest split plane over all axes
+    float bestCost = std::numeric_limits<float>::max();
+    int bestAxis = -1;
+    uint32_t bestSplit = 0;
+
+    for (int axis = 0; axis < 3; axis++)
+    {
+        float extent = centroidBounds.Max[axis] - centroidBounds.Min[axis];
+        if (extent <= 0.0f)
+            continue;
+
+        Bin bins[BinCount];
+        float binScale = (float)BinCount / extent;
+        for (uint32_t i = first; i < first + count; i++)
+        {
+            const BuildPrimitive& primitive = m_BuildPrimitives[i];
+            uint32_t bin = std::min(BinCount - 1, (uint32_t)((primitive.Centroid[axis] - centroidBounds.Min[axis]) * binScale));
+            bins[bin].Bounds.Grow(primitive.Min, primitive.Max);
+            bins[bin].Count++;
+        }
+
+        // Sweep from the right to get the cost of everything right of each plane
+        float rightArea[BinCount - 1];
+        uint32_t rightCount[BinCount - 1];
+        AABB right;
+        uint32_t binned = 0;
+        for (uint32_t i = BinCount - 1; i > 0; i--)
+        {
+            right.Grow(bins[i].Bounds.Min, bins[i].Bounds.Max);
+            binned += bins[i].Count;
+            rightArea[i - 1] = right.GetHalfArea();
+            rightCount[i - 1] = binned;
+        }
+
+        AABB left;
+        binned = 0;
+        for (uint32_t i = 0; i < BinCount - 1; i++)
+        {
+            left.Grow(bins[i].Bounds.Min, bins[i].Bounds.Max);
+            binned += bins[i].Count;
+
+            if (binned == 0 || rightCount[i] == 0)
+                continue;
+
+            float cost = binned * left.GetHalfArea() + rightCount[i] * rightArea[i];
+            if (cost < bestCost)
+            {
+                bestCost = cost;
+                bestAxis = axis;
+                bestSplit = i + 1;
+            }
+        }
+    }
+
+    // All centroids coincide, nothing left to split
+    if (bestAxis < 0)
+        return;
+
+    float leafCost = count * bounds.GetHalfArea();
+    float splitCost = TraversalCost * bounds.GetHalfArea() + bestCost;
+    if (splitCost >= leafCost && count <= MaxLeafSize)
+        return;
+
+    float binScale = (float)BinCount / (centroidBounds.Max[bestAxis] - centroidBounds.Min[bestAxis]);
+    auto middle = std::partition(m_BuildPrimitives.begin() + first, m_BuildPrimitives.begin() + first + count,
+        [&](const BuildPrimitive& primitive)
+        {
+            uint32_t bin = std::min(BinCount - 1, (uint32_t)((primitive.Centroid[bestAxis] - centroidBounds.Min[bestAxis]) * binScale));
+            return bin < bestSplit;
+        });
+
+    uint32_t leftCount = (uint32_t)(middle - m_BuildPrimitives.begin()) - first;
+    if (leftCount == 0 || leftCount == count)
+        return;
+
+    uint32_t leftIndex = (uint32_t)m_Nodes.size();
+    m_Nodes.emplace_back();
+    m_Nodes.emplace_back();
+
+    m_Nodes[nodeIndex].First = leftIndex;
+    m_Nodes[nodeIndex].Count = 0;
+
+    Subdivide(leftIndex, first, leftCount, depth + 1);
+    Subdivide(leftIndex + 1, first + leftCount, count - leftCount, depth + 1);
+}
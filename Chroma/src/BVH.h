@@ -0,0 +1,175 @@
+#pragma once
+
+#include "Ray.h"
+#include "RenderStats.h"
+#include "Scene.h"
+
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Bounding volume hierarchy over the spheres, boxes and triangles of a scene, built with a binned
+// surface area heuristic. Planes are unbounded and stay outside of it.
+class BVH
+{
+public:
+    struct Node
+    {
+        glm::vec3 Min;
+        uint32_t First;     // Left child for interior nodes (the right one follows it), first reference for leaves
+        glm::vec3 Max;
+        uint32_t Count;     // Number of references in a leaf, 0 for interior nodes
+    };
+
+    static constexpr uint32_t MaxDepth = 64;
+
+    void Build(const Scene& scene);
+    void Clear();
+
+    // Recomputes the bounds of every node after shapes moved or changed form, the tree itself is kept.
+    // Returns false when it got so much worse than the built one that a rebuild is due.
+    bool Refit(const Scene& scene);
+    // Only refits the leaves holding the referenced primitives and the nodes above them, which is all
+    // that changes when a few shapes of a large scene move. Same verdict as refitting everything.
+    bool Refit(const Scene& scene, const std::vector<uint32_t>& references);
+
+    // Calls intersect(reference) for every primitive whose leaf the ray reaches before hitDistance.
+    // intersect is expected to lower hitDistance when it finds a closer hit, which prunes the rest.
+    // Returns the number of node bounds tested, always 0 without CHROMA_STATS.
+    template<typename IntersectFunc>
+    uint32_t Traverse(const Ray& ray, const float& hitDistance, IntersectFunc&& intersect) const;
+
+    // Primitive references keep the shape type in the top two bits and the index in the rest
+    static uint32_t MakeReference(ShapeType type, uint32_t index) { return ((uint32_t)type << 30) | index; }
+    static ShapeType GetType(uint32_t reference) { return (ShapeType)(reference >> 30); }
+    static uint32_t GetIndex(uint32_t reference) { return reference & 0x3fffffff; }
+
+    // Bounds of everything in the tree, false when it is empty
+    bool GetBounds(glm::vec3& min, glm::vec3& max) const;
+    // Bounds of a sphere, box or triangle of the scene, without the padding the tree adds
+    static void GetPrimitiveBounds(const Scene& scene, ShapeType type, uint32_t index, glm::vec3& min, glm::vec3& max);
+
+    bool IsEmpty() const { return m_Nodes.empty(); }
+    uint32_t GetNodeCount() const { return (uint32_t)m_Nodes.size(); }
+    uint32_t GetPrimitiveCount() const { return (uint32_t)m_References.size(); }
+    size_t GetMemorySize() const
+    {
+        return m_Nodes.capacity() * sizeof(Node) + m_References.capacity() * sizeof(uint32_t) +
+            m_BuildPrimitives.capacity() * sizeof(BuildPrimitive) +
+            (m_Parents.capacity() + m_Leaves.capacity() + m_RefitNodes.capacity()) * sizeof(uint32_t) +
+            m_RefitMarks.capacity();
+    }
+private:
+    struct BuildPrimitive
+    {
+        glm::vec3 Min, Max;
+        glm::vec3 Centroid;
+        uint32_t Reference;
+    };
+
+    void Subdivide(uint32_t nodeIndex, uint32_t first, uint32_t count, uint32_t depth);
+    void RefitNode(const Scene& scene, Node& node) const;
+
+    // Spheres, then boxes, then triangles
+    uint32_t GetPrimitiveSlot(uint32_t reference) const
+    {
+        const ShapeType type = GetType(reference);
+        return GetIndex(reference) + (type == ShapeType::Box ? m_BoxSlots : type == ShapeType::Triangle ? m_TriangleSlots : 0);
+    }
+
+    // Entry distance of the ray into the node, or a negative value when it misses or starts beyond maxDistance
+    static float IntersectNode(const Node& node, const Ray& ray, const glm::vec3& invDirection, float maxDistance);
+private:
+    std::vector<Node> m_Nodes;
+    std::vector<uint32_t> m_References;
+    float m_BuiltArea = 0.0f; // Summed node surface area right after Build()
+    float m_Area = 0.0f;      // And after the last refit
+
+    // For refitting from the leaves up, both filled by Build()
+    std::vector<uint32_t> m_Parents;    // Per node, the root has none
+    std::vector<uint32_t> m_Leaves;     // Leaf of every primitive, by GetPrimitiveSlot()
+    uint32_t m_BoxSlots = 0, m_TriangleSlots = 0;
+    std::vector<uint32_t> m_RefitNodes;
+    std::vector<uint8_t> m_RefitMarks;
+    std::vector<BuildPrimitive> m_BuildPrimitives; // Only used during Build()
+};
+
+inline float BVH::IntersectNode(const Node& node, const Ray& ray, const glm::vec3& invDirection, float maxDistance)
+{
+    glm::vec3 t0 = (node.Min - ray.Origin) * invDirection;
+    glm::vec3 t1 = (node.Max - ray.Origin) * invDirection;
+
+    glm::vec3 tSmall = glm::min(t0, t1);
+    glm::vec3 tBig = glm::max(t0, t1);
+
+    float tNear = glm::max(glm::max(tSmall.x, tSmall.y), glm::max(tSmall.z, 0.0f));
+    float tFar = glm::min(glm::min(tBig.x, tBig.y), glm::min(tBig.z, maxDistance));
+
+    return tNear <= tFar ? tNear : -1.0f;
+}
+
+template<typename IntersectFunc>
+uint32_t BVH::Traverse(const Ray& ray, const float& hitDistance, IntersectFunc&& intersect) const
+{
+    uint32_t visited = 0;
+    if (m_Nodes.empty())
+        return visited;
+
+    const glm::vec3 invDirection = 1.0f / ray.Direction;
+
+    struct StackEntry
+    {
+        uint32_t Node;
+        float Distance;
+    };
+    StackEntry stack[MaxDepth + 1];
+    uint32_t stackSize = 0;
+
+    CHROMA_STAT(visited++);
+    if (IntersectNode(m_Nodes[0], ray, invDirection, hitDistance) < 0.0f)
+        return visited;
+    stack[stackSize++] = { 0, 0.0f };
+
+    while (stackSize > 0)
+    {
+        const StackEntry entry = stack[--stackSize];
+        if (entry.Distance > hitDistance)
+            continue;
+
+        const Node* node = &m_Nodes[entry.Node];
+        while (node->Count == 0)
+        {
+            // Descend into the nearer child first, the other one waits on the stack
+            uint32_t nearIndex = node->First;
+            uint32_t farIndex = node->First + 1;
+            float nearDistance = IntersectNode(m_Nodes[nearIndex], ray, invDirection, hitDistance);
+            float farDistance = IntersectNode(m_Nodes[farIndex], ray, invDirection, hitDistance);
+            CHROMA_STAT(visited += 2);
+
+            if (farDistance >= 0.0f && (nearDistance < 0.0f || farDistance < nearDistance))
+            {
+                std::swap(nearIndex, farIndex);
+                std::swap(nearDistance, farDistance);
+            }
+
+            if (nearDistance < 0.0f)
+            {
+                node = nullptr;
+                break;
+            }
+
+            if (farDistance >= 0.0f)
+                stack[stackSize++] = { farIndex, farDistance };
+            node = &m_Nodes[nearIndex];
+        }
+
+        if (!node)
+            continue;
+
+        for (uint32_t i = 0; i < node->Count; i++)
+            intersect(m_References[node->First + i]);
+    }
+
+    return visited;
+}
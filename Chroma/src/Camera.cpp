@@ -6,6 +6,9 @@
 
 #include "Walnut/Input/Input.h"
 
+#include <algorithm>
+#include <execution>
+
 using namespace Walnut;
 
 Camera::Camera(float verticalFOV, float nearClip, float farClip)
@@ -102,6 +105,24 @@ void Camera::OnResize(uint32_t width, uint32_t height)
 	RecalculateRayDirections();
 }
 
+void Camera::LookAt(const glm::vec3& position, const glm::vec3& target)
+{
+	m_Position = position;
+	m_ForwardDirection = glm::normalize(target - position);
+
+	RecalculateView();
+	RecalculateRayDirections();
+}
+
+void Camera::SetView(const glm::vec3& position, const glm::vec3& direction)
+{
+	m_Position = position;
+	m_ForwardDirection = direction;
+
+	RecalculateView();
+	RecalculateRayDirections();
+}
+
 float Camera::GetRotationSpeed()
 {
 	return 0.3f;
@@ -121,18 +142,27 @@ void Camera::RecalculateView()
 
 void Camera::RecalculateRayDirections()
 {
+	// Never shrinks, resizing within the largest size so far doesn't reallocate
 	m_RayDirections.resize(m_ViewportWidth * m_ViewportHeight);
 
-	for (uint32_t y = 0; y < m_ViewportHeight; y++)
+	if (m_RowIter.size() != m_ViewportHeight)
 	{
-		for (uint32_t x = 0; x < m_ViewportWidth; x++)
-		{
-			glm::vec2 coord = { (float)x / (float)m_ViewportWidth, (float)y / (float)m_ViewportHeight };
-			coord = coord * 2.0f - 1.0f; // -1 -> 1
-
-			glm::vec4 target = m_InverseProjection * glm::vec4(coord.x, coord.y, 1, 1);
-			glm::vec3 rayDirection = glm::vec3(m_InverseView * glm::vec4(glm::normalize(glm::vec3(target) / target.w), 0)); // World space
-			m_RayDirections[x + y * m_ViewportWidth] = rayDirection;
-		}
+		m_RowIter.resize(m_ViewportHeight);
+		for (uint32_t y = 0; y < m_ViewportHeight; y++)
+			m_RowIter[y] = y;
 	}
+
+	std::for_each(std::execution::par, m_RowIter.begin(), m_RowIter.end(),
+		[this](uint32_t y)
+		{
+			for (uint32_t x = 0; x < m_ViewportWidth; x++)
+			{
+				glm::vec2 coord = { (float)x / (float)m_ViewportWidth, (float)y / (float)m_ViewportHeight };
+				coord = coord * 2.0f - 1.0f; // -1 -> 1
+
+				glm::vec4 target = m_InverseProjection * glm::vec4(coord.x, coord.y, 1, 1);
+				glm::vec3 rayDirection = glm::vec3(m_InverseView * glm::vec4(glm::normalize(glm::vec3(target) / target.w), 0)); // World space
+				m_RayDirections[x + y * m_ViewportWidth] = rayDirection;
+			}
+		});
 }
\ No newline at end of file
@@ -12,6 +12,11 @@ public:
 	bool OnUpdate(float ts);
 	void OnResize(uint32_t width, uint32_t height);
 
+	// Places the camera, used to set up scenes without any input
+	void LookAt(const glm::vec3& position, const glm::vec3& target);
+	// Restores a view exactly as GetPosition() and GetDirection() returned it
+	void SetView(const glm::vec3& position, const glm::vec3& direction);
+
 	const glm::mat4& GetProjection() const { return m_Projection; }
 	const glm::mat4& GetInverseProjection() const { return m_InverseProjection; }
 	const glm::mat4& GetView() const { return m_View; }
@@ -19,6 +24,9 @@ public:
 
 	const glm::vec3& GetPosition() const { return m_Position; }
 	const glm::vec3& GetDirection() const { return m_ForwardDirection; }
+	float GetVerticalFOV() const { return m_VerticalFOV; }
+	float GetNearClip() const { return m_NearClip; }
+	float GetFarClip() const { return m_FarClip; }
 
 	const std::vector<glm::vec3>& GetRayDirections() const { return m_RayDirections; }
 
@@ -42,6 +50,7 @@ private:
 
 	// Cached ray directions
 	std::vector<glm::vec3> m_RayDirections;
+	std::vector<uint32_t> m_RowIter;
 
 	glm::vec2 m_LastMousePosition{ 0.0f, 0.0f };
 
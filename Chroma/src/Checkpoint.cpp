@@ -0,0 +1,235 @@
+#include "Checkpoint.h"
+#include "Utils.h"
+
+#include "Walnut/Timer.h"
+
+#include <cstring>
+
+namespace {
+
+    constexpr char Magic[8] = { 'C', 'H', 'R', 'O', 'M', 'A', 'C', 'P' };
+    constexpr uint32_t Version = 1;
+
+    // The slots start on a page of their own, flushing one never touches the other
+    constexpr uint64_t HeaderSize = 4096;
+
+    struct FileHeader
+    {
+        char Magic[8];
+        uint32_t Version;
+        uint32_t Reserved;
+        uint64_t SlotSize;  // Including the slot header
+    };
+
+}
+
+struct Checkpoint::SlotHeader
+{
+    uint64_t Sequence;      // 0 while the slot is written, higher is newer
+    uint64_t Checksum;      // Of the payload
+    uint64_t PayloadSize;
+    uint64_t Reserved[5];
+};
+
+Checkpoint::~Checkpoint()
+{
+    Close();
+
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Stopping = true;
+    }
+    m_Condition.notify_all();
+    if (m_Flusher.joinable())
+        m_Flusher.join();
+}
+
+bool Checkpoint::Open(const std::string& path)
+{
+    Close();
+    if (!m_File.Open(path))
+        return false;
+
+    m_SlotSize = 0;
+    m_Sequence = 0;
+    m_WriteSlot = 0;
+    m_LastWrite = std::chrono::steady_clock::now();
+
+    // Anything that is not a checkpoint file of this version is started over
+    const FileHeader* header = (const FileHeader*)m_File.Data();
+    if (m_File.Size() < HeaderSize || std::memcmp(header->Magic, Magic, sizeof(Magic)) != 0 ||
+        header->Version != Version || m_File.Size() < HeaderSize + header->SlotSize * 2)
+    {
+        return true;
+    }
+
+    m_SlotSize = header->SlotSize;
+    for (uint32_t slot = 0; slot < 2; slot++)
+    {
+        if (IsComplete(slot) && GetSlot(slot)->Sequence > m_Sequence)
+        {
+            m_Sequence = GetSlot(slot)->Sequence;
+            m_WriteSlot = slot ^ 1;
+        }
+    }
+    return true;
+}
+
+void Checkpoint::Close()
+{
+    Wait();
+    m_File.Close();
+    m_SlotSize = 0;
+}
+
+const uint8_t* Checkpoint::GetLatest(size_t& size)
+{
+    Wait();
+    if (m_Sequence == 0)
+        return nullptr;
+
+    const SlotHeader* slot = GetSlot(m_WriteSlot ^ 1);
+    size = (size_t)slot->PayloadSize;
+    return (const uint8_t*)(slot + 1);
+}
+
+double Checkpoint::GetAge() const
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - m_LastWrite).count();
+}
+
+uint8_t* Checkpoint::BeginWrite(size_t size)
+{
+    if (!IsOpen() || m_Flushing)
+        return nullptr;
+
+    // Growing moves the second slot. Only happens when the image got larger.
+    const uint64_t slotSize = sizeof(SlotHeader) + size;
+    if (slotSize > m_SlotSize && !Grow(slotSize))
+        return nullptr;
+
+    m_LastWrite = std::chrono::steady_clock::now();
+    SlotHeader* slot = GetSlot(m_WriteSlot);
+    slot->Sequence = 0;
+    slot->PayloadSize = size;
+    return (uint8_t*)(slot + 1);
+}
+
+void Checkpoint::EndWrite()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Flushing = true;
+        m_FlushPending = true;
+    }
+
+    if (!m_Flusher.joinable())
+        m_Flusher = std::thread([this]() { FlushMain(); });
+    m_Condition.notify_all();
+}
+
+bool Checkpoint::Grow(uint64_t slotSize)
+{
+    // The first slot stays in place, the newest checkpoint is moved there before anything else
+    // changes. Until the file header names the new size the old layout is intact on the disk.
+    if (m_Sequence > 0 && m_WriteSlot == 0)
+    {
+        const SlotHeader* newest = GetSlot(1);
+        SlotHeader* first = GetSlot(0);
+        first->Sequence = 0;
+        m_File.Flush(HeaderSize, sizeof(SlotHeader));
+
+        std::memcpy(first + 1, newest + 1, (size_t)newest->PayloadSize);
+        first->PayloadSize = newest->PayloadSize;
+        first->Checksum = newest->Checksum;
+        m_File.Flush(HeaderSize + sizeof(SlotHeader), (size_t)newest->PayloadSize);
+        first->Sequence = newest->Sequence;
+        m_File.Flush(HeaderSize, sizeof(SlotHeader));
+        m_WriteSlot = 1;
+    }
+
+    const uint64_t pageSize = Memory::GetPageSize();
+    const uint64_t newSlotSize = (slotSize + pageSize - 1) / pageSize * pageSize;
+    if (!m_File.Resize(HeaderSize + newSlotSize * 2))
+    {
+        // Without a mapping there is nothing left to write to, the file itself is untouched
+        if (!m_File.Data())
+        {
+            m_File.Close();
+            m_SlotSize = 0;
+            m_Sequence = 0;
+        }
+        return false;
+    }
+
+    // The second slot now starts inside the old one or past the end of the old file
+    m_SlotSize = newSlotSize;
+    if (m_Sequence == 0)
+    {
+        std::memset(GetSlot(0), 0, sizeof(SlotHeader));
+        m_File.Flush(HeaderSize, sizeof(SlotHeader));
+        m_WriteSlot = 0;
+    }
+    std::memset(GetSlot(1), 0, sizeof(SlotHeader));
+    m_File.Flush(HeaderSize + m_SlotSize, sizeof(SlotHeader));
+
+    FileHeader* header = (FileHeader*)m_File.Data();
+    std::memcpy(header->Magic, Magic, sizeof(Magic));
+    header->Version = Version;
+    header->Reserved = 0;
+    header->SlotSize = m_SlotSize;
+    m_File.Flush(0, HeaderSize);
+    return true;
+}
+
+Checkpoint::SlotHeader* Checkpoint::GetSlot(uint32_t slot)
+{
+    return (SlotHeader*)(m_File.Data() + HeaderSize + m_SlotSize * slot);
+}
+
+bool Checkpoint::IsComplete(uint32_t slot)
+{
+    const SlotHeader* header = GetSlot(slot);
+    return header->Sequence > 0 && header->PayloadSize <= m_SlotSize - sizeof(SlotHeader) &&
+        Utils::HashBytes(header + 1, (size_t)header->PayloadSize) == header->Checksum;
+}
+
+void Checkpoint::FlushMain()
+{
+    Walnut::Profiler::SetThreadName("Checkpoint");
+
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    for (;;)
+    {
+        m_Condition.wait(lock, [this]() { return m_FlushPending || m_Stopping; });
+        if (m_Stopping)
+            return;
+        m_FlushPending = false;
+        lock.unlock();
+
+        {
+            WL_PROFILE_ZONE("Checkpoint::Flush");
+
+            // The payload has to be on the disk before the header claims it is complete
+            SlotHeader* slot = GetSlot(m_WriteSlot);
+            const size_t offset = (size_t)(HeaderSize + m_SlotSize * m_WriteSlot);
+            slot->Checksum = Utils::HashBytes(slot + 1, (size_t)slot->PayloadSize);
+            m_File.Flush(offset + sizeof(SlotHeader), (size_t)slot->PayloadSize);
+            slot->Sequence = m_Sequence + 1;
+            m_File.Flush(offset, sizeof(SlotHeader));
+
+            m_Sequence++;
+            m_WriteSlot ^= 1;
+        }
+
+        lock.lock();
+        m_Flushing = false;
+        m_Condition.notify_all();
+    }
+}
+
+void Checkpoint::Wait()
+{
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    m_Condition.wait(lock, [this]() { return !m_Flushing; });
+}
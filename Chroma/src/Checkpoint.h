@@ -0,0 +1,65 @@
+#pragma once
+
+#include "Memory.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Memory-mapped file holding the last two checkpoints of a render. A new one goes into the slot
+// not holding the newest, and a background thread writes it to the disk and only then marks it
+// as complete. A crash at any point leaves at least one complete checkpoint behind.
+class Checkpoint
+{
+public:
+    Checkpoint() = default;
+    ~Checkpoint();
+
+    Checkpoint(const Checkpoint&) = delete;
+    Checkpoint& operator=(const Checkpoint&) = delete;
+
+    // Opens the file or creates it, the checkpoints in an existing file can be resumed from
+    bool Open(const std::string& path);
+    // Waits for a running flush
+    void Close();
+    bool IsOpen() const { return m_File.IsOpen(); }
+
+    // Payload of the newest complete checkpoint, nullptr if there is none. Waits for a running flush.
+    const uint8_t* GetLatest(size_t& size);
+
+    // A new checkpoint can only be started once the last one reached the disk
+    bool IsFlushing() const { return m_Flushing; }
+    // Seconds since the last checkpoint was started, or since the file was opened
+    double GetAge() const;
+
+    // Space for a new checkpoint of size bytes, nullptr while flushing or if the file can not grow
+    uint8_t* BeginWrite(size_t size);
+    // Hands it to the background thread, it becomes the newest once it is on the disk
+    void EndWrite();
+private:
+    struct SlotHeader;
+
+    // Moves to slots of at least slotSize bytes, keeping the newest complete checkpoint
+    bool Grow(uint64_t slotSize);
+    SlotHeader* GetSlot(uint32_t slot);
+    bool IsComplete(uint32_t slot);
+    void FlushMain();
+    void Wait();
+private:
+    Memory::MappedFile m_File;
+    uint64_t m_SlotSize = 0;
+    uint64_t m_Sequence = 0;        // Of the newest complete checkpoint
+    uint32_t m_WriteSlot = 0;
+    std::chrono::steady_clock::time_point m_LastWrite;
+
+    std::thread m_Flusher;
+    std::mutex m_Mutex;
+    std::condition_variable m_Condition;
+    std::atomic<bool> m_Flushing{ false };
+    bool m_FlushPending = false;
+    bool m_Stopping = false;
+};
@@ -0,0 +1,460 @@
+#include "Distributed.h"
+#include "Serialize.h"
+#include "Utils.h"
+
+#include "Walnut/Timer.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace Distributed {
+
+    namespace {
+
+        constexpr uint32_t ProtocolVersion = 1;
+
+        // A worker keeps one assignment queued behind the one it renders, so it never waits on a round trip
+        constexpr size_t MaxAssignmentsPerWorker = 2;
+        // Long enough to hide the message overhead, short enough to balance the last tiles of a frame
+        constexpr float AssignmentSeconds = 0.05f;
+        // Another copy goes out once the last one sent took this many times longer than expected
+        constexpr float TimeoutFactor = 8.0f;
+        constexpr double MinTimeout = 1.0;
+        // Before a worker's first result its speed is unknown, and the first one includes the BVH build
+        constexpr double FirstTimeout = 10.0;
+        constexpr double NoWorkerTimeout = 30.0;
+        constexpr uint32_t ReceiveTimeout = 10000;
+        constexpr double ConnectTimeout = 10.0;
+        constexpr uint32_t MaxMessageSize = 1u << 30;
+
+        enum class MessageType : uint32_t
+        {
+            Hello = 1,      // Worker to coordinator once connected
+            Job = 2,        // Job id, JobHeader and the scene
+            Assignment = 3,
+            Result = 4      // ResultHeader and the sample sums of the tile
+        };
+
+        struct Hello
+        {
+            uint32_t Version;
+            uint32_t SettingsSize;
+            uint32_t FootprintSize;
+            uint32_t TileSize;
+        };
+
+        struct JobHeader
+        {
+            uint32_t Width, Height;
+            glm::vec3 CameraPosition;
+            glm::vec3 CameraDirection;
+            float VerticalFOV, NearClip, FarClip;
+            Renderer::Settings Settings;
+        };
+
+        struct AssignmentMessage
+        {
+            uint32_t JobId;
+            uint32_t Id;
+            uint32_t Tile;
+            uint32_t FirstFrame, FrameCount;
+        };
+
+        struct ResultHeader
+        {
+            uint32_t Id;
+            float Seconds;  // Spent rendering, without the messages
+            Footprint::Set Footprint;
+        };
+
+        Hello MakeHello()
+        {
+            return { ProtocolVersion, (uint32_t)sizeof(Renderer::Settings), (uint32_t)sizeof(Footprint::Set), Renderer::TileSize };
+        }
+
+        template<typename T>
+        void HashValue(uint64_t& hash, const T& value)
+        {
+            hash = Utils::HashBytes(&value, sizeof(T), hash);
+        }
+
+        // Everything the samples depend on. Exposure, targets and the like only matter to the coordinator.
+        uint64_t GetJobHash(const Renderer& renderer, Renderer::Settings settings, const Scene& scene, const Camera& camera)
+        {
+            uint64_t hash = GetContentHash(scene);
+            HashValue(hash, renderer.GetWidth());
+            HashValue(hash, renderer.GetHeight());
+            HashValue(hash, camera.GetPosition());
+            HashValue(hash, camera.GetDirection());
+            HashValue(hash, camera.GetVerticalFOV());
+            HashValue(hash, camera.GetNearClip());
+            HashValue(hash, camera.GetFarClip());
+            HashValue(hash, settings.Accumulate);
+            HashValue(hash, settings.SlowRandom);
+            HashValue(hash, settings.SamplesPerPixel);
+            HashValue(hash, settings.Seed);
+            HashValue(hash, settings.InvalidationDepth);
+            return hash;
+        }
+    }
+
+    bool Coordinator::Listen(const std::string& address)
+    {
+        Close();
+        return m_Listener.Listen(address);
+    }
+
+    void Coordinator::Close()
+    {
+        m_Listener.Close();
+        m_Workers.clear();
+        m_Assignments.clear();
+        m_JobId = 0;
+        m_JobHash = 0;
+    }
+
+    bool Coordinator::WaitForWorkers(uint32_t count, double timeout)
+    {
+        const auto deadline = Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(timeout));
+        while (true)
+        {
+            uint32_t ready = 0;
+            for (const std::unique_ptr<Worker>& worker : m_Workers)
+                ready += worker->Ready ? 1 : 0;
+            if (ready >= count)
+                return true;
+            if (Clock::now() >= deadline)
+                return false;
+            Update(nullptr, 10);
+        }
+    }
+
+    bool Coordinator::Render(Renderer& renderer, const Scene& scene, const Camera& camera, uint32_t frames)
+    {
+        WL_PROFILE_ZONE("Distributed::Render");
+
+        const auto start = Clock::now();
+        m_Stats = {};
+
+        // Heatmap costs are not sent back, and an empty image has no tiles to hand out
+        Renderer::Settings& settings = renderer.GetSettings();
+        if (settings.Heatmap != Heatmap::Metric::None || renderer.GetTileCount() == 0)
+            return false;
+
+        const uint64_t jobHash = GetJobHash(renderer, settings, scene, camera);
+        if (jobHash != m_JobHash || m_JobId == 0 || m_Tiles.size() != renderer.GetTileCount())
+        {
+            // Results still out for the last job are dropped by their job id
+            m_JobHash = jobHash;
+            m_JobId++;
+            m_Tiles.assign(renderer.GetTileCount(), {});
+            renderer.ResetFrameIndex();
+
+            JobHeader job = {};
+            job.Width = renderer.GetWidth();
+            job.Height = renderer.GetHeight();
+            job.CameraPosition = camera.GetPosition();
+            job.CameraDirection = camera.GetDirection();
+            job.VerticalFOV = camera.GetVerticalFOV();
+            job.NearClip = camera.GetNearClip();
+            job.FarClip = camera.GetFarClip();
+            job.Settings = settings;
+
+            m_Job.clear();
+            ByteWriter writer(m_Job);
+            writer.Write(job);
+            WriteScene(scene, m_Job);
+        }
+
+        m_TargetFrames = frames;
+        auto lastWorker = Clock::now();
+        while (true)
+        {
+            const std::vector<uint32_t>& tileFrames = renderer.GetTileFrames();
+            if (std::all_of(tileFrames.begin(), tileFrames.end(), [frames](uint32_t count) { return count >= frames; }))
+                break;
+
+            Update(&renderer, 1);
+
+            const auto now = Clock::now();
+            if (m_Workers.empty())
+            {
+                if (std::chrono::duration<double>(now - lastWorker).count() > NoWorkerTimeout)
+                    return false;
+                continue;
+            }
+            lastWorker = now;
+
+            for (size_t i = 0; i < m_Workers.size(); i++)
+            {
+                Worker& worker = *m_Workers[i];
+                while (worker.Ready && worker.Socket.IsOpen() && worker.Assignments.size() < MaxAssignmentsPerWorker)
+                {
+                    // Tiles nobody works on first, then another copy of the ones that are late. Each copy
+                    // moves the deadline, so tiles whose copies all hang still get a new one after it.
+                    const uint32_t tileCount = (uint32_t)m_Tiles.size();
+                    uint32_t tile = tileCount;
+                    for (uint32_t n = 0; n < tileCount && tile == tileCount; n++)
+                    {
+                        const uint32_t candidate = (m_TileCursor + n) % tileCount;
+                        if (m_Tiles[candidate].Copies == 0 && tileFrames[candidate] < frames)
+                            tile = candidate;
+                    }
+                    if (tile == tileCount)
+                    {
+                        for (uint32_t candidate = 0; candidate < tileCount && tile == tileCount; candidate++)
+                        {
+                            const TileState& state = m_Tiles[candidate];
+                            if (state.Copies > 0 && now > state.Deadline && tileFrames[candidate] < frames &&
+                                std::none_of(worker.Assignments.begin(), worker.Assignments.end(), [&](uint32_t id)
+                                    { return m_Assignments[id].Tile == candidate; }))
+                            {
+                                tile = candidate;
+                                m_Stats.Reissued++;
+                            }
+                        }
+                    }
+                    if (tile == tileCount)
+                        break;
+
+                    m_TileCursor = (tile + 1) % tileCount;
+                    Assign(worker, renderer, tile, frames - tileFrames[tile]);
+                }
+            }
+        }
+
+        m_Stats.Workers = (uint32_t)m_Workers.size();
+        m_Stats.Seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        return true;
+    }
+
+    void Coordinator::Assign(Worker& worker, Renderer& renderer, uint32_t tile, uint32_t frames)
+    {
+        if (worker.JobId != m_JobId)
+        {
+            if (!Network::SendMessage(worker.Socket, (uint32_t)MessageType::Job, &m_JobId, sizeof(m_JobId), m_Job.data(), m_Job.size()))
+            {
+                worker.Socket.Close();
+                return;
+            }
+            worker.JobId = m_JobId;
+        }
+
+        // Sized to take about the same time on every worker, whatever its speed
+        const Renderer::Rect rect = renderer.GetTileRect(tile);
+        const float pixels = (float)(rect.Width * rect.Height);
+        uint32_t frameCount = 1;
+        if (worker.SecondsPerSample > 0.0f)
+            frameCount = std::clamp((uint32_t)(AssignmentSeconds / (worker.SecondsPerSample * pixels)), 1u, frames);
+
+        const AssignmentMessage message = { m_JobId, m_NextAssignmentId++, tile, renderer.GetTileFrames()[tile] + 1, frameCount };
+        if (!Network::SendMessage(worker.Socket, (uint32_t)MessageType::Assignment, &message, sizeof(message)))
+        {
+            worker.Socket.Close();
+            return;
+        }
+        m_Assignments[message.Id] = { message.JobId, worker.Id, tile, message.FirstFrame, message.FrameCount };
+        worker.Assignments.push_back(message.Id);
+        m_Stats.Assignments++;
+
+        // The worker gets to everything queued before this one first
+        TileState& state = m_Tiles[tile];
+        state.Copies++;
+        double timeout = FirstTimeout;
+        if (worker.SecondsPerSample > 0.0f)
+        {
+            double queued = 0.0;
+            for (uint32_t id : worker.Assignments)
+            {
+                const Assignment& assignment = m_Assignments[id];
+                const Renderer::Rect queuedRect = renderer.GetTileRect(assignment.Tile);
+                queued += (double)assignment.FrameCount * queuedRect.Width * queuedRect.Height * worker.SecondsPerSample;
+            }
+            timeout = std::max(MinTimeout, queued * TimeoutFactor);
+        }
+        state.Deadline = Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(timeout));
+    }
+
+    void Coordinator::Update(Renderer* renderer, int timeout)
+    {
+        std::vector<Network::Socket*> sockets;
+        sockets.push_back(&m_Listener);
+        for (const std::unique_ptr<Worker>& worker : m_Workers)
+            sockets.push_back(&worker->Socket);
+
+        std::vector<uint8_t> readable(sockets.size());
+        if (Network::Poll(sockets.data(), sockets.size(), readable.data(), timeout) < 0)
+            return;
+
+        // Backwards, lost workers are removed on the way
+        for (size_t i = m_Workers.size(); i-- > 0;)
+        {
+            Worker& worker = *m_Workers[i];
+            if (!worker.Socket.IsOpen() || (readable[i + 1] && !ReadMessage(worker, renderer)))
+                RemoveWorker(i);
+        }
+
+        if (readable[0])
+        {
+            auto worker = std::make_unique<Worker>();
+            if (m_Listener.Accept(worker->Socket))
+            {
+                // A worker that stops halfway through a message must not stall every other one
+                worker->Socket.SetReceiveTimeout(ReceiveTimeout);
+                worker->Id = m_NextWorkerId++;
+                m_Workers.push_back(std::move(worker));
+            }
+        }
+    }
+
+    bool Coordinator::ReadMessage(Worker& worker, Renderer* renderer)
+    {
+        Network::MessageHeader header;
+        if (!Network::ReceiveMessage(worker.Socket, header, m_Message, MaxMessageSize))
+            return false;
+
+        if (header.Type == (uint32_t)MessageType::Hello)
+        {
+            const Hello expected = MakeHello();
+            worker.Ready = m_Message.size() == sizeof(Hello) && std::memcmp(m_Message.data(), &expected, sizeof(Hello)) == 0;
+            return worker.Ready;
+        }
+        if (header.Type != (uint32_t)MessageType::Result || m_Message.size() < sizeof(ResultHeader))
+            return false;
+
+        ResultHeader result;
+        std::memcpy(&result, m_Message.data(), sizeof(result));
+        auto it = m_Assignments.find(result.Id);
+        if (it == m_Assignments.end() || it->second.WorkerId != worker.Id)
+            return false;
+
+        const Assignment assignment = it->second;
+        m_Assignments.erase(it);
+        worker.Assignments.erase(std::find(worker.Assignments.begin(), worker.Assignments.end(), result.Id));
+
+        // Results of an earlier job, or of a size the renderer no longer has, only tell the speed
+        const bool current = renderer && assignment.JobId == m_JobId;
+        if (!current)
+        {
+            m_Stats.Discarded++;
+            return true;
+        }
+
+        const Renderer::Rect rect = renderer->GetTileRect(assignment.Tile);
+        const size_t pixels = (size_t)rect.Width * rect.Height;
+        if (m_Message.size() != sizeof(ResultHeader) + pixels * sizeof(glm::vec3))
+            return false;
+
+        // Smoothed, one tile may be much cheaper than the next
+        const float secondsPerSample = result.Seconds / (float)(pixels * assignment.FrameCount);
+        worker.SecondsPerSample = worker.SecondsPerSample > 0.0f
+            ? worker.SecondsPerSample * 0.7f + secondsPerSample * 0.3f : secondsPerSample;
+
+        // The first copy of the frames to come back is merged, any other arrives too late
+        TileState& state = m_Tiles[assignment.Tile];
+        const bool next = assignment.FirstFrame == renderer->GetTileFrames()[assignment.Tile] + 1;
+        if (next && renderer->MergeTileSamples(assignment.Tile, assignment.FirstFrame, assignment.FrameCount,
+            (const glm::vec3*)(m_Message.data() + sizeof(ResultHeader)), result.Footprint))
+        {
+            state.Copies = 0;
+        }
+        else
+        {
+            if (next)
+                state.Copies--;
+            m_Stats.Discarded++;
+        }
+        return true;
+    }
+
+    void Coordinator::RemoveWorker(size_t index)
+    {
+        Worker& worker = *m_Workers[index];
+        for (uint32_t id : worker.Assignments)
+        {
+            auto it = m_Assignments.find(id);
+            if (it == m_Assignments.end())
+                continue;
+
+            // Frames only it was working on go to the next worker with room
+            const Assignment& assignment = it->second;
+            if (assignment.JobId == m_JobId && assignment.Tile < m_Tiles.size() && m_Tiles[assignment.Tile].Copies > 0 &&
+                --m_Tiles[assignment.Tile].Copies == 0)
+            {
+                m_Stats.Reissued++;
+            }
+            m_Assignments.erase(it);
+        }
+        m_Workers.erase(m_Workers.begin() + index);
+        m_Stats.LostWorkers++;
+    }
+
+    bool RunWorker(const std::string& address)
+    {
+        Network::Socket socket;
+        const Hello hello = MakeHello();
+        if (!socket.Connect(address, ConnectTimeout) ||
+            !Network::SendMessage(socket, (uint32_t)MessageType::Hello, &hello, sizeof(hello)))
+            return false;
+
+        Renderer renderer(true);
+        Scene scene;
+        std::unique_ptr<Camera> camera;
+        uint32_t jobId = 0;
+
+        Network::MessageHeader header;
+        std::vector<uint8_t> message;
+        std::vector<glm::vec3> sums;
+        while (Network::ReceiveMessage(socket, header, message, MaxMessageSize))
+        {
+            if (header.Type == (uint32_t)MessageType::Job)
+            {
+                ByteReader reader(message.data(), message.size());
+                JobHeader job;
+                if (!reader.Read(jobId) || !reader.Read(job) ||
+                    !ReadScene(message.data() + sizeof(jobId) + sizeof(job), reader.GetRemaining(), scene))
+                {
+                    return false;
+                }
+
+                // Tiles come one at a time, the worker processes are the parallelism. Pinning, NUMA
+                // placement and the texture cache stay as this machine has them.
+                Renderer::Settings& settings = renderer.GetSettings();
+                const Renderer::Settings local = settings;
+                settings = job.Settings;
+                settings.ThreadCount = 1;
+                settings.Affinity = local.Affinity;
+                settings.NUMALocal = local.NUMALocal;
+                settings.TextureCacheSize = local.TextureCacheSize;
+                renderer.OnResize(job.Width, job.Height);
+                camera = std::make_unique<Camera>(job.VerticalFOV, job.NearClip, job.FarClip);
+                camera->OnResize(job.Width, job.Height);
+                camera->SetView(job.CameraPosition, job.CameraDirection);
+            }
+            else if (header.Type == (uint32_t)MessageType::Assignment && message.size() == sizeof(AssignmentMessage))
+            {
+                AssignmentMessage assignment;
+                std::memcpy(&assignment, message.data(), sizeof(assignment));
+                if (!camera || assignment.JobId != jobId || assignment.Tile >= renderer.GetTileCount())
+                    return false;
+
+                ResultHeader result;
+                std::memset(&result, 0, sizeof(result));
+                result.Id = assignment.Id;
+                const auto start = std::chrono::steady_clock::now();
+                renderer.RenderTileSamples(scene, *camera, assignment.Tile, assignment.FirstFrame, assignment.FrameCount,
+                    sums, result.Footprint);
+                result.Seconds = std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count();
+
+                if (!Network::SendMessage(socket, (uint32_t)MessageType::Result, &result, sizeof(result), sums.data(),
+                    sums.size() * sizeof(glm::vec3)))
+                    return true;
+            }
+            else
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+}
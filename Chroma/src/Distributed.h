@@ -0,0 +1,102 @@
+#pragma once
+
+#include "Network.h"
+#include "Renderer.h"
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Renders tiles in worker processes and merges their samples into the image of one renderer. Every
+// worker gets the scene, camera and settings once per job and then single tiles with a range of
+// frames. Samples are seeded by their frame within the tile, which worker renders them does not
+// matter. Workers and coordinator have to be the same build, messages hold data as it is in memory.
+namespace Distributed {
+
+    struct Stats
+    {
+        uint32_t Workers = 0;      // Connected at the end
+        uint32_t LostWorkers = 0;
+        uint32_t Assignments = 0;
+        uint32_t Reissued = 0;     // Assignments handed out again, after a timeout or a lost worker
+        uint32_t Discarded = 0;    // Results that came after another copy of the frames was merged
+        double Seconds = 0.0;
+    };
+
+    // Hands out tiles to the workers connected to it. Workers may connect or go away at any time,
+    // frames of a lost or late worker go to another one.
+    class Coordinator
+    {
+    public:
+        bool Listen(const std::string& address);
+        void Close();
+
+        // False if fewer connected within timeout seconds
+        bool WaitForWorkers(uint32_t count, double timeout);
+
+        // Renders every tile up to frames frames into the renderer, which has to have the size of the
+        // camera. Tiles already holding samples of the same job are continued. False if it was left
+        // without workers for too long.
+        bool Render(Renderer& renderer, const Scene& scene, const Camera& camera, uint32_t frames);
+
+        uint32_t GetWorkerCount() const { return (uint32_t)m_Workers.size(); }
+        const Stats& GetStats() const { return m_Stats; }
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        struct Worker
+        {
+            Network::Socket Socket;
+            uint32_t Id = 0;
+            uint32_t JobId = 0;            // Last job it was sent
+            bool Ready = false;            // Said hello with a matching build
+            float SecondsPerSample = 0.0f; // Per pixel and frame, 0 until the first result
+            std::vector<uint32_t> Assignments;
+        };
+
+        struct Assignment
+        {
+            uint32_t JobId;
+            uint32_t WorkerId;
+            uint32_t Tile;
+            uint32_t FirstFrame, FrameCount;
+        };
+
+        struct TileState
+        {
+            uint32_t Copies = 0;          // Assignments of its next frames still out
+            Clock::time_point Deadline;   // Of the last copy sent, another one goes out after it
+        };
+
+        // Accepts new workers and reads the messages waiting for at most timeout milliseconds. Without
+        // a renderer results are only counted.
+        void Update(Renderer* renderer, int timeout);
+        bool ReadMessage(Worker& worker, Renderer* renderer);
+        void RemoveWorker(size_t index);
+        void Assign(Worker& worker, Renderer& renderer, uint32_t tile, uint32_t frames);
+    private:
+        Network::Socket m_Listener;
+        std::vector<std::unique_ptr<Worker>> m_Workers;
+        uint32_t m_NextWorkerId = 1;
+
+        std::vector<uint8_t> m_Job;   // Message every worker is sent before its first assignment of it
+        uint32_t m_JobId = 0;
+        uint64_t m_JobHash = 0;
+        uint32_t m_TargetFrames = 0;
+        std::vector<TileState> m_Tiles;
+        uint32_t m_TileCursor = 0;
+
+        std::unordered_map<uint32_t, Assignment> m_Assignments;
+        uint32_t m_NextAssignmentId = 1;
+
+        std::vector<uint8_t> m_Message;
+        Stats m_Stats;
+    };
+
+    // Connects to a coordinator and renders what it assigns until it closes the connection. False
+    // if there was no coordinator or it sent something this build does not understand.
+    bool RunWorker(const std::string& address);
+}
@@ -0,0 +1,166 @@
+#pragma once
+
+#include "Ray.h"
+#include "Scene.h"
+#include "Utils.h"
+
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+// What the paths through a tile interacted with since its accumulation last restarted. An edit only
+// restarts the tiles whose footprint it may have touched, the samples of the others stay valid.
+// Footprints are conservative, they may claim more than the paths touched but never less.
+namespace Footprint {
+
+    // Bloom filter over the shapes that were hit, two bits per shape
+    constexpr uint32_t ObjectBits = 512;
+
+    struct Set
+    {
+        uint64_t Objects[ObjectBits / 64];
+        uint64_t Materials;  // One bit per material index modulo 64
+        glm::vec3 Min, Max;  // Bounds of every path segment
+
+        void Clear()
+        {
+            for (uint64_t& word : Objects)
+                word = 0;
+            Materials = 0;
+            Min = glm::vec3(std::numeric_limits<float>::max());
+            Max = glm::vec3(-std::numeric_limits<float>::max());
+        }
+
+        void AddHit(ShapeType type, uint32_t index, uint32_t materialIndex)
+        {
+            const uint32_t hash = GetObjectHash(type, index);
+            Objects[(hash % ObjectBits) / 64] |= 1ull << (hash % 64);
+            Objects[((hash >> 16) % ObjectBits) / 64] |= 1ull << ((hash >> 16) % 64);
+            Materials |= 1ull << (materialIndex % 64);
+        }
+
+        void AddSegment(const glm::vec3& from, const glm::vec3& to)
+        {
+            Min = glm::min(Min, glm::min(from, to));
+            Max = glm::max(Max, glm::max(from, to));
+        }
+
+        void Add(const Set& other)
+        {
+            for (uint32_t i = 0; i < ObjectBits / 64; i++)
+                Objects[i] |= other.Objects[i];
+            Materials |= other.Materials;
+            Min = glm::min(Min, other.Min);
+            Max = glm::max(Max, other.Max);
+        }
+
+        bool MayContainObject(ShapeType type, uint32_t index) const
+        {
+            const uint32_t hash = GetObjectHash(type, index);
+            return (Objects[(hash % ObjectBits) / 64] & (1ull << (hash % 64))) &&
+                (Objects[((hash >> 16) % ObjectBits) / 64] & (1ull << ((hash >> 16) % 64)));
+        }
+
+        bool MayContainMaterial(uint32_t materialIndex) const
+        {
+            return (Materials & (1ull << (materialIndex % 64))) != 0;
+        }
+
+        bool MayOverlap(const glm::vec3& min, const glm::vec3& max) const
+        {
+            return Min.x <= max.x && Min.y <= max.y && Min.z <= max.z &&
+                Max.x >= min.x && Max.y >= min.y && Max.z >= min.z;
+        }
+
+        // Whether any path segment may cross the plane, or ran along it
+        bool MayCross(const Plane& plane) const
+        {
+            if (Min.x > Max.x)
+                return false;
+
+            // Signed distances of the nearest and farthest corner along the normal
+            const glm::vec3 center = (Min + Max) * 0.5f;
+            const glm::vec3 extent = (Max - Min) * 0.5f;
+            const float distance = glm::dot(plane.Normal, center) + plane.Distance;
+            const float radius = glm::dot(glm::abs(plane.Normal), extent);
+            return glm::abs(distance) <= radius + 1e-4f;
+        }
+
+        static uint32_t GetObjectHash(ShapeType type, uint32_t index)
+        {
+            return Utils::PCG_Hash(((uint32_t)type << 30) ^ index);
+        }
+    };
+
+    // Distance at which a ray leaves the box, negative when it misses it
+    inline float GetExitDistance(const Ray& ray, const glm::vec3& min, const glm::vec3& max)
+    {
+        const glm::vec3 invDirection = 1.0f / ray.Direction;
+        const glm::vec3 t0 = (min - ray.Origin) * invDirection;
+        const glm::vec3 t1 = (max - ray.Origin) * invDirection;
+        const glm::vec3 tSmall = glm::min(t0, t1);
+        const glm::vec3 tBig = glm::max(t0, t1);
+
+        const float tNear = glm::max(glm::max(tSmall.x, tSmall.y), glm::max(tSmall.z, 0.0f));
+        const float tFar = glm::min(glm::min(tBig.x, tBig.y), tBig.z);
+        return tNear <= tFar ? tFar : -1.0f;
+    }
+
+    // What an edit may have changed, tested against the footprint of every tile
+    struct Query
+    {
+        struct Object
+        {
+            ShapeType Type;
+            uint32_t Index;
+        };
+
+        struct Bounds
+        {
+            glm::vec3 Min, Max;
+        };
+
+        std::vector<Object> Objects;      // Paths that hit them saw the old state
+        std::vector<uint32_t> Materials;
+        std::vector<Bounds> Regions;      // Paths that crossed them may hit the new state
+        std::vector<Plane> Planes;
+
+        bool IsEmpty() const { return Objects.empty() && Materials.empty() && Regions.empty() && Planes.empty(); }
+        size_t GetSize() const { return Objects.size() + Materials.size() + Regions.size() + Planes.size(); }
+
+        void Clear()
+        {
+            Objects.clear();
+            Materials.clear();
+            Regions.clear();
+            Planes.clear();
+        }
+
+        bool Touches(const Set& set) const
+        {
+            for (const Object& object : Objects)
+            {
+                if (set.MayContainObject(object.Type, object.Index))
+                    return true;
+            }
+            for (uint32_t material : Materials)
+            {
+                if (set.MayContainMaterial(material))
+                    return true;
+            }
+            for (const Bounds& region : Regions)
+            {
+                if (set.MayOverlap(region.Min, region.Max))
+                    return true;
+            }
+            for (const Plane& plane : Planes)
+            {
+                if (set.MayCross(plane))
+                    return true;
+            }
+            return false;
+        }
+    };
+
+}
@@ -0,0 +1,188 @@
+#include "FrameOutput.h"
+
+#include <cstring>
+
+namespace {
+
+    constexpr uint64_t Alignment = 64;
+
+    uint64_t AlignUp(uint64_t value) { return (value + Alignment - 1) & ~(Alignment - 1); }
+
+    // Bytes per pixel of every channel, in the order of the Channel bits
+    constexpr uint64_t ChannelSizes[SharedFrame::ChannelCount] = { 4, 12, 4 };
+
+}
+
+bool FrameOutput::Open(const std::string& name, uint32_t channels, uint32_t slotCount)
+{
+    Close();
+    if (name.empty() || slotCount < 2)
+        return false;
+
+    m_Name = name;
+    m_Channels = channels | SharedFrame::Color;
+    m_SlotCount = slotCount;
+    return true;
+}
+
+void FrameOutput::Close()
+{
+    Release();
+    m_Name.clear();
+}
+
+void FrameOutput::Release()
+{
+    // Readers still holding the memory see it is gone and look the name up again
+    if (m_Memory.IsOpen())
+        GetHeader()->Closed.store(1, std::memory_order_release);
+    m_Memory.Close();
+}
+
+SharedFrame::SlotHeader* FrameOutput::GetSlot(uint32_t slot)
+{
+    const SharedFrame::Header* header = GetHeader();
+    return (SharedFrame::SlotHeader*)(m_Memory.Data() + header->SlotOffset + header->SlotSize * slot);
+}
+
+bool FrameOutput::Prepare(uint32_t width, uint32_t height, uint64_t& slotFrame)
+{
+    slotFrame = 0;
+    if (!IsOpen() || width == 0 || height == 0)
+        return false;
+
+    if (!m_Memory.IsOpen() || GetHeader()->Width != width || GetHeader()->Height != height)
+    {
+        Release();
+
+        uint64_t offsets[SharedFrame::ChannelCount] = {};
+        uint64_t slotSize = AlignUp(sizeof(SharedFrame::SlotHeader));
+        for (uint32_t channel = 0; channel < SharedFrame::ChannelCount; channel++)
+        {
+            if (m_Channels & (1u << channel))
+            {
+                offsets[channel] = slotSize;
+                slotSize = AlignUp(slotSize + ChannelSizes[channel] * width * height);
+            }
+        }
+        const uint64_t slotOffset = AlignUp(sizeof(SharedFrame::Header));
+        if (!m_Memory.Create(m_Name, (size_t)(slotOffset + slotSize * m_SlotCount)))
+            return false;
+
+        SharedFrame::Header* header = GetHeader();
+        header->Version = SharedFrame::Version;
+        header->SlotCount = m_SlotCount;
+        header->Width = width;
+        header->Height = height;
+        header->Channels = m_Channels;
+        header->SlotOffset = slotOffset;
+        header->SlotSize = slotSize;
+        std::memcpy(header->ChannelOffsets, offsets, sizeof(offsets));
+
+        // A reader that finds the magic finds everything before it
+        std::atomic_thread_fence(std::memory_order_release);
+        std::memcpy(header->Magic, SharedFrame::Magic, sizeof(SharedFrame::Magic));
+    }
+
+    slotFrame = GetSlot(SharedFrame::GetSlot(m_FrameNumber + 1, m_SlotCount))->Frame;
+    return true;
+}
+
+FrameOutput::Frame FrameOutput::BeginFrame()
+{
+    Frame frame;
+    frame.Number = m_FrameNumber + 1;
+
+    SharedFrame::SlotHeader* slot = GetSlot(SharedFrame::GetSlot(frame.Number, m_SlotCount));
+    slot->Sequence.store(slot->Sequence.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot->Frame = frame.Number;
+
+    const uint64_t* offsets = GetHeader()->ChannelOffsets;
+    uint8_t* data = (uint8_t*)slot;
+    frame.Color = (uint32_t*)(data + offsets[0]);
+    if (offsets[1])
+        frame.Radiance = (float*)(data + offsets[1]);
+    if (offsets[2])
+        frame.Samples = (uint32_t*)(data + offsets[2]);
+    return frame;
+}
+
+void FrameOutput::EndFrame(const Frame& frame, uint32_t accumulatedFrames, uint32_t samplesPerPixel, double accumulationTime)
+{
+    SharedFrame::SlotHeader* slot = GetSlot(SharedFrame::GetSlot(frame.Number, m_SlotCount));
+    slot->AccumulatedFrames = accumulatedFrames;
+    slot->SamplesPerPixel = samplesPerPixel;
+    slot->AccumulationTime = accumulationTime;
+    slot->Sequence.store(slot->Sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+
+    GetHeader()->Latest.store(frame.Number, std::memory_order_release);
+    m_FrameNumber = frame.Number;
+}
+
+bool FrameReader::Open(const std::string& name)
+{
+    if (!m_Memory.Open(name))
+        return false;
+
+    // The writer may still be setting the memory up, the magic goes in last
+    const SharedFrame::Header* header = GetHeader();
+    bool valid = m_Memory.Size() >= sizeof(SharedFrame::Header) &&
+        std::memcmp(header->Magic, SharedFrame::Magic, sizeof(SharedFrame::Magic)) == 0;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    valid = valid && header->Version == SharedFrame::Version && header->SlotCount > 0 &&
+        m_Memory.Size() >= header->SlotOffset + header->SlotSize * header->SlotCount;
+    if (!valid)
+        m_Memory.Close();
+    return valid;
+}
+
+bool FrameReader::IsClosed() const
+{
+    return !IsOpen() || GetHeader()->Closed.load(std::memory_order_acquire) != 0;
+}
+
+bool FrameReader::Acquire(View& view, uint64_t after) const
+{
+    if (!IsOpen())
+        return false;
+
+    const SharedFrame::Header* header = GetHeader();
+    const uint64_t latest = header->Latest.load(std::memory_order_acquire);
+    if (latest == 0 || latest <= after)
+        return false;
+
+    const uint32_t slotIndex = SharedFrame::GetSlot(latest, header->SlotCount);
+    const uint8_t* data = m_Memory.Data() + header->SlotOffset + header->SlotSize * slotIndex;
+    const SharedFrame::SlotHeader* slot = (const SharedFrame::SlotHeader*)data;
+
+    view.Sequence = slot->Sequence.load(std::memory_order_acquire);
+    if (view.Sequence & 1)
+        return false;
+
+    // Lapped by the writer in the meantime the slot holds a newer frame, which is just as complete
+    view.Frame = slot->Frame;
+    view.Slot = slotIndex;
+    view.Width = header->Width;
+    view.Height = header->Height;
+    view.AccumulatedFrames = slot->AccumulatedFrames;
+    view.SamplesPerPixel = slot->SamplesPerPixel;
+    view.AccumulationTime = slot->AccumulationTime;
+
+    const uint64_t* offsets = header->ChannelOffsets;
+    view.Color = (const uint32_t*)(data + offsets[0]);
+    view.Radiance = offsets[1] ? (const float*)(data + offsets[1]) : nullptr;
+    view.Samples = offsets[2] ? (const uint32_t*)(data + offsets[2]) : nullptr;
+
+    return true;
+}
+
+bool FrameReader::IsValid(const View& view) const
+{
+    const SharedFrame::Header* header = GetHeader();
+    const SharedFrame::SlotHeader* slot =
+        (const SharedFrame::SlotHeader*)(m_Memory.Data() + header->SlotOffset + header->SlotSize * view.Slot);
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return slot->Sequence.load(std::memory_order_relaxed) == view.Sequence;
+}
@@ -0,0 +1,140 @@
+#pragma once
+
+#include "Memory.h"
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Layout of the shared memory resolved frames are published in, for other processes to map. It
+// holds a ring of slots, each a complete image with its channels one after the other. The writer
+// fills the slot after the newest one and readers take the newest, so a reader has SlotCount - 1
+// frames of time before the writer comes back to it. Every slot is guarded by a sequence lock:
+// odd while it is written, and a reader that sees it change while reading drops what it read.
+namespace SharedFrame {
+
+    constexpr char Magic[8] = { 'C', 'H', 'R', 'O', 'M', 'A', 'F', 'B' };
+    constexpr uint32_t Version = 1;
+
+    enum Channel : uint32_t
+    {
+        Color = 1 << 0,     // RGBA8 per pixel, the displayed image
+        Radiance = 1 << 1,  // Linear RGB float per pixel, the mean of the accumulated samples
+        Samples = 1 << 2,   // uint32 per pixel, samples accumulated
+    };
+
+    constexpr uint32_t ChannelCount = 3;
+
+    struct Header
+    {
+        char Magic[8];
+        uint32_t Version;
+        uint32_t SlotCount;
+        uint32_t Width, Height;
+        uint32_t Channels;
+        uint32_t Reserved;
+        uint64_t SlotOffset;                // From the start of the memory to the first slot
+        uint64_t SlotSize;                  // Including the slot header
+        uint64_t ChannelOffsets[ChannelCount]; // From the start of a slot, 0 for a missing channel
+        std::atomic<uint64_t> Latest;       // Number of the newest complete frame, 0 before the first
+        std::atomic<uint32_t> Closed;       // Set when the writer is gone or moved to memory of another size
+    };
+
+    struct alignas(64) SlotHeader
+    {
+        std::atomic<uint64_t> Sequence;     // Odd while the slot is written
+        uint64_t Frame;                     // Number of the frame the slot holds, from 1 on
+        uint32_t AccumulatedFrames;         // Of the image, restarted tiles hold fewer
+        uint32_t SamplesPerPixel;           // Fewest samples of any pixel
+        double AccumulationTime;            // In seconds since accumulation restarted
+    };
+
+    // Readers of another process only see the memory, the atomics must not hide a lock
+    static_assert(std::atomic<uint64_t>::is_always_lock_free && std::atomic<uint32_t>::is_always_lock_free,
+        "shared frame atomics have to be lock free");
+
+    inline uint32_t GetSlot(uint64_t frame, uint32_t slotCount) { return (uint32_t)((frame - 1) % slotCount); }
+
+}
+
+// Writer side, the renderer fills it in ResolveImage() when one is attached
+class FrameOutput
+{
+public:
+    struct Frame
+    {
+        uint64_t Number = 0;
+        uint32_t* Color = nullptr;      // Rows of the image, nullptr for a missing channel
+        float* Radiance = nullptr;
+        uint32_t* Samples = nullptr;
+    };
+public:
+    FrameOutput() = default;
+    ~FrameOutput() { Close(); }
+
+    FrameOutput(const FrameOutput&) = delete;
+    FrameOutput& operator=(const FrameOutput&) = delete;
+
+    // The memory itself is created by the first Prepare(), with the image size. Color is always there.
+    bool Open(const std::string& name, uint32_t channels, uint32_t slotCount = 3);
+    void Close();
+    bool IsOpen() const { return !m_Name.empty(); }
+
+    const std::string& GetName() const { return m_Name; }
+    uint32_t GetChannels() const { return m_Channels; }
+    uint64_t GetFrameCount() const { return m_FrameNumber; }
+
+    // Creates the memory for the size unless it has it already, and returns the number of the frame
+    // the slot of the next one still holds, 0 if none. Only what changed since then has to be written.
+    bool Prepare(uint32_t width, uint32_t height, uint64_t& slotFrame);
+    Frame BeginFrame();
+    void EndFrame(const Frame& frame, uint32_t accumulatedFrames, uint32_t samplesPerPixel, double accumulationTime);
+private:
+    SharedFrame::Header* GetHeader() { return (SharedFrame::Header*)m_Memory.Data(); }
+    SharedFrame::SlotHeader* GetSlot(uint32_t slot);
+    void Release();
+private:
+    Memory::SharedMemory m_Memory;
+    std::string m_Name;
+    uint32_t m_Channels = 0;
+    uint32_t m_SlotCount = 0;
+    uint64_t m_FrameNumber = 0;     // Of the newest published frame, it goes on across sizes
+};
+
+// Reader side, nothing is copied: a view points into the shared memory and is checked afterwards
+class FrameReader
+{
+public:
+    struct View
+    {
+        uint64_t Frame = 0;
+        uint64_t Sequence = 0;
+        uint32_t Slot = 0;
+        uint32_t Width = 0, Height = 0;
+        uint32_t AccumulatedFrames = 0;
+        uint32_t SamplesPerPixel = 0;
+        double AccumulationTime = 0.0;
+        const uint32_t* Color = nullptr;
+        const float* Radiance = nullptr;
+        const uint32_t* Samples = nullptr;
+    };
+public:
+    bool Open(const std::string& name);
+    void Close() { m_Memory.Close(); }
+    bool IsOpen() const { return m_Memory.IsOpen(); }
+
+    // The writer went away or moved to memory of another size, Open() again
+    bool IsClosed() const;
+    uint32_t GetChannels() const { return GetHeader()->Channels; }
+
+    // Points the view at the newest frame if it is newer than after. False if there is none, or the
+    // writer is in the middle of it already.
+    bool Acquire(View& view, uint64_t after = 0) const;
+    // Whether the slot stayed untouched since Acquire(). Check it after reading from the view,
+    // anything read is garbage when it is false.
+    bool IsValid(const View& view) const;
+private:
+    const SharedFrame::Header* GetHeader() const { return (const SharedFrame::Header*)m_Memory.Data(); }
+private:
+    Memory::SharedMemory m_Memory;
+};
@@ -0,0 +1,50 @@
+#include "Heatmap.h"
+
+namespace Heatmap {
+
+    const char* GetMetricName(Metric metric)
+    {
+        switch (metric)
+        {
+            case Metric::None:              return "none";
+            case Metric::IntersectionTests: return "tests";
+            case Metric::TraversalSteps:    return "steps";
+            case Metric::Bounces:           return "bounces";
+            case Metric::Cycles:            return "cycles";
+        }
+        return "";
+    }
+
+    glm::vec3 Colormap(float x)
+    {
+        // Polynomial fit of Google's Turbo colormap
+        const glm::vec4 red(0.13572138f, 4.61539260f, -42.66032258f, 132.13108234f);
+        const glm::vec4 green(0.09140261f, 2.19418839f, 4.84296658f, -14.18503333f);
+        const glm::vec4 blue(0.10667330f, 12.64194608f, -60.58204836f, 110.36276771f);
+        const glm::vec2 red2(-152.94239396f, 59.28637943f);
+        const glm::vec2 green2(4.27729857f, 2.82956604f);
+        const glm::vec2 blue2(-89.90310912f, 27.34824973f);
+
+        x = glm::clamp(x, 0.0f, 1.0f);
+        const glm::vec4 v4(1.0f, x, x * x, x * x * x);
+        const glm::vec2 v2 = glm::vec2(v4.z, v4.w) * v4.z;
+
+        return glm::clamp(glm::vec3(
+            glm::dot(v4, red) + glm::dot(v2, red2),
+            glm::dot(v4, green) + glm::dot(v2, green2),
+            glm::dot(v4, blue) + glm::dot(v2, blue2)), 0.0f, 1.0f);
+    }
+
+    void ResolveSpan(const float* cost, uint32_t* output, uint32_t count, float scale)
+    {
+        for (uint32_t i = 0; i < count; i++)
+        {
+            glm::vec3 color = Colormap(cost[i] * scale);
+            uint32_t r = (uint32_t)(color.r * 255.0f + 0.5f);
+            uint32_t g = (uint32_t)(color.g * 255.0f + 0.5f);
+            uint32_t b = (uint32_t)(color.b * 255.0f + 0.5f);
+            output[i] = 0xff000000 | (b << 16) | (g << 8) | r;
+        }
+    }
+
+}
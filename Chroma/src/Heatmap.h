@@ -0,0 +1,29 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cstdint>
+
+// False-colour debug view of what every pixel cost to render
+namespace Heatmap {
+
+    enum class Metric
+    {
+        None = 0,               // Regular shaded image
+        IntersectionTests = 1,  // Primitive tests, needs CHROMA_STATS
+        TraversalSteps = 2,     // BVH node bounds tested, needs CHROMA_STATS
+        Bounces = 3,            // Path segments traced
+        Cycles = 4              // Time stamp counter ticks
+    };
+
+    constexpr uint32_t MetricCount = 5;
+
+    // Short lower case name, used on the command line and in file names
+    const char* GetMetricName(Metric metric);
+
+    // Turbo colormap, x in [0, 1] from blue over green to red. Returns display ready colors.
+    glm::vec3 Colormap(float x);
+
+    // Maps count costs (multiplied by scale, so that the most expensive pixel ends up at 1) to packed RGBA8
+    void ResolveSpan(const float* cost, uint32_t* output, uint32_t count, float scale);
+
+}
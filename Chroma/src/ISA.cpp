@@ -0,0 +1,190 @@
+#include "ISA.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define CHROMA_ISA_X64 1
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+namespace ISA {
+
+    namespace {
+
+#if CHROMA_ISA_X64
+        void CPUID(uint32_t leaf, uint32_t subleaf, uint32_t registers[4])
+        {
+#ifdef _MSC_VER
+            __cpuidex((int*)registers, (int)leaf, (int)subleaf);
+#else
+            __cpuid_count(leaf, subleaf, registers[0], registers[1], registers[2], registers[3]);
+#endif
+        }
+
+        // Register state the OS saves on context switches
+        uint64_t ReadXCR0()
+        {
+#ifdef _MSC_VER
+            return _xgetbv(0);
+#else
+            uint32_t eax, edx;
+            __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+            return ((uint64_t)edx << 32) | eax;
+#endif
+        }
+#endif
+
+        Level DetectLevel()
+        {
+#if CHROMA_ISA_X64
+            uint32_t registers[4];
+            CPUID(0, 0, registers);
+            const uint32_t maxLeaf = registers[0];
+
+            CPUID(1, 0, registers);
+            const uint32_t features1 = registers[2];
+            const bool sse42 = (features1 & (1u << 19)) && (features1 & (1u << 20)); // SSE4.1 and SSE4.2
+            if (!sse42)
+                return Level::Generic;
+
+            // AVX needs the OS to save the upper halves of the registers (XCR0 bits 1 and 2)
+            const bool osxsave = (features1 & (1u << 27)) != 0;
+            const bool avx = (features1 & (1u << 28)) != 0;
+            const uint64_t xcr0 = osxsave ? ReadXCR0() : 0;
+            if (!avx || (xcr0 & 0x6) != 0x6 || maxLeaf < 7)
+                return Level::SSE42;
+
+            CPUID(7, 0, registers);
+            const uint32_t features7 = registers[1];
+            if (!(features7 & (1u << 5)))
+                return Level::SSE42;
+
+            // AVX-512F and the opmask / ZMM state (XCR0 bits 5 to 7)
+            if ((features7 & (1u << 16)) && (xcr0 & 0xe6) == 0xe6)
+                return Level::AVX512;
+            return Level::AVX2;
+#else
+            return Level::Generic;
+#endif
+        }
+
+        struct State
+        {
+            Level Supported = Level::Generic;
+            std::atomic<Level> Active{ Level::Generic };
+
+            State()
+            {
+                Supported = DetectLevel();
+                Active = Supported;
+
+                // Lets benchmarks and bug reports pin a lower level without rebuilding
+                Level level;
+                const char* name = std::getenv("CHROMA_ISA");
+                if (name && ParseLevel(name, level) && level <= Supported)
+                    Active = level;
+            }
+        };
+
+        State& GetState()
+        {
+            static State state;
+            return state;
+        }
+
+    }
+
+    void PlaneSet::Build(const std::vector<Plane>& planes)
+    {
+        Count = (uint32_t)planes.size();
+        PaddedCount = (Count + Padding - 1) / Padding * Padding;
+
+        // A zero normal makes every padding plane parallel to every ray
+        m_Data.assign((size_t)PaddedCount * 4, 0.0f);
+        float* normalX = m_Data.data();
+        float* normalY = normalX + PaddedCount;
+        float* normalZ = normalY + PaddedCount;
+        float* distance = normalZ + PaddedCount;
+
+        for (size_t i = 0; i < planes.size(); i++)
+        {
+            normalX[i] = planes[i].Normal.x;
+            normalY[i] = planes[i].Normal.y;
+            normalZ[i] = planes[i].Normal.z;
+            distance[i] = planes[i].Distance;
+        }
+
+        NormalX = normalX;
+        NormalY = normalY;
+        NormalZ = normalZ;
+        Distance = distance;
+    }
+
+    Level GetSupportedLevel()
+    {
+        return GetState().Supported;
+    }
+
+    Level GetLevel()
+    {
+        return GetState().Active.load(std::memory_order_relaxed);
+    }
+
+    bool SetLevel(Level level)
+    {
+        State& state = GetState();
+        if (level > state.Supported)
+            return false;
+
+        state.Active.store(level, std::memory_order_relaxed);
+        return true;
+    }
+
+    const KernelTable& GetKernels()
+    {
+        return GetKernels(GetLevel());
+    }
+
+    const KernelTable& GetKernels(Level level)
+    {
+        switch (level)
+        {
+            case Level::SSE42:  return GetSSE42Kernels();
+            case Level::AVX2:   return GetAVX2Kernels();
+            case Level::AVX512: return GetAVX512Kernels();
+            default:            return GetGenericKernels();
+        }
+    }
+
+    const char* GetLevelName(Level level)
+    {
+        switch (level)
+        {
+            case Level::Generic: return "generic";
+            case Level::SSE42:   return "sse4.2";
+            case Level::AVX2:    return "avx2";
+            case Level::AVX512:  return "avx512";
+        }
+        return "";
+    }
+
+    bool ParseLevel(const char* name, Level& level)
+    {
+        for (uint32_t i = 0; i < LevelCount; i++)
+        {
+            if (strcmp(name, GetLevelName((Level)i)) == 0)
+            {
+                level = (Level)i;
+                return true;
+            }
+        }
+        return false;
+    }
+
+}
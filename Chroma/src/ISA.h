@@ -0,0 +1,84 @@
+#pragma once
+
+#include "Ray.h"
+#include "Resolve.h"
+#include "Scene.h"
+
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+
+// Runtime instruction set dispatch. The hot kernels are compiled once per level, each in its own
+// translation unit built with that level's compiler flags (see premake5.lua), and the fastest
+// level the CPU and OS support is picked on first use. The rest of the renderer stays baseline x64.
+namespace ISA {
+
+    enum class Level
+    {
+        Generic = 0, // SSE2 on x64, plain C++ elsewhere
+        SSE42 = 1,
+        AVX2 = 2,
+        AVX512 = 3   // AVX-512F
+    };
+
+    constexpr uint32_t LevelCount = 4;
+
+    // Planes in structure of arrays form, padded with planes no ray can hit so every kernel
+    // can run whole vectors. Kernels only read the plain pointers.
+    struct PlaneSet
+    {
+        static constexpr uint32_t Padding = 16; // Lanes of the widest kernel
+
+        const float* NormalX = nullptr;
+        const float* NormalY = nullptr;
+        const float* NormalZ = nullptr;
+        const float* Distance = nullptr;
+        uint32_t Count = 0;       // Planes of the scene
+        uint32_t PaddedCount = 0; // Multiple of Padding
+
+        PlaneSet() = default;
+        PlaneSet(const PlaneSet&) = delete;
+        PlaneSet& operator=(const PlaneSet&) = delete;
+
+        void Build(const std::vector<Plane>& planes);
+    private:
+        std::vector<float> m_Data;
+    };
+
+    struct KernelTable
+    {
+        // Resolves the span in whole vectors and returns the number of pixels written, the caller
+        // resolves the remainder. lut is the sRGB table of Resolve, readable 3 bytes past its end.
+        uint32_t (*ResolveSpan)(const glm::vec4* accumulation, uint32_t* output, uint32_t count,
+            float scale, Resolve::Tonemapper tonemap, const uint8_t* lut);
+
+        // Index of the closest plane hit before hitDistance, which is lowered to it, or -1.
+        // Matches calling Renderer::IntersectPlane on every plane in order.
+        int32_t (*IntersectPlanes)(const Ray& ray, const PlaneSet& planes, float& hitDistance);
+
+        // Advances every seed by one Utils::RandomFloat step and stores the values
+        void (*RandomFloats)(uint32_t* seeds, float* values, uint32_t count);
+    };
+
+    // Highest level the CPU and OS support, detected once with cpuid
+    Level GetSupportedLevel();
+    // Level of the kernels in use. Defaults to the supported one, the CHROMA_ISA environment
+    // variable or SetLevel() can lower it.
+    Level GetLevel();
+    // Returns false and changes nothing when the CPU does not support the level
+    bool SetLevel(Level level);
+
+    const KernelTable& GetKernels();
+    const KernelTable& GetKernels(Level level);
+
+    const char* GetLevelName(Level level);
+    // Accepts the names of GetLevelName(), returns false for anything else
+    bool ParseLevel(const char* name, Level& level);
+
+    // Per level tables, only call the ones the CPU supports
+    const KernelTable& GetGenericKernels();
+    const KernelTable& GetSSE42Kernels();
+    const KernelTable& GetAVX2Kernels();
+    const KernelTable& GetAVX512Kernels();
+
+}
@@ -0,0 +1,182 @@
+#include "ISA.h"
+
+// Built with AVX2 enabled. Only plain data and intrinsics are used in here, an inline function
+// from a shared header could be emitted with these flags and picked by the linker for every caller.
+// FMA is left off on purpose (and contraction disabled), fused results would no longer match the
+// scalar code bit for bit.
+#if defined(_M_X64) || defined(__x86_64__)
+#define CHROMA_ISA_X64 1
+#include <cmath>
+#include <immintrin.h>
+#endif
+
+namespace ISA {
+
+#if CHROMA_ISA_X64
+    namespace {
+
+        using namespace Resolve::Constants;
+
+        inline uint32_t FirstLane(uint32_t mask)
+        {
+#ifdef _MSC_VER
+            unsigned long index;
+            _BitScanForward(&index, mask);
+            return (uint32_t)index;
+#else
+            return (uint32_t)__builtin_ctz(mask);
+#endif
+        }
+
+        inline __m256 Tonemap(__m256 x, Resolve::Tonemapper tonemap)
+        {
+            const __m256 one = _mm256_set1_ps(1.0f);
+
+            x = _mm256_min_ps(_mm256_max_ps(x, _mm256_setzero_ps()), _mm256_set1_ps(MaxRadiance));
+
+            switch (tonemap)
+            {
+                case Resolve::Tonemapper::Reinhard:
+                    x = _mm256_div_ps(x, _mm256_add_ps(one, x));
+                    break;
+                case Resolve::Tonemapper::ACES:
+                {
+                    __m256 num = _mm256_mul_ps(x, _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(ACES_A), x), _mm256_set1_ps(ACES_B)));
+                    __m256 den = _mm256_add_ps(_mm256_mul_ps(x, _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(ACES_C), x),
+                        _mm256_set1_ps(ACES_D))), _mm256_set1_ps(ACES_E));
+                    x = _mm256_div_ps(num, den);
+                    break;
+                }
+                default:
+                    break;
+            }
+
+            return _mm256_min_ps(x, one);
+        }
+
+        // Byte gather from the padded table
+        inline __m256i Encode(__m256 x, const uint8_t* lut)
+        {
+            __m256i index = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(x, _mm256_set1_ps(LUTScale)), _mm256_set1_ps(0.5f)));
+            return _mm256_and_si256(_mm256_i32gather_epi32((const int*)lut, index, 1), _mm256_set1_epi32(0xff));
+        }
+
+        uint32_t ResolveSpan(const glm::vec4* accumulation, uint32_t* output, uint32_t count,
+            float scale, Resolve::Tonemapper tonemap, const uint8_t* lut)
+        {
+            const __m256 scaleVector = _mm256_set1_ps(scale);
+
+            uint32_t i = 0;
+            for (; i + 8 <= count; i += 8)
+            {
+                const float* pixels = &accumulation[i].x;
+
+                // Pixels 0-3 in the low halves, 4-7 in the high halves
+                __m256 a = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(pixels + 0)), _mm_loadu_ps(pixels + 16), 1);
+                __m256 b = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(pixels + 4)), _mm_loadu_ps(pixels + 20), 1);
+                __m256 c = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(pixels + 8)), _mm_loadu_ps(pixels + 24), 1);
+                __m256 d = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(pixels + 12)), _mm_loadu_ps(pixels + 28), 1);
+
+                // 4x4 transpose within each half, alpha is discarded
+                __m256 t0 = _mm256_unpacklo_ps(a, b);
+                __m256 t1 = _mm256_unpacklo_ps(c, d);
+                __m256 t2 = _mm256_unpackhi_ps(a, b);
+                __m256 t3 = _mm256_unpackhi_ps(c, d);
+                __m256 red = _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(1, 0, 1, 0));
+                __m256 green = _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(3, 2, 3, 2));
+                __m256 blue = _mm256_shuffle_ps(t2, t3, _MM_SHUFFLE(1, 0, 1, 0));
+
+                __m256i r = Encode(Tonemap(_mm256_mul_ps(red, scaleVector), tonemap), lut);
+                __m256i g = Encode(Tonemap(_mm256_mul_ps(green, scaleVector), tonemap), lut);
+                __m256i bl = Encode(Tonemap(_mm256_mul_ps(blue, scaleVector), tonemap), lut);
+
+                __m256i packed = _mm256_or_si256(r, _mm256_slli_epi32(g, 8));
+                packed = _mm256_or_si256(packed, _mm256_slli_epi32(bl, 16));
+                packed = _mm256_or_si256(packed, _mm256_set1_epi32((int)0xff000000));
+                _mm256_storeu_si256((__m256i*)(output + i), packed);
+            }
+
+            return i;
+        }
+
+        int32_t IntersectPlanes(const Ray& ray, const PlaneSet& planes, float& hitDistance)
+        {
+            const __m256 dx = _mm256_set1_ps(ray.Direction.x), dy = _mm256_set1_ps(ray.Direction.y), dz = _mm256_set1_ps(ray.Direction.z);
+            const __m256 ox = _mm256_set1_ps(ray.Origin.x), oy = _mm256_set1_ps(ray.Origin.y), oz = _mm256_set1_ps(ray.Origin.z);
+            const __m256 signMask = _mm256_set1_ps(-0.0f);
+            const __m256 epsilon = _mm256_set1_ps(0.0001f);
+            const __m256 infinity = _mm256_set1_ps(INFINITY);
+
+            int32_t closest = -1;
+            for (uint32_t i = 0; i < planes.Count; i += 8)
+            {
+                const __m256 nx = _mm256_loadu_ps(planes.NormalX + i);
+                const __m256 ny = _mm256_loadu_ps(planes.NormalY + i);
+                const __m256 nz = _mm256_loadu_ps(planes.NormalZ + i);
+                const __m256 distance = _mm256_loadu_ps(planes.Distance + i);
+
+                const __m256 denom = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, nx), _mm256_mul_ps(dy, ny)), _mm256_mul_ps(dz, nz));
+                const __m256 numer = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ox, nx), _mm256_mul_ps(oy, ny)),
+                    _mm256_mul_ps(oz, nz)), distance);
+                __m256 t = _mm256_div_ps(_mm256_xor_ps(numer, signMask), denom);
+
+                // Written as "not less than" so NaN passes like in the scalar test, and then fails t < hitDistance
+                __m256 valid = _mm256_and_ps(_mm256_cmp_ps(_mm256_andnot_ps(signMask, denom), epsilon, _CMP_NLT_UQ),
+                    _mm256_cmp_ps(t, epsilon, _CMP_NLT_UQ));
+                valid = _mm256_and_ps(valid, _mm256_cmp_ps(t, _mm256_set1_ps(hitDistance), _CMP_LT_OQ));
+
+                const uint32_t mask = (uint32_t)_mm256_movemask_ps(valid);
+                if (mask == 0)
+                    continue;
+
+                // The first lane holding the smallest distance, like the sequential loop
+                t = _mm256_blendv_ps(infinity, t, valid);
+                __m256 minimum = _mm256_min_ps(t, _mm256_permute2f128_ps(t, t, 1));
+                minimum = _mm256_min_ps(minimum, _mm256_shuffle_ps(minimum, minimum, _MM_SHUFFLE(1, 0, 3, 2)));
+                minimum = _mm256_min_ps(minimum, _mm256_shuffle_ps(minimum, minimum, _MM_SHUFFLE(2, 3, 0, 1)));
+                const uint32_t lane = FirstLane((uint32_t)_mm256_movemask_ps(_mm256_cmp_ps(t, minimum, _CMP_EQ_OQ)) & mask);
+
+                hitDistance = _mm256_cvtss_f32(minimum);
+                closest = (int32_t)(i + lane);
+            }
+            return closest;
+        }
+
+        void RandomFloats(uint32_t* seeds, float* values, uint32_t count)
+        {
+            uint32_t i = 0;
+            for (; i + 8 <= count; i += 8)
+            {
+                // Utils::PCG_Hash, the variable shift is what SSE lacks
+                __m256i seed = _mm256_loadu_si256((const __m256i*)(seeds + i));
+                __m256i state = _mm256_add_epi32(_mm256_mullo_epi32(seed, _mm256_set1_epi32((int)747796405u)), _mm256_set1_epi32((int)2891336453u));
+                __m256i shift = _mm256_add_epi32(_mm256_srli_epi32(state, 28), _mm256_set1_epi32(4));
+                __m256i word = _mm256_mullo_epi32(_mm256_xor_si256(_mm256_srlv_epi32(state, shift), state), _mm256_set1_epi32((int)277803737u));
+                seed = _mm256_xor_si256(_mm256_srli_epi32(word, 22), word);
+                _mm256_storeu_si256((__m256i*)(seeds + i), seed);
+
+                // Unsigned to float in two exact halves, the single rounding of the sum matches a direct conversion
+                __m256 high = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srli_epi32(seed, 16)), _mm256_set1_ps(65536.0f));
+                __m256 low = _mm256_cvtepi32_ps(_mm256_and_si256(seed, _mm256_set1_epi32(0xffff)));
+                _mm256_storeu_ps(values + i, _mm256_div_ps(_mm256_add_ps(high, low), _mm256_set1_ps(4294967296.0f)));
+            }
+
+            if (i < count)
+                GetGenericKernels().RandomFloats(seeds + i, values + i, count - i);
+        }
+
+    }
+
+    const KernelTable& GetAVX2Kernels()
+    {
+        static const KernelTable table = { ResolveSpan, IntersectPlanes, RandomFloats };
+        return table;
+    }
+#else
+    const KernelTable& GetAVX2Kernels()
+    {
+        return GetGenericKernels();
+    }
+#endif
+
+}
@@ -0,0 +1,130 @@
+#include "ISA.h"
+
+// Built with AVX-512F enabled, nothing beyond the foundation instructions is used. Only plain data
+// and intrinsics are used in here, an inline function from a shared header could be emitted with
+// these flags and picked by the linker for every caller. AVX-512F includes FMA, the build disables
+// contraction for this file so results match the scalar code bit for bit.
+#if defined(_M_X64) || defined(__x86_64__)
+#define CHROMA_ISA_X64 1
+#include <cmath>
+#include <immintrin.h>
+#endif
+
+namespace ISA {
+
+#if CHROMA_ISA_X64
+    namespace {
+
+        using namespace Resolve::Constants;
+
+        inline __m512 Tonemap(__m512 x, Resolve::Tonemapper tonemap)
+        {
+            const __m512 one = _mm512_set1_ps(1.0f);
+
+            x = _mm512_min_ps(_mm512_max_ps(x, _mm512_setzero_ps()), _mm512_set1_ps(MaxRadiance));
+
+            switch (tonemap)
+            {
+                case Resolve::Tonemapper::Reinhard:
+                    x = _mm512_div_ps(x, _mm512_add_ps(one, x));
+                    break;
+                case Resolve::Tonemapper::ACES:
+                {
+                    __m512 num = _mm512_mul_ps(x, _mm512_add_ps(_mm512_mul_ps(_mm512_set1_ps(ACES_A), x), _mm512_set1_ps(ACES_B)));
+                    __m512 den = _mm512_add_ps(_mm512_mul_ps(x, _mm512_add_ps(_mm512_mul_ps(_mm512_set1_ps(ACES_C), x),
+                        _mm512_set1_ps(ACES_D))), _mm512_set1_ps(ACES_E));
+                    x = _mm512_div_ps(num, den);
+                    break;
+                }
+                default:
+                    break;
+            }
+
+            return _mm512_min_ps(x, one);
+        }
+
+        inline __m512i Encode(__m512 x, const uint8_t* lut)
+        {
+            __m512i index = _mm512_cvttps_epi32(_mm512_add_ps(_mm512_mul_ps(x, _mm512_set1_ps(LUTScale)), _mm512_set1_ps(0.5f)));
+            return _mm512_and_si512(_mm512_i32gather_epi32(index, lut, 1), _mm512_set1_epi32(0xff));
+        }
+
+        uint32_t ResolveSpan(const glm::vec4* accumulation, uint32_t* output, uint32_t count,
+            float scale, Resolve::Tonemapper tonemap, const uint8_t* lut)
+        {
+            const __m512 scaleVector = _mm512_set1_ps(scale);
+
+            // Channel c of pixel p sits at float 4 * p + c of two concatenated registers
+            const __m512i redGreen = _mm512_setr_epi32(0, 4, 8, 12, 16, 20, 24, 28, 1, 5, 9, 13, 17, 21, 25, 29);
+            const __m512i blue = _mm512_setr_epi32(2, 6, 10, 14, 18, 22, 26, 30, 2, 6, 10, 14, 18, 22, 26, 30);
+            const __m512i lowHalves = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 16, 17, 18, 19, 20, 21, 22, 23);
+            const __m512i highHalves = _mm512_setr_epi32(8, 9, 10, 11, 12, 13, 14, 15, 24, 25, 26, 27, 28, 29, 30, 31);
+
+            uint32_t i = 0;
+            for (; i + 16 <= count; i += 16)
+            {
+                const float* pixels = &accumulation[i].x;
+                __m512 p0 = _mm512_loadu_ps(pixels + 0);
+                __m512 p1 = _mm512_loadu_ps(pixels + 16);
+                __m512 p2 = _mm512_loadu_ps(pixels + 32);
+                __m512 p3 = _mm512_loadu_ps(pixels + 48);
+
+                // Pixels 0-7 and 8-15 first, then both halves are joined
+                __m512 redGreen01 = _mm512_permutex2var_ps(p0, redGreen, p1);
+                __m512 redGreen23 = _mm512_permutex2var_ps(p2, redGreen, p3);
+                __m512 blue01 = _mm512_permutex2var_ps(p0, blue, p1);
+                __m512 blue23 = _mm512_permutex2var_ps(p2, blue, p3);
+
+                __m512 r = _mm512_permutex2var_ps(redGreen01, lowHalves, redGreen23);
+                __m512 g = _mm512_permutex2var_ps(redGreen01, highHalves, redGreen23);
+                __m512 b = _mm512_permutex2var_ps(blue01, lowHalves, blue23);
+
+                __m512i red = Encode(Tonemap(_mm512_mul_ps(r, scaleVector), tonemap), lut);
+                __m512i green = Encode(Tonemap(_mm512_mul_ps(g, scaleVector), tonemap), lut);
+                __m512i blueChannel = Encode(Tonemap(_mm512_mul_ps(b, scaleVector), tonemap), lut);
+
+                __m512i packed = _mm512_or_si512(red, _mm512_slli_epi32(green, 8));
+                packed = _mm512_or_si512(packed, _mm512_slli_epi32(blueChannel, 16));
+                packed = _mm512_or_si512(packed, _mm512_set1_epi32((int)0xff000000));
+                _mm512_storeu_si512(output + i, packed);
+            }
+
+            return i;
+        }
+
+        void RandomFloats(uint32_t* seeds, float* values, uint32_t count)
+        {
+            uint32_t i = 0;
+            for (; i + 16 <= count; i += 16)
+            {
+                // Utils::PCG_Hash
+                __m512i seed = _mm512_loadu_si512(seeds + i);
+                __m512i state = _mm512_add_epi32(_mm512_mullo_epi32(seed, _mm512_set1_epi32((int)747796405u)), _mm512_set1_epi32((int)2891336453u));
+                __m512i shift = _mm512_add_epi32(_mm512_srli_epi32(state, 28), _mm512_set1_epi32(4));
+                __m512i word = _mm512_mullo_epi32(_mm512_xor_si512(_mm512_srlv_epi32(state, shift), state), _mm512_set1_epi32((int)277803737u));
+                seed = _mm512_xor_si512(_mm512_srli_epi32(word, 22), word);
+                _mm512_storeu_si512(seeds + i, seed);
+
+                _mm512_storeu_ps(values + i, _mm512_div_ps(_mm512_cvtepu32_ps(seed), _mm512_set1_ps(4294967296.0f)));
+            }
+
+            if (i < count)
+                GetGenericKernels().RandomFloats(seeds + i, values + i, count - i);
+        }
+
+    }
+
+    const KernelTable& GetAVX512Kernels()
+    {
+        // Scenes have a handful of planes, the 8 wide test with its cheaper reduction is faster there
+        static const KernelTable table = { ResolveSpan, GetAVX2Kernels().IntersectPlanes, RandomFloats };
+        return table;
+    }
+#else
+    const KernelTable& GetAVX512Kernels()
+    {
+        return GetGenericKernels();
+    }
+#endif
+
+}
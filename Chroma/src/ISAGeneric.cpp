@@ -0,0 +1,135 @@
+#include "ISA.h"
+#include "Utils.h"
+
+#include <cmath>
+
+// Baseline kernels, built with the project's default flags. SSE2 is part of x64, so the resolve
+// still runs 4 pixels wide there.
+#if defined(_M_X64) || defined(__SSE2__)
+#define CHROMA_ISA_SSE2 1
+#include <emmintrin.h>
+#include <xmmintrin.h>
+#endif
+
+namespace ISA {
+
+    namespace {
+
+        using namespace Resolve::Constants;
+
+#if CHROMA_ISA_SSE2
+        inline __m128 TonemapSSE(__m128 x, Resolve::Tonemapper tonemap)
+        {
+            const __m128 one = _mm_set1_ps(1.0f);
+
+            x = _mm_min_ps(_mm_max_ps(x, _mm_setzero_ps()), _mm_set1_ps(MaxRadiance));
+
+            switch (tonemap)
+            {
+                case Resolve::Tonemapper::Reinhard:
+                    x = _mm_div_ps(x, _mm_add_ps(one, x));
+                    break;
+                case Resolve::Tonemapper::ACES:
+                {
+                    __m128 num = _mm_mul_ps(x, _mm_add_ps(_mm_mul_ps(_mm_set1_ps(ACES_A), x), _mm_set1_ps(ACES_B)));
+                    __m128 den = _mm_add_ps(_mm_mul_ps(x, _mm_add_ps(_mm_mul_ps(_mm_set1_ps(ACES_C), x), _mm_set1_ps(ACES_D))),
+                        _mm_set1_ps(ACES_E));
+                    x = _mm_div_ps(num, den);
+                    break;
+                }
+                default:
+                    break;
+            }
+
+            return _mm_min_ps(x, one);
+        }
+
+        inline __m128i EncodeSSE(__m128 x, const uint8_t* lut)
+        {
+            alignas(16) int32_t index[4];
+            _mm_store_si128((__m128i*)index,
+                _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(LUTScale)), _mm_set1_ps(0.5f))));
+            return _mm_setr_epi32(lut[index[0]], lut[index[1]], lut[index[2]], lut[index[3]]);
+        }
+
+        // Resolves 4 consecutive pixels, returned as packed RGBA8
+        inline __m128i Resolve4(const glm::vec4* accumulation, __m128 scale, Resolve::Tonemapper tonemap, const uint8_t* lut)
+        {
+            __m128 p0 = _mm_loadu_ps(&accumulation[0].x);
+            __m128 p1 = _mm_loadu_ps(&accumulation[1].x);
+            __m128 p2 = _mm_loadu_ps(&accumulation[2].x);
+            __m128 p3 = _mm_loadu_ps(&accumulation[3].x);
+
+            // AoS -> SoA, afterwards p0 = R, p1 = G, p2 = B (alpha is discarded)
+            _MM_TRANSPOSE4_PS(p0, p1, p2, p3);
+
+            __m128i r = EncodeSSE(TonemapSSE(_mm_mul_ps(p0, scale), tonemap), lut);
+            __m128i g = EncodeSSE(TonemapSSE(_mm_mul_ps(p1, scale), tonemap), lut);
+            __m128i b = EncodeSSE(TonemapSSE(_mm_mul_ps(p2, scale), tonemap), lut);
+
+            __m128i packed = _mm_or_si128(r, _mm_slli_epi32(g, 8));
+            packed = _mm_or_si128(packed, _mm_slli_epi32(b, 16));
+            return _mm_or_si128(packed, _mm_set1_epi32((int)0xff000000));
+        }
+#endif
+
+        uint32_t ResolveSpan(const glm::vec4* accumulation, uint32_t* output, uint32_t count,
+            float scale, Resolve::Tonemapper tonemap, const uint8_t* lut)
+        {
+            uint32_t i = 0;
+
+#if CHROMA_ISA_SSE2
+            const __m128 scaleVector = _mm_set1_ps(scale);
+            for (; i + 8 <= count; i += 8)
+            {
+                __m128i lo = Resolve4(accumulation + i, scaleVector, tonemap, lut);
+                __m128i hi = Resolve4(accumulation + i + 4, scaleVector, tonemap, lut);
+                _mm_storeu_si128((__m128i*)(output + i), lo);
+                _mm_storeu_si128((__m128i*)(output + i + 4), hi);
+            }
+#else
+            (void)accumulation; (void)output; (void)count; (void)scale; (void)tonemap; (void)lut;
+#endif
+
+            return i;
+        }
+
+        // Same arithmetic, in the same order, as Renderer::IntersectPlane
+        int32_t IntersectPlanes(const Ray& ray, const PlaneSet& planes, float& hitDistance)
+        {
+            int32_t closest = -1;
+            for (uint32_t i = 0; i < planes.Count; i++)
+            {
+                float denom = ray.Direction.x * planes.NormalX[i] + ray.Direction.y * planes.NormalY[i] + ray.Direction.z * planes.NormalZ[i];
+                if (std::abs(denom) < 0.0001f)
+                    continue;
+
+                float t = -((ray.Origin.x * planes.NormalX[i] + ray.Origin.y * planes.NormalY[i] + ray.Origin.z * planes.NormalZ[i]) +
+                    planes.Distance[i]) / denom;
+                if (t < 0.0001f)
+                    continue;
+
+                if (t < hitDistance)
+                {
+                    hitDistance = t;
+                    closest = (int32_t)i;
+                }
+            }
+            return closest;
+        }
+
+        void RandomFloats(uint32_t* seeds, float* values, uint32_t count)
+        {
+            for (uint32_t i = 0; i < count; i++)
+                values[i] = Utils::RandomFloat(seeds[i]);
+        }
+
+    }
+
+    const KernelTable& GetGenericKernels()
+    {
+        static const KernelTable table = { ResolveSpan, IntersectPlanes, RandomFloats };
+        return table;
+    }
+
+}
@@ -0,0 +1,82 @@
+#include "ISA.h"
+
+// Built with SSE4.2 enabled. Only plain data and intrinsics are used in here, an inline function
+// from a shared header could be emitted with these flags and picked by the linker for every caller.
+#if defined(_M_X64) || defined(__x86_64__)
+#define CHROMA_ISA_X64 1
+#include <cmath>
+#include <smmintrin.h>
+#endif
+
+namespace ISA {
+
+#if CHROMA_ISA_X64
+    namespace {
+
+        inline uint32_t FirstLane(uint32_t mask)
+        {
+#ifdef _MSC_VER
+            unsigned long index;
+            _BitScanForward(&index, mask);
+            return (uint32_t)index;
+#else
+            return (uint32_t)__builtin_ctz(mask);
+#endif
+        }
+
+        int32_t IntersectPlanes(const Ray& ray, const PlaneSet& planes, float& hitDistance)
+        {
+            const __m128 dx = _mm_set1_ps(ray.Direction.x), dy = _mm_set1_ps(ray.Direction.y), dz = _mm_set1_ps(ray.Direction.z);
+            const __m128 ox = _mm_set1_ps(ray.Origin.x), oy = _mm_set1_ps(ray.Origin.y), oz = _mm_set1_ps(ray.Origin.z);
+            const __m128 signMask = _mm_set1_ps(-0.0f);
+            const __m128 epsilon = _mm_set1_ps(0.0001f);
+            const __m128 infinity = _mm_set1_ps(INFINITY);
+
+            int32_t closest = -1;
+            for (uint32_t i = 0; i < planes.Count; i += 4)
+            {
+                const __m128 nx = _mm_loadu_ps(&planes.NormalX[i]);
+                const __m128 ny = _mm_loadu_ps(&planes.NormalY[i]);
+                const __m128 nz = _mm_loadu_ps(&planes.NormalZ[i]);
+                const __m128 distance = _mm_loadu_ps(&planes.Distance[i]);
+
+                const __m128 denom = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, nx), _mm_mul_ps(dy, ny)), _mm_mul_ps(dz, nz));
+                const __m128 numer = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(ox, nx), _mm_mul_ps(oy, ny)), _mm_mul_ps(oz, nz)), distance);
+                __m128 t = _mm_div_ps(_mm_xor_ps(numer, signMask), denom);
+
+                // Written as "not less than" so NaN passes like in the scalar test, and then fails t < hitDistance
+                __m128 valid = _mm_and_ps(_mm_cmpnlt_ps(_mm_andnot_ps(signMask, denom), epsilon), _mm_cmpnlt_ps(t, epsilon));
+                valid = _mm_and_ps(valid, _mm_cmplt_ps(t, _mm_set1_ps(hitDistance)));
+
+                const uint32_t mask = (uint32_t)_mm_movemask_ps(valid);
+                if (mask == 0)
+                    continue;
+
+                // The first lane holding the smallest distance, like the sequential loop
+                t = _mm_blendv_ps(infinity, t, valid);
+                __m128 minimum = _mm_min_ps(t, _mm_shuffle_ps(t, t, _MM_SHUFFLE(1, 0, 3, 2)));
+                minimum = _mm_min_ps(minimum, _mm_shuffle_ps(minimum, minimum, _MM_SHUFFLE(2, 3, 0, 1)));
+                const uint32_t lane = FirstLane((uint32_t)_mm_movemask_ps(_mm_cmpeq_ps(t, minimum)) & mask);
+
+                hitDistance = _mm_cvtss_f32(minimum);
+                closest = (int32_t)(i + lane);
+            }
+            return closest;
+        }
+
+    }
+
+    const KernelTable& GetSSE42Kernels()
+    {
+        // Resolve and random numbers gain nothing over SSE2 without wider vectors or variable shifts
+        static const KernelTable table = { GetGenericKernels().ResolveSpan, IntersectPlanes, GetGenericKernels().RandomFloats };
+        return table;
+    }
+#else
+    const KernelTable& GetSSE42Kernels()
+    {
+        return GetGenericKernels();
+    }
+#endif
+
+}
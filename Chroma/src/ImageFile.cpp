@@ -0,0 +1,242 @@
+#include "ImageFile.h"
+
+#include <glm/gtc/packing.hpp>
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb_image_write.h"
+
+#include <cstdio>
+#include <cstring>
+
+namespace ImageFile {
+
+    namespace {
+
+        bool IsLittleEndian()
+        {
+            const uint16_t value = 1;
+            uint8_t first;
+            memcpy(&first, &value, 1);
+            return first == 1;
+        }
+
+        void SwapBytes(float& value)
+        {
+            uint8_t bytes[4];
+            memcpy(bytes, &value, 4);
+            uint8_t swapped[4] = { bytes[3], bytes[2], bytes[1], bytes[0] };
+            memcpy(&value, swapped, 4);
+        }
+
+        template<typename T>
+        void PutLittleEndian(std::vector<uint8_t>& data, T value)
+        {
+            for (size_t i = 0; i < sizeof(T); i++)
+                data.push_back((uint8_t)((uint64_t)value >> (i * 8)));
+        }
+
+        void PutString(std::vector<uint8_t>& data, const char* text)
+        {
+            data.insert(data.end(), text, text + strlen(text) + 1);
+        }
+
+        bool EndsWith(const std::string& text, const char* suffix)
+        {
+            const size_t length = strlen(suffix);
+            return text.size() >= length && text.compare(text.size() - length, length, suffix) == 0;
+        }
+
+        bool WriteFile(const std::string& path, const std::vector<uint8_t>& data)
+        {
+            FILE* file = fopen(path.c_str(), "wb");
+            if (!file)
+                return false;
+            const size_t written = fwrite(data.data(), 1, data.size(), file);
+            return fclose(file) == 0 && written == data.size();
+        }
+
+    }
+
+    bool WritePFM(const std::string& path, uint32_t width, uint32_t height, const std::vector<glm::vec3>& pixels)
+    {
+        if (pixels.size() != (size_t)width * height)
+            return false;
+
+        FILE* file = fopen(path.c_str(), "wb");
+        if (!file)
+            return false;
+
+        // A negative scale marks little endian data
+        fprintf(file, "PF\n%u %u\n%s\n", width, height, IsLittleEndian() ? "-1.0" : "1.0");
+        size_t written = fwrite(pixels.data(), sizeof(glm::vec3), pixels.size(), file);
+
+        return fclose(file) == 0 && written == pixels.size();
+    }
+
+    bool ReadPFM(const std::string& path, uint32_t& width, uint32_t& height, std::vector<glm::vec3>& pixels)
+    {
+        FILE* file = fopen(path.c_str(), "rb");
+        if (!file)
+            return false;
+
+        char magic[3] = {};
+        float scale = 0.0f;
+        if (fscanf(file, "%2s %u %u %f", magic, &width, &height, &scale) != 4 || strcmp(magic, "PF") != 0)
+        {
+            fclose(file);
+            return false;
+        }
+        fgetc(file); // Single whitespace character before the data
+
+        pixels.resize((size_t)width * height);
+        size_t read = fread(pixels.data(), sizeof(glm::vec3), pixels.size(), file);
+        fclose(file);
+
+        if (read != pixels.size())
+            return false;
+
+        if ((scale < 0.0f) != IsLittleEndian())
+        {
+            for (glm::vec3& pixel : pixels)
+            {
+                SwapBytes(pixel.r);
+                SwapBytes(pixel.g);
+                SwapBytes(pixel.b);
+            }
+        }
+
+        return true;
+    }
+
+    bool WritePPM(const std::string& path, uint32_t width, uint32_t height, const uint32_t* pixels)
+    {
+        FILE* file = fopen(path.c_str(), "wb");
+        if (!file)
+            return false;
+
+        fprintf(file, "P6\n%u %u\n255\n", width, height);
+
+        std::vector<uint8_t> row((size_t)width * 3);
+        bool written = true;
+        for (uint32_t y = height; y-- > 0;)
+        {
+            for (uint32_t x = 0; x < width; x++)
+            {
+                uint32_t pixel = pixels[x + (size_t)y * width];
+                row[x * 3 + 0] = (uint8_t)(pixel & 0xff);
+                row[x * 3 + 1] = (uint8_t)((pixel >> 8) & 0xff);
+                row[x * 3 + 2] = (uint8_t)((pixel >> 16) & 0xff);
+            }
+            written &= fwrite(row.data(), 1, row.size(), file) == row.size();
+        }
+
+        return fclose(file) == 0 && written;
+    }
+
+    bool WritePNG(const std::string& path, uint32_t width, uint32_t height, const uint32_t* pixels)
+    {
+        std::vector<uint8_t> rows((size_t)width * height * 3);
+        for (uint32_t y = 0; y < height; y++)
+        {
+            const uint32_t* source = pixels + (size_t)(height - 1 - y) * width;
+            uint8_t* row = rows.data() + (size_t)y * width * 3;
+            for (uint32_t x = 0; x < width; x++)
+            {
+                row[x * 3 + 0] = (uint8_t)(source[x] & 0xff);
+                row[x * 3 + 1] = (uint8_t)((source[x] >> 8) & 0xff);
+                row[x * 3 + 2] = (uint8_t)((source[x] >> 16) & 0xff);
+            }
+        }
+        return stbi_write_png(path.c_str(), (int)width, (int)height, 3, rows.data(), (int)width * 3) != 0;
+    }
+
+    bool WriteEXR(const std::string& path, uint32_t width, uint32_t height, const std::vector<glm::vec3>& pixels)
+    {
+        if (pixels.size() != (size_t)width * height || width == 0 || height == 0)
+            return false;
+
+        std::vector<uint8_t> file = { 0x76, 0x2f, 0x31, 0x01, 2, 0, 0, 0 };
+        auto putAttribute = [&file](const char* name, const char* type, uint32_t size)
+        {
+            PutString(file, name);
+            PutString(file, type);
+            PutLittleEndian(file, size);
+        };
+
+        // Channels are listed alphabetically and stored in that order within every scanline
+        const char* channels[3] = { "B", "G", "R" };
+        putAttribute("channels", "chlist", 3 * 18 + 1);
+        for (const char* channel : channels)
+        {
+            PutString(file, channel);
+            PutLittleEndian(file, (uint32_t)1); // Half
+            PutLittleEndian(file, (uint32_t)0); // Not linear, reserved
+            PutLittleEndian(file, (uint32_t)1); // Sampling
+            PutLittleEndian(file, (uint32_t)1);
+        }
+        file.push_back(0);
+
+        putAttribute("compression", "compression", 1);
+        file.push_back(0);
+        for (const char* window : { "dataWindow", "displayWindow" })
+        {
+            putAttribute(window, "box2i", 16);
+            PutLittleEndian(file, (int32_t)0);
+            PutLittleEndian(file, (int32_t)0);
+            PutLittleEndian(file, (int32_t)width - 1);
+            PutLittleEndian(file, (int32_t)height - 1);
+        }
+        putAttribute("lineOrder", "lineOrder", 1);
+        file.push_back(0); // Increasing y
+        const float one = 1.0f, zero = 0.0f;
+        uint32_t oneBits, zeroBits;
+        memcpy(&oneBits, &one, 4);
+        memcpy(&zeroBits, &zero, 4);
+        putAttribute("pixelAspectRatio", "float", 4);
+        PutLittleEndian(file, oneBits);
+        putAttribute("screenWindowCenter", "v2f", 8);
+        PutLittleEndian(file, zeroBits);
+        PutLittleEndian(file, zeroBits);
+        putAttribute("screenWindowWidth", "float", 4);
+        PutLittleEndian(file, oneBits);
+        file.push_back(0);
+
+        // One scanline per chunk, each after a table of their offsets
+        const uint32_t lineSize = width * 3 * 2;
+        const uint64_t firstLine = file.size() + (uint64_t)height * 8;
+        for (uint32_t y = 0; y < height; y++)
+            PutLittleEndian(file, firstLine + (uint64_t)y * (8 + lineSize));
+
+        file.reserve(firstLine + (size_t)height * (8 + lineSize));
+        for (uint32_t y = 0; y < height; y++)
+        {
+            PutLittleEndian(file, (int32_t)y);
+            PutLittleEndian(file, lineSize);
+            const glm::vec3* row = pixels.data() + (size_t)(height - 1 - y) * width;
+            for (int channel = 2; channel >= 0; channel--)
+            {
+                for (uint32_t x = 0; x < width; x++)
+                    PutLittleEndian(file, glm::packHalf1x16(row[x][channel]));
+            }
+        }
+        return WriteFile(path, file);
+    }
+
+    bool IsLinear(const std::string& path)
+    {
+        return EndsWith(path, ".exr") || EndsWith(path, ".pfm");
+    }
+
+    bool Write(const std::string& path, uint32_t width, uint32_t height, const uint32_t* pixels,
+        const std::vector<glm::vec3>& linearPixels)
+    {
+        if (EndsWith(path, ".exr"))
+            return WriteEXR(path, width, height, linearPixels);
+        if (EndsWith(path, ".pfm"))
+            return WritePFM(path, width, height, linearPixels);
+        if (EndsWith(path, ".png"))
+            return WritePNG(path, width, height, pixels);
+        return WritePPM(path, width, height, pixels);
+    }
+
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace ImageFile {
+
+    // Portable float map (.pfm) with three channels. Rows are stored bottom to top, which is the
+    // order the renderer produces them in.
+    bool WritePFM(const std::string& path, uint32_t width, uint32_t height, const std::vector<glm::vec3>& pixels);
+    bool ReadPFM(const std::string& path, uint32_t& width, uint32_t& height, std::vector<glm::vec3>& pixels);
+
+    // Binary 8-bit .ppm from packed RGBA8 pixels as the renderer resolves them, alpha is dropped.
+    // Rows are flipped so that the file is top to bottom like any other viewer expects.
+    bool WritePPM(const std::string& path, uint32_t width, uint32_t height, const uint32_t* pixels);
+
+    // Same pixels as WritePPM() as an 8-bit RGB .png, encoded by stb_image_write
+    bool WritePNG(const std::string& path, uint32_t width, uint32_t height, const uint32_t* pixels);
+
+    // Uncompressed half float OpenEXR with R, G and B channels, from linear pixels as WritePFM() takes them
+    bool WriteEXR(const std::string& path, uint32_t width, uint32_t height, const std::vector<glm::vec3>& pixels);
+
+    // Whether the extension of the path (.exr, .pfm) takes linear pixels instead of resolved ones
+    bool IsLinear(const std::string& path);
+    // Picks the format by the extension, .ppm for anything unknown. Only the pixels IsLinear() asks for are used.
+    bool Write(const std::string& path, uint32_t width, uint32_t height, const uint32_t* pixels,
+        const std::vector<glm::vec3>& linearPixels);
+
+}
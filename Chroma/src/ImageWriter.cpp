@@ -0,0 +1,99 @@
+#include "ImageWriter.h"
+#include "ImageFile.h"
+
+#include "Walnut/Timer.h"
+
+#include <chrono>
+
+ImageWriter::ImageWriter(uint32_t maxPending)
+    : m_MaxPending(maxPending > 0 ? maxPending : 1)
+{
+    m_Thread = std::thread([this]() { WriteMain(); });
+}
+
+ImageWriter::~ImageWriter()
+{
+    Finish();
+
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Stopping = true;
+    }
+    m_Condition.notify_all();
+    m_Thread.join();
+}
+
+std::unique_ptr<ImageWriter::Image> ImageWriter::Acquire()
+{
+    WL_PROFILE_ZONE("ImageWriter::Acquire");
+
+    const auto start = std::chrono::steady_clock::now();
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    m_Condition.wait(lock, [this]() { return m_Busy < m_MaxPending; });
+    m_WaitTime += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    m_Busy++;
+    if (m_Free.empty())
+        return std::make_unique<Image>();
+
+    std::unique_ptr<Image> image = std::move(m_Free.back());
+    m_Free.pop_back();
+    return image;
+}
+
+void ImageWriter::Submit(std::unique_ptr<Image> image)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Queue.push_back(std::move(image));
+    }
+    m_Condition.notify_all();
+}
+
+void ImageWriter::Finish()
+{
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    m_Condition.wait(lock, [this]() { return m_Queue.empty() && !m_Writing; });
+}
+
+void ImageWriter::WriteMain()
+{
+    Walnut::Profiler::SetThreadName("ImageWriter");
+
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    for (;;)
+    {
+        m_Condition.wait(lock, [this]() { return !m_Queue.empty() || m_Stopping; });
+        if (m_Queue.empty())
+            return;
+
+        std::unique_ptr<Image> image = std::move(m_Queue.front());
+        m_Queue.pop_front();
+        m_Writing = true;
+        lock.unlock();
+
+        bool written;
+        const auto start = std::chrono::steady_clock::now();
+        {
+            WL_PROFILE_ZONE("ImageWriter::Write");
+            written = ImageFile::Write(image->Path, image->Width, image->Height, image->Pixels.data(), image->Radiance);
+        }
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        lock.lock();
+        m_WriteTime += seconds;
+        if (written)
+        {
+            m_Written++;
+        }
+        else
+        {
+            m_Failed++;
+            m_LastFailure = image->Path;
+        }
+        m_Free.push_back(std::move(image));
+        m_Busy--;
+        m_Writing = false;
+        m_Condition.notify_all();
+    }
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Encodes and writes images on a thread of its own, the renderer only copies its image into a
+// buffer and goes on with the next frame. It only waits when it gets more than MaxPending images
+// ahead of the disk. Buffers of written images are handed out again.
+class ImageWriter
+{
+public:
+    struct Image
+    {
+        std::string Path;           // The extension picks the format, see ImageFile::Write()
+        uint32_t Width = 0, Height = 0;
+        std::vector<uint32_t> Pixels;       // Resolved, for .png and .ppm
+        std::vector<glm::vec3> Radiance;    // Linear, for .exr and .pfm
+    };
+public:
+    explicit ImageWriter(uint32_t maxPending = 3);
+    ~ImageWriter();
+
+    ImageWriter(const ImageWriter&) = delete;
+    ImageWriter& operator=(const ImageWriter&) = delete;
+
+    // An image to fill in and Submit(), waits while MaxPending are queued
+    std::unique_ptr<Image> Acquire();
+    void Submit(std::unique_ptr<Image> image);
+    // Waits until everything submitted is on the disk
+    void Finish();
+
+    uint32_t GetWrittenCount() const { return m_Written; }
+    uint32_t GetFailedCount() const { return m_Failed; }
+    const std::string& GetLastFailure() const { return m_LastFailure; }
+    // Seconds Acquire() waited for the writer, and the writer spent encoding and writing
+    double GetWaitTime() const { return m_WaitTime; }
+    double GetWriteTime() const { return m_WriteTime; }
+private:
+    void WriteMain();
+private:
+    const uint32_t m_MaxPending;
+    std::thread m_Thread;
+    std::mutex m_Mutex;
+    std::condition_variable m_Condition;
+    std::deque<std::unique_ptr<Image>> m_Queue;
+    std::vector<std::unique_ptr<Image>> m_Free;
+    uint32_t m_Busy = 0;            // Acquired or queued, not yet written
+    bool m_Writing = false;
+    bool m_Stopping = false;
+
+    uint32_t m_Written = 0, m_Failed = 0;
+    std::string m_LastFailure;
+    double m_WaitTime = 0.0, m_WriteTime = 0.0;
+};
@@ -0,0 +1,274 @@
+#include "Memory.h"
+
+#include <algorithm>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace Memory {
+
+    void* AllocatePages(size_t size)
+    {
+        if (size == 0)
+            return nullptr;
+
+#ifdef _WIN32
+        return VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#else
+        void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        return memory == MAP_FAILED ? nullptr : memory;
+#endif
+    }
+
+    void FreePages(void* memory, size_t size)
+    {
+        if (!memory)
+            return;
+
+#ifdef _WIN32
+        VirtualFree(memory, 0, MEM_RELEASE);
+#else
+        munmap(memory, size);
+#endif
+    }
+
+    size_t GetPageSize()
+    {
+#ifdef _WIN32
+        SYSTEM_INFO info;
+        GetSystemInfo(&info);
+        return info.dwPageSize;
+#else
+        return (size_t)sysconf(_SC_PAGESIZE);
+#endif
+    }
+
+    bool MappedFile::Open(const std::string& path)
+    {
+        Close();
+
+#ifdef _WIN32
+        HANDLE file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_ALWAYS,
+            FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+            return false;
+        LARGE_INTEGER size;
+        GetFileSizeEx(file, &size);
+        m_File = file;
+        m_Size = (size_t)size.QuadPart;
+#else
+        m_File = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+        if (m_File < 0)
+            return false;
+        struct stat info;
+        fstat(m_File, &info);
+        m_Size = (size_t)info.st_size;
+#endif
+
+        if (!Map())
+        {
+            Close();
+            return false;
+        }
+        return true;
+    }
+
+    void MappedFile::Close()
+    {
+        Unmap();
+#ifdef _WIN32
+        if (m_File)
+            CloseHandle(m_File);
+        m_File = nullptr;
+#else
+        if (m_File >= 0)
+            close(m_File);
+        m_File = -1;
+#endif
+        m_Size = 0;
+    }
+
+    bool MappedFile::Resize(size_t size)
+    {
+        if (!IsOpen())
+            return false;
+
+        Unmap();
+#ifdef _WIN32
+        LARGE_INTEGER end;
+        end.QuadPart = (LONGLONG)size;
+        const bool resized = SetFilePointerEx(m_File, end, nullptr, FILE_BEGIN) && SetEndOfFile(m_File);
+#else
+        const bool resized = ftruncate(m_File, (off_t)size) == 0;
+#endif
+        if (resized)
+            m_Size = size;
+        return Map() && resized;
+    }
+
+    bool MappedFile::Flush(size_t offset, size_t size)
+    {
+        if (!m_Data || offset >= m_Size)
+            return false;
+
+        // Both systems want the range to start on a page
+        const size_t pageOffset = offset - offset % GetPageSize();
+        size = std::min(size, m_Size - offset) + (offset - pageOffset);
+#ifdef _WIN32
+        return FlushViewOfFile(m_Data + pageOffset, size) && FlushFileBuffers(m_File);
+#else
+        return msync(m_Data + pageOffset, size, MS_SYNC) == 0;
+#endif
+    }
+
+    bool MappedFile::IsOpen() const
+    {
+#ifdef _WIN32
+        return m_File != nullptr;
+#else
+        return m_File >= 0;
+#endif
+    }
+
+    bool MappedFile::Map()
+    {
+        // Nothing to map in an empty file
+        if (m_Size == 0)
+            return true;
+
+#ifdef _WIN32
+        m_Mapping = CreateFileMappingA(m_File, nullptr, PAGE_READWRITE, 0, 0, nullptr);
+        if (!m_Mapping)
+            return false;
+        m_Data = (uint8_t*)MapViewOfFile(m_Mapping, FILE_MAP_ALL_ACCESS, 0, 0, m_Size);
+#else
+        void* data = mmap(nullptr, m_Size, PROT_READ | PROT_WRITE, MAP_SHARED, m_File, 0);
+        m_Data = data == MAP_FAILED ? nullptr : (uint8_t*)data;
+#endif
+        return m_Data != nullptr;
+    }
+
+    void MappedFile::Unmap()
+    {
+#ifdef _WIN32
+        if (m_Data)
+            UnmapViewOfFile(m_Data);
+        if (m_Mapping)
+            CloseHandle(m_Mapping);
+        m_Mapping = nullptr;
+#else
+        if (m_Data)
+            munmap(m_Data, m_Size);
+#endif
+        m_Data = nullptr;
+    }
+
+    namespace {
+
+#ifdef _WIN32
+        std::string GetMappingName(const std::string& name) { return "Local\\" + name; }
+#else
+        std::string GetMappingName(const std::string& name) { return "/" + name; }
+#endif
+
+    }
+
+    bool SharedMemory::Create(const std::string& name, size_t size)
+    {
+        Close();
+        const std::string mappingName = GetMappingName(name);
+
+#ifdef _WIN32
+        m_Mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, (DWORD)((uint64_t)size >> 32),
+            (DWORD)size, mappingName.c_str());
+        if (!m_Mapping)
+            return false;
+        m_Data = (uint8_t*)MapViewOfFile(m_Mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+#else
+        // Readers still holding the old memory keep it until they unmap, the name moves on
+        shm_unlink(mappingName.c_str());
+        const int file = shm_open(mappingName.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+        if (file < 0)
+            return false;
+        void* data = ftruncate(file, (off_t)size) == 0
+            ? mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0) : MAP_FAILED;
+        close(file);
+        m_Data = data == MAP_FAILED ? nullptr : (uint8_t*)data;
+        if (!m_Data)
+            shm_unlink(mappingName.c_str());
+#endif
+
+        if (!m_Data)
+        {
+            Close();
+            return false;
+        }
+        m_Size = size;
+        m_Name = name;
+        return true;
+    }
+
+    bool SharedMemory::Open(const std::string& name)
+    {
+        Close();
+        const std::string mappingName = GetMappingName(name);
+
+#ifdef _WIN32
+        m_Mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, mappingName.c_str());
+        if (!m_Mapping)
+            return false;
+        m_Data = (uint8_t*)MapViewOfFile(m_Mapping, FILE_MAP_READ, 0, 0, 0);
+        MEMORY_BASIC_INFORMATION info;
+        if (m_Data && VirtualQuery(m_Data, &info, sizeof(info)))
+            m_Size = info.RegionSize;
+#else
+        const int file = shm_open(mappingName.c_str(), O_RDONLY, 0);
+        if (file < 0)
+            return false;
+        struct stat info;
+        void* data = MAP_FAILED;
+        if (fstat(file, &info) == 0 && info.st_size > 0)
+        {
+            m_Size = (size_t)info.st_size;
+            data = mmap(nullptr, m_Size, PROT_READ, MAP_SHARED, file, 0);
+        }
+        close(file);
+        m_Data = data == MAP_FAILED ? nullptr : (uint8_t*)data;
+#endif
+
+        if (!m_Data)
+        {
+            Close();
+            return false;
+        }
+        return true;
+    }
+
+    void SharedMemory::Close()
+    {
+#ifdef _WIN32
+        if (m_Data)
+            UnmapViewOfFile(m_Data);
+        if (m_Mapping)
+            CloseHandle(m_Mapping);
+        m_Mapping = nullptr;
+#else
+        if (m_Data)
+            munmap(m_Data, m_Size);
+        if (!m_Name.empty())
+            shm_unlink(GetMappingName(m_Name).c_str());
+#endif
+        m_Data = nullptr;
+        m_Size = 0;
+        m_Name.clear();
+    }
+
+}
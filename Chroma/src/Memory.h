@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace Memory {
+
+    // Maps fresh, zeroed pages straight from the OS. Nothing is touched here, so each page is
+    // physically placed (on NUMA systems: on the node of) whichever thread writes to it first.
+    void* AllocatePages(size_t size);
+    void FreePages(void* memory, size_t size);
+
+    size_t GetPageSize();
+
+    // Owning array on top of AllocatePages, the contents are zero after every Resize()
+    template<typename T>
+    class PageArray
+    {
+    public:
+        PageArray() = default;
+        ~PageArray() { FreePages(m_Data, m_Count * sizeof(T)); }
+
+        PageArray(const PageArray&) = delete;
+        PageArray& operator=(const PageArray&) = delete;
+
+        void Resize(size_t count)
+        {
+            FreePages(m_Data, m_Count * sizeof(T));
+            m_Data = (T*)AllocatePages(count * sizeof(T));
+            m_Count = count;
+        }
+
+        T* Data() { return m_Data; }
+        const T* Data() const { return m_Data; }
+        size_t Size() const { return m_Count; }
+    private:
+        T* m_Data = nullptr;
+        size_t m_Count = 0;
+    };
+
+    // File mapped into memory in full and shared with the OS page cache, so writes to it reach
+    // the disk even if the process dies right after. Flush() waits until they have.
+    class MappedFile
+    {
+    public:
+        MappedFile() = default;
+        ~MappedFile() { Close(); }
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        // Maps an existing file as it is, or creates an empty one
+        bool Open(const std::string& path);
+        void Close();
+
+        // Changes the file size and maps it again, the data moves
+        bool Resize(size_t size);
+        // Writes the range back to the disk and waits for it
+        bool Flush(size_t offset, size_t size);
+
+        bool IsOpen() const;
+        uint8_t* Data() { return m_Data; }
+        const uint8_t* Data() const { return m_Data; }
+        size_t Size() const { return m_Size; }
+    private:
+        bool Map();
+        void Unmap();
+    private:
+        uint8_t* m_Data = nullptr;
+        size_t m_Size = 0;
+#ifdef _WIN32
+        void* m_File = nullptr;
+        void* m_Mapping = nullptr;
+#else
+        int m_File = -1;
+#endif
+    };
+
+    // Named memory that other processes map by the same name: POSIX shared memory, or a file mapping
+    // in the session namespace on Windows. The creator owns the name, it goes away on Close().
+    class SharedMemory
+    {
+    public:
+        SharedMemory() = default;
+        ~SharedMemory() { Close(); }
+
+        SharedMemory(const SharedMemory&) = delete;
+        SharedMemory& operator=(const SharedMemory&) = delete;
+
+        // Replaces any memory of that name, the new one is zeroed
+        bool Create(const std::string& name, size_t size);
+        // Maps existing memory in full, read only
+        bool Open(const std::string& name);
+        void Close();
+
+        bool IsOpen() const { return m_Data != nullptr; }
+        uint8_t* Data() { return m_Data; }
+        const uint8_t* Data() const { return m_Data; }
+        size_t Size() const { return m_Size; }
+    private:
+        uint8_t* m_Data = nullptr;
+        size_t m_Size = 0;
+        std::string m_Name;  // Only set for memory this process created
+#ifdef _WIN32
+        void* m_Mapping = nullptr;
+#endif
+    };
+}
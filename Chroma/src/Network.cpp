@@ -0,0 +1,293 @@
+#include "Network.h"
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <WinSock2.h>
+#include <WS2tcpip.h>
+#ifdef _MSC_VER
+#pragma comment(lib, "ws2_32.lib")
+#endif
+#else
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace Network {
+
+    namespace {
+
+#ifdef _WIN32
+        using NativeSocket = SOCKET;
+
+        void CloseNative(NativeSocket socket) { closesocket(socket); }
+
+        bool Startup()
+        {
+            static const bool started = []()
+            {
+                WSADATA data;
+                return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+            }();
+            return started;
+        }
+#else
+        using NativeSocket = int;
+
+        void CloseNative(NativeSocket socket) { close(socket); }
+
+        bool Startup() { return true; }
+#endif
+
+        constexpr const char* UnixPrefix = "unix:";
+
+        bool IsUnixAddress(const std::string& address)
+        {
+            return address.compare(0, 5, UnixPrefix) == 0;
+        }
+
+        // Opens a socket for the address and hands it to bind or connect, trying every resolved address
+        template<typename Func>
+        intptr_t OpenSocket(const std::string& address, bool listen, Func&& func)
+        {
+            if (!Startup())
+                return Socket::InvalidHandle;
+
+            if (IsUnixAddress(address))
+            {
+#ifdef _WIN32
+                return Socket::InvalidHandle;
+#else
+                sockaddr_un name = {};
+                name.sun_family = AF_UNIX;
+                const std::string path = address.substr(5);
+                if (path.empty() || path.size() >= sizeof(name.sun_path))
+                    return Socket::InvalidHandle;
+                path.copy(name.sun_path, path.size());
+
+                NativeSocket handle = socket(AF_UNIX, SOCK_STREAM, 0);
+                if (handle < 0)
+                    return Socket::InvalidHandle;
+                if (!func(handle, (const sockaddr*)&name, (int)sizeof(name)))
+                {
+                    CloseNative(handle);
+                    return Socket::InvalidHandle;
+                }
+                return handle;
+#endif
+            }
+
+            const size_t colon = address.rfind(':');
+            if (colon == std::string::npos)
+                return Socket::InvalidHandle;
+            const std::string host = address.substr(0, colon);
+            const std::string port = address.substr(colon + 1);
+
+            addrinfo hints = {};
+            hints.ai_family = AF_UNSPEC;
+            hints.ai_socktype = SOCK_STREAM;
+            hints.ai_flags = listen ? AI_PASSIVE : 0;
+            addrinfo* results = nullptr;
+            if (getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(), &hints, &results) != 0)
+                return Socket::InvalidHandle;
+
+            intptr_t result = Socket::InvalidHandle;
+            for (addrinfo* info = results; info && result == Socket::InvalidHandle; info = info->ai_next)
+            {
+                NativeSocket handle = socket(info->ai_family, info->ai_socktype, info->ai_protocol);
+                if ((intptr_t)handle == Socket::InvalidHandle)
+                    continue;
+
+                // Messages are small and answered right away, they must not wait for more data
+                int enable = 1;
+                setsockopt(handle, IPPROTO_TCP, TCP_NODELAY, (const char*)&enable, sizeof(enable));
+                if (listen)
+                    setsockopt(handle, SOL_SOCKET, SO_REUSEADDR, (const char*)&enable, sizeof(enable));
+
+                if (func(handle, info->ai_addr, (int)info->ai_addrlen))
+                    result = (intptr_t)handle;
+                else
+                    CloseNative(handle);
+            }
+            freeaddrinfo(results);
+            return result;
+        }
+    }
+
+    Socket::Socket(Socket&& other) noexcept
+        : m_Handle(other.m_Handle), m_Path(std::move(other.m_Path))
+    {
+        other.m_Handle = InvalidHandle;
+        other.m_Path.clear();
+    }
+
+    Socket& Socket::operator=(Socket&& other) noexcept
+    {
+        if (this != &other)
+        {
+            Close();
+            m_Handle = other.m_Handle;
+            m_Path = std::move(other.m_Path);
+            other.m_Handle = InvalidHandle;
+            other.m_Path.clear();
+        }
+        return *this;
+    }
+
+    bool Socket::Listen(const std::string& address)
+    {
+        Close();
+
+        // A socket file left behind by a listener that crashed would make bind fail
+        if (IsUnixAddress(address))
+        {
+#ifndef _WIN32
+            unlink(address.c_str() + 5);
+#endif
+        }
+
+        m_Handle = OpenSocket(address, true, [](NativeSocket handle, const sockaddr* name, int size)
+            {
+                return bind(handle, name, size) == 0 && listen(handle, SOMAXCONN) == 0;
+            });
+        if (IsOpen() && IsUnixAddress(address))
+            m_Path = address.substr(5);
+        return IsOpen();
+    }
+
+    bool Socket::Accept(Socket& client)
+    {
+        client.Close();
+        NativeSocket handle = accept((NativeSocket)m_Handle, nullptr, nullptr);
+        if ((intptr_t)handle == InvalidHandle)
+            return false;
+
+        int enable = 1;
+        setsockopt(handle, IPPROTO_TCP, TCP_NODELAY, (const char*)&enable, sizeof(enable));
+        client.m_Handle = (intptr_t)handle;
+        return true;
+    }
+
+    bool Socket::Connect(const std::string& address, double timeout)
+    {
+        Close();
+
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::duration<double>(timeout);
+        while (true)
+        {
+            m_Handle = OpenSocket(address, false, [](NativeSocket handle, const sockaddr* name, int size)
+                {
+                    return connect(handle, name, size) == 0;
+                });
+            if (IsOpen() || std::chrono::steady_clock::now() >= deadline)
+                return IsOpen();
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        }
+    }
+
+    void Socket::Close()
+    {
+        if (!IsOpen())
+            return;
+
+        CloseNative((NativeSocket)m_Handle);
+        m_Handle = InvalidHandle;
+#ifndef _WIN32
+        if (!m_Path.empty())
+            unlink(m_Path.c_str());
+#endif
+        m_Path.clear();
+    }
+
+    bool Socket::Send(const void* data, size_t size)
+    {
+#ifdef MSG_NOSIGNAL
+        // A worker that went away must show up as an error, not end the process with SIGPIPE
+        constexpr int Flags = MSG_NOSIGNAL;
+#else
+        constexpr int Flags = 0;
+#endif
+        const char* bytes = (const char*)data;
+        while (size > 0)
+        {
+            const int chunk = (int)std::min<size_t>(size, 1 << 30);
+            const auto sent = send((NativeSocket)m_Handle, bytes, chunk, Flags);
+            if (sent <= 0)
+                return false;
+            bytes += sent;
+            size -= (size_t)sent;
+        }
+        return true;
+    }
+
+    bool Socket::Receive(void* data, size_t size)
+    {
+        char* bytes = (char*)data;
+        while (size > 0)
+        {
+            const int chunk = (int)std::min<size_t>(size, 1 << 30);
+            const auto received = recv((NativeSocket)m_Handle, bytes, chunk, 0);
+            if (received <= 0)
+                return false;
+            bytes += received;
+            size -= (size_t)received;
+        }
+        return true;
+    }
+
+    void Socket::SetReceiveTimeout(uint32_t milliseconds)
+    {
+#ifdef _WIN32
+        DWORD timeout = milliseconds;
+#else
+        timeval timeout = {};
+        timeout.tv_sec = milliseconds / 1000;
+        timeout.tv_usec = (milliseconds % 1000) * 1000;
+#endif
+        setsockopt((NativeSocket)m_Handle, SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout));
+    }
+
+    int Poll(Socket* const* sockets, size_t count, uint8_t* readable, int timeout)
+    {
+        std::vector<pollfd> fds(count);
+        for (size_t i = 0; i < count; i++)
+        {
+            fds[i].fd = (NativeSocket)sockets[i]->GetHandle();
+            fds[i].events = POLLIN;
+        }
+
+#ifdef _WIN32
+        const int ready = WSAPoll(fds.data(), (ULONG)count, timeout);
+#else
+        const int ready = poll(fds.data(), (nfds_t)count, timeout);
+#endif
+        for (size_t i = 0; i < count; i++)
+            readable[i] = ready > 0 && (fds[i].revents & (POLLIN | POLLHUP | POLLERR)) ? 1 : 0;
+        return ready;
+    }
+
+    bool SendMessage(Socket& socket, uint32_t type, const void* data, size_t size, const void* extraData, size_t extraSize)
+    {
+        const MessageHeader header = { type, (uint32_t)(size + extraSize) };
+        return socket.Send(&header, sizeof(header)) && socket.Send(data, size) &&
+            (extraSize == 0 || socket.Send(extraData, extraSize));
+    }
+
+    bool ReceiveMessage(Socket& socket, MessageHeader& header, std::vector<uint8_t>& payload, uint32_t maxSize)
+    {
+        if (!socket.Receive(&header, sizeof(header)) || header.Size > maxSize)
+            return false;
+        payload.resize(header.Size);
+        return socket.Receive(payload.data(), payload.size());
+    }
+}
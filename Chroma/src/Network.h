@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Blocking stream sockets between processes. Addresses are "host:port" for TCP, with an empty host
+// meaning every interface to listen on and this machine to connect to, or "unix:<path>" for a Unix
+// domain socket where the platform has them.
+namespace Network {
+
+    class Socket
+    {
+    public:
+        Socket() = default;
+        ~Socket() { Close(); }
+
+        Socket(const Socket&) = delete;
+        Socket& operator=(const Socket&) = delete;
+        Socket(Socket&& other) noexcept;
+        Socket& operator=(Socket&& other) noexcept;
+
+        bool Listen(const std::string& address);
+        // Waits for the next connection to a listening socket
+        bool Accept(Socket& client);
+        // Retries until the listener is up or timeout seconds passed
+        bool Connect(const std::string& address, double timeout = 0.0);
+        void Close();
+
+        // Both move all of the data or fail, a closed connection is a failure too
+        bool Send(const void* data, size_t size);
+        bool Receive(void* data, size_t size);
+        // Receive() fails once nothing arrived for that long, 0 waits forever
+        void SetReceiveTimeout(uint32_t milliseconds);
+
+        bool IsOpen() const { return m_Handle != InvalidHandle; }
+        intptr_t GetHandle() const { return m_Handle; }
+
+        static constexpr intptr_t InvalidHandle = -1;
+    private:
+        intptr_t m_Handle = InvalidHandle;
+        std::string m_Path; // Of a listening Unix domain socket, removed on Close()
+    };
+
+    // Waits up to timeout milliseconds for any of the sockets to have data or a closed connection
+    // waiting, and flags those in readable. Returns how many there are, or -1 on error.
+    int Poll(Socket* const* sockets, size_t count, uint8_t* readable, int timeout);
+
+    // Messages are a header and Size bytes of payload, the type is up to the protocol
+    struct MessageHeader
+    {
+        uint32_t Type;
+        uint32_t Size;
+    };
+
+    // The payload is sent from two parts, so that a fixed header and a large array need no copy
+    bool SendMessage(Socket& socket, uint32_t type, const void* data, size_t size, const void* extraData = nullptr,
+        size_t extraSize = 0);
+    // Fails on payloads larger than maxSize, the connection is out of step after that
+    bool ReceiveMessage(Socket& socket, MessageHeader& header, std::vector<uint8_t>& payload, uint32_t maxSize);
+}
@@ -0,0 +1,188 @@
+#include "PerfCounters.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#endif
+
+namespace PerfCounters {
+
+    namespace {
+
+#ifdef __linux__
+        struct ThreadGroup
+        {
+            int Fds[CounterCount] = { -1, -1, -1, -1, -1 };
+            // Position of each counter in the group read, the group only holds the ones that opened
+            uint32_t Slots[CounterCount] = {};
+            uint32_t Opened = 0;
+            uint32_t ValidMask = 0;
+            std::string Error;
+
+            ThreadGroup()
+            {
+                const struct { uint32_t Type; uint64_t Config; } events[CounterCount] = {
+                    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+                    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+                    { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                        (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+                    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+                    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+                };
+
+                for (uint32_t i = 0; i < CounterCount; i++)
+                {
+                    perf_event_attr attr;
+                    memset(&attr, 0, sizeof(attr));
+                    attr.size = sizeof(attr);
+                    attr.type = events[i].Type;
+                    attr.config = events[i].Config;
+                    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+                    // User space only, which perf_event_paranoid 2 still allows
+                    attr.exclude_kernel = 1;
+                    attr.exclude_hv = 1;
+                    attr.disabled = i == 0 ? 1 : 0;
+
+                    const int leader = i == 0 ? -1 : Fds[0];
+                    const int fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0);
+                    if (fd < 0)
+                    {
+                        // Without the leader there is no group, other counters are optional
+                        if (i == 0)
+                        {
+                            Error = std::string("perf_event_open: ") + strerror(errno);
+                            return;
+                        }
+                        continue;
+                    }
+
+                    Fds[i] = fd;
+                    Slots[i] = Opened++;
+                    ValidMask |= 1u << i;
+                }
+
+                ioctl(Fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+                ioctl(Fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+            }
+
+            ~ThreadGroup()
+            {
+                for (int fd : Fds)
+                {
+                    if (fd >= 0)
+                        close(fd);
+                }
+            }
+
+            void Read(Snapshot& snapshot) const
+            {
+                snapshot = {};
+                if (ValidMask == 0)
+                    return;
+
+                // nr, time_enabled, time_running, then one value per opened counter
+                uint64_t data[3 + CounterCount];
+                const ssize_t size = read(Fds[0], data, sizeof(data));
+                if (size < (ssize_t)(3 * sizeof(uint64_t)) || data[0] != Opened)
+                    return;
+
+                snapshot.TimeEnabled = data[1];
+                snapshot.TimeRunning = data[2];
+                for (uint32_t i = 0; i < CounterCount; i++)
+                {
+                    if (ValidMask & (1u << i))
+                        snapshot.Values[i] = data[3 + Slots[i]];
+                }
+                snapshot.ValidMask = ValidMask;
+            }
+        };
+
+        ThreadGroup& GetThreadGroup()
+        {
+            thread_local ThreadGroup group;
+            return group;
+        }
+#endif
+
+    }
+
+    const char* GetCounterName(Counter counter)
+    {
+        switch (counter)
+        {
+            case Counter::Cycles:       return "cycles";
+            case Counter::Instructions: return "instructions";
+            case Counter::L1DMisses:    return "l1d_misses";
+            case Counter::LLCMisses:    return "llc_misses";
+            case Counter::BranchMisses: return "branch_misses";
+        }
+        return "";
+    }
+
+    double Sample::GetIPC() const
+    {
+        if (!Has(Counter::Cycles) || !Has(Counter::Instructions) || Get(Counter::Cycles) == 0)
+            return 0.0;
+        return (double)Get(Counter::Instructions) / (double)Get(Counter::Cycles);
+    }
+
+    void Sample::AddDelta(const Snapshot& begin, const Snapshot& end)
+    {
+        const uint32_t mask = begin.ValidMask & end.ValidMask;
+        if (mask == 0)
+            return;
+
+        // The group ran for only part of the time when the kernel multiplexed it with others
+        const uint64_t enabled = end.TimeEnabled - begin.TimeEnabled;
+        const uint64_t running = end.TimeRunning - begin.TimeRunning;
+        const double scale = running > 0 ? (double)enabled / (double)running : 0.0;
+
+        for (uint32_t i = 0; i < CounterCount; i++)
+        {
+            if (mask & (1u << i))
+                Values[i] += (uint64_t)((double)(end.Values[i] - begin.Values[i]) * scale);
+        }
+        ValidMask |= mask;
+    }
+
+    void Sample::Add(const Sample& other)
+    {
+        for (uint32_t i = 0; i < CounterCount; i++)
+            Values[i] += other.Values[i];
+        ValidMask |= other.ValidMask;
+    }
+
+    void Read(Snapshot& snapshot)
+    {
+#ifdef __linux__
+        GetThreadGroup().Read(snapshot);
+#else
+        snapshot = {};
+#endif
+    }
+
+    bool IsAvailable()
+    {
+#ifdef __linux__
+        return GetThreadGroup().ValidMask != 0;
+#else
+        return false;
+#endif
+    }
+
+    const std::string& GetUnavailableReason()
+    {
+#ifdef __linux__
+        return GetThreadGroup().Error;
+#else
+        static const std::string reason = "Hardware counters are only read on Linux";
+        return reason;
+#endif
+    }
+
+}
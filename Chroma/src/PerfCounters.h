@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Hardware performance counters of the calling thread, read through perf_event_open on Linux.
+// Every thread opens its own counter group the first time it reads one. When the counters are
+// unavailable (other platforms, containers, perf_event_paranoid) reads return an empty sample.
+namespace PerfCounters {
+
+    enum class Counter
+    {
+        Cycles = 0,
+        Instructions = 1,
+        L1DMisses = 2,
+        LLCMisses = 3,
+        BranchMisses = 4
+    };
+
+    constexpr uint32_t CounterCount = 5;
+
+    const char* GetCounterName(Counter counter);
+
+    // Raw group reading, only differences of two snapshots mean something
+    struct Snapshot
+    {
+        uint64_t Values[CounterCount] = {};
+        uint64_t TimeEnabled = 0;
+        uint64_t TimeRunning = 0;
+        uint32_t ValidMask = 0;
+    };
+
+    // Counts between two snapshots, scaled up when the kernel had to multiplex the group
+    struct Sample
+    {
+        uint64_t Values[CounterCount] = {};
+        uint32_t ValidMask = 0; // Bit per Counter, a counter the CPU lacks is never set
+
+        bool Has(Counter counter) const { return (ValidMask >> (uint32_t)counter) & 1; }
+        uint64_t Get(Counter counter) const { return Values[(uint32_t)counter]; }
+        double GetIPC() const;
+
+        void AddDelta(const Snapshot& begin, const Snapshot& end);
+        void Add(const Sample& other);
+    };
+
+    // Counts of the two render phases of a frame, summed over all workers
+    struct FrameSample
+    {
+        Sample Render;  // Tile loop
+        Sample Resolve;
+    };
+
+    // Opens the calling thread's group on first use
+    void Read(Snapshot& snapshot);
+
+    // Whether the calling thread could open at least the cycle counter, and why not
+    bool IsAvailable();
+    const std::string& GetUnavailableReason();
+
+}
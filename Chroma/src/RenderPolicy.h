@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+
+// The render kernels are compiled once for every combination of these features. Renderer picks
+// the combination matching the settings and scene once per frame, so the per-pixel loop never
+// checks settings that cannot change during a frame and skips shape types the scene lacks.
+namespace RenderPolicy {
+
+    enum Feature : uint32_t
+    {
+        AntiAliasing = 1 << 0, // Jittered samples, more than one per pixel
+        SlowRandom   = 1 << 1, // Diffuse bounces use Walnut::Random instead of the per-pixel hash
+        Spheres      = 1 << 2,
+        Planes       = 1 << 3,
+        Boxes        = 1 << 4,
+        Triangles    = 1 << 5,
+        Transparency = 1 << 6, // Some material refracts
+        Textures     = 1 << 7  // Some material has a texture
+    };
+
+    constexpr uint32_t FeatureCount = 8;
+    constexpr uint32_t Combinations = 1u << FeatureCount;
+
+    template<uint32_t Features>
+    struct Policy
+    {
+        static constexpr bool AntiAliasing = (Features & Feature::AntiAliasing) != 0;
+        static constexpr bool SlowRandom = (Features & Feature::SlowRandom) != 0;
+
+        static constexpr bool Spheres = (Features & Feature::Spheres) != 0;
+        static constexpr bool Planes = (Features & Feature::Planes) != 0;
+        static constexpr bool Boxes = (Features & Feature::Boxes) != 0;
+        static constexpr bool Triangles = (Features & Feature::Triangles) != 0;
+        static constexpr bool BVH = Spheres || Boxes || Triangles; // Planes are not part of the BVH
+
+        static constexpr bool Transparency = (Features & Feature::Transparency) != 0;
+        static constexpr bool Textures = (Features & Feature::Textures) != 0;
+    };
+
+    inline const char* GetFeatureName(Feature feature)
+    {
+        switch (feature)
+        {
+            case AntiAliasing: return "aa";
+            case SlowRandom:   return "slow-random";
+            case Spheres:      return "spheres";
+            case Planes:       return "planes";
+            case Boxes:        return "boxes";
+            case Triangles:    return "triangles";
+            case Transparency: return "transparency";
+            case Textures:     return "textures";
+        }
+        return "";
+    }
+
+}
@@ -0,0 +1,429 @@
+#include "RenderService.h"
+#include "ImageFile.h"
+
+#include "Walnut/Timer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+namespace RenderService {
+
+    namespace {
+
+        enum class MessageType : uint32_t
+        {
+            Submit = 1,     // JobRequest, answered with Submitted
+            Watch = 2,      // Job id, answered with its progress
+            Cancel = 3,     // Job id, answered with its progress
+            Submitted = 4,  // Job id
+            Progress = 5    // JobProgress
+        };
+
+        constexpr uint32_t MaxMessageSize = 1u << 16;
+        constexpr int PollTimeout = 50;
+        // In milliseconds, messages are small so a client this slow to finish one is dropped
+        constexpr uint32_t ReceiveTimeout = 1000;
+        // Progress is pushed at most this often while a job renders, state changes right away
+        constexpr double ProgressInterval = 0.1;
+        // Finished jobs stay known this long after their watchers got the final state, so a late Watch
+        // still gets it. Older ones are answered as unknown.
+        constexpr size_t MaxRetiredJobs = 1024;
+
+        template<typename T>
+        bool Send(Network::Socket& socket, MessageType type, const T& value)
+        {
+            return Network::SendMessage(socket, (uint32_t)type, &value, sizeof(value));
+        }
+
+        void SetMessage(JobProgress& progress, const std::string& message)
+        {
+            snprintf(progress.Message, sizeof(progress.Message), "%s", message.c_str());
+        }
+
+    }
+
+    const char* GetStateName(JobState state)
+    {
+        switch (state)
+        {
+            case JobState::Queued:    return "queued";
+            case JobState::Loading:   return "loading";
+            case JobState::Rendering: return "rendering";
+            case JobState::Done:      return "done";
+            case JobState::Cancelled: return "cancelled";
+            case JobState::Failed:    return "failed";
+        }
+        return "";
+    }
+
+    Server::Server(size_t cacheSize)
+        : m_Cache(cacheSize)
+    {
+    }
+
+    Server::~Server()
+    {
+        Stop();
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+        }
+        m_JobAdded.notify_all();
+        if (m_RenderThread.joinable())
+            m_RenderThread.join();
+    }
+
+    bool Server::Listen(const std::string& address)
+    {
+        return m_Listener.Listen(address);
+    }
+
+    void Server::Run()
+    {
+        m_RenderThread = std::thread(&Server::RenderJobs, this);
+
+        std::vector<Network::Socket*> sockets;
+        std::vector<uint8_t> readable;
+        std::vector<uint32_t> updated;
+        while (!m_Stopping)
+        {
+            sockets.clear();
+            sockets.push_back(&m_Listener);
+            for (const std::unique_ptr<Connection>& connection : m_Connections)
+                sockets.push_back(&connection->Socket);
+            readable.assign(sockets.size(), 0);
+
+            if (Network::Poll(sockets.data(), sockets.size(), readable.data(), PollTimeout) > 0)
+            {
+                // Backwards, closed connections are removed on the way
+                for (size_t i = m_Connections.size(); i-- > 0;)
+                {
+                    if (readable[i + 1] && !ReadMessage(*m_Connections[i]))
+                        m_Connections.erase(m_Connections.begin() + i);
+                }
+
+                if (readable[0])
+                {
+                    auto connection = std::make_unique<Connection>();
+                    if (m_Listener.Accept(connection->Socket))
+                    {
+                        // A client that stops halfway through a message must not stall every other one
+                        connection->Socket.SetReceiveTimeout(ReceiveTimeout);
+                        m_Connections.push_back(std::move(connection));
+                    }
+                }
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(m_Mutex);
+                updated.swap(m_Updated);
+            }
+            for (uint32_t jobId : updated)
+                SendProgress(jobId);
+            updated.clear();
+        }
+
+        // Taking the lock makes sure the render thread either sees the flag or is already waiting
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+        }
+        m_JobAdded.notify_all();
+        m_RenderThread.join();
+
+        // The job stopped with the service is the last thing its watchers hear
+        updated.swap(m_Updated);
+        for (uint32_t jobId : updated)
+            SendProgress(jobId);
+    }
+
+    bool Server::ReadMessage(Connection& connection)
+    {
+        Network::MessageHeader header;
+        std::vector<uint8_t> payload;
+        if (!Network::ReceiveMessage(connection.Socket, header, payload, MaxMessageSize))
+            return false;
+
+        if (header.Type == (uint32_t)MessageType::Submit && payload.size() == sizeof(JobRequest))
+        {
+            auto job = std::make_shared<Job>();
+            std::memcpy(&job->Request, payload.data(), sizeof(JobRequest));
+            job->Request.ScenePath[sizeof(job->Request.ScenePath) - 1] = '\0';
+            job->Request.OutputPath[sizeof(job->Request.OutputPath) - 1] = '\0';
+            job->Progress.TargetFrames = job->Request.Samples;
+
+            uint32_t jobId;
+            {
+                std::lock_guard<std::mutex> lock(m_Mutex);
+                jobId = m_NextJobId++;
+                job->Order = jobId;
+                job->Progress.JobId = jobId;
+                m_Jobs[jobId] = job;
+                m_Queue.push(job);
+            }
+            m_JobAdded.notify_one();
+
+            connection.Watched.push_back(jobId);
+            if (!Send(connection.Socket, MessageType::Submitted, jobId))
+                return false;
+            SendProgress(jobId);
+            return true;
+        }
+
+        if ((header.Type == (uint32_t)MessageType::Watch || header.Type == (uint32_t)MessageType::Cancel) &&
+            payload.size() == sizeof(uint32_t))
+        {
+            uint32_t jobId;
+            std::memcpy(&jobId, payload.data(), sizeof(jobId));
+
+            JobProgress progress;
+            {
+                std::lock_guard<std::mutex> lock(m_Mutex);
+                auto found = m_Jobs.find(jobId);
+                if (found == m_Jobs.end())
+                {
+                    progress.JobId = jobId;
+                    progress.State = JobState::Failed;
+                    SetMessage(progress, "Unknown job");
+                    return Send(connection.Socket, MessageType::Progress, progress);
+                }
+
+                // A queued job is skipped when it comes up, a rendering one stops after its frame
+                Job& job = *found->second;
+                if (header.Type == (uint32_t)MessageType::Cancel && !IsFinished(job.Progress.State))
+                {
+                    job.Cancelled = true;
+                    if (job.Progress.State == JobState::Queued)
+                    {
+                        // Its other watchers hear of it now, not once it comes up
+                        job.Progress.State = JobState::Cancelled;
+                        m_Updated.push_back(jobId);
+                    }
+                }
+                progress = job.Progress;
+            }
+
+            // A finished job does not change anymore, the reply is all there is to watch
+            if (!IsFinished(progress.State) &&
+                std::find(connection.Watched.begin(), connection.Watched.end(), jobId) == connection.Watched.end())
+                connection.Watched.push_back(jobId);
+            return Send(connection.Socket, MessageType::Progress, progress);
+        }
+
+        return false;
+    }
+
+    void Server::SendProgress(uint32_t jobId)
+    {
+        JobProgress progress;
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            auto found = m_Jobs.find(jobId);
+            if (found == m_Jobs.end())
+                return;
+            progress = found->second->Progress;
+
+            // The final state is sent once, after that the job only waits to be forgotten
+            Job& job = *found->second;
+            if (IsFinished(progress.State) && !job.Retired)
+            {
+                job.Retired = true;
+                m_Retired.push_back(jobId);
+                while (m_Retired.size() > MaxRetiredJobs)
+                {
+                    m_Jobs.erase(m_Retired.front());
+                    m_Retired.pop_front();
+                }
+            }
+        }
+
+        // A failed send shows up as a closed connection on the next poll
+        for (const std::unique_ptr<Connection>& connection : m_Connections)
+        {
+            std::vector<uint32_t>& watched = connection->Watched;
+            auto found = std::find(watched.begin(), watched.end(), jobId);
+            if (found == watched.end())
+                continue;
+            Send(connection->Socket, MessageType::Progress, progress);
+            if (IsFinished(progress.State))
+                watched.erase(found);
+        }
+    }
+
+    void Server::Publish(Job& job, const JobProgress& progress)
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        job.Progress = progress;
+        m_Updated.push_back(progress.JobId);
+    }
+
+    void Server::RenderJobs()
+    {
+        Walnut::Profiler::SetThreadName("RenderService");
+
+        while (true)
+        {
+            std::shared_ptr<Job> job;
+            {
+                std::unique_lock<std::mutex> lock(m_Mutex);
+                m_JobAdded.wait(lock, [this]() { return m_Stopping || !m_Queue.empty(); });
+                if (m_Stopping)
+                    return;
+
+                job = m_Queue.top();
+                m_Queue.pop();
+                if (job->Cancelled)
+                {
+                    m_Updated.push_back(job->Progress.JobId);
+                    continue;
+                }
+                job->Progress.State = JobState::Loading;
+                m_Updated.push_back(job->Progress.JobId);
+            }
+            RenderJob(*job);
+        }
+    }
+
+    void Server::RenderJob(Job& job)
+    {
+        WL_PROFILE_ZONE("RenderService::RenderJob");
+
+        using Clock = std::chrono::steady_clock;
+        const JobRequest& request = job.Request;
+        JobProgress progress;
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            progress = job.Progress;
+        }
+
+        if (request.Width == 0 || request.Height == 0 || request.Samples == 0)
+        {
+            progress.State = JobState::Failed;
+            SetMessage(progress, "Empty image or no samples");
+            Publish(job, progress);
+            return;
+        }
+
+        auto start = Clock::now();
+        bool hit = false;
+        SceneCache::Entry* entry = m_Cache.Acquire(request.ScenePath, hit);
+        if (!entry)
+        {
+            progress.State = JobState::Failed;
+            SetMessage(progress, std::string("Can not load ") + request.ScenePath);
+            Publish(job, progress);
+            return;
+        }
+        progress.CacheHit = hit ? 1 : 0;
+        progress.LoadSeconds = std::chrono::duration<float>(Clock::now() - start).count();
+
+        // A cached renderer keeps its BVH, only the accumulation starts over for the new camera
+        Renderer& renderer = *entry->SceneRenderer;
+        renderer.GetSettings().SlowRandom = false;
+        renderer.OnResize(request.Width, request.Height);
+        renderer.ResetFrameIndex();
+
+        Camera camera(request.VerticalFOV, 0.1f, 100.0f);
+        camera.OnResize(request.Width, request.Height);
+        camera.LookAt(request.CameraPosition, request.CameraTarget);
+
+        start = Clock::now();
+        renderer.UpdateScene(entry->SceneData);
+        progress.BuildSeconds = std::chrono::duration<float>(Clock::now() - start).count();
+        progress.State = JobState::Rendering;
+        // Materials whose textures can not be loaded render without them
+        if (!renderer.GetTextureErrors().empty())
+            SetMessage(progress, "Texture " + renderer.GetTextureErrors().front());
+        Publish(job, progress);
+
+        start = Clock::now();
+        auto published = start;
+        while (progress.Frames < request.Samples && !job.Cancelled && !m_Stopping)
+        {
+            renderer.Render(entry->SceneData, camera);
+            progress.Frames++;
+
+            const auto now = Clock::now();
+            progress.RenderSeconds = std::chrono::duration<float>(now - start).count();
+            if (std::chrono::duration<double>(now - published).count() >= ProgressInterval)
+            {
+                Publish(job, progress);
+                published = now;
+            }
+        }
+
+        if (job.Cancelled || progress.Frames < request.Samples)
+        {
+            progress.State = JobState::Cancelled;
+            if (!job.Cancelled)
+                SetMessage(progress, "Service stopped");
+        }
+        else
+        {
+            const std::string path = request.OutputPath;
+            std::vector<glm::vec3> image;
+            if (ImageFile::IsLinear(path))
+                renderer.GetAccumulatedImage(image);
+            else
+                renderer.ResolveImage();
+            const bool written = ImageFile::Write(path, request.Width, request.Height, renderer.GetImageData(), image);
+            progress.State = written ? JobState::Done : JobState::Failed;
+            if (!written)
+                SetMessage(progress, "Can not write " + path);
+        }
+
+        m_Cache.Update(*entry);
+        Publish(job, progress);
+    }
+
+    bool Client::Connect(const std::string& address)
+    {
+        return m_Socket.Connect(address);
+    }
+
+    bool Client::Submit(const JobRequest& request, uint32_t& jobId)
+    {
+        return Send(m_Socket, MessageType::Submit, request) && Receive((uint32_t)MessageType::Submitted, &jobId, sizeof(jobId));
+    }
+
+    bool Client::Watch(uint32_t jobId)
+    {
+        return Send(m_Socket, MessageType::Watch, jobId);
+    }
+
+    bool Client::Cancel(uint32_t jobId)
+    {
+        return Send(m_Socket, MessageType::Cancel, jobId);
+    }
+
+    bool Client::ReceiveProgress(JobProgress& progress)
+    {
+        if (!m_Pending.empty())
+        {
+            progress = m_Pending.front();
+            m_Pending.pop_front();
+            return true;
+        }
+        return Receive((uint32_t)MessageType::Progress, &progress, sizeof(progress));
+    }
+
+    bool Client::Receive(uint32_t type, void* data, size_t size)
+    {
+        Network::MessageHeader header;
+        while (Network::ReceiveMessage(m_Socket, header, m_Message, MaxMessageSize))
+        {
+            if (header.Type == type && m_Message.size() == size)
+            {
+                std::memcpy(data, m_Message.data(), size);
+                return true;
+            }
+
+            // Progress of other jobs is kept for ReceiveProgress()
+            if (header.Type != (uint32_t)MessageType::Progress || m_Message.size() != sizeof(JobProgress))
+                return false;
+            JobProgress& progress = m_Pending.emplace_back();
+            std::memcpy(&progress, m_Message.data(), sizeof(progress));
+        }
+        return false;
+    }
+}
@@ -0,0 +1,150 @@
+#pragma once
+
+#include "Network.h"
+#include "SceneCache.h"
+
+#include <glm/glm.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Long-running process that renders jobs submitted over a local socket, one at a time and highest
+// priority first. Clients get the progress of the jobs they submitted or watch pushed to them. Scenes
+// and their BVHs stay cached between jobs, rendering a scene again from another camera only
+// restarts the accumulation.
+namespace RenderService {
+
+#ifdef _WIN32
+    constexpr const char* DefaultAddress = "127.0.0.1:47300";
+#else
+    constexpr const char* DefaultAddress = "unix:/tmp/chroma-service.sock";
+#endif
+
+    enum class JobState : uint32_t
+    {
+        Queued = 0,
+        Loading,
+        Rendering,
+        Done,
+        Cancelled,
+        Failed
+    };
+
+    const char* GetStateName(JobState state);
+    inline bool IsFinished(JobState state) { return state >= JobState::Done; }
+
+    // Sent as it is, client and service have to be the same build
+    struct JobRequest
+    {
+        char ScenePath[256] = {};   // Written by SaveScene()
+        char OutputPath[256] = {};  // .exr and .pfm keep the linear radiance, .png and .ppm are tonemapped
+        glm::vec3 CameraPosition{ 0.0f, 0.0f, 6.0f };
+        glm::vec3 CameraTarget{ 0.0f };
+        float VerticalFOV = 45.0f;
+        uint32_t Width = 1280, Height = 720;
+        uint32_t Samples = 256;     // Frames, each one sample per pixel
+        int32_t Priority = 0;       // Higher goes first, equal ones in order of submission
+    };
+
+    struct JobProgress
+    {
+        uint32_t JobId = 0;
+        JobState State = JobState::Queued;
+        uint32_t Frames = 0, TargetFrames = 0;
+        float RenderSeconds = 0.0f;
+        float LoadSeconds = 0.0f, BuildSeconds = 0.0f;
+        uint32_t CacheHit = 0;      // The scene and its BVH came from the cache
+        char Message[128] = {};     // Why it failed, or stopped without a cancel
+    };
+
+    class Server
+    {
+    public:
+        // cacheSize in bytes of scenes, BVHs and accumulation buffers
+        explicit Server(size_t cacheSize);
+        ~Server();
+
+        bool Listen(const std::string& address);
+        // Serves clients and renders jobs until Stop() is called from another thread
+        void Run();
+        void Stop() { m_Stopping = true; }
+    private:
+        struct Job
+        {
+            JobRequest Request;
+            JobProgress Progress;        // Guarded by m_Mutex
+            std::atomic<bool> Cancelled{ false };
+            uint64_t Order = 0;
+            bool Retired = false;        // Guarded by m_Mutex, the final state went out to the watchers
+        };
+
+        struct Connection
+        {
+            Network::Socket Socket;
+            std::vector<uint32_t> Watched;
+        };
+
+        struct JobOrder
+        {
+            bool operator()(const std::shared_ptr<Job>& a, const std::shared_ptr<Job>& b) const
+            {
+                if (a->Request.Priority != b->Request.Priority)
+                    return a->Request.Priority < b->Request.Priority;
+                return a->Order > b->Order;
+            }
+        };
+
+        bool ReadMessage(Connection& connection);
+        void SendProgress(uint32_t jobId);
+        void RenderJobs();
+        void RenderJob(Job& job);
+        // Called by the render thread, sent to the watchers by the serving one
+        void Publish(Job& job, const JobProgress& progress);
+    private:
+        Network::Socket m_Listener;
+        std::vector<std::unique_ptr<Connection>> m_Connections;
+        std::atomic<bool> m_Stopping{ false };
+
+        std::mutex m_Mutex;
+        std::condition_variable m_JobAdded;
+        // Cancelled jobs stay queued until they come up and are skipped
+        std::priority_queue<std::shared_ptr<Job>, std::vector<std::shared_ptr<Job>>, JobOrder> m_Queue;
+        std::unordered_map<uint32_t, std::shared_ptr<Job>> m_Jobs;
+        std::deque<uint32_t> m_Retired;   // Oldest first, forgotten beyond MaxRetiredJobs
+        std::vector<uint32_t> m_Updated;  // Jobs whose progress changed since it was last sent
+        uint32_t m_NextJobId = 1;
+
+        SceneCache m_Cache;               // Only used by the render thread
+        std::thread m_RenderThread;
+    };
+
+    // Blocking connection to a service
+    class Client
+    {
+    public:
+        bool Connect(const std::string& address);
+
+        // Progress of the job is sent to this client from then on
+        bool Submit(const JobRequest& request, uint32_t& jobId);
+        bool Watch(uint32_t jobId);
+        bool Cancel(uint32_t jobId);
+
+        // Waits for the next progress message of a watched job
+        bool ReceiveProgress(JobProgress& progress);
+    private:
+        bool Receive(uint32_t type, void* data, size_t size);
+    private:
+        Network::Socket m_Socket;
+        std::vector<uint8_t> m_Message;
+        std::deque<JobProgress> m_Pending;  // Arrived while waiting for another reply
+    };
+}
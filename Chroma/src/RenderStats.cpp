@@ -0,0 +1,28 @@
+#include "RenderStats.h"
+
+namespace Stats {
+
+    void Counters::Add(const Counters& other)
+    {
+        PrimaryRays += other.PrimaryRays;
+        SecondaryRays += other.SecondaryRays;
+        for (uint32_t i = 0; i < ShapeTypeCount; i++)
+            IntersectionTests[i] += other.IntersectionTests[i];
+        NodesVisited += other.NodesVisited;
+        for (uint32_t i = 0; i <= MaxPathDepth; i++)
+            PathDepth[i] += other.PathDepth[i];
+        SkyHits += other.SkyHits;
+        EmitterHits += other.EmitterHits;
+        TraceTicks += other.TraceTicks;
+        TileTicks += other.TileTicks;
+    }
+
+    uint64_t FrameStats::GetIntersectionTests() const
+    {
+        uint64_t tests = 0;
+        for (uint32_t i = 0; i < ShapeTypeCount; i++)
+            tests += Totals.IntersectionTests[i];
+        return tests;
+    }
+
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "Utils.h"
+
+#include <cstdint>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#else
+#include <chrono>
+#endif
+
+// Set to 0 to compile every counter out of the render loop
+#ifndef CHROMA_STATS
+#define CHROMA_STATS 1
+#endif
+
+#if CHROMA_STATS
+#define CHROMA_STAT(statement) statement
+#else
+#define CHROMA_STAT(statement)
+#endif
+
+namespace Stats {
+
+    constexpr uint32_t ShapeTypeCount = 4;
+    constexpr uint32_t MaxPathDepth = 8; // Longer paths are counted in the last bucket
+
+    // Everything a worker counts while rendering its tiles
+    struct Counters
+    {
+        uint64_t PrimaryRays = 0;
+        uint64_t SecondaryRays = 0;
+        uint64_t IntersectionTests[ShapeTypeCount] = {}; // Indexed by ShapeType
+        uint64_t NodesVisited = 0;                        // BVH node bounds tested
+        uint64_t PathDepth[MaxPathDepth + 1] = {};        // Paths by number of traced segments
+        uint64_t SkyHits = 0;
+        uint64_t EmitterHits = 0;
+
+        // Timestamps of ReadTicks(), only their ratio is used
+        uint64_t TraceTicks = 0;
+        uint64_t TileTicks = 0;
+
+        void Add(const Counters& other);
+    };
+
+    // One slot per worker, padded so that no two workers ever write to the same cache line
+    struct alignas(Utils::CacheLineSize) WorkerCounters
+    {
+        Counters Value;
+    };
+
+    struct FrameStats
+    {
+        Counters Totals;
+        uint32_t Workers = 0;
+
+        // Thread time summed over all workers, in seconds. Shading is whatever the tile loop
+        // spends outside of TraceRay().
+        double TraceTime = 0.0;
+        double ShadeTime = 0.0;
+
+        // Wall time, in seconds
+        double RenderTime = 0.0;
+        double ResolveTime = 0.0;
+        double UploadTime = 0.0;    // Waiting for a staging slot and recording the copy
+
+        uint64_t GetRays() const { return Totals.PrimaryRays + Totals.SecondaryRays; }
+        uint64_t GetIntersectionTests() const;
+    };
+
+    // Cheap timestamp in arbitrary units
+    inline uint64_t ReadTicks()
+    {
+#if defined(_M_X64) || defined(__x86_64__)
+        return __rdtsc();
+#else
+        return (uint64_t)std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+    }
+
+}
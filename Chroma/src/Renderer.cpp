@@ -1,111 +1,1364 @@
 #include "Renderer.h"
+#include "Checkpoint.h"
 #include "Utils.h"
 
 #include "Walnut/Random.h"
+#include "Walnut/Timer.h"
 
-#include <execution>
+#include <glm/gtc/constants.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <type_traits>
+
+namespace {
+
+    // Capacity is handed out in steps of this many pixels, on top of 25% headroom
+    constexpr uint32_t CapacityGranularity = 128;
+
+    // Frames the viewport has to stay below a quarter of the capacity before it shrinks
+    constexpr uint32_t ShrinkDelayFrames = 120;
+
+    // Start of a checkpoint, the per tile arrays and the accumulation blocks follow it
+    struct CheckpointState
+    {
+        uint64_t SceneHash;
+        uint32_t Width, Height;
+        uint32_t TileSize, TileCount;
+        uint64_t TileStride;
+        uint32_t SettingsSize;
+        uint32_t FrameIndex;
+        double AccumulationTime;
+        glm::vec3 CameraPosition;
+        glm::vec3 CameraDirection;
+        float VerticalFOV;
+        Renderer::Settings Settings;
+    };
+
+    struct CheckpointLayout
+    {
+        size_t TileFrames, TileNoise, Footprints, Accumulation, Size;
+
+        CheckpointLayout(size_t tileCount, size_t frameSize, size_t noiseSize, size_t footprintSize, size_t accumulationSize)
+        {
+            auto align = [](size_t offset) { return (offset + Utils::CacheLineSize - 1) / Utils::CacheLineSize * Utils::CacheLineSize; };
+            TileFrames = align(sizeof(CheckpointState));
+            TileNoise = align(TileFrames + tileCount * frameSize);
+            Footprints = align(TileNoise + tileCount * noiseSize);
+            Accumulation = align(Footprints + tileCount * footprintSize);
+            Size = Accumulation + accumulationSize;
+        }
+    };
+
+    // Widening of a texture ray cone at a diffuse bounce, in radians. Light gathered from the whole
+    // hemisphere blurs whatever it came from, so hits further down the path read coarse levels.
+    constexpr float DiffuseConeSpread = 0.5f;
+    // Cones meeting a surface at a grazing angle are stretched at most this many times
+    constexpr float MinConeCosine = 0.1f;
+
+    // Orthonormal directions along a surface, for projecting textures onto it
+    void GetPlanarBasis(const glm::vec3& normal, glm::vec3& tangent, glm::vec3& bitangent)
+    {
+        const glm::vec3 reference = std::abs(normal.y) < 0.999f ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+        tangent = glm::normalize(glm::cross(reference, normal));
+        bitangent = glm::cross(normal, tangent);
+    }
+
+    uint32_t CapacityFor(uint32_t size)
+    {
+        size += size / 4;
+        size = (size + CapacityGranularity - 1) / CapacityGranularity * CapacityGranularity;
+        return std::max(size, CapacityGranularity);
+    }
+
+}
+
+bool Renderer::UpdateCapacity(uint32_t width, uint32_t height)
+{
+    if (width > m_CapacityWidth || height > m_CapacityHeight)
+    {
+        m_CapacityWidth = std::max(m_CapacityWidth, CapacityFor(width));
+        m_CapacityHeight = std::max(m_CapacityHeight, CapacityFor(height));
+        m_ShrinkFrames = 0;
+        return true;
+    }
+
+    // Only give memory back once the viewport has been much smaller for a while,
+    // dragging a dock splitter back and forth must not reallocate
+    if ((uint64_t)width * height * 4 < (uint64_t)m_CapacityWidth * m_CapacityHeight)
+    {
+        if (++m_ShrinkFrames >= ShrinkDelayFrames)
+        {
+            m_CapacityWidth = CapacityFor(width);
+            m_CapacityHeight = CapacityFor(height);
+            m_ShrinkFrames = 0;
+            return true;
+        }
+    }
+    else
+    {
+        m_ShrinkFrames = 0;
+    }
+
+    return false;
+}
 
 void Renderer::OnResize(uint32_t width, uint32_t height)
 {
-    if (m_FinalImage)
+    bool capacityChanged = UpdateCapacity(width, height);
+    bool sizeChanged = width != m_Width || height != m_Height;
+
+    if (!capacityChanged && !sizeChanged)
+        return;
+
+    m_Width = width;
+    m_Height = height;
+
+    if (m_Headless)
     {
-        if (m_FinalImage->GetWidth() == width && m_FinalImage->GetHeight() == height)
-            return;
+        m_ImageData.Resize((size_t)width * height);
+    }
+    else if (m_FinalImage)
+    {
+        m_FinalImage->Resize(width, height, m_CapacityWidth, m_CapacityHeight);
+    }
+    else
+    {
+        m_FinalImage = std::make_shared<Walnut::Image>(m_CapacityWidth, m_CapacityHeight, Walnut::ImageFormat::RGBA);
+        m_FinalImage->Resize(width, height, m_CapacityWidth, m_CapacityHeight);
+    }
+
+    if (capacityChanged)
+    {
+        if (m_Accumulation.GetSizeInBytes() == 0)
+            m_Accumulation.Allocate(m_CapacityWidth, m_CapacityHeight, TileSize, m_Settings.Accumulation);
+        else
+            m_Accumulation.Reserve(m_CapacityWidth, m_CapacityHeight);
+    }
 
-        m_FinalImage->Resize(width, height);
+    if (!sizeChanged)
+    {
+        // Shrunk to fit, the samples were kept but the new image has to be resolved in full
+        std::fill(m_DirtyTiles.begin(), m_DirtyTiles.end(), (uint8_t)1);
+        return;
+    }
+
+    m_Accumulation.Resize(width, height);
+
+    m_Tiles.clear();
+    for (uint32_t y = 0; y < height; y += TileSize)
+    {
+        for (uint32_t x = 0; x < width; x += TileSize)
+        {
+            Tile& tile = m_Tiles.emplace_back();
+            tile.MinX = x;
+            tile.MinY = y;
+            tile.MaxX = std::min(x + TileSize, width);
+            tile.MaxY = std::min(y + TileSize, height);
+        }
+    }
+    m_TileFrames.assign(m_Tiles.size(), 0);
+    m_Footprints.resize(m_Tiles.size());
+    // The kept image still has the rows of the old size, the first resolve replaces all of it
+    m_DirtyTiles.assign(m_Tiles.size(), 1);
+    m_TileActive.assign(m_Tiles.size(), 0);
+    m_TileStamps.assign(m_Tiles.size(), 0);
+    m_TileNoise.assign(m_Tiles.size(), {});
+    m_ActiveTiles.reserve(m_Tiles.size());
+    m_TileRayCounts.assign(m_Tiles.size(), 0);
+    m_TileTimes.assign(m_Tiles.size(), 0.0f);
+    if (m_HeatmapMetric != Heatmap::Metric::None)
+        m_Cost.assign(m_Tiles.size() * TileSize * TileSize, 0.0f);
+    m_ResolveList.reserve(m_Tiles.size());
+    m_TileOutputFrames.assign(m_Tiles.size(), 0);
+
+    // The new accumulation buffer holds no samples yet
+    ResetFrameIndex();
+}
+
+void Renderer::UpdateScene(const Scene& scene)
+{
+    // Shapes added without a journal entry would otherwise be missing, or worse, indexed past the end
+    const bool boundedCountChanged = m_BVH.GetPrimitiveCount() != scene.Spheres.size() + scene.Boxes.size() + scene.Triangles.size();
+    const bool planeCountChanged = m_Planes.Count != scene.Planes.size();
+
+    const SceneJournal& journal = scene.Journal;
+    if (journal.GetSceneID() == m_SceneID && journal.GetVersion() == m_SceneVersion && !boundedCountChanged && !planeCountChanged)
+        return;
+
+    bool rebuildBVH = false, refitBVH = false, updatePlanes = false, updateFeatures = false, resetAll = false;
+    m_Invalidation.Clear();
+    m_RefitReferences.clear();
+    auto apply = [&](const SceneChange& change)
+    {
+        const bool bounded = change.Object == ObjectType::Sphere || change.Object == ObjectType::Box ||
+            change.Object == ObjectType::Triangle;
+        switch (change.Kind)
+        {
+            case ChangeKind::Add:
+            case ChangeKind::Remove:
+                rebuildBVH |= bounded;
+                updatePlanes |= change.Object == ObjectType::Plane;
+                updateFeatures = true;
+                break;
+            case ChangeKind::Transform:
+            case ChangeKind::Geometry:
+                refitBVH |= bounded;
+                updatePlanes |= change.Object == ObjectType::Plane;
+                for (uint32_t i = 0; bounded && i < change.Count && m_RefitReferences.size() <= MaxPartialRefit; i++)
+                    m_RefitReferences.push_back(BVH::MakeReference((ShapeType)change.Object, change.Index + i));
+                break;
+            case ChangeKind::Material:
+                // Materials are looked up while shading, only transparency and textures pick other kernels
+                updateFeatures |= change.Object == ObjectType::Material || change.Object == ObjectType::Texture;
+                break;
+        }
+
+        if (!resetAll && !AddInvalidation(scene, change))
+            resetAll = true;
+    };
+
+    if (journal.GetSceneID() != m_SceneID || !journal.ForEachChangeSince(m_SceneVersion, apply))
+        rebuildBVH = updatePlanes = updateFeatures = resetAll = true;
+
+    if (boundedCountChanged)
+        rebuildBVH = updateFeatures = resetAll = true;
+    if (planeCountChanged)
+        updatePlanes = updateFeatures = resetAll = true;
+
+    // Shapes that moved alone only refit the path up from their leaves, animating many refits everything
+    const bool partialRefit = m_RefitReferences.size() <= MaxPartialRefit;
+    if (rebuildBVH || (refitBVH && !(partialRefit ? m_BVH.Refit(scene, m_RefitReferences) : m_BVH.Refit(scene))))
+    {
+        WL_PROFILE_ZONE("BVH::Build");
+        m_BVH.Build(scene);
+    }
+    if (updatePlanes)
+        m_Planes.Build(scene.Planes);
+    if (updateFeatures)
+    {
+        m_SceneFeatures = SelectSceneFeatures(scene);
+        UpdateTextures(scene);
+    }
+    InvalidateTiles(resetAll);
+
+    m_SceneID = journal.GetSceneID();
+    m_SceneVersion = journal.GetVersion();
+}
+
+bool Renderer::WriteCheckpoint(Checkpoint& checkpoint, const Scene& scene, const Camera& camera)
+{
+    WL_PROFILE_ZONE("Renderer::WriteCheckpoint");
+    static_assert(std::is_trivially_copyable_v<Settings>, "Settings are saved as they are");
+
+    // The cost image is not saved, neither are the samples behind it
+    if (m_HeatmapMetric != Heatmap::Metric::None || m_Tiles.empty() || checkpoint.IsFlushing())
+        return false;
+
+    const CheckpointLayout layout(m_Tiles.size(), sizeof(uint32_t), sizeof(TileNoise), sizeof(Footprint::Set),
+        m_Accumulation.GetUsedSizeInBytes());
+    uint8_t* data = checkpoint.BeginWrite(layout.Size);
+    if (!data)
+        return false;
+
+    CheckpointState state = {};
+    state.SceneHash = GetContentHash(scene);
+    state.Width = m_Width;
+    state.Height = m_Height;
+    state.TileSize = TileSize;
+    state.TileCount = (uint32_t)m_Tiles.size();
+    state.TileStride = m_Accumulation.GetTileStride();
+    state.SettingsSize = sizeof(Settings);
+    state.FrameIndex = m_FrameIndex;
+    state.AccumulationTime = m_AccumulationTime;
+    state.CameraPosition = camera.GetPosition();
+    state.CameraDirection = camera.GetDirection();
+    state.VerticalFOV = camera.GetVerticalFOV();
+    state.Settings = m_Settings;
+
+    std::memcpy(data, &state, sizeof(state));
+    std::memcpy(data + layout.TileFrames, m_TileFrames.data(), m_Tiles.size() * sizeof(uint32_t));
+    std::memcpy(data + layout.TileNoise, m_TileNoise.data(), m_Tiles.size() * sizeof(TileNoise));
+    std::memcpy(data + layout.Footprints, m_Footprints.data(), m_Tiles.size() * sizeof(Footprint::Set));
+    std::memcpy(data + layout.Accumulation, m_Accumulation.GetData(), m_Accumulation.GetUsedSizeInBytes());
+    checkpoint.EndWrite();
+    return true;
+}
+
+bool Renderer::ResumeCheckpoint(Checkpoint& checkpoint, const Scene& scene, Camera& camera)
+{
+    WL_PROFILE_ZONE("Renderer::ResumeCheckpoint");
+
+    size_t size = 0;
+    const uint8_t* data = checkpoint.GetLatest(size);
+    if (!data || size < sizeof(CheckpointState))
+        return false;
+
+    CheckpointState state;
+    std::memcpy(&state, data, sizeof(state));
+
+    // Everything is checked before the renderer is touched, a rejected checkpoint changes nothing
+    const Settings& saved = state.Settings;
+    const size_t tileStride = AccumulationBuffer::GetTileStride(TileSize, saved.Accumulation);
+    if (state.SceneHash != GetContentHash(scene) || state.Width != m_Width || state.Height != m_Height ||
+        state.TileSize != TileSize || state.SettingsSize != sizeof(Settings) || state.VerticalFOV != camera.GetVerticalFOV() ||
+        state.TileCount != m_Tiles.size() || state.TileStride != tileStride || tileStride == 0)
+    {
+        return false;
+    }
+
+    const CheckpointLayout layout(m_Tiles.size(), sizeof(uint32_t), sizeof(TileNoise), sizeof(Footprint::Set),
+        tileStride * m_Tiles.size());
+    if (size < layout.Size)
+        return false;
+
+    // Only what the samples depend on is taken over. Threads, pinning and the texture cache stay
+    // as this machine and its command line set them up.
+    m_Settings.Accumulate = saved.Accumulate;
+    m_Settings.SlowRandom = saved.SlowRandom;
+    m_Settings.SamplesPerPixel = saved.SamplesPerPixel;
+    m_Settings.Seed = saved.Seed;
+    m_Settings.Accumulation = saved.Accumulation;
+    m_Settings.InvalidationDepth = saved.InvalidationDepth;
+    m_Settings.Crop = saved.Crop;
+    m_Settings.CropOutsideInterval = saved.CropOutsideInterval;
+    m_Settings.MaxSamples = saved.MaxSamples;
+    m_Settings.MaxTime = saved.MaxTime;
+    m_Settings.NoiseThreshold = saved.NoiseThreshold;
+
+    // Everything Render() would restart accumulation for is brought up to date first
+    UpdateScene(scene);
+    UpdateThreadPool();
+    m_Accumulation.Allocate(m_CapacityWidth, m_CapacityHeight, TileSize, m_Settings.Accumulation);
+    m_Accumulation.Resize(m_Width, m_Height);
+    if (m_Headless)
+        m_ImageData.Resize((size_t)m_Width * m_Height);
+    m_FootprintDepth = m_Settings.InvalidationDepth;
+    m_HeatmapMetric = Heatmap::Metric::None;
+    m_Cost = std::vector<float>();
+
+    std::memcpy(m_TileFrames.data(), data + layout.TileFrames, m_Tiles.size() * sizeof(uint32_t));
+    std::memcpy(m_TileNoise.data(), data + layout.TileNoise, m_Tiles.size() * sizeof(TileNoise));
+    std::memcpy(m_Footprints.data(), data + layout.Footprints, m_Tiles.size() * sizeof(Footprint::Set));
+    std::memcpy(m_Accumulation.GetData(), data + layout.Accumulation, m_Accumulation.GetUsedSizeInBytes());
+    m_FrameIndex = state.FrameIndex;
+    m_AccumulationTime = state.AccumulationTime;
+    std::fill(m_DirtyTiles.begin(), m_DirtyTiles.end(), (uint8_t)1);
+
+    camera.SetView(state.CameraPosition, state.CameraDirection);
+    return true;
+}
+
+void Renderer::RenderTileSamples(const Scene& scene, const Camera& camera, uint32_t tileIndex, uint32_t firstFrame,
+    uint32_t frameCount, std::vector<glm::vec3>& sums, Footprint::Set& footprint)
+{
+    WL_PROFILE_ZONE("Renderer::RenderTileSamples");
+
+    UpdateScene(scene);
+    m_ActiveScene = &scene;
+    m_ActiveCamera = &camera;
+    PrepareKernels();
+    const PerPixelKernel perPixel = GetKernels(m_KernelFeatures).PerPixel;
+
+    const Tile& tile = m_Tiles[tileIndex];
+    const uint32_t width = tile.MaxX - tile.MinX;
+    sums.assign((size_t)width * (tile.MaxY - tile.MinY), glm::vec3(0.0f));
+    footprint.Clear();
+
+    Stats::Counters stats;
+    uint32_t rayCount = 0;
+    for (uint32_t frameIndex = firstFrame; frameIndex < firstFrame + frameCount; frameIndex++)
+    {
+        for (uint32_t y = tile.MinY; y < tile.MaxY; y++)
+        {
+            for (uint32_t x = tile.MinX; x < tile.MaxX; x++)
+                sums[(x - tile.MinX) + (y - tile.MinY) * width] += glm::vec3((this->*perPixel)(x, y, frameIndex, rayCount, stats, footprint));
+        }
+    }
+    m_RayCount = rayCount;
+}
+
+bool Renderer::MergeTileSamples(uint32_t tileIndex, uint32_t firstFrame, uint32_t frameCount, const glm::vec3* sums,
+    const Footprint::Set& footprint)
+{
+    UpdateAccumulation(false);
+    if (m_HeatmapMetric != Heatmap::Metric::None || tileIndex >= m_Tiles.size() || frameCount == 0 ||
+        firstFrame != m_TileFrames[tileIndex] + 1)
+    {
+        return false;
+    }
+
+    const Tile& tile = m_Tiles[tileIndex];
+    const uint32_t width = tile.MaxX - tile.MinX;
+    const uint32_t frames = firstFrame + frameCount - 1;
+    for (uint32_t y = 0; y < tile.MaxY - tile.MinY; y++)
+    {
+        for (uint32_t x = 0; x < width; x++)
+            m_Accumulation.AddSum(tileIndex, x + y * TileSize, sums[x + y * width], frameCount, frames);
+    }
+
+    if (firstFrame == 1)
+    {
+        m_Footprints[tileIndex] = footprint;
+        m_TileNoise[tileIndex] = {};
     }
     else
     {
-        m_FinalImage = std::make_shared<Walnut::Image>(width, height, Walnut::ImageFormat::RGBA);
+        m_Footprints[tileIndex].Add(footprint);
     }
+    m_TileFrames[tileIndex] = frames;
+    m_DirtyTiles[tileIndex] = 1;
+    m_AccumulatedFrames = std::max(m_AccumulatedFrames, frames);
+    m_FrameIndex = m_AccumulatedFrames + 1;
+    return true;
+}
 
-    delete[] m_ImageData;
-    m_ImageData = new uint32_t[width * height];
+bool Renderer::AddInvalidation(const Scene& scene, const SceneChange& change)
+{
+    // Footprints are kept by index, removing objects moves the ones after them
+    if (change.Kind == ChangeKind::Remove)
+        return false;
 
-    delete[] m_AccumulationData;
-    m_AccumulationData = new glm::vec4[width * height];
+    // Large edits are cheaper to restart than to test every tile against
+    constexpr size_t MaxQuerySize = 256;
+    if (m_Invalidation.GetSize() + change.Count * 2 > MaxQuerySize)
+        return false;
 
-    m_ImageHorizontalIter.resize(width);
-    m_ImageVerticalIter.resize(height);
-    for (uint32_t i = 0; i < width; i++)
-        m_ImageHorizontalIter[i] = i;
-    for (uint32_t i = 0; i < height; i++)
-        m_ImageVerticalIter[i] = i;
+    if (change.Object == ObjectType::Material)
+    {
+        // A new material shows up nowhere until a shape uses it, which is a change of its own
+        if (change.Kind == ChangeKind::Material)
+        {
+            for (uint32_t i = change.Index; i < change.Index + change.Count; i++)
+                m_Invalidation.Materials.push_back(i);
+        }
+        return true;
+    }
+
+    if (change.Object == ObjectType::Texture)
+    {
+        // Only the materials using the texture look different, a new path also gives materials that
+        // pointed past the end their image
+        for (uint32_t i = 0; i < (uint32_t)scene.Materials.size(); i++)
+        {
+            const Material& material = scene.Materials[i];
+            for (int texture : { material.AlbedoTexture, material.RoughnessTexture, material.NormalTexture })
+            {
+                if (texture >= (int)change.Index && texture < (int)(change.Index + change.Count))
+                {
+                    m_Invalidation.Materials.push_back(i);
+                    break;
+                }
+            }
+        }
+        return m_Invalidation.GetSize() <= MaxQuerySize;
+    }
+
+    const ShapeType type = (ShapeType)change.Object;
+    for (uint32_t i = change.Index; i < change.Index + change.Count; i++)
+    {
+        // Paths that hit the shape saw its old state
+        if (change.Kind != ChangeKind::Add)
+            m_Invalidation.Objects.push_back({ type, i });
+        if (change.Kind == ChangeKind::Material)
+            continue;
+
+        // Paths that crossed its new place would hit it now
+        if (type == ShapeType::Plane)
+        {
+            if (i >= scene.Planes.size())
+                return false;
+            m_Invalidation.Planes.push_back(scene.Planes[i]);
+            continue;
+        }
+
+        if (i >= (type == ShapeType::Sphere ? scene.Spheres.size() : type == ShapeType::Box ? scene.Boxes.size() : scene.Triangles.size()))
+            return false;
+
+        Footprint::Query::Bounds bounds;
+        BVH::GetPrimitiveBounds(scene, type, i, bounds.Min, bounds.Max);
+
+        // Escaping rays were cut off at the footprint bounds, beyond them nothing can be told
+        if (glm::any(glm::lessThan(bounds.Min, m_FootprintMin)) || glm::any(glm::greaterThan(bounds.Max, m_FootprintMax)))
+            return false;
+        m_Invalidation.Regions.push_back(bounds);
+    }
+    return true;
+}
+
+void Renderer::InvalidateTiles(bool all)
+{
+    // The heatmap scale is shared by every tile, so is its sample count
+    if (all || m_HeatmapMetric != Heatmap::Metric::None)
+    {
+        ResetFrameIndex();
+        m_InvalidatedTiles = (uint32_t)m_Tiles.size();
+
+        // Room for shapes to move a bit before an edit reaches outside
+        if (m_BVH.GetBounds(m_FootprintMin, m_FootprintMax))
+        {
+            const glm::vec3 margin = glm::vec3(glm::length(m_FootprintMax - m_FootprintMin) * 0.1f + 1e-3f);
+            m_FootprintMin -= margin;
+            m_FootprintMax += margin;
+        }
+        else
+        {
+            m_FootprintMin = m_FootprintMax = glm::vec3(0.0f);
+        }
+        return;
+    }
+
+    m_InvalidatedTiles = 0;
+    for (uint32_t i = 0; i < (uint32_t)m_Tiles.size(); i++)
+    {
+        if (m_TileFrames[i] > 0 && m_Invalidation.Touches(m_Footprints[i]))
+        {
+            m_TileFrames[i] = 0;
+            m_InvalidatedTiles++;
+        }
+    }
+
+    // The time target counts from the last edit that restarted anything
+    if (m_InvalidatedTiles > 0)
+        m_AccumulationTime = 0.0;
+}
+
+bool Renderer::UpdateThreadPool()
+{
+    if (m_ThreadPool.GetWorkerCount() > 0 && m_ThreadCount == m_Settings.ThreadCount &&
+        m_ThreadPool.GetAffinity() == m_Settings.Affinity && m_NUMALocal == m_Settings.NUMALocal)
+        return false;
+
+    m_ThreadPool.Start(m_Settings.ThreadCount, m_Settings.Affinity);
+    m_ThreadCount = m_Settings.ThreadCount;
+    m_NUMALocal = m_Settings.NUMALocal;
+    return true;
 }
 
 void Renderer::Render(const Scene& scene, const Camera& camera)
 {
+    WL_PROFILE_ZONE("Renderer::Render");
+
+    UpdateScene(scene);
+
     m_ActiveScene = &scene;
     m_ActiveCamera = &camera;
 
-    if (m_FrameIndex == 1)
-        memset(m_AccumulationData, 0, m_FinalImage->GetWidth() * m_FinalImage->GetHeight() * sizeof(glm::vec4));
+    // With NUMA-local tiles the buffers are mapped again, so the new owners touch them first
+    bool workersChanged = UpdateThreadPool();
+    UpdateAccumulation(workersChanged && m_NUMALocal);
+
+#if CHROMA_STATS
+    const auto start = std::chrono::steady_clock::now();
+    m_WorkerCounters.assign(std::max(m_ThreadPool.GetWorkerCount(), 1u), {});
+#endif
+
+    // Resolve counts are only kept until the next frame starts
+    m_ReadPerfCounters = m_Settings.PerfCounters;
+    m_PerfCounters = {};
+    if (m_ReadPerfCounters)
+        m_WorkerPerfCounters.assign(std::max(m_ThreadPool.GetWorkerCount(), 1u), {});
+
+    const auto frameStart = std::chrono::steady_clock::now();
+    m_MeasureNoise = m_Settings.NoiseThreshold > 0.0f && m_Settings.Accumulate && m_HeatmapMetric == Heatmap::Metric::None;
+
+    // Picked once per frame, the tile loop itself never looks at these settings again
+    PrepareKernels();
+    const RenderTileKernel renderTile = GetKernels(m_KernelFeatures).RenderTile;
+    SelectActiveTiles();
+
+    // Tiles are only skipped before they start, per tile sample counts keep a partial frame unbiased
+    const bool budgeted = m_Settings.FrameBudget > 0.0f;
+    if (budgeted)
+        SortActiveTiles();
+    const auto deadline = std::chrono::steady_clock::now() +
+        std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<float>(
+            m_Settings.FrameBudget * 1e-3f - m_TileTimeEstimate));
+    auto renderBudgeted = [this, renderTile, budgeted, deadline](uint32_t tileIndex, uint32_t worker, bool first)
+    {
+        if (budgeted && !first && std::chrono::steady_clock::now() > deadline)
+        {
+            m_TileActive[tileIndex] = 0;
+            m_TileRayCounts[tileIndex] = 0;
+            m_TileTimes[tileIndex] = 0.0f;
+            return;
+        }
+        (this->*renderTile)(m_Tiles[tileIndex], worker);
+    };
 
 #define MT 1
 #if MT
-    std::for_each(std::execution::par, m_ImageVerticalIter.begin(), m_ImageVerticalIter.end(),
-        [this](uint32_t y)
-        {
-            std::for_each(std::execution::par, m_ImageHorizontalIter.begin(), m_ImageHorizontalIter.end(),
-                [this, y](uint32_t x)
+    // NUMA-local tiles stay with the worker the static schedule gives them, whether they render or not.
+    // Every worker walks the priority order and takes its own tiles, a budget still cuts off the last ones.
+    if (m_NUMALocal)
+    {
+        const uint32_t tileCount = (uint32_t)m_Tiles.size();
+        const uint32_t sliceCount = std::max(m_ThreadPool.GetWorkerCount(), 1u);
+        m_ThreadPool.ParallelFor(sliceCount, Schedule::Static,
+            [this, &renderBudgeted, tileCount, sliceCount](uint32_t slice, uint32_t worker)
+            {
+                // The tiles a static loop over every tile gives this worker, see ThreadPool::WorkerMain()
+                const uint32_t first = (uint32_t)((uint64_t)slice * tileCount / sliceCount);
+                const uint32_t last = (uint32_t)((uint64_t)(slice + 1) * tileCount / sliceCount);
+                for (uint32_t tileIndex : m_ActiveTiles)
                 {
-                    glm::vec4 color = PerPixel(x, y);
-                    m_AccumulationData[x + y * m_FinalImage->GetWidth()] += color;
+                    if (tileIndex >= first && tileIndex < last)
+                        renderBudgeted(tileIndex, worker, tileIndex == m_ActiveTiles.front());
+                }
+            });
+    }
+    else
+    {
+        m_ThreadPool.ParallelFor((uint32_t)m_ActiveTiles.size(), Schedule::Dynamic,
+            [this, &renderBudgeted](uint32_t index, uint32_t worker)
+            {
+                renderBudgeted(m_ActiveTiles[index], worker, index == 0);
+            });
+    }
+#else
+    for (uint32_t index = 0; index < (uint32_t)m_ActiveTiles.size(); index++)
+        renderBudgeted(m_ActiveTiles[index], 0, index == 0);
+#endif
+
+    m_RenderedTiles = 0;
+    m_RenderedPixels = 0;
+    float renderedTime = 0.0f;
+    for (uint32_t tileIndex : m_ActiveTiles)
+    {
+        if (!m_TileActive[tileIndex])
+            continue;
+
+        const Tile& tile = m_Tiles[tileIndex];
+        m_DirtyTiles[tileIndex] = 1;
+        m_TileStamps[tileIndex] = m_RenderCount;
+        m_RenderedTiles++;
+        m_RenderedPixels += (uint64_t)(tile.MaxX - tile.MinX) * (tile.MaxY - tile.MinY);
+        renderedTime += m_TileTimes[tileIndex];
+    }
+    // The next deadline is pulled in by one average tile, so that the last tiles end near the budget
+    if (m_RenderedTiles > 0)
+    {
+        m_TileTimeEstimate = renderedTime / m_RenderedTiles;
+        m_AccumulationTime += std::chrono::duration<double>(std::chrono::steady_clock::now() - frameStart).count();
+    }
+    m_AccumulatedFrames = m_FrameIndex;
+
+    if (m_HeatmapMetric != Heatmap::Metric::None)
+        UpdateCostRange();
+
+    if (m_ReadPerfCounters)
+    {
+        for (const WorkerPerfCounters& counters : m_WorkerPerfCounters)
+            m_PerfCounters.Render.Add(counters.Value.Render);
+    }
+
+    m_RayCount = 0;
+    for (uint64_t rays : m_TileRayCounts)
+        m_RayCount += rays;
+
+#if CHROMA_STATS
+    m_Stats = {};
+    m_Stats.Workers = (uint32_t)m_WorkerCounters.size();
+    for (const Stats::WorkerCounters& counters : m_WorkerCounters)
+        m_Stats.Totals.Add(counters.Value);
+
+    // Tile times are wall clock, the tick ratio splits them into tracing and shading
+    double tileTime = 0.0;
+    for (float time : m_TileTimes)
+        tileTime += time;
+    const double traceFraction = m_Stats.Totals.TileTicks > 0
+        ? std::min((double)m_Stats.Totals.TraceTicks / (double)m_Stats.Totals.TileTicks, 1.0) : 0.0;
+    m_Stats.TraceTime = tileTime * traceFraction;
+    m_Stats.ShadeTime = tileTime - m_Stats.TraceTime;
+    m_Stats.RenderTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+#endif
+
+    if (m_Settings.Accumulate)
+        m_FrameIndex++;
+    else
+        m_FrameIndex = 1;
+}
+
+void Renderer::UpdateAccumulation(bool remap)
+{
+    if (m_Accumulation.GetFormat() != m_Settings.Accumulation || remap)
+    {
+        m_Accumulation.Allocate(m_CapacityWidth, m_CapacityHeight, TileSize, m_Settings.Accumulation);
+        m_Accumulation.Resize(m_Width, m_Height);
+        if (m_Headless)
+            m_ImageData.Resize((size_t)m_Width * m_Height);
+        ResetFrameIndex();
+    }
+
+    if (m_Settings.InvalidationDepth != m_FootprintDepth)
+    {
+        // Footprints recorded at another depth would miss or over-claim interactions
+        m_FootprintDepth = m_Settings.InvalidationDepth;
+        ResetFrameIndex();
+    }
+
+    if (m_Settings.Heatmap != m_HeatmapMetric)
+    {
+        m_HeatmapMetric = m_Settings.Heatmap;
+        if (m_HeatmapMetric != Heatmap::Metric::None)
+            m_Cost.assign(m_Tiles.size() * TileSize * TileSize, 0.0f);
+        else
+            m_Cost = std::vector<float>();
+        ResetFrameIndex();
+    }
+}
+
+void Renderer::SelectActiveTiles()
+{
+    const Rect& crop = m_Settings.Crop;
+    const bool cropped = !crop.IsEmpty() && (crop.X > 0 || crop.Y > 0 || crop.X + crop.Width < m_Width || crop.Y + crop.Height < m_Height);
+    const uint32_t interval = m_Settings.CropOutsideInterval;
+    const bool refreshOutside = interval > 0 && m_RenderCount % interval == 0;
+    m_RenderCount++;
+
+    m_ActiveTiles.clear();
+    m_ConvergedTiles = 0;
+    m_NoiseEstimate = 0.0f;
+    // Converged tiles plus those frozen outside the crop, neither will render again
+    uint32_t finishedTiles = 0;
+    for (uint32_t i = 0; i < (uint32_t)m_Tiles.size(); i++)
+    {
+        const Tile& tile = m_Tiles[i];
+        bool active = true;
+        bool finished = false;
+        if (IsTileConverged(i))
+        {
+            m_ConvergedTiles++;
+            active = false;
+            finished = true;
+        }
+        else if (m_MeasureNoise && m_TileFrames[i] > 0)
+        {
+            m_NoiseEstimate = std::max(m_NoiseEstimate, GetTileNoise(i));
+        }
+        if (cropped)
+        {
+            const bool inside = tile.MinX < crop.X + crop.Width && tile.MaxX > crop.X &&
+                tile.MinY < crop.Y + crop.Height && tile.MaxY > crop.Y;
+            // Tiles restarted by an edit or a camera move get a frame. Their old sums stay in the
+            // accumulation until then, the resolve shows them black rather than reading those.
+            active &= inside || refreshOutside || m_TileFrames[i] == 0;
+            finished |= !inside && interval == 0 && m_TileFrames[i] > 0;
+        }
+        if (finished)
+            finishedTiles++;
+
+        m_TileActive[i] = active ? 1 : 0;
+        if (active)
+        {
+            m_ActiveTiles.push_back(i);
+        }
+        else
+        {
+            m_TileRayCounts[i] = 0;
+            m_TileTimes[i] = 0.0f;
+        }
+    }
+    m_Converged = finishedTiles == (uint32_t)m_Tiles.size();
+}
+
+bool Renderer::IsTileConverged(uint32_t tileIndex) const
+{
+    // A single frame tells nothing about the noise, and without accumulation every frame starts over
+    constexpr uint32_t MinNoiseFrames = 8;
+
+    const uint32_t frames = m_TileFrames[tileIndex];
+    if (frames == 0 || !m_Settings.Accumulate)
+        return false;
+
+    if (m_Settings.MaxTime > 0.0f && m_AccumulationTime >= m_Settings.MaxTime)
+        return true;
+    if (m_Settings.MaxSamples > 0 && (uint64_t)frames * m_Settings.SamplesPerPixel >= m_Settings.MaxSamples)
+        return true;
+    if (m_Accumulation.GetFormat() == AccumulationFormat::RGBHalf && frames >= AccumulationBuffer::MaxHalfSamples)
+        return true;
+    return m_MeasureNoise && m_TileNoise[tileIndex].Frames + 1 >= MinNoiseFrames &&
+        GetTileNoise(tileIndex) <= m_Settings.NoiseThreshold;
+}
+
+float Renderer::GetTileNoise(uint32_t tileIndex) const
+{
+    // The variance of the mean shrinks with the frames in it
+    const TileNoise& noise = m_TileNoise[tileIndex];
+    if (noise.Frames == 0)
+        return std::numeric_limits<float>::max();
+    return std::sqrt(noise.Sum / (float)noise.Frames / (float)m_TileFrames[tileIndex]);
+}
+
+void Renderer::SortActiveTiles()
+{
+    struct Priority
+    {
+        uint32_t Frames;    // Fewest samples first, tiles a budget cut off go ahead of the others
+        uint32_t Stamp;     // Then the longest unrendered, without accumulation every tile has one frame
+        uint32_t Ring;      // Then square rings of tiles around the focus, inside out
+        float Angle;        // Walked around each ring
+        uint32_t Tile;
+    };
+
+    const float focusX = m_Settings.FocusX >= 0 ? (float)m_Settings.FocusX : m_Width * 0.5f;
+    const float focusY = m_Settings.FocusY >= 0 ? (float)m_Settings.FocusY : m_Height * 0.5f;
 
-                    glm::vec4 accumulatedColor = m_AccumulationData[x + y * m_FinalImage->GetWidth()];
-                    accumulatedColor /= (float)m_FrameIndex;
+    std::vector<Priority> order;
+    order.reserve(m_ActiveTiles.size());
+    for (uint32_t tileIndex : m_ActiveTiles)
+    {
+        const Tile& tile = m_Tiles[tileIndex];
+        const float dx = ((tile.MinX + tile.MaxX) * 0.5f - focusX) / TileSize;
+        const float dy = ((tile.MinY + tile.MaxY) * 0.5f - focusY) / TileSize;
+        const uint32_t ring = (uint32_t)std::max(std::abs(std::round(dx)), std::abs(std::round(dy)));
+        order.push_back({ m_TileFrames[tileIndex], m_TileStamps[tileIndex], ring, std::atan2(dy, dx), tileIndex });
+    }
 
-                    accumulatedColor = glm::clamp(accumulatedColor, glm::vec4(0.0f), glm::vec4(1.0f));
-                    m_ImageData[x + y * m_FinalImage->GetWidth()] = Utils::ConvertToRGBA(accumulatedColor);
-                });
+    std::sort(order.begin(), order.end(), [](const Priority& a, const Priority& b)
+        {
+            if (a.Frames != b.Frames)
+                return a.Frames < b.Frames;
+            if (a.Stamp != b.Stamp)
+                return a.Stamp < b.Stamp;
+            if (a.Ring != b.Ring)
+                return a.Ring < b.Ring;
+            return a.Angle < b.Angle;
         });
 
-#else
-    for (uint32_t y = 0; y < m_FinalImage->GetHeight(); y++)
+    for (size_t i = 0; i < order.size(); i++)
+        m_ActiveTiles[i] = order[i].Tile;
+}
+
+uint32_t Renderer::SelectSceneFeatures(const Scene& scene)
+{
+    uint32_t features = 0;
+    if (!scene.Spheres.empty())
+        features |= RenderPolicy::Spheres;
+    if (!scene.Planes.empty())
+        features |= RenderPolicy::Planes;
+    if (!scene.Boxes.empty())
+        features |= RenderPolicy::Boxes;
+    if (!scene.Triangles.empty())
+        features |= RenderPolicy::Triangles;
+
+    for (const Material& material : scene.Materials)
     {
-        for (uint32_t x = 0; x < m_FinalImage->GetWidth(); x++)
+        if (material.Transparency > 0.0f)
+            features |= RenderPolicy::Transparency;
+        if (material.HasTextures())
+            features |= RenderPolicy::Textures;
+    }
+
+    return features;
+}
+
+uint32_t Renderer::SelectKernelFeatures() const
+{
+    uint32_t features = m_SceneFeatures;
+    if (m_Settings.SamplesPerPixel > 1)
+        features |= RenderPolicy::AntiAliasing;
+    if (m_Settings.SlowRandom)
+        features |= RenderPolicy::SlowRandom;
+    return features;
+}
+
+void Renderer::PrepareKernels()
+{
+    m_KernelFeatures = SelectKernelFeatures();
+    m_ISAKernels = &ISA::GetKernels();
+
+    // Texture ray cones start as wide as a pixel, and the kernels are all that sample the cache
+    m_PixelSpread = 2.0f * std::tan(glm::radians(m_ActiveCamera->GetVerticalFOV()) * 0.5f) / (float)std::max(m_Height, 1u);
+    if (m_Textures.GetSize() != m_Settings.TextureCacheSize)
+        m_Textures.SetSize(m_Settings.TextureCacheSize);
+}
+
+void Renderer::UpdateTextures(const Scene& scene)
+{
+    m_MaterialTextures.assign(scene.Materials.size(), glm::ivec3(-1));
+    m_TextureErrors.clear();
+
+    // Failures are reported once per texture and encoding, however many materials use it
+    std::vector<int32_t> handles(scene.Textures.size() * Texture::EncodingCount, -1);
+    std::vector<uint8_t> tried(handles.size(), 0);
+    auto load = [&](int texture, Texture::Encoding encoding)
+    {
+        if (texture < 0)
+            return -1;
+        if ((size_t)texture >= scene.Textures.size())
         {
-            glm::vec4 color = PerPixel(x, y);
-            m_AccumulationData[x + y * m_FinalImage->GetWidth()] += color;
+            m_TextureErrors.push_back("texture " + std::to_string(texture) + " is not in the scene");
+            return -1;
+        }
 
-            glm::vec4 accumulatedColor = m_AccumulationData[x + y * m_FinalImage->GetWidth()];
-            accumulatedColor /= (float)m_FrameIndex;
+        const size_t slot = (size_t)texture * Texture::EncodingCount + (size_t)encoding;
+        if (!tried[slot])
+        {
+            std::string error;
+            tried[slot] = 1;
+            handles[slot] = m_Textures.Load(scene.Textures[texture], encoding, error);
+            if (handles[slot] < 0)
+                m_TextureErrors.push_back(error);
+        }
+        return handles[slot];
+    };
+
+    for (size_t i = 0; i < scene.Materials.size(); i++)
+    {
+        const Material& material = scene.Materials[i];
+        m_MaterialTextures[i] = { load(material.AlbedoTexture, Texture::Encoding::sRGB),
+            load(material.RoughnessTexture, Texture::Encoding::Linear), load(material.NormalTexture, Texture::Encoding::Normal) };
+    }
+}
+
+template<uint32_t Features>
+void Renderer::RenderTile(const Tile& tile, uint32_t worker)
+{
+    WL_PROFILE_ZONE("Renderer::RenderTile");
+
+    const uint32_t tileIndex = (uint32_t)(&tile - m_Tiles.data());
+    const auto start = std::chrono::steady_clock::now();
+    uint32_t rayCount = 0;
+
+    // Tiles keep their own sample count, a scene edit may have restarted only some of them
+    const uint32_t frameIndex = m_Settings.Accumulate ? m_TileFrames[tileIndex] + 1 : 1;
+    Footprint::Set footprint;
+    if (frameIndex > 1)
+        footprint = m_Footprints[tileIndex];
+    else
+        footprint.Clear();
+
+    // Counted on the stack and added to the worker's own slot once per tile
+    Stats::Counters stats;
+    CHROMA_STAT(const uint64_t startTicks = Stats::ReadTicks());
+
+    PerfCounters::Snapshot perfBegin;
+    if (m_ReadPerfCounters)
+        PerfCounters::Read(perfBegin);
+
+    // Deviation of each new sample from the mean of the ones before, relative to that mean. Pixels
+    // darker than NoiseFloor are judged by their absolute deviation, or they would never converge.
+    constexpr float NoiseFloor = 0.1f;
+    const bool measureNoise = m_MeasureNoise && frameIndex > 1;
+    float noise = 0.0f;
+
+    if (m_HeatmapMetric == Heatmap::Metric::None)
+    {
+        for (uint32_t y = tile.MinY; y < tile.MaxY; y++)
+        {
+            for (uint32_t x = tile.MinX; x < tile.MaxX; x++)
+            {
+                const uint32_t pixelIndex = (x - tile.MinX) + (y - tile.MinY) * TileSize;
+                glm::vec4 color = PerPixel<Features>(x, y, frameIndex, rayCount, stats, footprint);
+                if (measureNoise)
+                {
+                    const glm::vec3 mean = m_Accumulation.Load(tileIndex, pixelIndex, frameIndex - 1) / (float)(frameIndex - 1);
+                    const float meanLuminance = Utils::Luminance(mean);
+                    const float deviation = Utils::Luminance(glm::vec3(color)) - meanLuminance;
+                    const float scale = std::max(meanLuminance, NoiseFloor);
+                    noise += deviation * deviation / (scale * scale);
+                }
+                m_Accumulation.Add(tileIndex, pixelIndex, glm::vec3(color), frameIndex);
+            }
+        }
+    }
+    else
+    {
+        // The cost is summed like the samples, the resolve divides by the tile's frame count
+        float* cost = m_Cost.data() + (size_t)tileIndex * TileSize * TileSize;
+        for (uint32_t y = tile.MinY; y < tile.MaxY; y++)
+        {
+            for (uint32_t x = tile.MinX; x < tile.MaxX; x++)
+            {
+                const uint32_t pixelIndex = (x - tile.MinX) + (y - tile.MinY) * TileSize;
+                const uint64_t before = ReadCost(stats, rayCount);
+                glm::vec4 color = PerPixel<Features>(x, y, frameIndex, rayCount, stats, footprint);
+                const float pixelCost = (float)(ReadCost(stats, rayCount) - before);
 
-            accumulatedColor = glm::clamp(accumulatedColor, glm::vec4(0.0f), glm::vec4(1.0f));
-            m_ImageData[x + y * m_FinalImage->GetWidth()] = Utils::ConvertToRGBA(accumulatedColor);
+                m_Accumulation.Add(tileIndex, pixelIndex, glm::vec3(color), frameIndex);
+                cost[pixelIndex] = frameIndex > 1 ? cost[pixelIndex] + pixelCost : pixelCost;
+            }
         }
     }
+
+    // Written once per tile, neighbouring tiles are rendered by other threads
+    m_TileFrames[tileIndex] = frameIndex;
+    m_Footprints[tileIndex] = footprint;
+    if (frameIndex == 1)
+    {
+        m_TileNoise[tileIndex] = {};
+    }
+    else if (measureNoise)
+    {
+        // A deviation from the mean of n - 1 samples has n / (n - 1) times the variance of one sample
+        const uint32_t pixels = (tile.MaxX - tile.MinX) * (tile.MaxY - tile.MinY);
+        m_TileNoise[tileIndex].Sum += noise / (float)pixels * (float)(frameIndex - 1) / (float)frameIndex;
+        m_TileNoise[tileIndex].Frames++;
+    }
+    m_TileRayCounts[tileIndex] = rayCount;
+    m_TileTimes[tileIndex] = std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count();
+
+    if (m_ReadPerfCounters)
+    {
+        PerfCounters::Snapshot perfEnd;
+        PerfCounters::Read(perfEnd);
+        m_WorkerPerfCounters[worker].Value.Render.AddDelta(perfBegin, perfEnd);
+    }
+
+#if CHROMA_STATS
+    stats.TileTicks = Stats::ReadTicks() - startTicks;
+    m_WorkerCounters[worker].Value.Add(stats);
+#else
+    (void)worker;
 #endif
+}
+
+uint64_t Renderer::ReadCost(const Stats::Counters& stats, uint32_t rayCount) const
+{
+    switch (m_HeatmapMetric)
+    {
+        case Heatmap::Metric::IntersectionTests:
+        {
+            uint64_t tests = 0;
+            for (uint64_t count : stats.IntersectionTests)
+                tests += count;
+            return tests;
+        }
+        case Heatmap::Metric::TraversalSteps:
+            return stats.NodesVisited;
+        case Heatmap::Metric::Bounces:
+            return rayCount;
+        case Heatmap::Metric::Cycles:
+            return Stats::ReadTicks();
+        default:
+            return 0;
+    }
+}
 
-    m_FinalImage->SetData(m_ImageData);
+void Renderer::ResolveImage()
+{
+    WL_PROFILE_ZONE("Renderer::ResolveImage");
 
-    if (m_Settings.Accumulate)
-        m_FrameIndex++;
+    // Exposure and tonemapping only live in the resolve, so changing them invalidates every tile
+    if (m_Settings.Exposure != m_ResolvedExposure || m_Settings.Tonemap != m_ResolvedTonemap ||
+        m_HeatmapMetric != m_ResolvedHeatmap)
+    {
+        std::fill(m_DirtyTiles.begin(), m_DirtyTiles.end(), (uint8_t)1);
+        m_ResolvedExposure = m_Settings.Exposure;
+        m_ResolvedTonemap = m_Settings.Tonemap;
+        m_ResolvedHeatmap = m_HeatmapMetric;
+    }
+
+    // The output slot the frame goes to was last written a few frames ago, the tiles written to the
+    // slots in between have to go into it as well. Progressive rendering touches every tile anyway.
+    uint64_t slotFrame = 0;
+    const bool output = m_FrameOutput && m_FrameOutput->Prepare(m_Width, m_Height, slotFrame);
+    if (output)
+    {
+        for (uint32_t i = 0; i < (uint32_t)m_Tiles.size(); i++)
+        {
+            if (slotFrame == 0 || m_TileOutputFrames[i] > slotFrame)
+                m_DirtyTiles[i] = 1;
+        }
+    }
+
+    m_ResolveList.clear();
+    for (uint32_t i = 0; i < (uint32_t)m_Tiles.size(); i++)
+    {
+        if (m_DirtyTiles[i])
+            m_ResolveList.push_back(i);
+    }
+
+    CHROMA_STAT(m_Stats.ResolveTime = 0.0);
+    CHROMA_STAT(m_Stats.UploadTime = 0.0);
+    if (m_ResolveList.empty())
+        return;
+
+    // Resolved pixels go straight into the mapped upload buffer
+    CHROMA_STAT(auto start = std::chrono::steady_clock::now());
+    uint32_t* imageData = m_Headless ? m_ImageData.Data() : (uint32_t*)m_FinalImage->BeginUpload();
+    CHROMA_STAT(m_Stats.UploadTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    CHROMA_STAT(start = std::chrono::steady_clock::now());
+    const uint32_t width = m_Width;
+    const float costScale = m_CostScaleTop > 0.0f ? 1.0f / m_CostScaleTop : 0.0f;
+    const FrameOutput::Frame outputFrame = output ? m_FrameOutput->BeginFrame() : FrameOutput::Frame();
+
+    auto resolveTile = [this, imageData, width, costScale, &outputFrame](uint32_t tileIndex, uint32_t worker)
+    {
+        WL_PROFILE_ZONE("Resolve::Tile");
+        const Tile& tile = m_Tiles[tileIndex];
+        const uint32_t count = tile.MaxX - tile.MinX;
+
+        PerfCounters::Snapshot perfBegin;
+        if (m_ReadPerfCounters)
+            PerfCounters::Read(perfBegin);
+
+        if (!m_Cost.empty())
+        {
+            // Tiles hold sums over their own frame count, which differs under a crop or a frame budget
+            const float* cost = m_Cost.data() + (size_t)tileIndex * TileSize * TileSize;
+            const uint32_t frames = m_TileFrames[tileIndex];
+            const float scale = frames > 0 ? costScale / (float)frames : 0.0f;
+            for (uint32_t y = tile.MinY; y < tile.MaxY; y++)
+                Heatmap::ResolveSpan(cost + (y - tile.MinY) * TileSize, imageData + tile.MinX + y * width, count, scale);
+        }
+        else
+        {
+            const uint32_t frames = m_TileFrames[tileIndex];
+            const Resolve::Params params = Resolve::MakeParams(frames, m_Settings.Exposure, m_Settings.Tonemap);
+            const float scale = 1.0f / (float)std::max(frames, 1u);
+            glm::vec4 row[TileSize];
+            // A tile restarted since its last frame still holds the old sums, it is black until it renders
+            if (frames == 0)
+                std::fill_n(row, count, glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+            for (uint32_t y = tile.MinY; y < tile.MaxY; y++)
+            {
+                if (frames > 0)
+                    m_Accumulation.LoadRow(tileIndex, y - tile.MinY, count, frames, row);
+                Resolve::ResolveSpan(row, imageData + tile.MinX + y * width, count, params);
+
+                if (outputFrame.Radiance)
+                {
+                    float* radiance = outputFrame.Radiance + (tile.MinX + (size_t)y * width) * 3;
+                    for (uint32_t i = 0; i < count; i++)
+                    {
+                        radiance[i * 3 + 0] = row[i].r * scale;
+                        radiance[i * 3 + 1] = row[i].g * scale;
+                        radiance[i * 3 + 2] = row[i].b * scale;
+                    }
+                }
+            }
+        }
+        m_DirtyTiles[tileIndex] = 0;
+
+        if (outputFrame.Color)
+        {
+            for (uint32_t y = tile.MinY; y < tile.MaxY; y++)
+                std::memcpy(outputFrame.Color + tile.MinX + (size_t)y * width, imageData + tile.MinX + y * width, count * sizeof(uint32_t));
+
+            if (outputFrame.Samples)
+            {
+                const uint32_t samples = m_TileFrames[tileIndex] * (uint32_t)m_Settings.SamplesPerPixel;
+                for (uint32_t y = tile.MinY; y < tile.MaxY; y++)
+                    std::fill_n(outputFrame.Samples + tile.MinX + (size_t)y * width, count, samples);
+            }
+            m_TileOutputFrames[tileIndex] = outputFrame.Number;
+        }
+
+        if (m_ReadPerfCounters)
+        {
+            PerfCounters::Snapshot perfEnd;
+            PerfCounters::Read(perfEnd);
+            m_WorkerPerfCounters[worker].Value.Resolve.AddDelta(perfBegin, perfEnd);
+        }
+    };
+
+    // NUMA-local tiles are resolved by the worker that rendered them
+    if (m_NUMALocal)
+    {
+        m_ThreadPool.ParallelFor((uint32_t)m_Tiles.size(), Schedule::Static,
+            [this, &resolveTile](uint32_t tileIndex, uint32_t worker)
+            {
+                if (m_DirtyTiles[tileIndex])
+                    resolveTile(tileIndex, worker);
+            });
+    }
     else
-        m_FrameIndex = 1;
+    {
+        m_ThreadPool.ParallelFor((uint32_t)m_ResolveList.size(), Schedule::Dynamic,
+            [this, &resolveTile](uint32_t index, uint32_t worker)
+            {
+                resolveTile(m_ResolveList[index], worker);
+            });
+    }
+
+    if (m_ReadPerfCounters)
+    {
+        m_PerfCounters.Resolve = {};
+        for (WorkerPerfCounters& counters : m_WorkerPerfCounters)
+        {
+            m_PerfCounters.Resolve.Add(counters.Value.Resolve);
+            counters.Value.Resolve = {};
+        }
+    }
+    if (output)
+    {
+        const uint32_t minFrames = m_TileFrames.empty() ? 0 : *std::min_element(m_TileFrames.begin(), m_TileFrames.end());
+        m_FrameOutput->EndFrame(outputFrame, m_AccumulatedFrames, minFrames * (uint32_t)m_Settings.SamplesPerPixel,
+            m_AccumulationTime);
+    }
+    CHROMA_STAT(m_Stats.ResolveTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+
+    if (m_Headless)
+        return;
+
+    CHROMA_STAT(start = std::chrono::steady_clock::now());
+
+    // Only the resolved tiles are uploaded, runs of dirty tiles within a tile row become one region
+    m_UploadRegions.clear();
+    for (uint32_t tileIndex : m_ResolveList)
+    {
+        const Tile& tile = m_Tiles[tileIndex];
+        if (!m_UploadRegions.empty())
+        {
+            Walnut::ImageRegion& last = m_UploadRegions.back();
+            if (last.Y == tile.MinY && last.X + last.Width == tile.MinX)
+            {
+                last.Width += tile.MaxX - tile.MinX;
+                continue;
+            }
+        }
+        m_UploadRegions.push_back({ tile.MinX, tile.MinY, tile.MaxX - tile.MinX, tile.MaxY - tile.MinY });
+    }
+
+    // Stack runs with the same horizontal span, a fully dirty frame ends up as a single region
+    size_t regionCount = 0;
+    for (const Walnut::ImageRegion& region : m_UploadRegions)
+    {
+        if (regionCount > 0)
+        {
+            Walnut::ImageRegion& last = m_UploadRegions[regionCount - 1];
+            if (last.X == region.X && last.Width == region.Width && last.Y + last.Height == region.Y)
+            {
+                last.Height += region.Height;
+                continue;
+            }
+        }
+        m_UploadRegions[regionCount++] = region;
+    }
+    m_UploadRegions.resize(regionCount);
+
+    m_FinalImage->EndUpload(m_UploadRegions);
+    CHROMA_STAT(m_Stats.UploadTime += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+}
+
+void Renderer::GetAccumulatedImage(std::vector<glm::vec3>& image) const
+{
+    image.resize((size_t)m_Width * m_Height);
+
+    glm::vec4 row[TileSize];
+    for (uint32_t tileIndex = 0; tileIndex < (uint32_t)m_Tiles.size(); tileIndex++)
+    {
+        const Tile& tile = m_Tiles[tileIndex];
+        const uint32_t count = tile.MaxX - tile.MinX;
+        const uint32_t frames = m_TileFrames[tileIndex];
+        const float scale = 1.0f / (float)std::max(frames, 1u);
+        if (frames == 0)
+            std::fill_n(row, count, glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+        for (uint32_t y = tile.MinY; y < tile.MaxY; y++)
+        {
+            if (frames > 0)
+                m_Accumulation.LoadRow(tileIndex, y - tile.MinY, count, frames, row);
+            for (uint32_t i = 0; i < count; i++)
+                image[tile.MinX + i + (size_t)y * m_Width] = glm::vec3(row[i]) * scale;
+        }
+    }
+}
+
+void Renderer::GetCostImage(std::vector<float>& image) const
+{
+    if (m_Cost.empty())
+    {
+        image.clear();
+        return;
+    }
+
+    image.resize((size_t)m_Width * m_Height);
+
+    for (uint32_t tileIndex = 0; tileIndex < (uint32_t)m_Tiles.size(); tileIndex++)
+    {
+        const Tile& tile = m_Tiles[tileIndex];
+        const float* cost = m_Cost.data() + (size_t)tileIndex * TileSize * TileSize;
+        const uint32_t frames = m_TileFrames[tileIndex];
+        const float scale = frames > 0 ? 1.0f / (float)frames : 0.0f;
+        for (uint32_t y = tile.MinY; y < tile.MaxY; y++)
+        {
+            for (uint32_t x = tile.MinX; x < tile.MaxX; x++)
+                image[x + (size_t)y * m_Width] = cost[(x - tile.MinX) + (y - tile.MinY) * TileSize] * scale;
+        }
+    }
 }
 
-glm::vec4 Renderer::PerPixel(uint32_t x, uint32_t y)
+void Renderer::UpdateCostRange()
 {
+    // Top of the color scale at the 99.5th percentile of the mean cost of all pixels rendered so far
+    m_CostScratch.clear();
+    for (uint32_t tileIndex = 0; tileIndex < (uint32_t)m_Tiles.size(); tileIndex++)
+    {
+        const Tile& tile = m_Tiles[tileIndex];
+        const uint32_t frames = m_TileFrames[tileIndex];
+        if (frames == 0)
+            continue;
+
+        const float* cost = m_Cost.data() + (size_t)tileIndex * TileSize * TileSize;
+        const float scale = 1.0f / (float)frames;
+        for (uint32_t y = 0; y < tile.MaxY - tile.MinY; y++)
+        {
+            for (uint32_t x = 0; x < tile.MaxX - tile.MinX; x++)
+                m_CostScratch.push_back(cost[x + y * TileSize] * scale);
+        }
+    }
+
+    m_MaxCost = 0.0f;
+    m_CostScaleTop = 0.0f;
+    if (m_CostScratch.empty())
+        return;
+
+    m_MaxCost = *std::max_element(m_CostScratch.begin(), m_CostScratch.end());
+    auto top = m_CostScratch.begin() + (ptrdiff_t)((m_CostScratch.size() - 1) * 995 / 1000);
+    std::nth_element(m_CostScratch.begin(), top, m_CostScratch.end());
+    m_CostScaleTop = *top;
+}
+
+template<uint32_t Features>
+glm::vec4 Renderer::PerPixel(uint32_t x, uint32_t y, uint32_t frameIndex, uint32_t& rayCount, Stats::Counters& stats, Footprint::Set& footprint)
+{
+    using Policy = RenderPolicy::Policy<Features>;
+
+    // Without anti-aliasing every pixel takes exactly one sample along the camera's precomputed ray
+    const int samplesPerPixel = Policy::AntiAliasing ? m_Settings.SamplesPerPixel : 1;
+
     glm::vec3 finalColor(0.0f);
 
-    uint32_t baseSeed = x + y * m_FinalImage->GetWidth();
-    baseSeed *= m_FrameIndex;
+    // Seeded by the frame of the tile, a tile restarted on its own renders what a full restart would
+    uint32_t baseSeed = x + y * m_Width;
+    baseSeed *= frameIndex;
+    baseSeed += m_Settings.Seed * 0x9e3779b9u;
+
+    // The jitter of up to JitterBatch samples is drawn at once, with the widest vectors of the CPU
+    constexpr int JitterBatch = 16;
+    uint32_t jitterSeeds[JitterBatch];
+    float jitterX[JitterBatch], jitterY[JitterBatch];
 
-    for (int sample = 0; sample < m_Settings.SamplesPerPixel; sample++)
+    for (int sample = 0; sample < samplesPerPixel; sample++)
     {
         uint32_t seed = baseSeed + sample * 719393;
 
         Ray ray;
         ray.Origin = m_ActiveCamera->GetPosition();
 
-        if (m_Settings.SamplesPerPixel > 1)
+        if constexpr (Policy::AntiAliasing)
         {
-            float offsetX = Utils::RandomFloat(seed) - 0.5f;
-            float offsetY = Utils::RandomFloat(seed) - 0.5f;
+            const int slot = sample % JitterBatch;
+            if (slot == 0)
+            {
+                const int batch = std::min(JitterBatch, samplesPerPixel - sample);
+                for (int i = 0; i < batch; i++)
+                    jitterSeeds[i] = baseSeed + (sample + i) * 719393;
+                m_ISAKernels->RandomFloats(jitterSeeds, jitterX, (uint32_t)batch);
+                m_ISAKernels->RandomFloats(jitterSeeds, jitterY, (uint32_t)batch);
+            }
 
-            float ndcX = (((float)x + offsetX) / (float)m_FinalImage->GetWidth()) * 2.0f - 1.0f;
-            float ndcY = (((float)y + offsetY) / (float)m_FinalImage->GetHeight()) * 2.0f - 1.0f;
+            // Continues from the seed the two draws left behind, like drawing them one by one
+            seed = jitterSeeds[slot];
+            float offsetX = jitterX[slot] - 0.5f;
+            float offsetY = jitterY[slot] - 0.5f;
+
+            float ndcX = (((float)x + offsetX) / (float)m_Width) * 2.0f - 1.0f;
+            float ndcY = (((float)y + offsetY) / (float)m_Height) * 2.0f - 1.0f;
 
             glm::vec4 target = m_ActiveCamera->GetInverseProjection() * glm::vec4(ndcX, ndcY, 1, 1);
             ray.Direction = glm::normalize(glm::vec3(m_ActiveCamera->GetInverseView() *
@@ -113,33 +1366,70 @@ glm::vec4 Renderer::PerPixel(uint32_t x, uint32_t y)
         }
         else
         {
-            ray.Direction = m_ActiveCamera->GetRayDirections()[x + y * m_FinalImage->GetWidth()];
+            ray.Direction = m_ActiveCamera->GetRayDirections()[x + y * m_Width];
         }
 
         glm::vec3 light(0.0f);
         glm::vec3 contribution(1.0f);
 
+        // Width of the path's ray cone at the last hit and the angle it widens by, for texture levels
+        float coneWidth = 0.0f, coneSpread = m_PixelSpread;
+        Material texturedMaterial;
+
         int bounces = 5;
+        const int recordedBounces = m_FootprintDepth > 0 ? (int)m_FootprintDepth : bounces;
+        CHROMA_STAT(uint32_t depth = 0);
         for (int i = 0; i < bounces; i++)
         {
             seed += i;
 
-            Renderer::HitPayload payload = TraceRay(ray);
+            CHROMA_STAT(const uint64_t traceStart = Stats::ReadTicks());
+            Renderer::HitPayload payload = TraceRay<Features>(ray, stats);
+            CHROMA_STAT(stats.TraceTicks += Stats::ReadTicks() - traceStart);
+            CHROMA_STAT((i == 0 ? stats.PrimaryRays : stats.SecondaryRays)++);
+            rayCount++;
+            CHROMA_STAT(depth++);
+            if (i < recordedBounces)
+            {
+                if (payload.HitDistance >= 0.0f)
+                {
+                    footprint.AddSegment(ray.Origin, payload.WorldPosition);
+                    footprint.AddHit(payload.Type, (uint32_t)payload.ShapeIndex, (uint32_t)payload.ObjectIndex);
+                }
+                else
+                {
+                    // Nothing bounded lies beyond the footprint bounds, the ray only matters up to there
+                    const float exit = Footprint::GetExitDistance(ray, m_FootprintMin, m_FootprintMax);
+                    if (exit > 0.0f)
+                        footprint.AddSegment(ray.Origin, ray.Origin + ray.Direction * exit);
+                }
+            }
+
             if (payload.HitDistance < 0.0f)
             {
+                CHROMA_STAT(stats.SkyHits++);
                 glm::vec3 skyColor = glm::vec3(0.6f, 0.7f, 0.9f);
                 light += skyColor * contribution;
                 break;
             }
 
-            const Material& material = m_ActiveScene->Materials[payload.ObjectIndex];
+            glm::vec3 shadingNormal = payload.WorldNormal;
+            if constexpr (Policy::Textures)
+                coneWidth += coneSpread * payload.HitDistance;
+            const Material& material = Policy::Textures ?
+                ApplyTextures(payload, ray.Direction, coneWidth, seed, texturedMaterial, shadingNormal) :
+                m_ActiveScene->Materials[payload.ObjectIndex];
             light += material.GetEmission() * contribution;
+            CHROMA_STAT(stats.EmitterHits += material.EmissionPower > 0.0f ? 1 : 0);
 
             glm::vec3 worldPosition = payload.WorldPosition;
             glm::vec3 worldNormal = payload.WorldNormal;
             ray.Origin = worldPosition + worldNormal * 0.0001f;
+            // The origin still leaves the surface itself, only shading sees the normal map
+            if constexpr (Policy::Textures)
+                worldNormal = shadingNormal;
 
-            if (material.Transparency > 0.0f)
+            if (Policy::Transparency && material.Transparency > 0.0f)
             {
                 float cosTheta = glm::min(glm::dot(-ray.Direction, worldNormal), 1.0f);
                 float reflectance = CalculateFresnel(cosTheta, material.IndexOfRefraction);
@@ -185,16 +1475,20 @@ glm::vec4 Renderer::PerPixel(uint32_t x, uint32_t y)
                     ray.Direction = glm::reflect(ray.Direction,
                         worldNormal + material.Roughness * Utils::InUnitSphere(seed));
                     contribution *= material.Albedo * material.ReflectionTint;
+                    if constexpr (Policy::Textures)
+                        coneSpread += material.Roughness * DiffuseConeSpread;
                 }
                 else
                 {
-                    if (m_Settings.SlowRandom) {
+                    if constexpr (Policy::SlowRandom) {
                         ray.Direction = glm::normalize(worldNormal + Walnut::Random::InUnitSphere());
                     }
                     else {
                         ray.Direction = glm::normalize(worldNormal + Utils::InUnitSphere(seed));
                     }
                     contribution *= material.Albedo;
+                    if constexpr (Policy::Textures)
+                        coneSpread = std::max(coneSpread, DiffuseConeSpread);
                 }
             }
 
@@ -202,10 +1496,11 @@ glm::vec4 Renderer::PerPixel(uint32_t x, uint32_t y)
                 break;
         }
 
+        CHROMA_STAT(stats.PathDepth[std::min(depth, Stats::MaxPathDepth)]++);
         finalColor += light;
     }
 
-    finalColor /= (float)m_Settings.SamplesPerPixel;
+    finalColor /= (float)samplesPerPixel;
     return glm::vec4(finalColor, 1.0f);
 }
 
@@ -221,122 +1516,218 @@ bool Renderer::ShouldReflect(const Material& material, uint32_t& seed)
     return Utils::RandomFloat(seed) < reflectProb;
 }
 
-Renderer::HitPayload Renderer::TraceRay(const Ray& ray)
+const Material& Renderer::ApplyTextures(const HitPayload& payload, const glm::vec3& direction, float coneWidth,
+    uint32_t& seed, Material& textured, glm::vec3& shadingNormal)
 {
-    int closestShape = -1;
-    float hitDistance = std::numeric_limits<float>::max();
-    ShapeType shapeType = ShapeType::None;
-    glm::vec3 triangleNormal;
+    const Material& material = m_ActiveScene->Materials[payload.ObjectIndex];
+    const glm::ivec3 textures = m_MaterialTextures[payload.ObjectIndex];
+    if (textures.x < 0 && textures.y < 0 && textures.z < 0)
+        return material;
 
-    for (size_t i = 0; i < m_ActiveScene->Spheres.size(); i++)
+    // Texture coordinates, the directions on the surface they grow along (v towards the top of the
+    // image) and how many of them one unit of distance covers. Spheres are mapped by latitude and
+    // longitude, planes along themselves, and boxes and triangles along the axis closest to their normal.
+    const glm::vec3& normal = payload.WorldNormal;
+    glm::vec2 uv;
+    glm::vec3 tangent, bitangent;
+    float uvPerUnit;
+    if (payload.Type == ShapeType::Sphere)
     {
-        float t;
-        if (IntersectSphere(ray, m_ActiveScene->Spheres[i], t) && t < hitDistance)
+        const float radius = m_ActiveScene->Spheres[payload.ShapeIndex].Radius;
+        uv = { 0.5f + std::atan2(normal.z, normal.x) * (0.5f / glm::pi<float>()),
+            std::acos(glm::clamp(normal.y, -1.0f, 1.0f)) / glm::pi<float>() };
+        const glm::vec3 around(-normal.z, 0.0f, normal.x);
+        const float length = glm::length(around);
+        tangent = length > 1e-4f ? around / length : glm::vec3(1.0f, 0.0f, 0.0f);
+        bitangent = glm::cross(tangent, normal);
+        uvPerUnit = 1.0f / (glm::pi<float>() * radius);
+    }
+    else
+    {
+        glm::vec3 projection = normal;
+        if (payload.Type != ShapeType::Plane)
         {
-            hitDistance = t;
-            closestShape = (int)i;
-            shapeType = ShapeType::Sphere;
+            const glm::vec3 magnitude = glm::abs(normal);
+            const int axis = magnitude.x > magnitude.y ? (magnitude.x > magnitude.z ? 0 : 2) : (magnitude.y > magnitude.z ? 1 : 2);
+            projection = glm::vec3(0.0f);
+            projection[axis] = normal[axis] < 0.0f ? -1.0f : 1.0f;
         }
+        GetPlanarBasis(projection, tangent, bitangent);
+        uvPerUnit = 1.0f / std::max(material.TextureScale, 1e-4f);
+        uv = { glm::dot(payload.WorldPosition, tangent) * uvPerUnit, -glm::dot(payload.WorldPosition, bitangent) * uvPerUnit };
     }
 
-    for (size_t i = 0; i < m_ActiveScene->Planes.size(); i++)
+    // The cone meets the surface in an ellipse that stretches at grazing angles
+    const float cosine = std::max(std::abs(glm::dot(direction, normal)), MinConeCosine);
+    const float footprint = coneWidth / cosine * uvPerUnit;
+    const glm::vec3 random(Utils::RandomFloat(seed), Utils::RandomFloat(seed), Utils::RandomFloat(seed));
+
+    textured = material;
+    if (textures.x >= 0)
+        textured.Albedo *= glm::vec3(m_Textures.Sample(textures.x, uv, footprint, random));
+    if (textures.y >= 0)
+        textured.Roughness *= m_Textures.Sample(textures.y, uv, footprint, random).r;
+    if (textures.z >= 0)
     {
-        float t;
-        if (IntersectPlane(ray, m_ActiveScene->Planes[i], t) && t < hitDistance)
-        {
-            hitDistance = t;
-            closestShape = (int)i;
-            shapeType = ShapeType::Plane;
-        }
+        // Projected directions are only along the surface after removing the part along the normal
+        const glm::vec3 t = glm::normalize(tangent - normal * glm::dot(normal, tangent));
+        const glm::vec3 b = glm::normalize(bitangent - normal * glm::dot(normal, bitangent));
+        const glm::vec3 mapped = glm::vec3(m_Textures.Sample(textures.z, uv, footprint, random));
+        const glm::vec3 bent = t * mapped.x + b * mapped.y + normal * mapped.z;
+        const float length = glm::length(bent);
+        if (length > 1e-4f && glm::dot(bent, normal) > 0.0f)
+            shadingNormal = bent / length;
     }
+    return textured;
+}
 
-    for (size_t i = 0; i < m_ActiveScene->Boxes.size(); i++)
+template<uint32_t Features>
+Renderer::HitPayload Renderer::TraceRay(const Ray& ray, Stats::Counters& stats)
+{
+    using Policy = RenderPolicy::Policy<Features>;
+
+    int closestShape = -1;
+    float hitDistance = std::numeric_limits<float>::max();
+    ShapeType shapeType = ShapeType::None;
+
+    // Planes are unbounded and not part of the BVH
+    if constexpr (Policy::Planes)
     {
-        float t;
-        if (IntersectBox(ray, m_ActiveScene->Boxes[i], t) && t < hitDistance)
+        CHROMA_STAT(stats.IntersectionTests[(int)ShapeType::Plane] += m_Planes.Count);
+        const int32_t plane = m_ISAKernels->IntersectPlanes(ray, m_Planes, hitDistance);
+        if (plane >= 0)
         {
-            hitDistance = t;
-            closestShape = (int)i;
-            shapeType = ShapeType::Box;
+            closestShape = plane;
+            shapeType = ShapeType::Plane;
         }
     }
 
-    for (size_t i = 0; i < m_ActiveScene->Triangles.size(); i++)
+    // The BVH only references shape types the scene has, the others are compiled out of the leaf test
+    if constexpr (Policy::BVH)
     {
-        float t;
-        glm::vec3 normal;
-        if (IntersectTriangle(ray, m_ActiveScene->Triangles[i], t, normal) && t < hitDistance)
-        {
-            hitDistance = t;
-            closestShape = (int)i;
-            shapeType = ShapeType::Triangle;
-            triangleNormal = normal;
-        }
+        uint32_t nodesVisited = m_BVH.Traverse(ray, hitDistance,
+            [&](uint32_t reference)
+            {
+                const uint32_t index = BVH::GetIndex(reference);
+                const ShapeType type = BVH::GetType(reference);
+                CHROMA_STAT(stats.IntersectionTests[(int)type]++);
+
+                float t;
+                bool hit = false;
+                switch (type)
+                {
+                    case ShapeType::Sphere:
+                        if constexpr (Policy::Spheres)
+                            hit = IntersectSphere(ray, m_ActiveScene->Spheres[index], t);
+                        break;
+                    case ShapeType::Box:
+                        if constexpr (Policy::Boxes)
+                            hit = IntersectBox(ray, m_ActiveScene->Boxes[index], t);
+                        break;
+                    case ShapeType::Triangle:
+                    {
+                        if constexpr (Policy::Triangles)
+                        {
+                            glm::vec3 normal;
+                            hit = IntersectTriangle(ray, m_ActiveScene->Triangles[index], t, normal);
+                        }
+                        break;
+                    }
+                    default:
+                        break;
+                }
+
+                if (hit && t < hitDistance)
+                {
+                    hitDistance = t;
+                    closestShape = (int)index;
+                    shapeType = type;
+                }
+            });
+
+        CHROMA_STAT(stats.NodesVisited += nodesVisited);
+        (void)nodesVisited;
     }
 
     if (closestShape < 0)
         return Miss(ray);
 
-    return ClosestHit(ray, hitDistance, closestShape, shapeType);
+    return ClosestHit<Features>(ray, hitDistance, closestShape, shapeType);
 }
 
+template<uint32_t Features>
 Renderer::HitPayload Renderer::ClosestHit(const Ray& ray, float hitDistance, int objectIndex, ShapeType type)
 {
+    using Policy = RenderPolicy::Policy<Features>;
+
     Renderer::HitPayload payload;
     payload.HitDistance = hitDistance;
     payload.ObjectIndex = objectIndex;
+    payload.ShapeIndex = objectIndex;
     payload.Type = type;
 
     switch (type)
     {
         case ShapeType::Sphere:
         {
-            const Sphere& sphere = m_ActiveScene->Spheres[objectIndex];
-            glm::vec3 origin = ray.Origin - sphere.Position;
-            payload.WorldPosition = origin + ray.Direction * hitDistance;
-            payload.WorldNormal = glm::normalize(payload.WorldPosition);
-            payload.WorldPosition += sphere.Position;
-            payload.ObjectIndex = sphere.MaterialIndex;
+            if constexpr (Policy::Spheres)
+            {
+                const Sphere& sphere = m_ActiveScene->Spheres[objectIndex];
+                glm::vec3 origin = ray.Origin - sphere.Position;
+                payload.WorldPosition = origin + ray.Direction * hitDistance;
+                payload.WorldNormal = glm::normalize(payload.WorldPosition);
+                payload.WorldPosition += sphere.Position;
+                payload.ObjectIndex = sphere.MaterialIndex;
+            }
             break;
         }
         case ShapeType::Plane:
         {
-            const Plane& plane = m_ActiveScene->Planes[objectIndex];
-            payload.WorldPosition = ray.Origin + ray.Direction * hitDistance;
-            payload.WorldNormal = plane.Normal;
-            payload.ObjectIndex = plane.MaterialIndex;
+            if constexpr (Policy::Planes)
+            {
+                const Plane& plane = m_ActiveScene->Planes[objectIndex];
+                payload.WorldPosition = ray.Origin + ray.Direction * hitDistance;
+                payload.WorldNormal = plane.Normal;
+                payload.ObjectIndex = plane.MaterialIndex;
+            }
             break;
         }
         case ShapeType::Box:
         {
-            const Box& box = m_ActiveScene->Boxes[objectIndex];
-            payload.WorldPosition = ray.Origin + ray.Direction * hitDistance;
-
-            glm::vec3 p = payload.WorldPosition;
-            float epsilon = 0.0001f;
-
-            if (std::abs(p.x - box.Min.x) < epsilon)
-                payload.WorldNormal = glm::vec3(-1, 0, 0);
-            else if (std::abs(p.x - box.Max.x) < epsilon)
-                payload.WorldNormal = glm::vec3(1, 0, 0);
-            else if (std::abs(p.y - box.Min.y) < epsilon)
-                payload.WorldNormal = glm::vec3(0, -1, 0);
-            else if (std::abs(p.y - box.Max.y) < epsilon)
-                payload.WorldNormal = glm::vec3(0, 1, 0);
-            else if (std::abs(p.z - box.Min.z) < epsilon)
-                payload.WorldNormal = glm::vec3(0, 0, -1);
-            else if (std::abs(p.z - box.Max.z) < epsilon)
-                payload.WorldNormal = glm::vec3(0, 0, 1);
-
-            payload.ObjectIndex = box.MaterialIndex;
+            if constexpr (Policy::Boxes)
+            {
+                const Box& box = m_ActiveScene->Boxes[objectIndex];
+                payload.WorldPosition = ray.Origin + ray.Direction * hitDistance;
+
+                glm::vec3 p = payload.WorldPosition;
+                float epsilon = 0.0001f;
+
+                if (std::abs(p.x - box.Min.x) < epsilon)
+                    payload.WorldNormal = glm::vec3(-1, 0, 0);
+                else if (std::abs(p.x - box.Max.x) < epsilon)
+                    payload.WorldNormal = glm::vec3(1, 0, 0);
+                else if (std::abs(p.y - box.Min.y) < epsilon)
+                    payload.WorldNormal = glm::vec3(0, -1, 0);
+                else if (std::abs(p.y - box.Max.y) < epsilon)
+                    payload.WorldNormal = glm::vec3(0, 1, 0);
+                else if (std::abs(p.z - box.Min.z) < epsilon)
+                    payload.WorldNormal = glm::vec3(0, 0, -1);
+                else if (std::abs(p.z - box.Max.z) < epsilon)
+                    payload.WorldNormal = glm::vec3(0, 0, 1);
+
+                payload.ObjectIndex = box.MaterialIndex;
+            }
             break;
         }
         case ShapeType::Triangle:
         {
-            const Triangle& triangle = m_ActiveScene->Triangles[objectIndex];
-            payload.WorldPosition = ray.Origin + ray.Direction * hitDistance;
-            payload.WorldNormal = triangle.n0;
-            payload.ObjectIndex = triangle.MaterialIndex;
+            if constexpr (Policy::Triangles)
+            {
+                const Triangle& triangle = m_ActiveScene->Triangles[objectIndex];
+                payload.WorldPosition = ray.Origin + ray.Direction * hitDistance;
+                payload.WorldNormal = triangle.n0;
+                payload.ObjectIndex = triangle.MaterialIndex;
+            }
             break;
         }
     }
@@ -349,4 +1740,17 @@ Renderer::HitPayload Renderer::Miss(const Ray& ray)
     Renderer::HitPayload payload;
     payload.HitDistance = -1.0f;
     return payload;
+}
+
+template<uint32_t... Features>
+constexpr std::array<Renderer::Kernels, sizeof...(Features)> Renderer::MakeKernelTable(std::integer_sequence<uint32_t, Features...>)
+{
+    return { { { &Renderer::RenderTile<Features>, &Renderer::PerPixel<Features>, &Renderer::TraceRay<Features> }... } };
+}
+
+const Renderer::Kernels& Renderer::GetKernels(uint32_t features)
+{
+    static constexpr std::array<Kernels, RenderPolicy::Combinations> table =
+        MakeKernelTable(std::make_integer_sequence<uint32_t, RenderPolicy::Combinations>());
+    return table[features];
 }
\ No newline at end of file
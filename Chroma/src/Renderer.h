@@ -2,49 +2,295 @@
 
 #include "Walnut/Image.h"
 
+#include "AccumulationBuffer.h"
+#include "BVH.h"
 #include "Camera.h"
+#include "Footprint.h"
+#include "FrameOutput.h"
+#include "Heatmap.h"
+#include "ISA.h"
+#include "Memory.h"
+#include "PerfCounters.h"
 #include "Ray.h"
+#include "RenderPolicy.h"
+#include "RenderStats.h"
+#include "Resolve.h"
 #include "Scene.h"
+#include "TextureCache.h"
+#include "ThreadPool.h"
 
+#include <algorithm>
+#include <array>
 #include <memory>
+#include <utility>
 #include <glm/glm.hpp>
 
+class Checkpoint;
+
 class Renderer
 {
 public:
+    // In pixels of the viewport
+    struct Rect
+    {
+        uint32_t X = 0, Y = 0;
+        uint32_t Width = 0, Height = 0;
+
+        bool IsEmpty() const { return Width == 0 || Height == 0; }
+    };
+
     struct Settings
     {
         bool Accumulate = true;
         bool SlowRandom = true;
         int SamplesPerPixel = 1;
+        uint32_t Seed = 0; // Offsets every per-pixel random sequence
+
+        float Exposure = 0.0f; // In stops
+        Resolve::Tonemapper Tonemap = Resolve::Tonemapper::ACES;
+
+        AccumulationFormat Accumulation = AccumulationFormat::RGBFloat;
+
+        uint32_t ThreadCount = 0; // 0 uses every hardware thread
+        ThreadAffinity Affinity = ThreadAffinity::None;
+        // Every worker keeps the same tiles from frame to frame and is the first to touch their
+        // memory, so on NUMA systems a tile's samples stay on the node of the thread rendering it
+        bool NUMALocal = false;
+
+        // Shows what every pixel cost instead of the shaded image, changing it restarts accumulation
+        Heatmap::Metric Heatmap = Heatmap::Metric::None;
+
+        // Reads the hardware counters around every tile and resolved tile, Linux only
+        bool PerfCounters = false;
+
+        // Path segments whose interactions go into the tile footprints that scene edits are tested
+        // against, 0 records all of them. Fewer keep more of the image when an object is edited, at
+        // the price of leaving its faint indirect influence stale until accumulation restarts.
+        uint32_t InvalidationDepth = 0;
+
+        // Region of interest, only the tiles it overlaps are rendered every frame and an empty one
+        // renders everything. The other tiles keep their samples and get a frame every
+        // CropOutsideInterval frames, 0 freezes them once they hold a frame. Tiles outside that an edit
+        // restarted render again right away, under a frame budget they show black until they do.
+        Rect Crop;
+        uint32_t CropOutsideInterval = 0;
+
+        // In milliseconds, a frame starts no tile it expects to finish after this and the rest wait
+        // for the next one. 0 renders every tile. Tiles with the fewest samples go first, spiralling
+        // out from the focus pixel, or the image centre while it is negative.
+        float FrameBudget = 0.0f;
+        int32_t FocusX = -1, FocusY = -1;
+
+        // Accumulation stops at the first target it reaches, 0 disables a target. Samples and noise
+        // are judged per tile, converged tiles rest while noisy ones go on. The noise is the estimated
+        // relative standard error of the pixel means. RGBHalf stops at MaxHalfSamples frames anyway.
+        uint32_t MaxSamples = 0;
+        float MaxTime = 0.0f;           // In seconds of rendering since the accumulation restarted
+        float NoiseThreshold = 0.0f;
+
+        // In bytes, texture tiles rays reached lately are kept in memory up to it
+        size_t TextureCacheSize = TextureCache::DefaultSize;
     };
+
+    static constexpr uint32_t TileSize = 32;
 public:
     Renderer() = default;
+    // Headless renderers never touch the GPU, ResolveImage() writes to GetImageData() instead
+    explicit Renderer(bool headless) : m_Headless(headless) {}
 
     void OnResize(uint32_t width, uint32_t height);
     void Render(const Scene& scene, const Camera& camera);
 
+    // Applies the changes recorded in the scene journal since the last call. Every part of the
+    // renderer only reacts to the changes it depends on: the BVH is rebuilt when bounded shapes were
+    // added or removed and refitted when they moved, the plane set only follows plane edits and
+    // accumulation restarts in the tiles whose footprint an edit may have touched. A scene the
+    // renderer has not seen before is taken in full. Render() calls this itself, it is public so the
+    // BVH build can be done (and timed) up front.
+    void UpdateScene(const Scene& scene);
+
+    // Copies the samples and everything needed to continue them into the checkpoint, which flushes
+    // them in the background. Call it between frames. False while the last flush still runs, and in
+    // heatmap mode.
+    bool WriteCheckpoint(Checkpoint& checkpoint, const Scene& scene, const Camera& camera);
+    // Continues the newest checkpoint of the same scene and image size with its camera view, samples
+    // and the settings they depend on, threads and texture cache stay as they are. Exact with the fast
+    // random path, SlowRandom draws from global state that is not saved. False changes nothing.
+    bool ResumeCheckpoint(Checkpoint& checkpoint, const Scene& scene, Camera& camera);
+
+    // Renders frameCount frames of one tile from firstFrame on, on the calling thread, and returns the
+    // sums of their samples row by row within the tile and what their paths touched. Nothing of the
+    // renderer's own image changes, the samples are meant for MergeTileSamples() of another one.
+    void RenderTileSamples(const Scene& scene, const Camera& camera, uint32_t tileIndex, uint32_t firstFrame,
+        uint32_t frameCount, std::vector<glm::vec3>& sums, Footprint::Set& footprint);
+    // Adds samples RenderTileSamples() returned to the tile, firstFrame has to follow the frames it
+    // holds. Samples are seeded by their frame within the tile, so the image matches one rendered
+    // here up to float rounding. False in heatmap mode and for frames out of order.
+    bool MergeTileSamples(uint32_t tileIndex, uint32_t firstFrame, uint32_t frameCount, const glm::vec3* sums,
+        const Footprint::Set& footprint);
+
+    // Tonemaps the tiles touched since the last call into the final image and uploads it.
+    // Call once per displayed frame, Render() itself only accumulates.
+    void ResolveImage();
+
+    // Every resolve with anything new also goes into the output, with the channels it asks for.
+    // nullptr detaches it, the renderer does not own it.
+    void SetFrameOutput(FrameOutput* output)
+    {
+        m_FrameOutput = output;
+        std::fill(m_TileOutputFrames.begin(), m_TileOutputFrames.end(), 0ull);
+    }
+
     std::shared_ptr<Walnut::Image> GetFinalImage() const { return m_FinalImage; }
+    const uint32_t* GetImageData() const { return m_ImageData.Data(); }
+
+    uint32_t GetWidth() const { return m_Width; }
+    uint32_t GetHeight() const { return m_Height; }
+
+    // Mean linear radiance of every pixel accumulated so far, row by row
+    void GetAccumulatedImage(std::vector<glm::vec3>& image) const;
+    // Frames since accumulation last restarted for the whole image, tiles an edit restarted hold fewer
+    uint32_t GetAccumulatedFrames() const { return m_AccumulatedFrames; }
+    const std::vector<uint32_t>& GetTileFrames() const { return m_TileFrames; }
+    // Tiles the last scene edit restarted, out of GetTileCount()
+    uint32_t GetInvalidatedTiles() const { return m_InvalidatedTiles; }
+    uint32_t GetTileCount() const { return (uint32_t)m_Tiles.size(); }
+    Rect GetTileRect(uint32_t tileIndex) const
+    {
+        const Tile& tile = m_Tiles[tileIndex];
+        return { tile.MinX, tile.MinY, tile.MaxX - tile.MinX, tile.MaxY - tile.MinY };
+    }
+
+    // Mean heatmap cost of every pixel per frame, row by row. Empty while no heatmap is rendered.
+    void GetCostImage(std::vector<float>& image) const;
+    // Largest mean cost of a pixel, and the cost shown in red. That is a high percentile instead of
+    // the maximum, so that a few preempted pixels do not turn a cycle heatmap blue.
+    float GetMaxCost() const { return m_MaxCost; }
+    float GetHeatmapScaleTop() const { return m_CostScaleTop; }
+
+    // Rays traced by the last Render() call, camera rays and bounces
+    uint64_t GetRayCount() const { return m_RayCount; }
+    // Tiles and pixels the last Render() call traced, fewer than the image with a crop or a budget
+    uint32_t GetRenderedTileCount() const { return m_RenderedTiles; }
+    uint64_t GetRenderedPixelCount() const { return m_RenderedPixels; }
+    const BVH& GetBVH() const { return m_BVH; }
+
+    // Textures of the scene materials, loaded when a material first uses them. Their hit rates say
+    // whether the cache size holds what a frame reads.
+    TextureCache& GetTextureCache() { return m_Textures; }
+    const TextureCache& GetTextureCache() const { return m_Textures; }
+    // Why textures the scene uses could not be loaded, those materials render without them
+    const std::vector<std::string>& GetTextureErrors() const { return m_TextureErrors; }
+
+    // Whether the last Render() call found every tile at a target, or frozen outside the crop. A
+    // restart, an edit or a looser target gives it work again on the next call.
+    bool IsConverged() const { return m_Converged; }
+    uint32_t GetConvergedTileCount() const { return m_ConvergedTiles; }
+    // Largest noise estimate of a tile still rendering towards the noise target
+    float GetNoiseEstimate() const { return m_NoiseEstimate; }
+    double GetAccumulationTime() const { return m_AccumulationTime; }
+
+    // Counters and timings of the last Render() and ResolveImage() calls, all zero without CHROMA_STATS
+    const Stats::FrameStats& GetStats() const { return m_Stats; }
+
+    // Hardware counters of the last Render() and ResolveImage() calls, empty unless enabled and available
+    const PerfCounters::FrameSample& GetPerfCounters() const { return m_PerfCounters; }
+
+    // Worker timings of the last Render() call, and the render time of every tile in seconds
+    const ThreadPool& GetThreadPool() const { return m_ThreadPool; }
+    const std::vector<float>& GetTileTimes() const { return m_TileTimes; }
+
+    // RenderPolicy::Feature bits of the kernels the last Render() call ran
+    uint32_t GetKernelFeatures() const { return m_KernelFeatures; }
 
-    void ResetFrameIndex() { m_FrameIndex = 1; }
+    void ResetFrameIndex()
+    {
+        m_FrameIndex = 1;
+        std::fill(m_TileFrames.begin(), m_TileFrames.end(), 0u);
+        m_AccumulationTime = 0.0;
+    }
     Settings& GetSettings() { return m_Settings; }
+
+    size_t GetAccumulationMemory() const { return m_Accumulation.GetSizeInBytes(); }
 private:
+    struct Tile
+    {
+        uint32_t MinX, MinY;
+        uint32_t MaxX, MaxY; // Exclusive
+    };
+
     struct HitPayload
     {
         float HitDistance;
         glm::vec3 WorldPosition;
         glm::vec3 WorldNormal;
 
-        int ObjectIndex;
+        int ObjectIndex; // Of the material once ClosestHit() is done
+        int ShapeIndex;
         ShapeType Type = ShapeType::None;
     };
 
-    glm::vec4 PerPixel(uint32_t x, uint32_t y); // RayGen
+    bool UpdateCapacity(uint32_t width, uint32_t height);
+    // Restarts accumulation when the settings changed what it holds, remap moves it to new workers
+    void UpdateAccumulation(bool remap);
+    // Picks the tiles of the next frame from the crop
+    void SelectActiveTiles();
+    // Whether the tile reached a target of the settings
+    bool IsTileConverged(uint32_t tileIndex) const;
+    float GetTileNoise(uint32_t tileIndex) const;
+    // Sorts them into the order a frame budget renders them in
+    void SortActiveTiles();
+    bool UpdateThreadPool();
+    uint64_t ReadCost(const Stats::Counters& stats, uint32_t rayCount) const;
+    void UpdateCostRange();
 
-    HitPayload TraceRay(const Ray& ray);
+    // Adds what the change may have touched to m_Invalidation, false when it affects every tile
+    bool AddInvalidation(const Scene& scene, const SceneChange& change);
+    // Restarts the tiles m_Invalidation touches, or all of them
+    void InvalidateTiles(bool all);
+
+    // Kernels are specialized on RenderPolicy::Feature bits, see SelectKernelFeatures()
+    template<uint32_t Features>
+    void RenderTile(const Tile& tile, uint32_t worker);
+    template<uint32_t Features>
+    glm::vec4 PerPixel(uint32_t x, uint32_t y, uint32_t frameIndex, uint32_t& rayCount, Stats::Counters& stats, Footprint::Set& footprint); // RayGen
+
+    template<uint32_t Features>
+    HitPayload TraceRay(const Ray& ray, Stats::Counters& stats);
+    template<uint32_t Features>
     HitPayload ClosestHit(const Ray& ray, float hitDistance, int objectIndex, ShapeType type);
     HitPayload Miss(const Ray& ray);
 
+    // Loads the textures the materials use, see m_MaterialTextures
+    void UpdateTextures(const Scene& scene);
+    // The material of the hit with its textures applied, or the scene's one if it has none. Texture
+    // levels are picked by the width of the ray cone at the hit, which grows with the distance the
+    // path travelled and at rough bounces. The normal map only bends the shading normal.
+    const Material& ApplyTextures(const HitPayload& payload, const glm::vec3& direction, float coneWidth,
+        uint32_t& seed, Material& textured, glm::vec3& shadingNormal);
+
+    // The features the scene needs, and the ones a frame of it needs with the current settings
+    static uint32_t SelectSceneFeatures(const Scene& scene);
+    uint32_t SelectKernelFeatures() const;
+    // Selects the kernels of the next frame
+    void PrepareKernels();
+
+    using RenderTileKernel = void (Renderer::*)(const Tile&, uint32_t);
+    using PerPixelKernel = glm::vec4 (Renderer::*)(uint32_t, uint32_t, uint32_t, uint32_t&, Stats::Counters&, Footprint::Set&);
+    using TraceRayKernel = HitPayload (Renderer::*)(const Ray&, Stats::Counters&);
+
+    struct Kernels
+    {
+        RenderTileKernel RenderTile;
+        PerPixelKernel PerPixel;
+        TraceRayKernel TraceRay;
+    };
+
+    // Dispatch table entry of every feature combination
+    static const Kernels& GetKernels(uint32_t features);
+    template<uint32_t... Features>
+    static constexpr std::array<Kernels, sizeof...(Features)> MakeKernelTable(std::integer_sequence<uint32_t, Features...>);
+
     // Shape intersection methods
     bool IntersectSphere(const Ray& ray, const Sphere& sphere, float& hitDistance) const;
     bool IntersectPlane(const Ray& ray, const Plane& plane, float& hitDistance) const;
@@ -53,18 +299,110 @@ private:
         glm::vec3& normal) const;
 
 private:
+    friend class RendererBench;
+
     std::shared_ptr<Walnut::Image> m_FinalImage;
+    Memory::PageArray<uint32_t> m_ImageData; // Headless only
     Settings m_Settings;
 
-    std::vector<uint32_t> m_ImageHorizontalIter, m_ImageVerticalIter;
+    bool m_Headless = false;
+    uint32_t m_Width = 0, m_Height = 0;
+
+    // Framebuffers are allocated for the capacity and only use the top-left viewport sized part
+    uint32_t m_CapacityWidth = 0, m_CapacityHeight = 0;
+    uint32_t m_ShrinkFrames = 0;
+
+    std::vector<Tile> m_Tiles;
+    std::vector<uint32_t> m_TileFrames; // Frames accumulated per tile, 0 restarts it
+    std::vector<Footprint::Set> m_Footprints;
+    std::vector<uint8_t> m_DirtyTiles;
+    std::vector<uint32_t> m_ActiveTiles;
+    std::vector<uint8_t> m_TileActive;
+    std::vector<uint32_t> m_TileStamps;     // Render call that last rendered the tile
+    uint32_t m_RenderCount = 0;
+    uint32_t m_RenderedTiles = 0;
+    uint64_t m_RenderedPixels = 0;
+    float m_TileTimeEstimate = 0.0f;        // In seconds, average of the last frame
+
+    // Relative variance of a frame's pixel samples, summed over the frames that measured it
+    struct TileNoise
+    {
+        float Sum;
+        uint32_t Frames;
+    };
+    std::vector<TileNoise> m_TileNoise;
+    bool m_MeasureNoise = false;
+    double m_AccumulationTime = 0.0;
+    bool m_Converged = false;
+    uint32_t m_ConvergedTiles = 0;
+    float m_NoiseEstimate = 0.0f;
+    std::vector<uint64_t> m_TileRayCounts;
+    std::vector<float> m_TileTimes;
+
+    // Summed heatmap cost per pixel, in tile sized blocks like the accumulation buffer
+    std::vector<float> m_Cost;
+    std::vector<float> m_CostScratch;
+    float m_MaxCost = 0.0f, m_CostScaleTop = 0.0f; // Per frame, like GetCostImage()
+    Heatmap::Metric m_HeatmapMetric = Heatmap::Metric::None;
+    std::vector<uint32_t> m_ResolveList;
+    std::vector<Walnut::ImageRegion> m_UploadRegions;
+
+    // Output frame the tile was last written to, a slot holding an older one misses the newer pixels
+    FrameOutput* m_FrameOutput = nullptr;
+    std::vector<uint64_t> m_TileOutputFrames;
 
     const Scene* m_ActiveScene = nullptr;
     const Camera* m_ActiveCamera = nullptr;
 
-    uint32_t* m_ImageData = nullptr;
-    glm::vec4* m_AccumulationData = nullptr;
+    // Journal position of the scene everything below was derived from, see UpdateScene()
+    uint64_t m_SceneID = 0;
+    uint64_t m_SceneVersion = 0;
+    uint32_t m_SceneFeatures = 0;
+
+    BVH m_BVH;
+
+    TextureCache m_Textures;
+    std::vector<glm::ivec3> m_MaterialTextures;     // Albedo, roughness and normal texture handles, -1 for none
+    std::vector<std::string> m_TextureErrors;
+    float m_PixelSpread = 0.0f;                     // Angle between the camera rays of neighbouring pixels
+
+    // Escaping rays are only recorded up to where they leave these bounds, nothing bounded lies
+    // beyond them. Set whenever every tile restarts, an edit reaching outside restarts them all.
+    glm::vec3 m_FootprintMin{ 0.0f }, m_FootprintMax{ 0.0f };
+    uint32_t m_FootprintDepth = 0;
+    Footprint::Query m_Invalidation;
+    static constexpr size_t MaxPartialRefit = 1024;
+    std::vector<uint32_t> m_RefitReferences;    // Shapes that moved, for a partial BVH refit
+    uint32_t m_InvalidatedTiles = 0;
+
+    AccumulationBuffer m_Accumulation;
+
+    ThreadPool m_ThreadPool;
+    uint32_t m_ThreadCount = 0;
+    bool m_NUMALocal = false;
+
+    uint32_t m_KernelFeatures = 0;
+    const ISA::KernelTable* m_ISAKernels = nullptr;
+    ISA::PlaneSet m_Planes;
 
     uint32_t m_FrameIndex = 1;
+    uint32_t m_AccumulatedFrames = 0;
+    uint64_t m_RayCount = 0;
+
+    std::vector<Stats::WorkerCounters> m_WorkerCounters;
+    Stats::FrameStats m_Stats;
+
+    struct alignas(Utils::CacheLineSize) WorkerPerfCounters
+    {
+        PerfCounters::FrameSample Value;
+    };
+    std::vector<WorkerPerfCounters> m_WorkerPerfCounters;
+    PerfCounters::FrameSample m_PerfCounters;
+    bool m_ReadPerfCounters = false;
+
+    float m_ResolvedExposure = 0.0f;
+    Resolve::Tonemapper m_ResolvedTonemap = Resolve::Tonemapper::ACES;
+    Heatmap::Metric m_ResolvedHeatmap = Heatmap::Metric::None;
 
     bool ShouldReflect(const Material& material, uint32_t& seed);
     float CalculateFresnel(float cosTheta, float ior);
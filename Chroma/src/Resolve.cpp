@@ -0,0 +1,100 @@
+#include "Resolve.h"
+#include "ISA.h"
+
+#include <cmath>
+
+namespace Resolve {
+
+    namespace {
+
+        using namespace Constants;
+
+        // Linear [0, 1] -> 8-bit sRGB, indexed by the quantized linear value
+        struct SRGBTable
+        {
+            uint8_t Values[LUTSize + 3]; // Padded for the 32-bit gathers of the wide kernels
+
+            SRGBTable()
+            {
+                for (uint32_t i = 0; i < LUTSize; i++)
+                {
+                    float linear = (float)i / LUTScale;
+                    float encoded = linear <= 0.0031308f
+                        ? linear * 12.92f
+                        : 1.055f * std::pow(linear, 1.0f / 2.4f) - 0.055f;
+                    Values[i] = (uint8_t)(encoded * 255.0f + 0.5f);
+                }
+                Values[LUTSize] = Values[LUTSize + 1] = Values[LUTSize + 2] = 0;
+            }
+        };
+
+        const uint8_t* GetSRGBTable()
+        {
+            static const SRGBTable table;
+            return table.Values;
+        }
+
+        inline float TonemapChannel(float x, Tonemapper tonemap)
+        {
+            // Written so that NaN ends up as 0, same as _mm_max_ps
+            x = x > 0.0f ? x : 0.0f;
+            x = x < MaxRadiance ? x : MaxRadiance;
+
+            switch (tonemap)
+            {
+                case Tonemapper::Reinhard:
+                    x = x / (1.0f + x);
+                    break;
+                case Tonemapper::ACES:
+                    x = (x * (ACES_A * x + ACES_B)) / (x * (ACES_C * x + ACES_D) + ACES_E);
+                    break;
+                default:
+                    break;
+            }
+
+            return x < 1.0f ? x : 1.0f;
+        }
+
+        inline uint32_t EncodeChannel(float x, const uint8_t* lut)
+        {
+            return lut[(uint32_t)(x * LUTScale + 0.5f)];
+        }
+
+    }
+
+    Params MakeParams(uint32_t sampleCount, float exposure, Tonemapper tonemap)
+    {
+        Params params;
+        params.Scale = std::exp2(exposure) / (float)(sampleCount > 0 ? sampleCount : 1);
+        params.Tonemap = tonemap;
+        return params;
+    }
+
+    uint32_t ResolvePixel(const glm::vec4& accumulated, const Params& params)
+    {
+        const uint8_t* lut = GetSRGBTable();
+
+        uint32_t r = EncodeChannel(TonemapChannel(accumulated.r * params.Scale, params.Tonemap), lut);
+        uint32_t g = EncodeChannel(TonemapChannel(accumulated.g * params.Scale, params.Tonemap), lut);
+        uint32_t b = EncodeChannel(TonemapChannel(accumulated.b * params.Scale, params.Tonemap), lut);
+
+        return 0xff000000 | (b << 16) | (g << 8) | r;
+    }
+
+    glm::vec3 Tonemap(const glm::vec3& color, const Params& params)
+    {
+        return glm::vec3(
+            TonemapChannel(color.r * params.Scale, params.Tonemap),
+            TonemapChannel(color.g * params.Scale, params.Tonemap),
+            TonemapChannel(color.b * params.Scale, params.Tonemap));
+    }
+
+    void ResolveSpan(const glm::vec4* accumulation, uint32_t* output, uint32_t count, const Params& params)
+    {
+        uint32_t i = ISA::GetKernels().ResolveSpan(accumulation, output, count, params.Scale, params.Tonemap, GetSRGBTable());
+
+        for (; i < count; i++)
+            output[i] = ResolvePixel(accumulation[i], params);
+    }
+
+}
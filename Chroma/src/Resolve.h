@@ -0,0 +1,52 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cstdint>
+
+namespace Resolve {
+
+    enum class Tonemapper
+    {
+        None = 0,
+        Reinhard = 1,
+        ACES = 2
+    };
+
+    // Shared with the resolve kernels of every ISA level, see ISA.h
+    namespace Constants {
+
+        // Entries of the sRGB table, indexed by the quantized linear value
+        constexpr uint32_t LUTSize = 4096;
+        constexpr float LUTScale = (float)(LUTSize - 1);
+
+        // Narkowicz's fit of the ACES filmic curve
+        constexpr float ACES_A = 2.51f;
+        constexpr float ACES_B = 0.03f;
+        constexpr float ACES_C = 2.43f;
+        constexpr float ACES_D = 0.59f;
+        constexpr float ACES_E = 0.14f;
+
+        // Upper bound applied before tonemapping, keeps inf / huge values from turning into NaN
+        constexpr float MaxRadiance = 65504.0f;
+
+    }
+
+    struct Params
+    {
+        float Scale = 1.0f;     // 1 / sample count, premultiplied by exposure
+        Tonemapper Tonemap = Tonemapper::ACES;
+    };
+
+    // Builds the parameters for a given accumulated sample count and exposure (in stops)
+    Params MakeParams(uint32_t sampleCount, float exposure, Tonemapper tonemap);
+
+    // Resolves a run of accumulated linear colors into packed, sRGB encoded RGBA8.
+    // Whole vectors go through the kernel of the active ISA level, the remainder one pixel at a time.
+    void ResolveSpan(const glm::vec4* accumulation, uint32_t* output, uint32_t count, const Params& params);
+
+    // Scalar reference for a single pixel, matches ResolveSpan bit for bit
+    uint32_t ResolvePixel(const glm::vec4& accumulated, const Params& params);
+
+    // Scaled and tonemapped color in [0, 1] before sRGB encoding, for image comparisons
+    glm::vec3 Tonemap(const glm::vec3& color, const Params& params);
+}
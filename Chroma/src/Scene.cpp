@@ -0,0 +1,329 @@
+#include "Scene.h"
+#include "Serialize.h"
+#include "Utils.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+
+namespace {
+
+    constexpr char SceneFileMagic[8] = { 'C', 'H', 'R', 'O', 'M', 'A', 'S', 'C' };
+    constexpr uint32_t SceneFileVersion = 2;
+
+    // Version 1 files know neither texture paths nor the texture fields at the end of a material
+    constexpr size_t MaterialSizeV1 = 15 * sizeof(float);
+    constexpr size_t MaterialSizeV2 = MaterialSizeV1 + 4 * sizeof(int32_t);
+
+    uint64_t NextSceneID()
+    {
+        static std::atomic<uint64_t> nextID{ 1 };
+        return nextID.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Field by field, the shapes carry a vtable pointer and maybe padding
+    template<typename T>
+    void HashValue(uint64_t& hash, const T& value)
+    {
+        hash = Utils::HashBytes(&value, sizeof(T), hash);
+    }
+
+}
+
+SceneJournal::SceneJournal()
+    : m_SceneID(NextSceneID())
+{
+}
+
+SceneJournal::SceneJournal(const SceneJournal& other)
+{
+    *this = other;
+}
+
+SceneJournal& SceneJournal::operator=(const SceneJournal& other)
+{
+    if (this == &other)
+        return *this;
+
+    // The contents were replaced wholesale, consumers of this scene have to start from scratch
+    m_SceneID = NextSceneID();
+    m_Version = other.m_Version;
+    m_FirstKnownVersion = other.m_FirstKnownVersion;
+    m_Changes = other.m_Changes;
+    return *this;
+}
+
+void SceneJournal::Record(ChangeKind kind, ObjectType object, uint32_t index, uint32_t count)
+{
+    m_Version++;
+
+    // Dragging a slider edits the same object every frame, one entry is enough. Adding and removing
+    // are not idempotent and always get their own entry.
+    if (!m_Changes.empty() && kind != ChangeKind::Add && kind != ChangeKind::Remove)
+    {
+        SceneChange& last = m_Changes.back();
+        if (last.Kind == kind && last.Object == object && last.Index == index && last.Count == count)
+        {
+            last.Version = m_Version;
+            return;
+        }
+    }
+
+    m_Changes.push_back({ m_Version, kind, object, index, count });
+    if (m_Changes.size() > Capacity)
+    {
+        m_FirstKnownVersion = m_Changes.front().Version;
+        m_Changes.pop_front();
+    }
+}
+
+uint64_t GetContentHash(const Scene& scene)
+{
+    uint64_t hash = Utils::HashBytes(nullptr, 0);
+    for (const Sphere& sphere : scene.Spheres)
+    {
+        HashValue(hash, sphere.Position);
+        HashValue(hash, sphere.Radius);
+        HashValue(hash, sphere.MaterialIndex);
+    }
+    HashValue(hash, scene.Spheres.size());
+    for (const Plane& plane : scene.Planes)
+    {
+        HashValue(hash, plane.Normal);
+        HashValue(hash, plane.Distance);
+        HashValue(hash, plane.MaterialIndex);
+    }
+    HashValue(hash, scene.Planes.size());
+    for (const Box& box : scene.Boxes)
+    {
+        HashValue(hash, box.Min);
+        HashValue(hash, box.Max);
+        HashValue(hash, box.MaterialIndex);
+    }
+    HashValue(hash, scene.Boxes.size());
+    for (const Triangle& triangle : scene.Triangles)
+    {
+        for (const glm::vec3* vertex : { &triangle.v0, &triangle.v1, &triangle.v2, &triangle.n0, &triangle.n1, &triangle.n2 })
+            HashValue(hash, *vertex);
+        HashValue(hash, triangle.MaterialIndex);
+    }
+    HashValue(hash, scene.Triangles.size());
+    for (const Material& material : scene.Materials)
+    {
+        HashValue(hash, material.Albedo);
+        HashValue(hash, material.Roughness);
+        HashValue(hash, material.Metallic);
+        HashValue(hash, material.EmissionColor);
+        HashValue(hash, material.EmissionPower);
+        HashValue(hash, material.ReflectionStrength);
+        HashValue(hash, material.ReflectionTint);
+        HashValue(hash, material.Transparency);
+        HashValue(hash, material.IndexOfRefraction);
+        HashValue(hash, material.AlbedoTexture);
+        HashValue(hash, material.RoughnessTexture);
+        HashValue(hash, material.NormalTexture);
+        HashValue(hash, material.TextureScale);
+    }
+    HashValue(hash, scene.Materials.size());
+    for (const std::string& texture : scene.Textures)
+        hash = Utils::HashBytes(texture.data(), texture.size() + 1, hash);
+    HashValue(hash, scene.Textures.size());
+    return hash;
+}
+
+// Field by field, the file does not change with the layout of the struct
+static void WriteMaterial(ByteWriter& writer, const Material& material)
+{
+    writer.Write(material.Albedo);
+    writer.Write(material.Roughness);
+    writer.Write(material.Metallic);
+    writer.Write(material.EmissionColor);
+    writer.Write(material.EmissionPower);
+    writer.Write(material.ReflectionStrength);
+    writer.Write(material.ReflectionTint);
+    writer.Write(material.Transparency);
+    writer.Write(material.IndexOfRefraction);
+    writer.Write((int32_t)material.AlbedoTexture);
+    writer.Write((int32_t)material.RoughnessTexture);
+    writer.Write((int32_t)material.NormalTexture);
+    writer.Write(material.TextureScale);
+}
+
+static void ReadMaterial(ByteReader& reader, Material& material, uint32_t version)
+{
+    reader.Read(material.Albedo);
+    reader.Read(material.Roughness);
+    reader.Read(material.Metallic);
+    reader.Read(material.EmissionColor);
+    reader.Read(material.EmissionPower);
+    reader.Read(material.ReflectionStrength);
+    reader.Read(material.ReflectionTint);
+    reader.Read(material.Transparency);
+    reader.Read(material.IndexOfRefraction);
+    if (version < 2)
+        return;
+
+    int32_t albedoTexture = -1, roughnessTexture = -1, normalTexture = -1;
+    reader.Read(albedoTexture);
+    reader.Read(roughnessTexture);
+    reader.Read(normalTexture);
+    reader.Read(material.TextureScale);
+    material.AlbedoTexture = albedoTexture;
+    material.RoughnessTexture = roughnessTexture;
+    material.NormalTexture = normalTexture;
+}
+
+void WriteScene(const Scene& scene, std::vector<uint8_t>& data)
+{
+    ByteWriter writer(data);
+    writer.Write((uint32_t)scene.Spheres.size());
+    for (const Sphere& sphere : scene.Spheres)
+    {
+        writer.Write(sphere.Position);
+        writer.Write(sphere.Radius);
+        writer.Write(sphere.MaterialIndex);
+    }
+    writer.Write((uint32_t)scene.Planes.size());
+    for (const Plane& plane : scene.Planes)
+    {
+        writer.Write(plane.Normal);
+        writer.Write(plane.Distance);
+        writer.Write(plane.MaterialIndex);
+    }
+    writer.Write((uint32_t)scene.Boxes.size());
+    for (const Box& box : scene.Boxes)
+    {
+        writer.Write(box.Min);
+        writer.Write(box.Max);
+        writer.Write(box.MaterialIndex);
+    }
+    writer.Write((uint32_t)scene.Triangles.size());
+    for (const Triangle& triangle : scene.Triangles)
+    {
+        for (const glm::vec3* vertex : { &triangle.v0, &triangle.v1, &triangle.v2, &triangle.n0, &triangle.n1, &triangle.n2 })
+            writer.Write(*vertex);
+        writer.Write(triangle.MaterialIndex);
+    }
+    writer.Write((uint32_t)scene.Materials.size());
+    for (const Material& material : scene.Materials)
+        WriteMaterial(writer, material);
+    writer.Write((uint32_t)scene.Textures.size());
+    for (const std::string& texture : scene.Textures)
+    {
+        writer.Write((uint32_t)texture.size());
+        writer.WriteBytes(texture.data(), texture.size());
+    }
+}
+
+static bool ReadSceneVersion(const uint8_t* data, size_t size, Scene& scene, uint32_t version)
+{
+    ByteReader reader(data, size);
+    scene = Scene();
+
+    // Counts are checked against the bytes left before anything is allocated
+    uint32_t count = 0;
+    auto readCount = [&](size_t minimumSize)
+    {
+        return reader.Read(count) && (size_t)count * minimumSize <= reader.GetRemaining();
+    };
+
+    if (!readCount(sizeof(glm::vec3)))
+        return false;
+    scene.Spheres.resize(count);
+    for (Sphere& sphere : scene.Spheres)
+    {
+        reader.Read(sphere.Position);
+        reader.Read(sphere.Radius);
+        reader.Read(sphere.MaterialIndex);
+    }
+    if (!readCount(sizeof(glm::vec3)))
+        return false;
+    scene.Planes.resize(count);
+    for (Plane& plane : scene.Planes)
+    {
+        reader.Read(plane.Normal);
+        reader.Read(plane.Distance);
+        reader.Read(plane.MaterialIndex);
+    }
+    if (!readCount(sizeof(glm::vec3)))
+        return false;
+    scene.Boxes.resize(count);
+    for (Box& box : scene.Boxes)
+    {
+        reader.Read(box.Min);
+        reader.Read(box.Max);
+        reader.Read(box.MaterialIndex);
+    }
+    if (!readCount(sizeof(glm::vec3)))
+        return false;
+    scene.Triangles.resize(count);
+    for (Triangle& triangle : scene.Triangles)
+    {
+        for (glm::vec3* vertex : { &triangle.v0, &triangle.v1, &triangle.v2, &triangle.n0, &triangle.n1, &triangle.n2 })
+            reader.Read(*vertex);
+        reader.Read(triangle.MaterialIndex);
+    }
+    if (!readCount(version >= 2 ? MaterialSizeV2 : MaterialSizeV1))
+        return false;
+    scene.Materials.resize(count);
+    for (Material& material : scene.Materials)
+        ReadMaterial(reader, material, version);
+
+    if (version >= 2)
+    {
+        if (!readCount(sizeof(uint32_t)))
+            return false;
+        scene.Textures.resize(count);
+        for (std::string& texture : scene.Textures)
+        {
+            uint32_t length = 0;
+            if (!reader.Read(length) || length > reader.GetRemaining())
+                return false;
+            texture.resize(length);
+            reader.ReadBytes(texture.data(), length);
+        }
+    }
+
+    return !reader.HasFailed() && reader.GetRemaining() == 0;
+}
+
+bool ReadScene(const uint8_t* data, size_t size, Scene& scene)
+{
+    return ReadSceneVersion(data, size, scene, SceneFileVersion);
+}
+
+bool SaveScene(const Scene& scene, const std::string& path)
+{
+    std::vector<uint8_t> data;
+    ByteWriter writer(data);
+    writer.WriteBytes(SceneFileMagic, sizeof(SceneFileMagic));
+    writer.Write(SceneFileVersion);
+    WriteScene(scene, data);
+
+    FILE* file = fopen(path.c_str(), "wb");
+    if (!file)
+        return false;
+    const bool written = fwrite(data.data(), 1, data.size(), file) == data.size();
+    return fclose(file) == 0 && written;
+}
+
+bool LoadScene(const std::string& path, Scene& scene)
+{
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file)
+        return false;
+
+    std::vector<uint8_t> data;
+    uint8_t buffer[1 << 16];
+    size_t read;
+    while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+        data.insert(data.end(), buffer, buffer + read);
+    fclose(file);
+
+    constexpr size_t HeaderSize = sizeof(SceneFileMagic) + sizeof(SceneFileVersion);
+    uint32_t version = 0;
+    if (data.size() < HeaderSize || memcmp(data.data(), SceneFileMagic, sizeof(SceneFileMagic)) != 0)
+        return false;
+    memcpy(&version, data.data() + sizeof(SceneFileMagic), sizeof(version));
+    return version >= 1 && version <= SceneFileVersion && ReadSceneVersion(data.data() + HeaderSize, data.size() - HeaderSize, scene, version);
+}
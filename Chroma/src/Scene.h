@@ -1,6 +1,10 @@
 #pragma once
 
 #include <glm/glm.hpp>
+#include <cstdint>
+#include <deque>
+#include <iterator>
+#include <string>
 #include <vector>
 
 struct Material
@@ -17,7 +21,16 @@ struct Material
     float Transparency = 0.0f;         // 0.0 = opaque, 1.0 = fully transparent
     float IndexOfRefraction = 1.5f;    // 1.0 = air, 1.33 = water, 1.5 = glass, 2.4 = diamond
 
+    // Indices into Scene::Textures, -1 for none. The albedo map multiplies Albedo and the red channel
+    // of the roughness map Roughness, the normal map bends the shading normal. Spheres wrap the
+    // textures around once, the other shapes repeat them every TextureScale units along their faces.
+    int AlbedoTexture = -1;
+    int RoughnessTexture = -1;
+    int NormalTexture = -1;
+    float TextureScale = 1.0f;
+
     glm::vec3 GetEmission() const { return EmissionColor * EmissionPower; }
+    bool HasTextures() const { return AlbedoTexture >= 0 || RoughnessTexture >= 0 || NormalTexture >= 0; }
 };
 
 // Base shape interface
@@ -84,6 +97,86 @@ enum class ShapeType
     Triangle = 3
 };
 
+// Everything the scene journal tracks, the shapes share their ShapeType values
+enum class ObjectType : uint8_t
+{
+    Sphere = 0,
+    Plane = 1,
+    Box = 2,
+    Triangle = 3,
+    Material = 4,
+    Texture = 5     // A path in Scene::Textures
+};
+
+// What an edit changed. Consumers only react to the kinds they depend on, the BVH for example
+// ignores material edits and refits instead of rebuilding when shapes only moved.
+enum class ChangeKind : uint8_t
+{
+    Material,  // Parameters of a material, the material a shape uses, or the image behind a texture path
+    Transform, // A shape moved, its form stayed the same
+    Geometry,  // The form or size of a shape
+    Add,
+    Remove     // Objects after the removed ones move down by Count
+};
+
+struct SceneChange
+{
+    uint64_t Version;  // Version of the scene once the change was made
+    ChangeKind Kind;
+    ObjectType Object;
+    uint32_t Index;    // First object changed
+    uint32_t Count;    // Consecutive objects, adding a pyramid adds six triangles at once
+};
+
+// Versioned record of the edits made to a scene. Every edit bumps the version, consumers remember
+// the version they last saw and only look at what changed since. A scene filled before anyone
+// consumed it needs no entries, a consumer that has not seen a scene yet always starts from scratch.
+class SceneJournal
+{
+public:
+    // Older changes are dropped, consumers that fell further behind start from scratch
+    static constexpr size_t Capacity = 256;
+
+    SceneJournal();
+    // A copy is a different scene to every consumer
+    SceneJournal(const SceneJournal& other);
+    SceneJournal& operator=(const SceneJournal& other);
+
+    void Record(ChangeKind kind, ObjectType object, uint32_t index, uint32_t count = 1);
+
+    // Unique per scene object, versions of different scenes can not be compared
+    uint64_t GetSceneID() const { return m_SceneID; }
+    uint64_t GetVersion() const { return m_Version; }
+
+    // Calls func(change) for every change made after version, oldest first. Returns false when they
+    // are not all known any more, the caller then has to assume that everything changed.
+    template<typename Func>
+    bool ForEachChangeSince(uint64_t version, Func&& func) const;
+private:
+    uint64_t m_SceneID;
+    uint64_t m_Version = 0;
+    uint64_t m_FirstKnownVersion = 0; // Every change after it is in m_Changes
+    std::deque<SceneChange> m_Changes;
+};
+
+template<typename Func>
+bool SceneJournal::ForEachChangeSince(uint64_t version, Func&& func) const
+{
+    if (version < m_FirstKnownVersion)
+        return false;
+
+    // Changes are ordered by version, only the newest ones are of interest
+    auto first = m_Changes.end();
+    while (first != m_Changes.begin() && std::prev(first)->Version > version)
+        --first;
+
+    for (auto it = first; it != m_Changes.end(); ++it)
+        func(*it);
+    return true;
+}
+
+// Shapes and materials are edited in place. Edits of a scene that is being rendered have to be
+// recorded in the journal, that is how the renderer finds out what to update.
 struct Scene
 {
     std::vector<Sphere> Spheres;
@@ -91,4 +184,21 @@ struct Scene
     std::vector<Box> Boxes;
     std::vector<Triangle> Triangles;
     std::vector<Material> Materials;
-};
\ No newline at end of file
+    // Image files, loaded by the renderer when a material uses them. Pointing a material at one is a
+    // material change, adding or replacing a path is a change of the texture.
+    std::vector<std::string> Textures;
+
+    SceneJournal Journal;
+};
+
+// Hash of every shape, material and texture path, equal for scenes with the same content whatever their journal
+uint64_t GetContentHash(const Scene& scene);
+
+// Shapes, materials and texture paths as bytes, for other processes of the same build. A scene read back has a
+// fresh journal.
+void WriteScene(const Scene& scene, std::vector<uint8_t>& data);
+bool ReadScene(const uint8_t* data, size_t size, Scene& scene);
+
+// Scene files hold a short header and the WriteScene() data
+bool SaveScene(const Scene& scene, const std::string& path);
+bool LoadScene(const std::string& path, Scene& scene);
\ No newline at end of file
@@ -0,0 +1,108 @@
+#include "SceneCache.h"
+#include "Utils.h"
+
+#include "Walnut/Timer.h"
+
+namespace {
+
+    size_t GetSceneSize(const Scene& scene)
+    {
+        return scene.Spheres.capacity() * sizeof(Sphere) + scene.Planes.capacity() * sizeof(Plane) +
+            scene.Boxes.capacity() * sizeof(Box) + scene.Triangles.capacity() * sizeof(Triangle) +
+            scene.Materials.capacity() * sizeof(Material) + scene.Textures.capacity() * sizeof(std::string);
+    }
+
+    // Size and time of each texture file, a missing one counts as well
+    uint64_t GetTextureHash(const std::vector<std::string>& textures)
+    {
+        uint64_t hash = Utils::HashBytes(nullptr, 0);
+        for (const std::string& texture : textures)
+        {
+            std::error_code error;
+            const uintmax_t size = std::filesystem::file_size(texture, error);
+            const auto time = error ? std::filesystem::file_time_type() : std::filesystem::last_write_time(texture, error);
+            const int64_t ticks = error ? -1 : (int64_t)time.time_since_epoch().count();
+            hash = Utils::HashBytes(texture.data(), texture.size() + 1, hash);
+            hash = Utils::HashBytes(&size, sizeof(size), hash);
+            hash = Utils::HashBytes(&ticks, sizeof(ticks), hash);
+        }
+        return hash;
+    }
+
+}
+
+SceneCache::Entry* SceneCache::Acquire(const std::string& path, bool& hit)
+{
+    WL_PROFILE_ZONE("SceneCache::Acquire");
+    hit = false;
+
+    std::error_code error;
+    const uintmax_t fileSize = std::filesystem::file_size(path, error);
+    if (error)
+        return nullptr;
+    const std::filesystem::file_time_type fileTime = std::filesystem::last_write_time(path, error);
+    if (error)
+        return nullptr;
+
+    // A file seen before with the same size and time, and whose textures did not change either, is
+    // taken to hold the same scene
+    auto found = m_Index.end();
+    auto file = m_Files.find(path);
+    if (file != m_Files.end() && file->second.Size == fileSize && file->second.Time == fileTime &&
+        file->second.TextureHash == GetTextureHash(file->second.Textures))
+        found = m_Index.find(file->second.Hash);
+
+    Scene scene;
+    if (found == m_Index.end())
+    {
+        if (!LoadScene(path, scene))
+            return nullptr;
+        // The renderer of an entry keeps its textures loaded, an edited texture needs a new entry
+        const uint64_t textureHash = GetTextureHash(scene.Textures);
+        const uint64_t hash = Utils::HashBytes(&textureHash, sizeof(textureHash), GetContentHash(scene));
+        m_Files[path] = { fileSize, fileTime, hash, scene.Textures, textureHash };
+        found = m_Index.find(hash);
+    }
+
+    if (found != m_Index.end())
+    {
+        hit = true;
+        m_Entries.splice(m_Entries.begin(), m_Entries, found->second);
+        return &m_Entries.front();
+    }
+
+    Entry& entry = m_Entries.emplace_front();
+    entry.Hash = m_Files[path].Hash;
+    entry.SceneData = std::move(scene);
+    entry.SceneRenderer = std::make_unique<Renderer>(true);
+    m_Index[entry.Hash] = m_Entries.begin();
+    Update(entry);
+    return &entry;
+}
+
+void SceneCache::Update(Entry& entry)
+{
+    m_Size -= entry.Size;
+    entry.Size = GetSceneSize(entry.SceneData) + entry.SceneRenderer->GetBVH().GetMemorySize() +
+        entry.SceneRenderer->GetAccumulationMemory() +
+        (size_t)entry.SceneRenderer->GetTextureCache().GetStats().ResidentTiles * Texture::TileBytes;
+    m_Size += entry.Size;
+    Evict(entry);
+}
+
+void SceneCache::Evict(const Entry& keep)
+{
+    // The entry in use stays, even if it alone is over the budget
+    while (m_Size > m_Capacity && m_Entries.size() > 1)
+    {
+        auto last = std::prev(m_Entries.end());
+        if (&*last == &keep)
+            last = std::prev(last);
+
+        m_Size -= last->Size;
+        m_Index.erase(last->Hash);
+        for (auto file = m_Files.begin(); file != m_Files.end();)
+            file = file->second.Hash == last->Hash ? m_Files.erase(file) : std::next(file);
+        m_Entries.erase(last);
+    }
+}
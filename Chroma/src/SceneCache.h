@@ -0,0 +1,59 @@
+#pragma once
+
+#include "Renderer.h"
+#include "Scene.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Scene files loaded into memory together with a renderer that has built their BVH. Entries are keyed
+// by the content hash of the scene and the size and time of the texture files it references, the same
+// scene under another path shares one, and the least recently used go once the cache is over its
+// memory budget. A file that has not changed since it was last loaded is not read again, so a hit
+// skips both the load and the build.
+class SceneCache
+{
+public:
+    struct Entry
+    {
+        uint64_t Hash;
+        Scene SceneData;
+        std::unique_ptr<Renderer> SceneRenderer;  // Headless, its BVH is built for SceneData
+        size_t Size = 0;
+    };
+
+    explicit SceneCache(size_t capacity) : m_Capacity(capacity) {}
+
+    // The entry of the scene in the file, loaded on a miss. nullptr if the file can not be loaded.
+    // Entries stay valid until the next call.
+    Entry* Acquire(const std::string& path, bool& hit);
+    // Counts what the entry's renderer allocated since and evicts the least recently used others
+    // until the cache fits
+    void Update(Entry& entry);
+
+    size_t GetSize() const { return m_Size; }
+    size_t GetCapacity() const { return m_Capacity; }
+    uint32_t GetEntryCount() const { return (uint32_t)m_Entries.size(); }
+private:
+    struct FileStamp
+    {
+        uintmax_t Size;
+        std::filesystem::file_time_type Time;
+        uint64_t Hash;
+        std::vector<std::string> Textures;  // Checked again on every acquire, they can change on their own
+        uint64_t TextureHash;
+    };
+
+    void Evict(const Entry& keep);
+private:
+    size_t m_Capacity;
+    size_t m_Size = 0;
+    std::list<Entry> m_Entries;  // Most recently used first
+    std::unordered_map<uint64_t, std::list<Entry>::iterator> m_Index;
+    std::unordered_map<std::string, FileStamp> m_Files;  // Only of files whose entry is still cached
+};
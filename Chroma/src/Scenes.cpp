@@ -0,0 +1,377 @@
+#include "Scenes.h"
+#include "ImageFile.h"
+#include "Shapes.h"
+#include "Utils.h"
+
+#include <glm/gtc/constants.hpp>
+
+#include <algorithm>
+#include <filesystem>
+#include <functional>
+#include <vector>
+
+namespace {
+
+    constexpr uint32_t TilesPerSide = 8;
+
+    // Fills an image row by row from the top, as a file holds it, and writes it unless it exists
+    bool WriteTexture(const std::string& path, uint32_t size, const std::function<glm::vec3(uint32_t x, uint32_t y)>& texel)
+    {
+        std::error_code error;
+        if (std::filesystem::exists(path, error))
+            return true;
+
+        // WritePNG() takes rows bottom to top like the renderer makes them
+        std::vector<uint32_t> pixels((size_t)size * size);
+        for (uint32_t y = 0; y < size; y++)
+        {
+            for (uint32_t x = 0; x < size; x++)
+                pixels[(size_t)(size - 1 - y) * size + x] = Utils::ConvertToRGBA(glm::vec4(glm::clamp(texel(x, y), 0.0f, 1.0f), 1.0f));
+        }
+        return ImageFile::WritePNG(path, size, size, pixels.data());
+    }
+
+    // 1 on a tile, falling to 0 in the mortar between them
+    float GetTileHeight(int32_t x, int32_t y, uint32_t size)
+    {
+        const float tileSize = (float)size / TilesPerSide;
+        const float u = std::fmod((float)((x + size) % size) + 0.5f, tileSize) / tileSize;
+        const float v = std::fmod((float)((y + size) % size) + 0.5f, tileSize) / tileSize;
+        const float edge = std::min(std::min(u, 1.0f - u), std::min(v, 1.0f - v));
+        return glm::smoothstep(0.02f, 0.06f, edge);
+    }
+
+    float GetTileRandom(uint32_t x, uint32_t y, uint32_t size, uint32_t salt)
+    {
+        const uint32_t tile = (y * TilesPerSide / size) * TilesPerSide + x * TilesPerSide / size;
+        return (float)Utils::PCG_Hash(tile * 7919u + salt) / (float)std::numeric_limits<uint32_t>::max();
+    }
+
+}
+
+namespace Scenes {
+
+    CameraView CreateDefault(Scene& scene)
+    {
+        // Floor material
+        Material& floorMaterial = scene.Materials.emplace_back();
+        floorMaterial.Albedo = { 0.9f, 0.9f, 0.9f };     // White
+        floorMaterial.Roughness = 0.8f;
+        floorMaterial.Metallic = 0.0f;
+        floorMaterial.ReflectionStrength = 0.05f;
+
+        // Glass material
+        Material& glassMaterial = scene.Materials.emplace_back();
+        glassMaterial.Albedo = { 0.9f, 0.9f, 1.0f };     // Very slight blue tint
+        glassMaterial.Roughness = 0.0f;                  // Perfectly smooth
+        glassMaterial.Metallic = 0.0f;
+        glassMaterial.ReflectionStrength = 0.3f;
+        glassMaterial.ReflectionTint = { 0.95f, 0.95f, 1.0f };
+        glassMaterial.Transparency = 0.95f;              // High transparency
+        glassMaterial.IndexOfRefraction = 1.52f;         // Glass IOR
+
+        // Red box material
+        Material& redMaterial = scene.Materials.emplace_back();
+        redMaterial.Albedo = { 0.9f, 0.1f, 0.1f };       // Red
+        redMaterial.Roughness = 0.1f;                    // Smooth
+        redMaterial.Metallic = 1.0f;
+        redMaterial.ReflectionStrength = 0.8f;
+
+        // Green box material
+        Material& greenMaterial = scene.Materials.emplace_back();
+        greenMaterial.Albedo = { 0.1f, 0.9f, 0.1f };     // Green
+        greenMaterial.Roughness = 0.4f;                  // Moderate roughness
+        greenMaterial.Metallic = 0.0f;
+        greenMaterial.ReflectionStrength = 0.2f;
+
+        // Light source material
+        Material& lightMaterial = scene.Materials.emplace_back();
+        lightMaterial.EmissionColor = { 1.0f, 0.9f, 0.7f }; // Warm white
+        lightMaterial.EmissionPower = 25.0f;                // Bright light
+
+        // Add a plane as a floor
+        Shapes::AddPlane(scene, glm::vec3(0.0f, 1.0f, 0.0f), 0.0f, 0);
+
+        // Add the glass sphere
+        Shapes::AddSphere(scene, glm::vec3(0.0f, 1.0f, 0.0f), 1.0f, 1);
+
+        // Add a red box
+        Shapes::AddCube(scene, glm::vec3(3.0f, 1.0f, 0.0f), 1.0f, 2);
+
+        // Add a green box
+        Shapes::AddCube(scene, glm::vec3(-3.0f, 0.5f, 0.0f), 1.0f, 3);
+
+        // Add a green pyramid
+        Shapes::AddPyramid(scene, glm::vec3(0.0f, 0.0f, -2.0f), 2.0f, 2.0f, 3);
+
+        // Add a light source
+        Shapes::AddSphere(scene, glm::vec3(0.0f, 5.0f, 0.0f), 0.5f, 4);
+
+        // Same as the Camera defaults
+        return { glm::vec3(0.0f, 0.0f, 6.0f), glm::vec3(0.0f, 0.0f, 5.0f) };
+    }
+
+    CameraView CreateCornellBox(Scene& scene)
+    {
+        Material& white = scene.Materials.emplace_back();
+        white.Albedo = { 0.73f, 0.73f, 0.73f };
+        white.ReflectionStrength = 0.0f;
+
+        Material& red = scene.Materials.emplace_back();
+        red.Albedo = { 0.65f, 0.05f, 0.05f };
+        red.ReflectionStrength = 0.0f;
+
+        Material& green = scene.Materials.emplace_back();
+        green.Albedo = { 0.12f, 0.45f, 0.15f };
+        green.ReflectionStrength = 0.0f;
+
+        Material& light = scene.Materials.emplace_back();
+        light.EmissionColor = { 1.0f, 0.85f, 0.6f };
+        light.EmissionPower = 15.0f;
+
+        // The room spans x = [-1, 1], y = [0, 2], z = [-1, ...], open towards the camera
+        Shapes::AddPlane(scene, glm::vec3(0.0f, 1.0f, 0.0f), 0.0f, 0);   // Floor
+        Shapes::AddPlane(scene, glm::vec3(0.0f, -1.0f, 0.0f), 2.0f, 0);  // Ceiling
+        Shapes::AddPlane(scene, glm::vec3(0.0f, 0.0f, 1.0f), 1.0f, 0);   // Back wall
+        Shapes::AddPlane(scene, glm::vec3(1.0f, 0.0f, 0.0f), 1.0f, 1);   // Left wall
+        Shapes::AddPlane(scene, glm::vec3(-1.0f, 0.0f, 0.0f), 1.0f, 2);  // Right wall
+
+        Box& tall = scene.Boxes.emplace_back();
+        tall.Min = { -0.7f, 0.0f, -0.6f };
+        tall.Max = { -0.1f, 1.2f, 0.0f };
+
+        Box& small = scene.Boxes.emplace_back();
+        small.Min = { 0.1f, 0.0f, -0.1f };
+        small.Max = { 0.7f, 0.6f, 0.5f };
+
+        Box& panel = scene.Boxes.emplace_back();
+        panel.Min = { -0.3f, 1.98f, -0.3f };
+        panel.Max = { 0.3f, 1.999f, 0.3f };
+        panel.MaterialIndex = 3;
+
+        return { glm::vec3(0.0f, 1.0f, 3.2f), glm::vec3(0.0f, 1.0f, 0.0f) };
+    }
+
+    CameraView CreateRandomSpheres(Scene& scene, uint32_t count, uint32_t seed)
+    {
+        Material& floor = scene.Materials.emplace_back();
+        floor.Albedo = { 0.5f, 0.5f, 0.5f };
+        floor.ReflectionStrength = 0.0f;
+
+        // A small palette of diffuse, metal and glass materials the spheres pick from
+        constexpr int PaletteSize = 8;
+        for (int i = 0; i < PaletteSize; i++)
+        {
+            Material& material = scene.Materials.emplace_back();
+            material.Albedo = glm::vec3(Utils::RandomFloat(seed), Utils::RandomFloat(seed), Utils::RandomFloat(seed)) * 0.8f + 0.1f;
+            material.Roughness = Utils::RandomFloat(seed);
+
+            if (i >= 4 && i < 6)
+            {
+                material.Metallic = 1.0f;
+                material.ReflectionStrength = 0.9f;
+            }
+            else if (i >= 6)
+            {
+                material.Transparency = 0.95f;
+                material.Roughness = 0.0f;
+                material.ReflectionStrength = 0.1f;
+            }
+        }
+
+        Shapes::AddPlane(scene, glm::vec3(0.0f, 1.0f, 0.0f), 0.0f, 0);
+
+        // Roughly 2.5 spheres per square unit, resting on the floor
+        const float halfExtent = glm::sqrt((float)count / 2.5f) * 0.5f;
+        scene.Spheres.reserve(scene.Spheres.size() + count);
+        for (uint32_t i = 0; i < count; i++)
+        {
+            float radius = 0.05f + Utils::RandomFloat(seed) * 0.2f;
+            float x = (Utils::RandomFloat(seed) * 2.0f - 1.0f) * halfExtent;
+            float z = (Utils::RandomFloat(seed) * 2.0f - 1.0f) * halfExtent;
+            int material = 1 + (int)(Utils::RandomFloat(seed) * (PaletteSize - 1) + 0.5f);
+            Shapes::AddSphere(scene, glm::vec3(x, radius, z), radius, material);
+        }
+
+        return { glm::vec3(0.0f, 6.0f, 40.0f), glm::vec3(0.0f, 0.0f, 0.0f) };
+    }
+
+    CameraView CreateTriangleMesh(Scene& scene, uint32_t triangleCount)
+    {
+        Material& floor = scene.Materials.emplace_back();
+        floor.Albedo = { 0.8f, 0.8f, 0.8f };
+        floor.ReflectionStrength = 0.0f;
+
+        Material& gold = scene.Materials.emplace_back();
+        gold.Albedo = { 1.0f, 0.78f, 0.34f };
+        gold.Roughness = 0.3f;
+        gold.Metallic = 1.0f;
+        gold.ReflectionStrength = 0.7f;
+
+        Material& light = scene.Materials.emplace_back();
+        light.EmissionColor = { 1.0f, 0.95f, 0.9f };
+        light.EmissionPower = 20.0f;
+
+        Shapes::AddPlane(scene, glm::vec3(0.0f, 1.0f, 0.0f), 0.0f, 0);
+        Shapes::AddSphere(scene, glm::vec3(-3.0f, 6.0f, 2.0f), 1.0f, 2);
+
+        // Two triangles per quad, the ring gets about 2.5 times the segments of the tube
+        const uint32_t quads = std::max(triangleCount / 2, 8u);
+        const uint32_t ringSegments = std::max((uint32_t)glm::sqrt((float)quads * 2.5f), 4u);
+        const uint32_t tubeSegments = std::max(quads / ringSegments, 2u);
+
+        constexpr float RingRadius = 2.0f;
+        constexpr float TubeRadius = 0.8f;
+        const glm::vec3 center(0.0f, TubeRadius * 1.1f + 0.1f, 0.0f);
+
+        auto vertex = [&](uint32_t ring, uint32_t tube)
+        {
+            float u = (float)ring / (float)ringSegments * glm::two_pi<float>();
+            float v = (float)tube / (float)tubeSegments * glm::two_pi<float>();
+            float r = TubeRadius * (1.0f + 0.05f * glm::sin(12.0f * u) * glm::sin(8.0f * v));
+            return center + glm::vec3(
+                (RingRadius + r * glm::cos(v)) * glm::cos(u),
+                r * glm::sin(v),
+                (RingRadius + r * glm::cos(v)) * glm::sin(u));
+        };
+
+        scene.Triangles.reserve(scene.Triangles.size() + (size_t)ringSegments * tubeSegments * 2);
+        for (uint32_t ring = 0; ring < ringSegments; ring++)
+        {
+            for (uint32_t tube = 0; tube < tubeSegments; tube++)
+            {
+                // Wrap around exactly so the seams share vertices
+                uint32_t nextRing = (ring + 1) % ringSegments;
+                uint32_t nextTube = (tube + 1) % tubeSegments;
+
+                glm::vec3 v00 = vertex(ring, tube);
+                glm::vec3 v10 = vertex(nextRing, tube);
+                glm::vec3 v01 = vertex(ring, nextTube);
+                glm::vec3 v11 = vertex(nextRing, nextTube);
+
+                Triangle& first = scene.Triangles.emplace_back(v00, v01, v11);
+                first.MaterialIndex = 1;
+                Triangle& second = scene.Triangles.emplace_back(v00, v11, v10);
+                second.MaterialIndex = 1;
+            }
+        }
+
+        return { glm::vec3(0.0f, 4.0f, 7.0f), glm::vec3(0.0f, 0.8f, 0.0f) };
+    }
+
+    CameraView CreateCaustics(Scene& scene)
+    {
+        Material& floor = scene.Materials.emplace_back();
+        floor.Albedo = { 0.9f, 0.9f, 0.9f };
+        floor.Roughness = 0.9f;
+        floor.ReflectionStrength = 0.0f;
+
+        auto addGlass = [&](const glm::vec3& tint, float ior)
+        {
+            Material& glass = scene.Materials.emplace_back();
+            glass.Albedo = tint;
+            glass.Roughness = 0.0f;
+            glass.ReflectionStrength = 0.05f;
+            glass.Transparency = 1.0f;
+            glass.IndexOfRefraction = ior;
+            return (int)scene.Materials.size() - 1;
+        };
+        int glass = addGlass({ 0.95f, 0.95f, 1.0f }, 1.5f);
+        int water = addGlass({ 0.8f, 0.95f, 1.0f }, 1.33f);
+        int diamond = addGlass({ 1.0f, 1.0f, 1.0f }, 2.4f);
+        int amber = addGlass({ 1.0f, 0.7f, 0.3f }, 1.55f);
+
+        Material& light = scene.Materials.emplace_back();
+        light.EmissionColor = { 1.0f, 0.95f, 0.85f };
+        light.EmissionPower = 60.0f;
+        int lightIndex = (int)scene.Materials.size() - 1;
+
+        Shapes::AddPlane(scene, glm::vec3(0.0f, 1.0f, 0.0f), 0.0f, 0);
+
+        Shapes::AddSphere(scene, glm::vec3(0.0f, 1.0f, 0.0f), 1.0f, glass);
+        Shapes::AddSphere(scene, glm::vec3(-2.2f, 0.6f, 0.8f), 0.6f, water);
+        Shapes::AddSphere(scene, glm::vec3(2.0f, 0.5f, 1.0f), 0.5f, diamond);
+        Shapes::AddCube(scene, glm::vec3(1.6f, 0.6f, -1.4f), 1.2f, amber);
+        Shapes::AddPyramid(scene, glm::vec3(-1.5f, 0.0f, -1.8f), 1.2f, 1.4f, glass);
+
+        // Small and bright so that the caustics are sharp and hard to converge
+        Shapes::AddSphere(scene, glm::vec3(2.0f, 6.0f, 1.0f), 0.3f, lightIndex);
+
+        return { glm::vec3(0.0f, 2.5f, 7.0f), glm::vec3(0.0f, 0.8f, 0.0f) };
+    }
+
+    CameraView CreateTextured(Scene& scene, const std::string& directory, uint32_t textureSize)
+    {
+        std::error_code error;
+        std::filesystem::create_directories(directory, error);
+        const uint32_t size = std::max(textureSize, TilesPerSide);
+        const std::string prefix = (std::filesystem::path(directory) / ("tiles-" + std::to_string(size))).string();
+
+        // Written as sRGB, the albedo maps are gamma encoded like any painted texture
+        auto encode = [](const glm::vec3& color) { return glm::pow(color, glm::vec3(1.0f / 2.2f)); };
+        WriteTexture(prefix + "-albedo.png", size, [&](uint32_t x, uint32_t y)
+            {
+                const glm::vec3 tile = glm::mix(glm::vec3(0.45f, 0.18f, 0.1f), glm::vec3(0.7f, 0.45f, 0.3f), GetTileRandom(x, y, size, 1));
+                const float grain = (float)(Utils::PCG_Hash(y * size + x) & 0xff) / 255.0f * 0.1f - 0.05f;
+                return encode(glm::mix(glm::vec3(0.55f, 0.55f, 0.5f), tile, GetTileHeight(x, y, size)) + grain);
+            });
+        WriteTexture(prefix + "-roughness.png", size, [&](uint32_t x, uint32_t y)
+            {
+                return glm::vec3(glm::mix(0.9f, 0.15f + 0.35f * GetTileRandom(x, y, size, 2), GetTileHeight(x, y, size)));
+            });
+        WriteTexture(prefix + "-normal.png", size, [&](uint32_t x, uint32_t y)
+            {
+                // Up in the image is the opposite way of the rows
+                const float strength = (float)size / TilesPerSide / 16.0f;
+                const float dx = GetTileHeight(x + 1, y, size) - GetTileHeight(x - 1, y, size);
+                const float dy = GetTileHeight(x, y + 1, size) - GetTileHeight(x, y - 1, size);
+                return glm::normalize(glm::vec3(-dx * strength, dy * strength, 1.0f)) * 0.5f + 0.5f;
+            });
+        WriteTexture(prefix + "-checker.png", size, [&](uint32_t x, uint32_t y)
+            {
+                const bool odd = ((x * 16 / size) + (y * 8 / size)) % 2 != 0;
+                return encode(odd ? glm::vec3(0.8f, 0.8f, 0.75f) : glm::vec3(0.1f, 0.25f, 0.6f));
+            });
+
+        scene.Textures = { prefix + "-albedo.png", prefix + "-roughness.png", prefix + "-normal.png", prefix + "-checker.png" };
+
+        Material& floor = scene.Materials.emplace_back();
+        floor.Metallic = 0.3f;
+        floor.ReflectionStrength = 0.6f;
+        floor.AlbedoTexture = 0;
+        floor.RoughnessTexture = 1;
+        floor.NormalTexture = 2;
+        floor.TextureScale = 4.0f;
+
+        Material& checker = scene.Materials.emplace_back();
+        checker.ReflectionStrength = 0.0f;
+        checker.AlbedoTexture = 3;
+
+        Material& metal = scene.Materials.emplace_back();
+        metal.Albedo = { 0.95f, 0.75f, 0.4f };
+        metal.Metallic = 1.0f;
+        metal.ReflectionStrength = 0.9f;
+        metal.RoughnessTexture = 1;
+
+        Material& crate = scene.Materials.emplace_back();
+        crate.ReflectionStrength = 0.0f;
+        crate.AlbedoTexture = 0;
+        crate.NormalTexture = 2;
+        crate.TextureScale = 1.0f;
+
+        Material& light = scene.Materials.emplace_back();
+        light.EmissionColor = { 1.0f, 0.9f, 0.75f };
+        light.EmissionPower = 30.0f;
+
+        Shapes::AddPlane(scene, glm::vec3(0.0f, 1.0f, 0.0f), 0.0f, 0);
+        Shapes::AddSphere(scene, glm::vec3(-1.6f, 1.0f, 0.0f), 1.0f, 1);
+        Shapes::AddSphere(scene, glm::vec3(1.4f, 0.8f, 0.6f), 0.8f, 2);
+        Shapes::AddCube(scene, glm::vec3(0.2f, 0.5f, -2.0f), 1.0f, 3);
+        Shapes::AddCube(scene, glm::vec3(3.5f, 0.75f, -3.0f), 1.5f, 3);
+        Shapes::AddSphere(scene, glm::vec3(-3.0f, 6.0f, 3.0f), 0.5f, 4);
+
+        // Low over the floor, which runs out to the horizon through every level of its textures
+        return { glm::vec3(0.0f, 1.6f, 6.0f), glm::vec3(0.0f, 0.6f, 0.0f) };
+    }
+
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "Scene.h"
+
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <string>
+
+// Procedurally generated scenes. The default one is what Chroma starts up with, the others are
+// reference scenes for ChromaBench that each stress a different part of the renderer.
+namespace Scenes {
+
+    // Where the camera should be placed to frame a scene
+    struct CameraView
+    {
+        glm::vec3 Position;
+        glm::vec3 Target;
+    };
+
+    // A floor, a glass sphere, two boxes, a pyramid and a light
+    CameraView CreateDefault(Scene& scene);
+
+    // Red and green side walls, two boxes and an emissive ceiling panel, lit almost entirely indirectly
+    CameraView CreateCornellBox(Scene& scene);
+
+    // Diffuse, metal and glass spheres scattered over a floor, lit by the sky
+    CameraView CreateRandomSpheres(Scene& scene, uint32_t count = 100000, uint32_t seed = 1);
+
+    // A rippled torus tessellated into roughly triangleCount triangles
+    CameraView CreateTriangleMesh(Scene& scene, uint32_t triangleCount = 1000000);
+
+    // Glass, water and diamond shapes under a small, bright light
+    CameraView CreateCaustics(Scene& scene);
+
+    // A tiled floor reaching to the horizon, and textured spheres and boxes. The tile albedo, roughness
+    // and normal maps and a checker map are generated into the directory unless they are there already.
+    CameraView CreateTextured(Scene& scene, const std::string& directory, uint32_t textureSize = 1024);
+}
@@ -0,0 +1,415 @@
+#include "Sequence.h"
+#include "Camera.h"
+#include "ImageFile.h"
+#include "ImageWriter.h"
+#include "Renderer.h"
+
+#include "Walnut/Timer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+
+namespace Sequence {
+
+    namespace {
+
+        // Keys are ordered by frame, the ones around the frame are blended
+        template<typename Key, typename LerpFunc>
+        Key Interpolate(const std::vector<Key>& keys, uint32_t frame, LerpFunc&& lerp)
+        {
+            if (frame <= keys.front().Frame)
+                return keys.front();
+            if (frame >= keys.back().Frame)
+                return keys.back();
+
+            auto next = std::upper_bound(keys.begin(), keys.end(), frame,
+                [](uint32_t value, const Key& key) { return value < key.Frame; });
+            const Key& a = *(next - 1);
+            const Key& b = *next;
+            Key key = lerp(a, b, (float)(frame - a.Frame) / (float)(b.Frame - a.Frame));
+            key.Frame = frame;
+            return key;
+        }
+
+        bool ParseObject(const char* name, ObjectType& object)
+        {
+            if (strcmp(name, "sphere") == 0)
+                object = ObjectType::Sphere;
+            else if (strcmp(name, "box") == 0)
+                object = ObjectType::Box;
+            else if (strcmp(name, "triangle") == 0)
+                object = ObjectType::Triangle;
+            else
+                return false;
+            return true;
+        }
+
+        size_t GetObjectCount(const Scene& scene, ObjectType object)
+        {
+            switch (object)
+            {
+                case ObjectType::Sphere: return scene.Spheres.size();
+                case ObjectType::Box: return scene.Boxes.size();
+                case ObjectType::Triangle: return scene.Triangles.size();
+                default: return 0;
+            }
+        }
+
+        glm::vec3 RotateY(const glm::vec3& v, float cosine, float sine)
+        {
+            return glm::vec3(cosine * v.x + sine * v.z, v.y, -sine * v.x + cosine * v.z);
+        }
+
+    }
+
+    bool Load(const std::string& path, Description& description, std::string& error)
+    {
+        FILE* file = fopen(path.c_str(), "r");
+        if (!file)
+        {
+            error = "Can not open " + path;
+            return false;
+        }
+
+        description = Description();
+        char line[512];
+        uint32_t lineNumber = 0;
+        bool valid = true;
+        while (valid && fgets(line, sizeof(line), file))
+        {
+            lineNumber++;
+            if (char* comment = strchr(line, '#'))
+                *comment = '\0';
+
+            char word[32] = {}, name[32] = {};
+            if (sscanf(line, "%31s", word) != 1)
+                continue;
+
+            uint32_t frame = 0, index = 0, count = 1;
+            glm::vec3 a(0.0f), b(0.0f);
+            float extra[3] = { 0.0f, 0.0f, 1.0f };
+            if (strcmp(word, "frames") == 0)
+            {
+                valid = sscanf(line, "%*s %u", &description.FrameCount) == 1;
+            }
+            else if (strcmp(word, "fov") == 0)
+            {
+                valid = sscanf(line, "%*s %f", &description.VerticalFOV) == 1;
+            }
+            else if (strcmp(word, "camera") == 0)
+            {
+                valid = sscanf(line, "%*s %u %f %f %f %f %f %f", &frame, &a.x, &a.y, &a.z, &b.x, &b.y, &b.z) == 7;
+                description.Camera.push_back({ frame, a, b });
+            }
+            else if (strcmp(word, "turntable") == 0)
+            {
+                Turntable& orbit = description.Orbit;
+                const int read = sscanf(line, "%*s %f %f %f %f %f %f", &a.x, &a.y, &a.z, &extra[0], &extra[1], &extra[2]);
+                valid = read >= 5;
+                orbit = { true, a, extra[0], extra[1], read == 6 ? extra[2] : 1.0f };
+            }
+            else if (strcmp(word, "track") == 0)
+            {
+                Track track;
+                valid = sscanf(line, "%*s %31s %u %u", name, &index, &count) >= 2 && ParseObject(name, track.Object);
+                track.Index = index;
+                track.Count = count;
+                description.Tracks.push_back(track);
+            }
+            else if (strcmp(word, "key") == 0)
+            {
+                valid = !description.Tracks.empty() && sscanf(line, "%*s %u %f %f %f %f", &frame, &a.x, &a.y, &a.z, &extra[0]) >= 4;
+                if (valid)
+                    description.Tracks.back().Keys.push_back({ frame, a, extra[0] });
+            }
+            else
+            {
+                valid = false;
+            }
+        }
+        fclose(file);
+
+        if (!valid)
+        {
+            error = path + ":" + std::to_string(lineNumber) + ": can not read the line";
+            return false;
+        }
+
+        auto byFrame = [](const auto& a, const auto& b) { return a.Frame < b.Frame; };
+        std::stable_sort(description.Camera.begin(), description.Camera.end(), byFrame);
+        for (Track& track : description.Tracks)
+            std::stable_sort(track.Keys.begin(), track.Keys.end(), byFrame);
+        return true;
+    }
+
+    bool Validate(const Description& description, const Scene& scene, std::string& error)
+    {
+        if (description.FrameCount == 0)
+            error = "The sequence has no frames";
+        else if (description.Camera.empty() == !description.Orbit.Enabled)
+            error = "The sequence needs either camera keys or a turntable";
+        else if (description.VerticalFOV <= 0.0f || description.VerticalFOV >= 180.0f)
+            error = "The field of view has to be between 0 and 180 degrees";
+
+        for (const Track& track : description.Tracks)
+        {
+            if (!error.empty())
+                break;
+            if (track.Keys.empty())
+                error = "A track has no keys";
+            else if (track.Count == 0 || (size_t)track.Index + track.Count > GetObjectCount(scene, track.Object))
+                error = "A track reaches past the shapes of the scene";
+        }
+        return error.empty();
+    }
+
+    void GetCamera(const Description& description, uint32_t frame, glm::vec3& position, glm::vec3& target)
+    {
+        if (description.Orbit.Enabled)
+        {
+            const Turntable& orbit = description.Orbit;
+            const float angle = glm::radians(360.0f) * orbit.Turns * (float)frame / (float)std::max(description.FrameCount, 1u);
+            target = orbit.Target;
+            position = orbit.Target + glm::vec3(orbit.Radius * glm::sin(angle), orbit.Height, orbit.Radius * glm::cos(angle));
+            return;
+        }
+
+        const CameraKey key = Interpolate(description.Camera, frame, [](const CameraKey& a, const CameraKey& b, float t)
+        {
+            return CameraKey{ 0, glm::mix(a.Position, b.Position, t), glm::mix(a.Target, b.Target, t) };
+        });
+        position = key.Position;
+        target = key.Target;
+    }
+
+    Animator::Animator(Scene& scene, const Description& description)
+        : m_Scene(scene)
+    {
+        for (const Track& track : description.Tracks)
+        {
+            TrackState& state = m_Tracks.emplace_back();
+            state.Source = &track;
+            state.Applied = { 0, glm::vec3(0.0f), 0.0f };
+
+            glm::vec3 min(std::numeric_limits<float>::max()), max(-std::numeric_limits<float>::max());
+            const uint32_t end = track.Index + track.Count;
+            switch (track.Object)
+            {
+                case ObjectType::Sphere:
+                    state.Spheres.assign(scene.Spheres.begin() + track.Index, scene.Spheres.begin() + end);
+                    for (const Sphere& sphere : state.Spheres)
+                    {
+                        min = glm::min(min, sphere.Position - sphere.Radius);
+                        max = glm::max(max, sphere.Position + sphere.Radius);
+                    }
+                    break;
+                case ObjectType::Box:
+                    state.Boxes.assign(scene.Boxes.begin() + track.Index, scene.Boxes.begin() + end);
+                    for (const Box& box : state.Boxes)
+                    {
+                        min = glm::min(min, box.Min);
+                        max = glm::max(max, box.Max);
+                    }
+                    break;
+                case ObjectType::Triangle:
+                    state.Triangles.assign(scene.Triangles.begin() + track.Index, scene.Triangles.begin() + end);
+                    for (const Triangle& triangle : state.Triangles)
+                    {
+                        min = glm::min(min, glm::min(triangle.v0, glm::min(triangle.v1, triangle.v2)));
+                        max = glm::max(max, glm::max(triangle.v0, glm::max(triangle.v1, triangle.v2)));
+                    }
+                    break;
+                default:
+                    break;
+            }
+            state.Pivot = (min + max) * 0.5f;
+        }
+    }
+
+    void Animator::Apply(uint32_t frame)
+    {
+        for (TrackState& state : m_Tracks)
+        {
+            const TransformKey key = Interpolate(state.Source->Keys, frame, [](const TransformKey& a, const TransformKey& b, float t)
+            {
+                return TransformKey{ 0, glm::mix(a.Translation, b.Translation, t), glm::mix(a.Rotation, b.Rotation, t) };
+            });
+
+            // Holding still keeps every sample that saw the shapes
+            if (key.Translation == state.Applied.Translation && key.Rotation == state.Applied.Rotation)
+                continue;
+            Place(state, key.Translation, key.Rotation);
+        }
+    }
+
+    void Animator::Restore()
+    {
+        for (TrackState& state : m_Tracks)
+        {
+            if (state.Applied.Translation != glm::vec3(0.0f) || state.Applied.Rotation != 0.0f)
+                Place(state, glm::vec3(0.0f), 0.0f);
+        }
+    }
+
+    void Animator::Place(TrackState& state, const glm::vec3& translation, float rotation)
+    {
+        const float cosine = glm::cos(glm::radians(rotation));
+        const float sine = glm::sin(glm::radians(rotation));
+        auto transform = [&](const glm::vec3& point)
+        {
+            return state.Pivot + RotateY(point - state.Pivot, cosine, sine) + translation;
+        };
+
+        const Track& track = *state.Source;
+        for (uint32_t i = 0; i < track.Count; i++)
+        {
+            switch (track.Object)
+            {
+                case ObjectType::Sphere:
+                    m_Scene.Spheres[track.Index + i].Position = transform(state.Spheres[i].Position);
+                    break;
+                case ObjectType::Box:
+                {
+                    const Box& rest = state.Boxes[i];
+                    const glm::vec3 center = transform((rest.Min + rest.Max) * 0.5f);
+                    const glm::vec3 extent = (rest.Max - rest.Min) * 0.5f;
+                    m_Scene.Boxes[track.Index + i].Min = center - extent;
+                    m_Scene.Boxes[track.Index + i].Max = center + extent;
+                    break;
+                }
+                case ObjectType::Triangle:
+                {
+                    const Triangle& rest = state.Triangles[i];
+                    Triangle& triangle = m_Scene.Triangles[track.Index + i];
+                    triangle.v0 = transform(rest.v0);
+                    triangle.v1 = transform(rest.v1);
+                    triangle.v2 = transform(rest.v2);
+                    triangle.n0 = RotateY(rest.n0, cosine, sine);
+                    triangle.n1 = RotateY(rest.n1, cosine, sine);
+                    triangle.n2 = RotateY(rest.n2, cosine, sine);
+                    break;
+                }
+                default:
+                    break;
+            }
+        }
+
+        m_Scene.Journal.Record(ChangeKind::Transform, track.Object, track.Index, track.Count);
+        state.Applied = { 0, translation, rotation };
+    }
+
+    std::string GetFramePath(const std::string& pattern, uint32_t frame)
+    {
+        const size_t first = pattern.find('#');
+        if (first == std::string::npos)
+        {
+            const size_t dot = pattern.find_last_of('.');
+            const size_t slash = pattern.find_last_of("/\\");
+            const size_t split = dot != std::string::npos && (slash == std::string::npos || dot > slash) ? dot : pattern.size();
+            return GetFramePath(pattern.substr(0, split) + "_####" + pattern.substr(split), frame);
+        }
+
+        const size_t last = pattern.find_first_not_of('#', first);
+        const size_t width = (last == std::string::npos ? pattern.size() : last) - first;
+        char number[32];
+        snprintf(number, sizeof(number), "%0*u", (int)std::min<size_t>(width, 16), frame);
+        return pattern.substr(0, first) + number + (last == std::string::npos ? "" : pattern.substr(last));
+    }
+
+    bool Render(Renderer& renderer, Scene& scene, const Description& description, const Options& options,
+        Stats& stats, const std::function<void(uint32_t frame, const Stats& stats)>& progress)
+    {
+        WL_PROFILE_ZONE("Sequence::Render");
+
+        using Clock = std::chrono::steady_clock;
+        const auto start = Clock::now();
+        stats = Stats();
+
+        std::string error;
+        if (!Validate(description, scene, error) || options.Width == 0 || options.Height == 0 || options.Samples == 0)
+            return false;
+
+        // Every frame renders until each tile holds the samples, which a crop or no accumulation would prevent
+        Renderer::Settings& settings = renderer.GetSettings();
+        const Renderer::Settings savedSettings = settings;
+        settings.Accumulate = true;
+        settings.Crop = {};
+        settings.MaxSamples = options.Samples;
+
+        renderer.OnResize(options.Width, options.Height);
+        Camera camera(description.VerticalFOV, 0.1f, 100.0f);
+        camera.OnResize(options.Width, options.Height);
+
+        const bool linear = ImageFile::IsLinear(options.OutputPattern);
+        ImageWriter writer(options.MaxPendingImages);
+        Animator animator(scene, description);
+
+        glm::vec3 lastPosition(0.0f), lastTarget(0.0f);
+        const uint32_t lastFrame = std::min(options.LastFrame, description.FrameCount - 1);
+        for (uint32_t frame = options.FirstFrame; frame <= lastFrame; frame++)
+        {
+            const auto renderStart = Clock::now();
+
+            // Samples only carry over to the next frame while the camera holds still
+            glm::vec3 position, target;
+            GetCamera(description, frame, position, target);
+            const bool cut = frame == options.FirstFrame || position != lastPosition || target != lastTarget;
+            if (cut)
+            {
+                camera.LookAt(position, target);
+                renderer.ResetFrameIndex();
+                stats.CameraCuts++;
+                lastPosition = position;
+                lastTarget = target;
+            }
+
+            animator.Apply(frame);
+            renderer.UpdateScene(scene);
+            for (uint32_t tileFrames : renderer.GetTileFrames())
+                stats.KeptTiles += tileFrames > 0;
+            stats.Tiles += renderer.GetTileCount();
+
+            do
+            {
+                renderer.Render(scene, camera);
+            } while (!renderer.IsConverged());
+
+            // Rendering only waits for the copy, encoding and writing happen behind the next frame
+            std::unique_ptr<ImageWriter::Image> image = writer.Acquire();
+            image->Path = GetFramePath(options.OutputPattern, frame);
+            image->Width = options.Width;
+            image->Height = options.Height;
+            if (linear)
+            {
+                renderer.GetAccumulatedImage(image->Radiance);
+            }
+            else
+            {
+                renderer.ResolveImage();
+                image->Pixels.assign(renderer.GetImageData(), renderer.GetImageData() + (size_t)options.Width * options.Height);
+            }
+            writer.Submit(std::move(image));
+
+            stats.Frames++;
+            stats.RenderSeconds += std::chrono::duration<double>(Clock::now() - renderStart).count();
+            stats.WriterWaitSeconds = writer.GetWaitTime();
+            stats.Seconds = std::chrono::duration<double>(Clock::now() - start).count();
+            if (progress)
+                progress(frame, stats);
+        }
+
+        writer.Finish();
+        animator.Restore();
+        settings = savedSettings;
+
+        stats.WriterWaitSeconds = writer.GetWaitTime();
+        stats.WriteSeconds = writer.GetWriteTime();
+        stats.FailedImages = writer.GetFailedCount();
+        stats.Seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        return stats.FailedImages == 0;
+    }
+
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include "Scene.h"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+class Renderer;
+
+// Camera paths, turntables and moving shapes rendered frame after frame into numbered images.
+// The renderer is kept across frames: shapes that move only refit their part of the BVH, and while
+// the camera stands still the tiles no moving shape reached keep their samples.
+namespace Sequence {
+
+    struct CameraKey
+    {
+        uint32_t Frame;
+        glm::vec3 Position;
+        glm::vec3 Target;
+    };
+
+    // Relative to where the shapes are when the sequence starts, the rotation turns them around the
+    // vertical axis through the centre of their bounds. Boxes stay axis aligned, only their centre turns.
+    struct TransformKey
+    {
+        uint32_t Frame;
+        glm::vec3 Translation;
+        float Rotation;     // In degrees
+    };
+
+    // Consecutive shapes of one type that move together, a mesh added as a range of triangles for example
+    struct Track
+    {
+        ObjectType Object = ObjectType::Sphere;
+        uint32_t Index = 0, Count = 1;
+        std::vector<TransformKey> Keys;     // Ordered by frame
+    };
+
+    // Circles the camera around the target instead of following keys
+    struct Turntable
+    {
+        bool Enabled = false;
+        glm::vec3 Target{ 0.0f };
+        float Radius = 6.0f;
+        float Height = 1.0f;    // Above the target
+        float Turns = 1.0f;     // Over the whole sequence
+    };
+
+    struct Description
+    {
+        uint32_t FrameCount = 0;
+        float VerticalFOV = 45.0f;
+        std::vector<CameraKey> Camera;      // Ordered by frame
+        Turntable Orbit;
+        std::vector<Track> Tracks;
+    };
+
+    // Reads a text description, one statement per line and # starts a comment:
+    //   frames <count>
+    //   fov <degrees>
+    //   camera <frame> <x> <y> <z> <target x> <target y> <target z>
+    //   turntable <target x> <target y> <target z> <radius> <height> [turns]
+    //   track sphere|box|triangle <index> [count]
+    //   key <frame> <x> <y> <z> [rotation]       (for the track above it)
+    // Values between keys are interpolated linearly, before the first and after the last they hold.
+    bool Load(const std::string& path, Description& description, std::string& error);
+    // Checks the tracks against the scene and that there is a camera
+    bool Validate(const Description& description, const Scene& scene, std::string& error);
+
+    void GetCamera(const Description& description, uint32_t frame, glm::vec3& position, glm::vec3& target);
+
+    // Moves the tracked shapes of the scene, relative to where they were when it was constructed.
+    // Only shapes that actually moved since the last frame are recorded in the journal.
+    class Animator
+    {
+    public:
+        Animator(Scene& scene, const Description& description);
+
+        void Apply(uint32_t frame);
+        // Puts every shape back where it was
+        void Restore();
+    private:
+        struct TrackState
+        {
+            const Track* Source;
+            glm::vec3 Pivot;
+            TransformKey Applied;
+            std::vector<Sphere> Spheres;
+            std::vector<Box> Boxes;
+            std::vector<Triangle> Triangles;
+        };
+
+        void Place(TrackState& state, const glm::vec3& translation, float rotation);
+    private:
+        Scene& m_Scene;
+        std::vector<TrackState> m_Tracks;
+    };
+
+    // Image paths replace a run of # with the zero padded frame number, a pattern without one gets
+    // _0000 style numbers before the extension. The extension picks the format, see ImageFile::Write().
+    std::string GetFramePath(const std::string& pattern, uint32_t frame);
+
+    struct Options
+    {
+        std::string OutputPattern = "frame_####.png";
+        uint32_t Width = 1280, Height = 720;
+        uint32_t Samples = 64;          // Per pixel and frame
+        uint32_t FirstFrame = 0;
+        uint32_t LastFrame = ~0u;       // Inclusive, clamped to the sequence
+        uint32_t MaxPendingImages = 3;  // Frames rendering may get ahead of the disk
+    };
+
+    struct Stats
+    {
+        uint32_t Frames = 0;
+        uint32_t CameraCuts = 0;        // Frames that restarted every tile because the camera moved
+        uint64_t KeptTiles = 0;         // Tiles a frame started with samples of the one before
+        uint64_t Tiles = 0;
+        double Seconds = 0.0;           // Wall time including the last image reaching the disk
+        double RenderSeconds = 0.0;
+        double WriterWaitSeconds = 0.0; // Rendering waited for the image writer
+        double WriteSeconds = 0.0;      // Spent by the image writer in the background
+        uint32_t FailedImages = 0;
+
+        double GetFramesPerMinute() const { return Seconds > 0.0 ? Frames * 60.0 / Seconds : 0.0; }
+    };
+
+    // Renders the frames with the renderer's settings, with the samples per pixel as the MaxSamples target.
+    // progress is called after every frame. The scene is back in its original state afterwards.
+    bool Render(Renderer& renderer, Scene& scene, const Description& description, const Options& options,
+        Stats& stats, const std::function<void(uint32_t frame, const Stats& stats)>& progress = {});
+
+}
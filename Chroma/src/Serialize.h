@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+// Plain byte streams for saving and sending data between processes of the same build. Values are
+// copied as they are in memory, no byte order or layout conversion happens.
+class ByteWriter
+{
+public:
+    explicit ByteWriter(std::vector<uint8_t>& buffer) : m_Buffer(buffer) {}
+
+    template<typename T>
+    void Write(const T& value)
+    {
+        static_assert(std::is_trivially_copyable_v<T>, "Only plain values can be written as they are");
+        WriteBytes(&value, sizeof(T));
+    }
+
+    void WriteBytes(const void* data, size_t size)
+    {
+        const size_t offset = m_Buffer.size();
+        m_Buffer.resize(offset + size);
+        if (size > 0)
+            std::memcpy(m_Buffer.data() + offset, data, size);
+    }
+private:
+    std::vector<uint8_t>& m_Buffer;
+};
+
+// Every read fails once the data runs out, so a truncated stream is caught at the end
+class ByteReader
+{
+public:
+    ByteReader(const uint8_t* data, size_t size) : m_Data(data), m_Size(size) {}
+
+    template<typename T>
+    bool Read(T& value)
+    {
+        static_assert(std::is_trivially_copyable_v<T>, "Only plain values can be read as they are");
+        return ReadBytes(&value, sizeof(T));
+    }
+
+    bool ReadBytes(void* data, size_t size)
+    {
+        if (size > m_Size - m_Offset)
+        {
+            m_Offset = m_Size;
+            m_Failed = true;
+            return false;
+        }
+        if (size > 0)
+            std::memcpy(data, m_Data + m_Offset, size);
+        m_Offset += size;
+        return true;
+    }
+
+    size_t GetRemaining() const { return m_Size - m_Offset; }
+    bool HasFailed() const { return m_Failed; }
+private:
+    const uint8_t* m_Data;
+    size_t m_Size;
+    size_t m_Offset = 0;
+    bool m_Failed = false;
+};
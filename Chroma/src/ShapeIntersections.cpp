@@ -83,7 +83,8 @@ bool Renderer::IntersectTriangle(const Ray& ray, const Triangle& triangle, float
 
     float det = glm::dot(edge1, pvec);
 
-    if (std::abs(det) < 0.0001f)
+    // Relative to the triangle size, an absolute epsilon rejects every ray on small triangles
+    if (std::abs(det) < 1e-6f * glm::dot(edge1, edge1) + 1e-12f)
         return false;
 
     float invDet = 1.0f / det;
@@ -40,6 +40,8 @@ namespace Shapes {
         Triangle leftFace(baseTopLeft, baseBottomLeft, apex);
         leftFace.MaterialIndex = materialIndex;
         scene.Triangles.push_back(leftFace);
+
+        scene.Journal.Record(ChangeKind::Add, ObjectType::Triangle, (uint32_t)scene.Triangles.size() - 6, 6);
     }
 
     // Add a cube shape to the scene
@@ -50,6 +52,7 @@ namespace Shapes {
         box.Max = center + glm::vec3(halfSize);
         box.MaterialIndex = materialIndex;
         scene.Boxes.push_back(box);
+        scene.Journal.Record(ChangeKind::Add, ObjectType::Box, (uint32_t)scene.Boxes.size() - 1);
     }
 
     // Add a sphere shape to the scene
@@ -59,6 +62,7 @@ namespace Shapes {
         sphere.Radius = radius;
         sphere.MaterialIndex = materialIndex;
         scene.Spheres.push_back(sphere);
+        scene.Journal.Record(ChangeKind::Add, ObjectType::Sphere, (uint32_t)scene.Spheres.size() - 1);
     }
 
     // Add a plane shape to the scene
@@ -68,5 +72,24 @@ namespace Shapes {
         plane.Distance = distance;
         plane.MaterialIndex = materialIndex;
         scene.Planes.push_back(plane);
+        scene.Journal.Record(ChangeKind::Add, ObjectType::Plane, (uint32_t)scene.Planes.size() - 1);
+    }
+
+    // Add a triangle to the scene
+    inline void AddTriangle(Scene& scene, const Triangle& triangle) {
+        scene.Triangles.push_back(triangle);
+        scene.Journal.Record(ChangeKind::Add, ObjectType::Triangle, (uint32_t)scene.Triangles.size() - 1);
+    }
+
+    // Remove a shape from the scene, the shapes after it move down by one
+    inline void Remove(Scene& scene, ShapeType type, uint32_t index) {
+        switch (type) {
+            case ShapeType::Sphere:   scene.Spheres.erase(scene.Spheres.begin() + index); break;
+            case ShapeType::Plane:    scene.Planes.erase(scene.Planes.begin() + index); break;
+            case ShapeType::Box:      scene.Boxes.erase(scene.Boxes.begin() + index); break;
+            case ShapeType::Triangle: scene.Triangles.erase(scene.Triangles.begin() + index); break;
+            default: return;
+        }
+        scene.Journal.Record(ChangeKind::Remove, (ObjectType)type, index);
     }
 }
\ No newline at end of file
@@ -0,0 +1,528 @@
+#include "TextureCache.h"
+#include "Utils.h"
+
+#include "stb_image.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+
+namespace {
+
+    constexpr char TileFileMagic[8] = { 'C', 'H', 'R', 'O', 'M', 'A', 'T', 'X' };
+    constexpr uint32_t TileFileVersion = 1;
+
+    // The tiles start on the page after it
+    struct TileFileHeader
+    {
+        char Magic[8];
+        uint32_t Version;
+        uint32_t Encoding;
+        uint64_t SourceHash;    // Of the image file and the encoding, it names the tile file
+        uint32_t LevelCount;
+        uint32_t TileCount;
+        Texture::Level Levels[Texture::MaxLevels];
+    };
+
+    static_assert(sizeof(TileFileHeader) <= Texture::TileBytes, "the tile file header has to fit the first page");
+
+    // Tiles a thread read lately, looked up by key without a lock. A path alternates between the albedo,
+    // roughness and normal tiles of every material it meets, a few dozen keep most of them at hand.
+    constexpr uint32_t ThreadTileBits = 5;
+
+    struct ThreadTile
+    {
+        uint64_t Generation = 0;
+        uint64_t Key = 0;
+        uint32_t Slot = 0;
+        uint32_t Version = 0;   // Of the slot when the tile was read into it
+    };
+
+    struct ThreadTiles
+    {
+        ThreadTile Entries[1 << ThreadTileBits];
+        uint64_t HitGeneration = 0;
+        uint64_t Hits = 0;      // Not counted by a shard yet
+    };
+
+    thread_local ThreadTiles t_ThreadTiles;
+
+    std::atomic<uint64_t> s_NextGeneration{ 1 };
+
+    float SRGBToLinear(float value)
+    {
+        return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+    }
+
+    float LinearToSRGB(float value)
+    {
+        return value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+    }
+
+    // Linear value of every 8 bit sRGB value
+    const float* GetSRGBTable()
+    {
+        static const struct Table
+        {
+            float Values[256];
+            Table()
+            {
+                for (int i = 0; i < 256; i++)
+                    Values[i] = SRGBToLinear((float)i / 255.0f);
+            }
+        } table;
+        return table.Values;
+    }
+
+    glm::vec4 Decode(uint32_t texel, Texture::Encoding encoding)
+    {
+        const glm::vec4 value((float)(texel & 0xff), (float)((texel >> 8) & 0xff), (float)((texel >> 16) & 0xff),
+            (float)(texel >> 24));
+        switch (encoding)
+        {
+            case Texture::Encoding::sRGB:
+            {
+                const float* table = GetSRGBTable();
+                return { table[texel & 0xff], table[(texel >> 8) & 0xff], table[(texel >> 16) & 0xff], value.a / 255.0f };
+            }
+            case Texture::Encoding::Normal:
+                return { glm::vec3(value) * (2.0f / 255.0f) - 1.0f, value.a / 255.0f };
+            default:
+                return value / 255.0f;
+        }
+    }
+
+    uint32_t Encode(const glm::vec4& value, Texture::Encoding encoding)
+    {
+        glm::vec4 stored = value;
+        if (encoding == Texture::Encoding::sRGB)
+            stored = { LinearToSRGB(value.r), LinearToSRGB(value.g), LinearToSRGB(value.b), value.a };
+        else if (encoding == Texture::Encoding::Normal)
+            stored = { glm::vec3(value) * 0.5f + 0.5f, value.a };
+
+        const glm::uvec4 bytes = glm::uvec4(glm::clamp(stored, 0.0f, 1.0f) * 255.0f + 0.5f);
+        return bytes.r | (bytes.g << 8) | (bytes.b << 16) | (bytes.a << 24);
+    }
+
+    // Box filters the level down to half its size, the last row or column of an odd size is left out
+    void Downsample(const std::vector<uint32_t>& source, uint32_t width, uint32_t height, Texture::Encoding encoding,
+        std::vector<uint32_t>& target)
+    {
+        const uint32_t targetWidth = std::max(width / 2, 1u), targetHeight = std::max(height / 2, 1u);
+        target.resize((size_t)targetWidth * targetHeight);
+        for (uint32_t y = 0; y < targetHeight; y++)
+        {
+            const uint32_t y0 = std::min(y * 2, height - 1), y1 = std::min(y * 2 + 1, height - 1);
+            for (uint32_t x = 0; x < targetWidth; x++)
+            {
+                const uint32_t x0 = std::min(x * 2, width - 1), x1 = std::min(x * 2 + 1, width - 1);
+                glm::vec4 sum = Decode(source[(size_t)y0 * width + x0], encoding) + Decode(source[(size_t)y0 * width + x1], encoding) +
+                    Decode(source[(size_t)y1 * width + x0], encoding) + Decode(source[(size_t)y1 * width + x1], encoding);
+                sum *= 0.25f;
+
+                // Normals that cancel out leave a flat surface
+                if (encoding == Texture::Encoding::Normal)
+                {
+                    const float length = glm::length(glm::vec3(sum));
+                    sum = glm::vec4(length > 1e-4f ? glm::vec3(sum) / length : glm::vec3(0.0f, 0.0f, 1.0f), sum.a);
+                }
+                target[(size_t)y * targetWidth + x] = Encode(sum, encoding);
+            }
+        }
+    }
+
+    bool ReadFile(const std::string& path, std::vector<uint8_t>& data)
+    {
+        FILE* file = fopen(path.c_str(), "rb");
+        if (!file)
+            return false;
+
+        uint8_t buffer[1 << 16];
+        size_t read;
+        while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+            data.insert(data.end(), buffer, buffer + read);
+        fclose(file);
+        return true;
+    }
+
+    // Decodes the image and writes its tile file, under a temporary name first so that a process
+    // converting the same image at the same time never sees half a file
+    bool ConvertImage(const std::vector<uint8_t>& source, Texture::Encoding encoding, uint64_t sourceHash,
+        const std::string& tilePath, std::string& error)
+    {
+        int width = 0, height = 0, channels = 0;
+        stbi_uc* pixels = stbi_load_from_memory(source.data(), (int)source.size(), &width, &height, &channels, 4);
+        if (!pixels)
+        {
+            error = stbi_failure_reason();
+            return false;
+        }
+        if ((uint32_t)std::max(width, height) > (1u << (Texture::MaxLevels - 1)))
+        {
+            stbi_image_free(pixels);
+            error = "image is larger than " + std::to_string(1u << (Texture::MaxLevels - 1)) + " texels";
+            return false;
+        }
+
+        TileFileHeader header = {};
+        header.Version = TileFileVersion;
+        header.Encoding = (uint32_t)encoding;
+        header.SourceHash = sourceHash;
+        for (uint32_t w = (uint32_t)width, h = (uint32_t)height;; w = std::max(w / 2, 1u), h = std::max(h / 2, 1u))
+        {
+            Texture::Level& level = header.Levels[header.LevelCount++];
+            level.Width = w;
+            level.Height = h;
+            level.TilesX = (w + Texture::TileSize - 1) / Texture::TileSize;
+            level.TilesY = (h + Texture::TileSize - 1) / Texture::TileSize;
+            level.FirstTile = header.TileCount;
+            header.TileCount += level.TilesX * level.TilesY;
+            if (w == 1 && h == 1)
+                break;
+        }
+
+        const std::string temporaryPath = tilePath + "." +
+            std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()) + ".tmp";
+        Memory::MappedFile file;
+        if (!file.Open(temporaryPath) || !file.Resize((size_t)Texture::TileBytes * (1 + header.TileCount)))
+        {
+            stbi_image_free(pixels);
+            file.Close();
+            std::error_code ignored;
+            std::filesystem::remove(temporaryPath, ignored);
+            error = "can not write " + temporaryPath;
+            return false;
+        }
+
+        std::vector<uint32_t> level((size_t)width * height), next;
+        std::memcpy(level.data(), pixels, level.size() * sizeof(uint32_t));
+        stbi_image_free(pixels);
+
+        uint8_t* tiles = file.Data() + Texture::TileBytes;
+        for (uint32_t i = 0; i < header.LevelCount; i++)
+        {
+            const Texture::Level& info = header.Levels[i];
+            if (i > 0)
+            {
+                Downsample(level, header.Levels[i - 1].Width, header.Levels[i - 1].Height, encoding, next);
+                level.swap(next);
+            }
+
+            // Texels of the edge tiles past the level are never read, lookups wrap before they pick a tile
+            for (uint32_t y = 0; y < info.Height; y++)
+            {
+                for (uint32_t x = 0; x < info.Width; x++)
+                {
+                    const uint32_t tile = info.FirstTile + (y / Texture::TileSize) * info.TilesX + x / Texture::TileSize;
+                    const uint32_t offset = ((y % Texture::TileSize) * Texture::TileSize + x % Texture::TileSize) * 4;
+                    std::memcpy(tiles + (size_t)tile * Texture::TileBytes + offset, &level[(size_t)y * info.Width + x], 4);
+                }
+            }
+        }
+
+        // A file with the magic holds all of its tiles
+        file.Flush(Texture::TileBytes, (size_t)Texture::TileBytes * header.TileCount);
+        std::memcpy(header.Magic, TileFileMagic, sizeof(TileFileMagic));
+        std::memcpy(file.Data(), &header, sizeof(header));
+        file.Flush(0, sizeof(header));
+        file.Close();
+
+        // Another process may have been first, its file holds the same
+        std::error_code renameError;
+        std::filesystem::rename(temporaryPath, tilePath, renameError);
+        if (renameError)
+        {
+            std::error_code ignored;
+            std::filesystem::remove(temporaryPath, ignored);
+        }
+        return true;
+    }
+
+}
+
+TextureCache::TextureCache(size_t size)
+{
+    SetSize(size);
+}
+
+void TextureCache::SetSize(size_t size)
+{
+    m_Size = size;
+    const uint32_t slotCount = (uint32_t)std::max<size_t>(size / Texture::TileBytes, 1);
+
+    m_ShardCount = 1;
+    while (m_ShardCount * 2 <= std::min(slotCount, MaxShards))
+        m_ShardCount *= 2;
+
+    m_Generation = s_NextGeneration.fetch_add(1, std::memory_order_relaxed);
+    m_Tiles.Resize((size_t)slotCount * Texture::TileBytes);
+    m_SlotKeys.assign(slotCount, 0);
+    m_SlotVersions.reset(new std::atomic<uint32_t>[slotCount]);
+    for (uint32_t i = 0; i < slotCount; i++)
+        m_SlotVersions[i].store(0, std::memory_order_relaxed);
+    m_Previous.assign(slotCount, NoSlot);
+    m_Next.assign(slotCount, NoSlot);
+    m_Shards = std::make_unique<Shard[]>(m_ShardCount);
+    for (uint32_t i = 0; i < m_ShardCount; i++)
+    {
+        Shard& shard = m_Shards[i];
+        shard.FirstSlot = (uint32_t)((uint64_t)slotCount * i / m_ShardCount);
+        shard.SlotCount = (uint32_t)((uint64_t)slotCount * (i + 1) / m_ShardCount) - shard.FirstSlot;
+        shard.Slots.reserve(shard.SlotCount);
+    }
+}
+
+std::string TextureCache::GetTileDirectory() const
+{
+    if (!m_TileDirectory.empty())
+        return m_TileDirectory;
+
+    std::error_code error;
+    const std::filesystem::path temporary = std::filesystem::temp_directory_path(error);
+    return ((error ? std::filesystem::path(".") : temporary) / "chroma-textures").string();
+}
+
+int32_t TextureCache::Load(const std::string& path, Texture::Encoding encoding, std::string& error)
+{
+    const std::string key = std::to_string((uint32_t)encoding) + ":" + path;
+    auto loaded = m_Loaded.find(key);
+    if (loaded != m_Loaded.end())
+        return loaded->second;
+
+    // The tile file is named by the contents of the image, an edited image gets a new one
+    std::vector<uint8_t> source;
+    if (!ReadFile(path, source))
+    {
+        error = "can not read " + path;
+        return -1;
+    }
+    uint64_t hash = Utils::HashBytes(source.data(), source.size());
+    hash = Utils::HashBytes(&encoding, sizeof(encoding), hash);
+
+    const std::filesystem::path directory = GetTileDirectory();
+    std::error_code directoryError;
+    std::filesystem::create_directories(directory, directoryError);
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.ctx", (unsigned long long)hash);
+    const std::string tilePath = (directory / name).string();
+
+    auto data = std::make_unique<TextureData>();
+    auto open = [&]()
+    {
+        std::error_code existsError;
+        if (!std::filesystem::exists(tilePath, existsError) || !data->File.Open(tilePath))
+            return false;
+
+        TileFileHeader header;
+        const size_t size = data->File.Size();
+        if (size < Texture::TileBytes)
+            return false;
+        std::memcpy(&header, data->File.Data(), sizeof(header));
+        if (std::memcmp(header.Magic, TileFileMagic, sizeof(TileFileMagic)) != 0 || header.Version != TileFileVersion ||
+            header.Encoding != (uint32_t)encoding || header.SourceHash != hash || header.LevelCount == 0 ||
+            header.LevelCount > Texture::MaxLevels || size < (size_t)Texture::TileBytes * (1 + (size_t)header.TileCount))
+        {
+            data->File.Close();
+            return false;
+        }
+
+        data->LevelCount = header.LevelCount;
+        std::memcpy(data->Levels, header.Levels, sizeof(header.Levels));
+        data->Tiles = data->File.Data() + Texture::TileBytes;
+        return true;
+    };
+
+    if (!open())
+    {
+        if (!ConvertImage(source, encoding, hash, tilePath, error))
+        {
+            error = path + ": " + error;
+            return -1;
+        }
+        if (!open())
+        {
+            error = "can not open " + tilePath;
+            return -1;
+        }
+    }
+
+    data->Path = path;
+    data->Encoding = encoding;
+    const int32_t handle = (int32_t)m_Textures.size();
+    m_Textures.push_back(std::move(data));
+    m_Loaded.emplace(key, handle);
+    return handle;
+}
+
+glm::vec4 TextureCache::Sample(int32_t texture, const glm::vec2& uv, float footprint, const glm::vec3& random)
+{
+    const TextureData& data = *m_Textures[texture];
+    const Texture::Level& base = data.Levels[0];
+
+    // Level on which the footprint covers about one texel, between two levels the finer one is
+    // taken with the weight trilinear filtering would give it
+    const float lod = std::min(std::log2(std::max(1.0f, footprint * (float)std::max(base.Width, base.Height))),
+        (float)(data.LevelCount - 1));
+    uint32_t levelIndex = (uint32_t)lod;
+    if (random.z < lod - (float)levelIndex)
+        levelIndex = std::min(levelIndex + 1, data.LevelCount - 1);
+    const Texture::Level& level = data.Levels[levelIndex];
+
+    // Jittered by up to a texel before rounding down, each of the four bilinear neighbours comes
+    // up with its weight
+    const float x = (uv.x - std::floor(uv.x)) * (float)level.Width - 0.5f + random.x;
+    const float y = (uv.y - std::floor(uv.y)) * (float)level.Height - 0.5f + random.y;
+    int32_t texelX = (int32_t)std::floor(x), texelY = (int32_t)std::floor(y);
+    if (texelX < 0)
+        texelX += (int32_t)level.Width;
+    else if (texelX >= (int32_t)level.Width)
+        texelX -= (int32_t)level.Width;
+    if (texelY < 0)
+        texelY += (int32_t)level.Height;
+    else if (texelY >= (int32_t)level.Height)
+        texelY -= (int32_t)level.Height;
+
+    const uint32_t tile = level.FirstTile + ((uint32_t)texelY / Texture::TileSize) * level.TilesX +
+        (uint32_t)texelX / Texture::TileSize;
+    const uint32_t offset = (((uint32_t)texelY % Texture::TileSize) * Texture::TileSize + (uint32_t)texelX % Texture::TileSize) * 4;
+    return Decode(ReadTexel(texture, data, tile, offset), data.Encoding);
+}
+
+uint32_t TextureCache::ReadTexel(int32_t texture, const TextureData& data, uint32_t tile, uint32_t offset)
+{
+    const uint64_t key = ((uint64_t)texture << 32) | tile;
+    const uint64_t hash = key * 0x9e3779b97f4a7c15ull;
+    ThreadTiles& threadTiles = t_ThreadTiles;
+    ThreadTile& recent = threadTiles.Entries[(hash >> 32) & ((1u << ThreadTileBits) - 1)];
+
+    // Most lookups land on a tile the thread read a moment ago. Its slot may have been given to another
+    // tile since, the version changes when it is, and a read it overlapped with is thrown away.
+    if (recent.Generation == m_Generation && recent.Key == key)
+    {
+        const std::atomic<uint32_t>& version = m_SlotVersions[recent.Slot];
+        if (version.load(std::memory_order_acquire) == recent.Version)
+        {
+            uint32_t texel;
+            std::memcpy(&texel, m_Tiles.Data() + (size_t)recent.Slot * Texture::TileBytes + offset, sizeof(texel));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (version.load(std::memory_order_relaxed) == recent.Version)
+            {
+                if (threadTiles.HitGeneration != m_Generation)
+                {
+                    threadTiles.HitGeneration = m_Generation;
+                    threadTiles.Hits = 0;
+                }
+                threadTiles.Hits++;
+                return texel;
+            }
+        }
+    }
+
+    Shard& shard = m_Shards[(hash >> 58) & (m_ShardCount - 1)];
+    std::lock_guard<std::mutex> lock(shard.Mutex);
+    shard.Locked++;
+    if (threadTiles.HitGeneration == m_Generation)
+    {
+        shard.Hits += threadTiles.Hits;
+        threadTiles.Hits = 0;
+    }
+
+    uint32_t slot;
+    auto found = shard.Slots.find(key);
+    if (found != shard.Slots.end())
+    {
+        slot = found->second;
+        shard.Hits++;
+        if (shard.Head != slot)
+        {
+            Unlink(shard, slot);
+            PushFront(shard, slot);
+        }
+    }
+    else
+    {
+        shard.Misses++;
+        if (shard.UsedSlots < shard.SlotCount)
+        {
+            slot = shard.FirstSlot + shard.UsedSlots++;
+        }
+        else
+        {
+            slot = shard.Tail;
+            Unlink(shard, slot);
+            shard.Slots.erase(m_SlotKeys[slot]);
+            shard.Evictions++;
+        }
+
+        // Only this shard writes its slots, the version is odd for as long as the tile is half copied.
+        // Read from the mapped tile file, the OS pages it in if it is not cached already.
+        std::atomic<uint32_t>& version = m_SlotVersions[slot];
+        const uint32_t previous = version.load(std::memory_order_relaxed);
+        version.store(previous + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        std::memcpy(m_Tiles.Data() + (size_t)slot * Texture::TileBytes, data.Tiles + (size_t)tile * Texture::TileBytes,
+            Texture::TileBytes);
+        version.store(previous + 2, std::memory_order_release);
+
+        m_SlotKeys[slot] = key;
+        shard.Slots.emplace(key, slot);
+        PushFront(shard, slot);
+    }
+
+    recent.Generation = m_Generation;
+    recent.Key = key;
+    recent.Slot = slot;
+    recent.Version = m_SlotVersions[slot].load(std::memory_order_relaxed);
+
+    uint32_t texel;
+    std::memcpy(&texel, m_Tiles.Data() + (size_t)slot * Texture::TileBytes + offset, sizeof(texel));
+    return texel;
+}
+
+void TextureCache::Unlink(Shard& shard, uint32_t slot)
+{
+    const uint32_t previous = m_Previous[slot], next = m_Next[slot];
+    (previous != NoSlot ? m_Next[previous] : shard.Head) = next;
+    (next != NoSlot ? m_Previous[next] : shard.Tail) = previous;
+}
+
+void TextureCache::PushFront(Shard& shard, uint32_t slot)
+{
+    m_Previous[slot] = NoSlot;
+    m_Next[slot] = shard.Head;
+    if (shard.Head != NoSlot)
+        m_Previous[shard.Head] = slot;
+    shard.Head = slot;
+    if (shard.Tail == NoSlot)
+        shard.Tail = slot;
+}
+
+TextureCache::Stats TextureCache::GetStats() const
+{
+    Stats stats;
+    for (uint32_t i = 0; i < m_ShardCount; i++)
+    {
+        Shard& shard = m_Shards[i];
+        std::lock_guard<std::mutex> lock(shard.Mutex);
+        stats.Hits += shard.Hits;
+        stats.Misses += shard.Misses;
+        stats.Locked += shard.Locked;
+        stats.Evictions += shard.Evictions;
+        stats.ResidentTiles += shard.UsedSlots;
+        stats.CapacityTiles += shard.SlotCount;
+    }
+    return stats;
+}
+
+void TextureCache::ResetStats()
+{
+    for (uint32_t i = 0; i < m_ShardCount; i++)
+    {
+        Shard& shard = m_Shards[i];
+        std::lock_guard<std::mutex> lock(shard.Mutex);
+        shard.Hits = shard.Misses = shard.Locked = shard.Evictions = 0;
+    }
+}
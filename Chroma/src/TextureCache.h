@@ -0,0 +1,136 @@
+#pragma once
+
+#include "Memory.h"
+
+#include <glm/glm.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Layout of converted textures. Loading an image decodes it once and converts it into a mip chain
+// cut into square tiles of RGBA8 texels, stored in a tile file that later loads of the same image
+// reuse. Each tile is one page, level after level and row by row within a level.
+namespace Texture {
+
+    // How texels are stored and filtered down the mip chain
+    enum class Encoding : uint8_t
+    {
+        sRGB,       // Colors like albedo maps, averaged in linear light and decoded on lookup
+        Linear,     // Data like roughness maps, averaged as it is
+        Normal      // Tangent space normals in RGB, renormalized after averaging
+    };
+
+    constexpr uint32_t EncodingCount = 3;
+
+    constexpr uint32_t TileSize = 32;                           // Texels per side
+    constexpr uint32_t TileBytes = TileSize * TileSize * 4;     // A 4 KB page
+    constexpr uint32_t MaxLevels = 16;                          // Images up to 32768 texels wide
+
+    struct Level
+    {
+        uint32_t Width, Height;
+        uint32_t TilesX, TilesY;
+        uint32_t FirstTile;     // Of the texture, the tiles of the levels before it come first
+    };
+
+}
+
+// Textures the renderer samples from its worker threads. The tile files are mapped read only, the OS
+// pages in the tiles lookups reach and may drop them again, they are page cache shared with every other
+// reader of the file. Tiles in use are copied into a cache of fixed size that evicts the least recently
+// used ones, the memory this process itself holds for textures stays within that size however many
+// texels the scene has.
+class TextureCache
+{
+public:
+    static constexpr size_t DefaultSize = 64ull << 20;
+
+    struct Stats
+    {
+        uint64_t Hits = 0, Misses = 0;
+        uint64_t Locked = 0;        // Lookups that took a shard lock, the others hit a tile the thread read lately
+        uint64_t Evictions = 0;
+        uint32_t ResidentTiles = 0, CapacityTiles = 0;
+
+        double GetHitRate() const { return Hits + Misses > 0 ? (double)Hits / (double)(Hits + Misses) : 0.0; }
+    };
+public:
+    // The size is in bytes of tiles, at least one tile is always kept
+    explicit TextureCache(size_t size = DefaultSize);
+
+    TextureCache(const TextureCache&) = delete;
+    TextureCache& operator=(const TextureCache&) = delete;
+
+    // Drops every cached tile, the loaded textures stay. Not while anything samples.
+    void SetSize(size_t size);
+    size_t GetSize() const { return m_Size; }
+
+    // Tile files go there, a chroma-textures directory in the temporary directory unless set
+    void SetTileDirectory(const std::string& directory) { m_TileDirectory = directory; }
+
+    // Handle of the image loaded with the encoding, converting it unless it was loaded before or a tile
+    // file of the same image is found. -1 if it can not be read, error says why. Not while anything samples.
+    int32_t Load(const std::string& path, Texture::Encoding encoding, std::string& error);
+
+    uint32_t GetTextureCount() const { return (uint32_t)m_Textures.size(); }
+    uint32_t GetWidth(int32_t texture) const { return m_Textures[texture]->Levels[0].Width; }
+    uint32_t GetHeight(int32_t texture) const { return m_Textures[texture]->Levels[0].Height; }
+    uint32_t GetLevelCount(int32_t texture) const { return m_Textures[texture]->LevelCount; }
+
+    // Texel at uv, which repeats outside [0, 1), filtered over a footprint of the given width in uv units.
+    // The filter is stochastic: the random numbers in [0, 1) pick a single texel with the weights of
+    // trilinear filtering, so averaged over the samples of a pixel it is trilinear at one texel read.
+    // sRGB texels come back linear, normals in [-1, 1]. Safe to call from any thread.
+    glm::vec4 Sample(int32_t texture, const glm::vec2& uv, float footprint, const glm::vec3& random);
+
+    // Hits that took no lock reach the counts the next time their thread takes one
+    Stats GetStats() const;
+    void ResetStats();
+private:
+    struct TextureData
+    {
+        std::string Path;
+        Texture::Encoding Encoding;
+        uint32_t LevelCount;
+        Texture::Level Levels[Texture::MaxLevels];
+        Memory::MappedFile File;
+        const uint8_t* Tiles;   // In the file
+    };
+
+    // Slots are spread over shards by the hash of their key, each with a lock and an LRU list of its own
+    struct Shard
+    {
+        std::mutex Mutex;
+        std::unordered_map<uint64_t, uint32_t> Slots;   // Tile key to slot
+        uint32_t FirstSlot = 0, SlotCount = 0, UsedSlots = 0;
+        uint32_t Head = NoSlot, Tail = NoSlot;          // Most and least recently used
+        uint64_t Hits = 0, Misses = 0, Locked = 0, Evictions = 0;
+    };
+
+    static constexpr uint32_t NoSlot = ~0u;
+    static constexpr uint32_t MaxShards = 64;
+
+    uint32_t ReadTexel(int32_t texture, const TextureData& data, uint32_t tile, uint32_t offset);
+    void Unlink(Shard& shard, uint32_t slot);
+    void PushFront(Shard& shard, uint32_t slot);
+    std::string GetTileDirectory() const;
+private:
+    size_t m_Size = 0;
+    std::string m_TileDirectory;
+    std::vector<std::unique_ptr<TextureData>> m_Textures;
+    std::unordered_map<std::string, int32_t> m_Loaded;  // Encoding and path to handle
+
+    Memory::PageArray<uint8_t> m_Tiles;
+    std::vector<uint64_t> m_SlotKeys;
+    // Odd while the tile of the slot is being replaced, lookups that took no lock check it around their read
+    std::unique_ptr<std::atomic<uint32_t>[]> m_SlotVersions;
+    std::vector<uint32_t> m_Previous, m_Next;           // LRU lists of the shards
+    std::unique_ptr<Shard[]> m_Shards;
+    uint32_t m_ShardCount = 0;
+    uint64_t m_Generation = 0;  // Unique per cache and size, tiles threads remember are only valid for it
+};
@@ -0,0 +1,338 @@
+#include "ThreadPool.h"
+
+#include "Walnut/Timer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#endif
+
+namespace {
+
+    using Clock = std::chrono::steady_clock;
+
+#ifdef _WIN32
+    std::vector<LogicalProcessor> QueryTopology()
+    {
+        std::vector<LogicalProcessor> processors;
+
+        DWORD length = 0;
+        GetLogicalProcessorInformationEx(RelationAll, nullptr, &length);
+        std::vector<uint8_t> buffer(length);
+        if (!GetLogicalProcessorInformationEx(RelationAll, (PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX)buffer.data(), &length))
+            return processors;
+
+        auto forEachProcessor = [](const GROUP_AFFINITY& mask, auto&& func)
+        {
+            for (uint32_t bit = 0; bit < 64; bit++)
+            {
+                if (mask.Mask & (1ull << bit))
+                    func(mask.Group * 64u + bit);
+            }
+        };
+
+        uint32_t package = 0;
+        for (DWORD offset = 0; offset < length;)
+        {
+            auto info = (PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX)(buffer.data() + offset);
+            if (info->Relationship == RelationProcessorPackage)
+            {
+                for (WORD group = 0; group < info->Processor.GroupCount; group++)
+                {
+                    forEachProcessor(info->Processor.GroupMask[group], [&](uint32_t id)
+                        {
+                            processors.push_back({ id, package, 0 });
+                        });
+                }
+                package++;
+            }
+            offset += info->Size;
+        }
+
+        for (DWORD offset = 0; offset < length;)
+        {
+            auto info = (PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX)(buffer.data() + offset);
+            if (info->Relationship == RelationNumaNode)
+            {
+                forEachProcessor(info->NumaNode.GroupMask, [&](uint32_t id)
+                    {
+                        for (LogicalProcessor& processor : processors)
+                        {
+                            if (processor.Id == id)
+                                processor.Node = info->NumaNode.NodeNumber;
+                        }
+                    });
+            }
+            offset += info->Size;
+        }
+
+        return processors;
+    }
+
+    void PinThread(std::thread& thread, uint32_t id)
+    {
+        GROUP_AFFINITY affinity = {};
+        affinity.Group = (WORD)(id / 64);
+        affinity.Mask = (KAFFINITY)1 << (id % 64);
+        SetThreadGroupAffinity(thread.native_handle(), &affinity, nullptr);
+    }
+#else
+    // Some ARM systems and VMs report -1 for ids they do not know, those get the fallback too
+    uint32_t ReadNumber(const std::filesystem::path& path, uint32_t fallback)
+    {
+        std::ifstream file(path);
+        int64_t value;
+        return file >> value && value >= 0 && value <= UINT32_MAX ? (uint32_t)value : fallback;
+    }
+
+    // "cpu12" -> 12, anything else is not a processor directory
+    bool ParseIndexedName(const std::string& name, const char* prefix, uint32_t& index)
+    {
+        size_t length = strlen(prefix);
+        if (name.size() <= length || name.compare(0, length, prefix) != 0)
+            return false;
+        if (name.find_first_not_of("0123456789", length) != std::string::npos)
+            return false;
+        index = (uint32_t)std::stoul(name.substr(length));
+        return true;
+    }
+
+    std::vector<LogicalProcessor> QueryTopology()
+    {
+        namespace fs = std::filesystem;
+
+        // Processors outside the cpuset of the process can not be pinned to
+        cpu_set_t allowed;
+        CPU_ZERO(&allowed);
+        const bool restricted = sched_getaffinity(0, sizeof(allowed), &allowed) == 0;
+
+        std::vector<LogicalProcessor> processors;
+        std::error_code error;
+        for (const fs::directory_entry& entry : fs::directory_iterator("/sys/devices/system/cpu", error))
+        {
+            uint32_t id;
+            if (!ParseIndexedName(entry.path().filename().string(), "cpu", id))
+                continue;
+            if (restricted && (id >= CPU_SETSIZE || !CPU_ISSET(id, &allowed)))
+                continue;
+
+            // Offline processors have no topology directory
+            if (!fs::exists(entry.path() / "topology", error))
+                continue;
+
+            LogicalProcessor& processor = processors.emplace_back();
+            processor.Id = id;
+            processor.Package = ReadNumber(entry.path() / "topology" / "physical_package_id", 0);
+            processor.Node = 0;
+
+            for (const fs::directory_entry& child : fs::directory_iterator(entry.path(), error))
+            {
+                uint32_t node;
+                if (ParseIndexedName(child.path().filename().string(), "node", node))
+                    processor.Node = node;
+            }
+        }
+        return processors;
+    }
+
+    void PinThread(std::thread& thread, uint32_t id)
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(id, &set);
+        pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set);
+    }
+#endif
+
+}
+
+const std::vector<LogicalProcessor>& GetProcessorTopology()
+{
+    static const std::vector<LogicalProcessor> topology = []()
+    {
+        std::vector<LogicalProcessor> processors = QueryTopology();
+        if (processors.empty())
+        {
+            uint32_t count = std::max(std::thread::hardware_concurrency(), 1u);
+            for (uint32_t i = 0; i < count; i++)
+                processors.push_back({ i, 0, 0 });
+        }
+
+        std::sort(processors.begin(), processors.end(), [](const LogicalProcessor& a, const LogicalProcessor& b)
+            {
+                return a.Package != b.Package ? a.Package < b.Package : a.Id < b.Id;
+            });
+
+        // Package ids can have gaps, or belong to packages the cpuset excludes. They are
+        // renumbered 0, 1, ... in order so that every package index holds processors.
+        uint32_t package = 0, lastId = processors[0].Package;
+        for (LogicalProcessor& processor : processors)
+        {
+            if (processor.Package != lastId)
+            {
+                lastId = processor.Package;
+                package++;
+            }
+            processor.Package = package;
+        }
+        return processors;
+    }();
+    return topology;
+}
+
+uint32_t GetPackageCount()
+{
+    uint32_t count = 0;
+    for (const LogicalProcessor& processor : GetProcessorTopology())
+        count = std::max(count, processor.Package + 1);
+    return count;
+}
+
+ThreadPool::~ThreadPool()
+{
+    Stop();
+}
+
+void ThreadPool::Start(uint32_t workerCount, ThreadAffinity affinity)
+{
+    Stop();
+
+    const std::vector<LogicalProcessor>& processors = GetProcessorTopology();
+    if (workerCount == 0)
+        workerCount = (uint32_t)processors.size();
+
+    m_Affinity = affinity;
+    m_Stopping = false;
+    m_Stats.assign(workerCount, {});
+
+    // Processors of every package, for spreading workers over the sockets
+    std::vector<std::vector<uint32_t>> packages(GetPackageCount());
+    for (const LogicalProcessor& processor : processors)
+        packages[processor.Package].push_back(processor.Id);
+
+    for (uint32_t worker = 0; worker < workerCount; worker++)
+    {
+        std::thread& thread = m_Threads.emplace_back(&ThreadPool::WorkerMain, this, worker);
+
+        if (affinity == ThreadAffinity::Compact)
+        {
+            PinThread(thread, processors[worker % processors.size()].Id);
+        }
+        else if (affinity == ThreadAffinity::Spread)
+        {
+            const std::vector<uint32_t>& package = packages[worker % packages.size()];
+            PinThread(thread, package[(worker / packages.size()) % package.size()]);
+        }
+    }
+}
+
+void ThreadPool::Stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Stopping = true;
+    }
+    m_WakeCondition.notify_all();
+
+    for (std::thread& thread : m_Threads)
+        thread.join();
+    m_Threads.clear();
+
+    // Workers of the next Start() begin at generation 0 and must not take the last job for a new one
+    m_Generation = 0;
+    m_Job = nullptr;
+    m_JobCount = 0;
+}
+
+void ThreadPool::ParallelFor(uint32_t count, Schedule schedule, const std::function<void(uint32_t, uint32_t)>& func)
+{
+    Clock::time_point start = Clock::now();
+
+    if (m_Threads.empty())
+    {
+        for (uint32_t i = 0; i < count; i++)
+            func(i, 0);
+
+        m_WallTime = std::chrono::duration<double>(Clock::now() - start).count();
+        m_Stats.assign(1, { m_WallTime, count });
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Job = &func;
+        m_JobCount = count;
+        m_JobSchedule = schedule;
+        m_NextIndex.store(0, std::memory_order_relaxed);
+        m_Pending = (uint32_t)m_Threads.size();
+        m_Generation++;
+    }
+    m_WakeCondition.notify_all();
+
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    m_DoneCondition.wait(lock, [this]() { return m_Pending == 0; });
+    m_Job = nullptr;
+
+    m_WallTime = std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+void ThreadPool::WorkerMain(uint32_t worker)
+{
+    Walnut::Profiler::SetThreadName("Worker " + std::to_string(worker));
+    uint64_t generation = 0;
+
+    for (;;)
+    {
+        const std::function<void(uint32_t, uint32_t)>* job;
+        uint32_t count;
+        Schedule schedule;
+        {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            m_WakeCondition.wait(lock, [&]() { return m_Stopping || m_Generation != generation; });
+            if (m_Stopping)
+                return;
+
+            generation = m_Generation;
+            job = m_Job;
+            count = m_JobCount;
+            schedule = m_JobSchedule;
+        }
+
+        Clock::time_point start = Clock::now();
+        uint32_t tasks = 0;
+
+        if (schedule == Schedule::Static)
+        {
+            const uint32_t workerCount = (uint32_t)m_Threads.size();
+            const uint32_t first = (uint32_t)((uint64_t)worker * count / workerCount);
+            const uint32_t last = (uint32_t)((uint64_t)(worker + 1) * count / workerCount);
+            for (uint32_t i = first; i < last; i++, tasks++)
+                (*job)(i, worker);
+        }
+        else
+        {
+            for (uint32_t i = m_NextIndex.fetch_add(1, std::memory_order_relaxed); i < count;
+                i = m_NextIndex.fetch_add(1, std::memory_order_relaxed), tasks++)
+                (*job)(i, worker);
+        }
+
+        m_Stats[worker].BusyTime = std::chrono::duration<double>(Clock::now() - start).count();
+        m_Stats[worker].Tasks = tasks;
+
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        if (--m_Pending == 0)
+            m_DoneCondition.notify_one();
+    }
+}
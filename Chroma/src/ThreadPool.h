@@ -0,0 +1,88 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+enum class ThreadAffinity
+{
+    None = 0,       // Threads are left to the OS scheduler
+    Compact = 1,    // Pinned, filling one socket before moving on to the next
+    Spread = 2      // Pinned, alternating between sockets
+};
+
+enum class Schedule
+{
+    Dynamic = 0,    // Indices are handed out one at a time to whichever worker is free
+    Static = 1      // Worker w always gets the same contiguous range of indices
+};
+
+// One logical processor as seen by the OS
+struct LogicalProcessor
+{
+    uint32_t Id;        // Linux CPU number, or group * 64 + number on Windows
+    uint32_t Package;   // Socket, numbered from 0 without gaps
+    uint32_t Node;      // NUMA node
+};
+
+// Logical processors the process may run on, sorted by package, then id. Falls back to a single
+// package when the topology cannot be queried.
+const std::vector<LogicalProcessor>& GetProcessorTopology();
+uint32_t GetPackageCount();
+
+// Fixed set of worker threads for the renderer's parallel loops. Unlike std::execution::par it
+// lets us choose the worker count, pin workers and keep tile ownership stable between frames.
+class ThreadPool
+{
+public:
+    struct WorkerStats
+    {
+        double BusyTime = 0.0;  // In seconds, spent inside the loop body
+        uint32_t Tasks = 0;
+    };
+
+    ThreadPool() = default;
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // workerCount 0 uses every hardware thread
+    void Start(uint32_t workerCount, ThreadAffinity affinity);
+    void Stop();
+
+    // Calls func(index, worker) for every index in [0, count) and waits for all of them
+    void ParallelFor(uint32_t count, Schedule schedule, const std::function<void(uint32_t, uint32_t)>& func);
+
+    uint32_t GetWorkerCount() const { return (uint32_t)m_Threads.size(); }
+    ThreadAffinity GetAffinity() const { return m_Affinity; }
+
+    // Of the last ParallelFor call
+    const std::vector<WorkerStats>& GetWorkerStats() const { return m_Stats; }
+    double GetWallTime() const { return m_WallTime; }
+private:
+    void WorkerMain(uint32_t worker);
+private:
+    std::vector<std::thread> m_Threads;
+    ThreadAffinity m_Affinity = ThreadAffinity::None;
+
+    std::mutex m_Mutex;
+    std::condition_variable m_WakeCondition;
+    std::condition_variable m_DoneCondition;
+    uint64_t m_Generation = 0;
+    uint32_t m_Pending = 0;
+    bool m_Stopping = false;
+
+    // Current job, only changed while no worker is running
+    const std::function<void(uint32_t, uint32_t)>* m_Job = nullptr;
+    uint32_t m_JobCount = 0;
+    Schedule m_JobSchedule = Schedule::Dynamic;
+    std::atomic<uint32_t> m_NextIndex{ 0 };
+
+    std::vector<WorkerStats> m_Stats;
+    double m_WallTime = 0.0;
+};
@@ -1,9 +1,13 @@
 #pragma once
 
 #include <glm/glm.hpp>
+#include <cstdint>
+#include <cstring>
 #include <limits>
 
 namespace Utils {
+    constexpr size_t CacheLineSize = 64;
+
     // Convert a vector4 color to RGBA format for image display
     inline uint32_t ConvertToRGBA(const glm::vec4& color)
     {
@@ -15,6 +19,28 @@ namespace Utils {
         return (a << 24) | (b << 16) | (g << 8) | r;
     }
 
+    // FNV-1a over 8 byte words, fast enough for hundreds of megabytes. Not meant to resist attacks.
+    inline uint64_t HashBytes(const void* data, size_t size, uint64_t hash = 14695981039346656037ull)
+    {
+        constexpr uint64_t Prime = 1099511628211ull;
+        const uint8_t* bytes = (const uint8_t*)data;
+        for (; size >= 8; size -= 8, bytes += 8)
+        {
+            uint64_t word;
+            std::memcpy(&word, bytes, 8);
+            hash = (hash ^ word) * Prime;
+        }
+        for (; size > 0; size--, bytes++)
+            hash = (hash ^ *bytes) * Prime;
+        return hash;
+    }
+
+    // Rec. 709 luminance of a linear color
+    inline float Luminance(const glm::vec3& color)
+    {
+        return glm::dot(color, glm::vec3(0.2126f, 0.7152f, 0.0722f));
+    }
+
     // PCG hash function for random number generation
     inline uint32_t PCG_Hash(uint32_t input)
     {
@@ -6,6 +6,8 @@
 
 #include "Renderer.h"
 #include "Camera.h"
+#include "Checkpoint.h"
+#include "Scenes.h"
 #include "Shapes.h"
 
 #include <glm/gtc/type_ptr.hpp>
@@ -18,73 +20,13 @@ public:
     ExampleLayer()
         : m_Camera(45.0f, 0.1f, 100.0f)
     {
-        CreateMaterials();
-        CreateScene();
-    }
-
-    void CreateMaterials()
-    {
-        // Floor material
-        Material& floorMaterial = m_Scene.Materials.emplace_back();
-        floorMaterial.Albedo = { 0.9f, 0.9f, 0.9f };     // White
-        floorMaterial.Roughness = 0.8f;
-        floorMaterial.Metallic = 0.0f;
-        floorMaterial.ReflectionStrength = 0.05f;
-
-        // Glass material
-        Material& glassMaterial = m_Scene.Materials.emplace_back();
-        glassMaterial.Albedo = { 0.9f, 0.9f, 1.0f };     // Very slight blue tint
-        glassMaterial.Roughness = 0.0f;                  // Perfectly smooth
-        glassMaterial.Metallic = 0.0f;
-        glassMaterial.ReflectionStrength = 0.3f;
-        glassMaterial.ReflectionTint = { 0.95f, 0.95f, 1.0f };
-        glassMaterial.Transparency = 0.95f;              // High transparency
-        glassMaterial.IndexOfRefraction = 1.52f;         // Glass IOR
-
-        // Red box material
-        Material& redMaterial = m_Scene.Materials.emplace_back();
-        redMaterial.Albedo = { 0.9f, 0.1f, 0.1f };       // Red
-        redMaterial.Roughness = 0.1f;                    // Smooth
-        redMaterial.Metallic = 1.0f;
-        redMaterial.ReflectionStrength = 0.8f;
-
-        // Green box material
-        Material& greenMaterial = m_Scene.Materials.emplace_back();
-        greenMaterial.Albedo = { 0.1f, 0.9f, 0.1f };     // Green
-        greenMaterial.Roughness = 0.4f;                  // Moderate roughness
-        greenMaterial.Metallic = 0.0f;
-        greenMaterial.ReflectionStrength = 0.2f;
-
-        // Light source material
-        Material& lightMaterial = m_Scene.Materials.emplace_back();
-        lightMaterial.EmissionColor = { 1.0f, 0.9f, 0.7f }; // Warm white
-        lightMaterial.EmissionPower = 25.0f;                // Bright light
-    }
-
-    void CreateScene()
-    {
-        // Add a plane as a floor
-        Shapes::AddPlane(m_Scene, glm::vec3(0.0f, 1.0f, 0.0f), 0.0f, 0);
-
-        // Add the glass sphere
-        Shapes::AddSphere(m_Scene, glm::vec3(0.0f, 1.0f, 0.0f), 1.0f, 1);
-
-        // Add a red box
-        Shapes::AddCube(m_Scene, glm::vec3(3.0f, 1.0f, 0.0f), 1.0f, 2);
-
-        // Add a green box
-        Shapes::AddCube(m_Scene, glm::vec3(-3.0f, 0.5f, 0.0f), 1.0f, 3);
-
-        // Add a green pyramid
-        Shapes::AddPyramid(m_Scene, glm::vec3(0.0f, 0.0f, -2.0f), 2.0f, 2.0f, 3);
-
-        // Add a light source
-        Shapes::AddSphere(m_Scene, glm::vec3(0.0f, 5.0f, 0.0f), 0.5f, 4);
+        Scenes::CreateDefault(m_Scene);
     }
 
     virtual void OnUpdate(float ts) override
     {
-        if (m_Camera.OnUpdate(ts))
+        m_CameraMoved = m_Camera.OnUpdate(ts);
+        if (m_CameraMoved)
             m_Renderer.ResetFrameIndex();
     }
 
@@ -102,13 +44,216 @@ public:
 
         ImGui::SliderInt("Anti-aliasing", &m_Renderer.GetSettings().SamplesPerPixel, 1, 16);
 
+        ImGui::DragFloat("Exposure", &m_Renderer.GetSettings().Exposure, 0.05f, -10.0f, 10.0f);
+        const char* tonemappers[] = { "None", "Reinhard", "ACES" };
+        int tonemap = (int)m_Renderer.GetSettings().Tonemap;
+        if (ImGui::Combo("Tonemapper", &tonemap, tonemappers, IM_ARRAYSIZE(tonemappers)))
+            m_Renderer.GetSettings().Tonemap = (Resolve::Tonemapper)tonemap;
+
+        const std::string halfFormat = "RGB Half (preview, " + std::to_string(AccumulationBuffer::MaxHalfSamples) + " samples)";
+        const char* accumulationFormats[] = { "RGB Float", "RGB Kahan", "RGB Double", halfFormat.c_str() };
+        int accumulation = (int)m_Renderer.GetSettings().Accumulation;
+        if (ImGui::Combo("Accumulation", &accumulation, accumulationFormats, IM_ARRAYSIZE(accumulationFormats)))
+            m_Renderer.GetSettings().Accumulation = (AccumulationFormat)accumulation;
+        ImGui::Text("Accumulation memory: %.1fMB", m_Renderer.GetAccumulationMemory() / (1024.0f * 1024.0f));
+
+        int threads = (int)m_Renderer.GetSettings().ThreadCount;
+        if (ImGui::SliderInt("Threads (0 = all)", &threads, 0, (int)GetProcessorTopology().size()))
+            m_Renderer.GetSettings().ThreadCount = (uint32_t)threads;
+        const char* affinities[] = { "None", "Compact", "Spread" };
+        int affinity = (int)m_Renderer.GetSettings().Affinity;
+        if (ImGui::Combo("Thread affinity", &affinity, affinities, IM_ARRAYSIZE(affinities)))
+            m_Renderer.GetSettings().Affinity = (ThreadAffinity)affinity;
+        ImGui::Checkbox("NUMA-local tiles", &m_Renderer.GetSettings().NUMALocal);
+
+        const char* heatmaps[] = { "Shaded", "Intersection tests", "Traversal steps", "Bounces", "Cycles" };
+        Heatmap::Metric& heatmap = m_Renderer.GetSettings().Heatmap;
+        if (ImGui::BeginCombo("Heatmap", heatmaps[(int)heatmap]))
+        {
+            for (uint32_t i = 0; i < Heatmap::MetricCount; i++)
+            {
+                const Heatmap::Metric metric = (Heatmap::Metric)i;
+#if !CHROMA_STATS
+                // Nothing counts these without CHROMA_STATS, they would be zero everywhere
+                if (metric == Heatmap::Metric::IntersectionTests || metric == Heatmap::Metric::TraversalSteps)
+                    continue;
+#endif
+                if (ImGui::Selectable(heatmaps[i], metric == heatmap))
+                    heatmap = metric;
+            }
+            ImGui::EndCombo();
+        }
+        if (m_Renderer.GetSettings().Heatmap != Heatmap::Metric::None)
+            ImGui::Text("Heatmap red: %.1f, max %.1f per pixel", m_Renderer.GetHeatmapScaleTop(), m_Renderer.GetMaxCost());
+
+        // Scene edits only restart the tiles whose paths interacted with what changed
+        int invalidationDepth = (int)m_Renderer.GetSettings().InvalidationDepth;
+        if (ImGui::SliderInt("Edit invalidation depth (0 = exact)", &invalidationDepth, 0, 5))
+            m_Renderer.GetSettings().InvalidationDepth = (uint32_t)invalidationDepth;
+
+        // Drag with the left mouse button in the viewport to crop, a click clears it
+        Renderer::Rect& crop = m_Renderer.GetSettings().Crop;
+        if (!crop.IsEmpty())
+        {
+            ImGui::Text("Crop: %u, %u  %ux%u", crop.X, crop.Y, crop.Width, crop.Height);
+            ImGui::SameLine();
+            if (ImGui::Button("Clear crop"))
+                crop = {};
+        }
+        // Rendering stops once a target is reached and resumes on any change
+        int maxSamples = (int)m_Renderer.GetSettings().MaxSamples;
+        if (ImGui::DragInt("Max samples (0 = none)", &maxSamples, 1.0f, 0, 1 << 20))
+            m_Renderer.GetSettings().MaxSamples = (uint32_t)maxSamples;
+        ImGui::DragFloat("Max time (s, 0 = none)", &m_Renderer.GetSettings().MaxTime, 0.5f, 0.0f, 3600.0f, "%.1f");
+        ImGui::DragFloat("Noise threshold (0 = none)", &m_Renderer.GetSettings().NoiseThreshold, 0.001f, 0.0f, 1.0f, "%.3f");
+        if (m_Renderer.IsConverged())
+            ImGui::Text("Converged after %.1fs", m_Renderer.GetAccumulationTime());
+        else
+            ImGui::Text("Converged tiles: %u of %u, noise %.3f", m_Renderer.GetConvergedTileCount(), m_Renderer.GetTileCount(),
+                m_Renderer.GetNoiseEstimate());
+
+        // Long renders survive a crash, the checkpoint is written between frames and flushed in the background
+        ImGui::Checkbox("Checkpoint every 30s", &m_Checkpointing);
+        ImGui::SameLine();
+        if (ImGui::Button("Resume checkpoint"))
+        {
+            const bool resumed = OpenCheckpoint() && m_Renderer.ResumeCheckpoint(m_Checkpoint, m_Scene, m_Camera);
+            m_CheckpointStatus = resumed ? "Resumed " + std::string(CheckpointPath)
+                : "No checkpoint of this scene and viewport size in " + std::string(CheckpointPath);
+        }
+        if (!m_CheckpointStatus.empty())
+            ImGui::TextUnformatted(m_CheckpointStatus.c_str());
+
+        // Other processes map the resolved frames by name, ChromaReader shows how
+        bool outputChanged = ImGui::Checkbox("Share frames", &m_SharingFrames);
+        ImGui::SameLine();
+        outputChanged |= ImGui::Checkbox("Radiance", &m_ShareRadiance);
+        ImGui::SameLine();
+        outputChanged |= ImGui::Checkbox("Samples", &m_ShareSamples);
+        if (outputChanged)
+            UpdateFrameOutput();
+        if (m_FrameOutput.IsOpen())
+            ImGui::Text("Shared as %s, frame %llu", FrameOutputName, (unsigned long long)m_FrameOutput.GetFrameCount());
+
+        // High sample counts stay interactive, the tiles near the cursor are refined first
+        ImGui::SliderFloat("Frame budget (ms, 0 = whole frame)", &m_Renderer.GetSettings().FrameBudget, 0.0f, 100.0f, "%.1f");
+
+        int cropInterval = (int)m_Renderer.GetSettings().CropOutsideInterval;
+        if (ImGui::SliderInt("Outside crop every N frames (0 = frozen)", &cropInterval, 0, 64))
+            m_Renderer.GetSettings().CropOutsideInterval = (uint32_t)cropInterval;
+
+        // Only how many texture tiles stay in memory, the image does not change
+        int textureCacheMB = (int)(m_Renderer.GetSettings().TextureCacheSize >> 20);
+        if (ImGui::SliderInt("Texture cache (MB)", &textureCacheMB, 1, 1024))
+            m_Renderer.GetSettings().TextureCacheSize = (size_t)textureCacheMB << 20;
+
         if (ImGui::Button("Reset"))
             m_Renderer.ResetFrameIndex();
 
         ImGui::End();
 
+        ImGui::Begin("Stats");
+        std::string kernel;
+        for (uint32_t bit = 0; bit < RenderPolicy::FeatureCount; bit++)
+        {
+            const RenderPolicy::Feature feature = (RenderPolicy::Feature)(1u << bit);
+            if (m_Renderer.GetKernelFeatures() & feature)
+                kernel += std::string(kernel.empty() ? "" : " ") + RenderPolicy::GetFeatureName(feature);
+        }
+        ImGui::TextWrapped("Kernel: %s", kernel.empty() ? "-" : kernel.c_str());
+        ImGui::Text("ISA: %s (supported: %s)", ISA::GetLevelName(ISA::GetLevel()), ISA::GetLevelName(ISA::GetSupportedLevel()));
+        ImGui::Text("Last scene edit restarted %u of %u tiles", m_Renderer.GetInvalidatedTiles(), m_Renderer.GetTileCount());
+        if (m_Renderer.GetKernelFeatures() & RenderPolicy::Textures)
+        {
+            const TextureCache::Stats textures = m_Renderer.GetTextureCache().GetStats();
+            ImGui::Text("Texture tiles: %u of %u, hit rate %.1f%%, %llu evicted", textures.ResidentTiles, textures.CapacityTiles,
+                textures.GetHitRate() * 100.0, (unsigned long long)textures.Evictions);
+        }
+#if CHROMA_STATS
+        const Stats::FrameStats& stats = m_Renderer.GetStats();
+        const double pixels = (double)m_Renderer.GetRenderedPixelCount();
+        const double paths = pixels * m_Renderer.GetSettings().SamplesPerPixel;
+        const double rays = (double)stats.GetRays();
+
+        ImGui::Text("Render: %.3fms on %u threads", stats.RenderTime * 1e3, stats.Workers);
+        ImGui::Text("Rendered %u of %u tiles", m_Renderer.GetRenderedTileCount(), m_Renderer.GetTileCount());
+        ImGui::Text("Trace: %.3fms  Shade: %.3fms (thread time)", stats.TraceTime * 1e3, stats.ShadeTime * 1e3);
+        ImGui::Text("Resolve: %.3fms  Upload: %.3fms", stats.ResolveTime * 1e3, stats.UploadTime * 1e3);
+        ImGui::Separator();
+        ImGui::Text("Primary rays: %llu", (unsigned long long)stats.Totals.PrimaryRays);
+        ImGui::Text("Secondary rays: %llu", (unsigned long long)stats.Totals.SecondaryRays);
+        ImGui::Text("Mrays/s: %.2f", stats.RenderTime > 0.0 ? rays / stats.RenderTime * 1e-6 : 0.0);
+        ImGui::Text("BVH nodes / ray: %.2f", rays > 0.0 ? stats.Totals.NodesVisited / rays : 0.0);
+        const char* shapeNames[] = { "Sphere", "Plane", "Box", "Triangle" };
+        for (uint32_t type = 0; type < Stats::ShapeTypeCount; type++)
+        {
+            ImGui::Text("%s tests / ray: %.2f", shapeNames[type],
+                rays > 0.0 ? stats.Totals.IntersectionTests[type] / rays : 0.0);
+        }
+        ImGui::Text("Sky hits: %.1f%%  Emitter hits: %.1f%%", paths > 0.0 ? stats.Totals.SkyHits / paths * 100.0 : 0.0,
+            rays > 0.0 ? stats.Totals.EmitterHits / rays * 100.0 : 0.0);
+
+        float depths[Stats::MaxPathDepth + 1];
+        for (uint32_t depth = 0; depth <= Stats::MaxPathDepth; depth++)
+            depths[depth] = paths > 0.0 ? (float)(stats.Totals.PathDepth[depth] / paths) : 0.0f;
+        ImGui::PlotHistogram("Path depth", depths, Stats::MaxPathDepth + 1, 0, nullptr, 0.0f, 1.0f, ImVec2(0, 60));
+#else
+        ImGui::Text("Built without CHROMA_STATS");
+#endif
+
+        ImGui::Separator();
+        ImGui::Checkbox("Hardware counters", &m_Renderer.GetSettings().PerfCounters);
+        if (m_Renderer.GetSettings().PerfCounters)
+        {
+            if (!PerfCounters::IsAvailable())
+            {
+                ImGui::TextWrapped("Unavailable: %s", PerfCounters::GetUnavailableReason().c_str());
+            }
+            else
+            {
+                auto showPhase = [](const char* name, const PerfCounters::Sample& sample)
+                {
+                    // Misses per thousand instructions
+                    const double kiloInstructions = sample.Get(PerfCounters::Counter::Instructions) * 1e-3;
+                    auto mpki = [&](PerfCounters::Counter counter)
+                    {
+                        return sample.Has(counter) && kiloInstructions > 0.0 ? sample.Get(counter) / kiloInstructions : 0.0;
+                    };
+                    ImGui::Text("%s: %.1f Mcycles, IPC %.2f", name, sample.Get(PerfCounters::Counter::Cycles) * 1e-6, sample.GetIPC());
+                    ImGui::Text("  MPKI L1D %.2f  LLC %.2f  branch %.2f", mpki(PerfCounters::Counter::L1DMisses),
+                        mpki(PerfCounters::Counter::LLCMisses), mpki(PerfCounters::Counter::BranchMisses));
+                };
+                showPhase("Render", m_Renderer.GetPerfCounters().Render);
+                showPhase("Resolve", m_Renderer.GetPerfCounters().Resolve);
+            }
+        }
+
+        ImGui::Separator();
+        if (!Profiler::IsCapturing())
+        {
+            if (ImGui::Button("Start trace capture"))
+                Profiler::BeginCapture();
+        }
+        else if (ImGui::Button("Stop and save trace"))
+        {
+            Profiler::EndCapture();
+            bool saved = Profiler::ExportChromeTrace("Chroma.trace.json") && Profiler::ExportPerfettoTrace("Chroma.perfetto-trace");
+            m_TraceStatus = saved ? "Saved Chroma.trace.json and Chroma.perfetto-trace" : "Failed to write the trace";
+        }
+        if (!m_TraceStatus.empty())
+            ImGui::TextUnformatted(m_TraceStatus.c_str());
+        ImGui::End();
+
         ImGui::Begin("Scene");
 
+        // Edits go into the scene journal, the renderer works out from it what to update
+        SceneJournal& journal = m_Scene.Journal;
+        auto editMaterialIndex = [&](int& materialIndex, ObjectType object, size_t index)
+        {
+            if (ImGui::DragInt("Material", &materialIndex, 1.0f, 0, (int)m_Scene.Materials.size() - 1))
+                journal.Record(ChangeKind::Material, object, (uint32_t)index);
+        };
+
         // Sphere section
         if (ImGui::CollapsingHeader("Spheres"))
         {
@@ -117,21 +262,27 @@ public:
                 ImGui::PushID(i);
 
                 Sphere& sphere = m_Scene.Spheres[i];
-                ImGui::DragFloat3("Position", glm::value_ptr(sphere.Position), 0.1f);
-                ImGui::DragFloat("Radius", &sphere.Radius, 0.1f);
-                ImGui::DragInt("Material", &sphere.MaterialIndex, 1.0f, 0, (int)m_Scene.Materials.size() - 1);
+                if (ImGui::DragFloat3("Position", glm::value_ptr(sphere.Position), 0.1f))
+                    journal.Record(ChangeKind::Transform, ObjectType::Sphere, (uint32_t)i);
+                if (ImGui::DragFloat("Radius", &sphere.Radius, 0.1f))
+                    journal.Record(ChangeKind::Geometry, ObjectType::Sphere, (uint32_t)i);
+                editMaterialIndex(sphere.MaterialIndex, ObjectType::Sphere, i);
+                bool remove = ImGui::Button("Remove");
 
                 ImGui::Separator();
 
                 ImGui::PopID();
+
+                if (remove)
+                {
+                    Shapes::Remove(m_Scene, ShapeType::Sphere, (uint32_t)i);
+                    break;
+                }
             }
 
             // Add new sphere button
             if (ImGui::Button("Add Sphere"))
-            {
                 Shapes::AddSphere(m_Scene, glm::vec3(0.0f), 0.5f, 0);
-                m_Renderer.ResetFrameIndex();
-            }
         }
 
         // Plane section
@@ -142,21 +293,27 @@ public:
                 ImGui::PushID(i + 1000); // Offset to avoid ID conflicts
 
                 Plane& plane = m_Scene.Planes[i];
-                ImGui::DragFloat3("Normal", glm::value_ptr(plane.Normal), 0.1f);
-                ImGui::DragFloat("Distance", &plane.Distance, 0.1f);
-                ImGui::DragInt("Material", &plane.MaterialIndex, 1.0f, 0, (int)m_Scene.Materials.size() - 1);
+                if (ImGui::DragFloat3("Normal", glm::value_ptr(plane.Normal), 0.1f))
+                    journal.Record(ChangeKind::Transform, ObjectType::Plane, (uint32_t)i);
+                if (ImGui::DragFloat("Distance", &plane.Distance, 0.1f))
+                    journal.Record(ChangeKind::Transform, ObjectType::Plane, (uint32_t)i);
+                editMaterialIndex(plane.MaterialIndex, ObjectType::Plane, i);
+                bool remove = ImGui::Button("Remove");
 
                 ImGui::Separator();
 
                 ImGui::PopID();
+
+                if (remove)
+                {
+                    Shapes::Remove(m_Scene, ShapeType::Plane, (uint32_t)i);
+                    break;
+                }
             }
 
             // Add new plane button
             if (ImGui::Button("Add Plane"))
-            {
                 Shapes::AddPlane(m_Scene, glm::vec3(0.0f, 1.0f, 0.0f), 0.0f, 0);
-                m_Renderer.ResetFrameIndex();
-            }
         }
 
         // Box section
@@ -167,21 +324,27 @@ public:
                 ImGui::PushID(i + 2000); // Offset to avoid ID conflicts
 
                 Box& box = m_Scene.Boxes[i];
-                ImGui::DragFloat3("Min", glm::value_ptr(box.Min), 0.1f);
-                ImGui::DragFloat3("Max", glm::value_ptr(box.Max), 0.1f);
-                ImGui::DragInt("Material", &box.MaterialIndex, 1.0f, 0, (int)m_Scene.Materials.size() - 1);
+                if (ImGui::DragFloat3("Min", glm::value_ptr(box.Min), 0.1f))
+                    journal.Record(ChangeKind::Geometry, ObjectType::Box, (uint32_t)i);
+                if (ImGui::DragFloat3("Max", glm::value_ptr(box.Max), 0.1f))
+                    journal.Record(ChangeKind::Geometry, ObjectType::Box, (uint32_t)i);
+                editMaterialIndex(box.MaterialIndex, ObjectType::Box, i);
+                bool remove = ImGui::Button("Remove");
 
                 ImGui::Separator();
 
                 ImGui::PopID();
+
+                if (remove)
+                {
+                    Shapes::Remove(m_Scene, ShapeType::Box, (uint32_t)i);
+                    break;
+                }
             }
 
             // Add new box button
             if (ImGui::Button("Add Box"))
-            {
                 Shapes::AddCube(m_Scene, glm::vec3(0.0f), 1.0f, 0);
-                m_Renderer.ResetFrameIndex();
-            }
         }
 
         // Triangle section
@@ -192,14 +355,23 @@ public:
                 ImGui::PushID(i + 3000); // Offset to avoid ID conflicts
 
                 Triangle& triangle = m_Scene.Triangles[i];
-                ImGui::DragFloat3("Vertex 0", glm::value_ptr(triangle.v0), 0.1f);
-                ImGui::DragFloat3("Vertex 1", glm::value_ptr(triangle.v1), 0.1f);
-                ImGui::DragFloat3("Vertex 2", glm::value_ptr(triangle.v2), 0.1f);
-                ImGui::DragInt("Material", &triangle.MaterialIndex, 1.0f, 0, (int)m_Scene.Materials.size() - 1);
+                bool moved = ImGui::DragFloat3("Vertex 0", glm::value_ptr(triangle.v0), 0.1f);
+                moved |= ImGui::DragFloat3("Vertex 1", glm::value_ptr(triangle.v1), 0.1f);
+                moved |= ImGui::DragFloat3("Vertex 2", glm::value_ptr(triangle.v2), 0.1f);
+                if (moved)
+                    journal.Record(ChangeKind::Geometry, ObjectType::Triangle, (uint32_t)i);
+                editMaterialIndex(triangle.MaterialIndex, ObjectType::Triangle, i);
+                bool remove = ImGui::Button("Remove");
 
                 ImGui::Separator();
 
                 ImGui::PopID();
+
+                if (remove)
+                {
+                    Shapes::Remove(m_Scene, ShapeType::Triangle, (uint32_t)i);
+                    break;
+                }
             }
 
             // Add new triangle button
@@ -211,18 +383,28 @@ public:
                     glm::vec3(0.0f, 1.0f, 0.0f)
                 );
                 triangle.MaterialIndex = 0;
-                m_Scene.Triangles.push_back(triangle);
-                m_Renderer.ResetFrameIndex();
+                Shapes::AddTriangle(m_Scene, triangle);
             }
 
             // Add pyramid button (convenience)
             if (ImGui::Button("Add Pyramid"))
-            {
                 Shapes::AddPyramid(m_Scene, glm::vec3(0.0f), 1.0f, 1.0f, 0);
-                m_Renderer.ResetFrameIndex();
-            }
         }
 
+        // Texture section, materials refer to the images by index
+        for (size_t i = 0; i < m_Scene.Textures.size(); i++)
+            ImGui::Text("Texture %zu: %s", i, m_Scene.Textures[i].c_str());
+        for (const std::string& error : m_Renderer.GetTextureErrors())
+            ImGui::TextWrapped("%s", error.c_str());
+        ImGui::InputText("##TexturePath", m_TexturePath, sizeof(m_TexturePath));
+        ImGui::SameLine();
+        if (ImGui::Button("Add Texture") && m_TexturePath[0])
+        {
+            m_Scene.Textures.push_back(m_TexturePath);
+            journal.Record(ChangeKind::Add, ObjectType::Texture, (uint32_t)m_Scene.Textures.size() - 1);
+        }
+        ImGui::Separator();
+
         // Material section
         for (size_t i = 0; i < m_Scene.Materials.size(); i++)
         {
@@ -232,19 +414,31 @@ public:
 
             if (ImGui::TreeNode(("Material " + std::to_string(i)).c_str()))
             {
-                ImGui::ColorEdit3("Albedo", glm::value_ptr(material.Albedo));
-                ImGui::DragFloat("Roughness", &material.Roughness, 0.05f, 0.0f, 1.0f);
-                ImGui::DragFloat("Metallic", &material.Metallic, 0.05f, 0.0f, 1.0f);
+                bool changed = ImGui::ColorEdit3("Albedo", glm::value_ptr(material.Albedo));
+                changed |= ImGui::DragFloat("Roughness", &material.Roughness, 0.05f, 0.0f, 1.0f);
+                changed |= ImGui::DragFloat("Metallic", &material.Metallic, 0.05f, 0.0f, 1.0f);
 
                 // Add these new controls
-                ImGui::DragFloat("Reflection Strength", &material.ReflectionStrength, 0.05f, 0.0f, 1.0f);
-                ImGui::ColorEdit3("Reflection Tint", glm::value_ptr(material.ReflectionTint));
+                changed |= ImGui::DragFloat("Reflection Strength", &material.ReflectionStrength, 0.05f, 0.0f, 1.0f);
+                changed |= ImGui::ColorEdit3("Reflection Tint", glm::value_ptr(material.ReflectionTint));
+
+                changed |= ImGui::ColorEdit3("Emission Color", glm::value_ptr(material.EmissionColor));
+                changed |= ImGui::DragFloat("Emission Power", &material.EmissionPower, 0.05f, 0.0f, FLT_MAX);
 
-                ImGui::ColorEdit3("Emission Color", glm::value_ptr(material.EmissionColor));
-                ImGui::DragFloat("Emission Power", &material.EmissionPower, 0.05f, 0.0f, FLT_MAX);
+                changed |= ImGui::DragFloat("Transparency", &material.Transparency, 0.05f, 0.0f, 1.0f);
+                changed |= ImGui::DragFloat("Index of Refraction", &material.IndexOfRefraction, 0.05f, 1.0f, 3.0f);
 
-                ImGui::DragFloat("Transparency", &material.Transparency, 0.05f, 0.0f, 1.0f);
-                ImGui::DragFloat("Index of Refraction", &material.IndexOfRefraction, 0.05f, 1.0f, 3.0f);
+                // Texture indices, -1 for none
+                changed |= ImGui::InputInt("Albedo Texture", &material.AlbedoTexture);
+                changed |= ImGui::InputInt("Roughness Texture", &material.RoughnessTexture);
+                changed |= ImGui::InputInt("Normal Texture", &material.NormalTexture);
+                changed |= ImGui::DragFloat("Texture Scale", &material.TextureScale, 0.05f, 0.01f, 100.0f);
+                material.AlbedoTexture = std::max(material.AlbedoTexture, -1);
+                material.RoughnessTexture = std::max(material.RoughnessTexture, -1);
+                material.NormalTexture = std::max(material.NormalTexture, -1);
+
+                if (changed)
+                    journal.Record(ChangeKind::Material, ObjectType::Material, (uint32_t)i);
 
                 ImGui::TreePop();
             }
@@ -261,7 +455,7 @@ public:
             material.Roughness = 0.5f;
             material.Metallic = 0.0f;
             m_Scene.Materials.push_back(material);
-            m_Renderer.ResetFrameIndex();
+            journal.Record(ChangeKind::Add, ObjectType::Material, (uint32_t)m_Scene.Materials.size() - 1);
         }
 
         ImGui::End();
@@ -275,7 +469,12 @@ public:
         auto image = m_Renderer.GetFinalImage();
         if (image)
             ImGui::Image(image->GetDescriptorSet(), { (float)image->GetWidth(), (float)image->GetHeight() },
-                ImVec2(0, 1), ImVec2(1, 0));
+                ImVec2(0, image->GetUVMaxY()), ImVec2(image->GetUVMaxX(), 0));
+        if (image)
+        {
+            UpdateCrop(image->GetWidth(), image->GetHeight());
+            UpdateFocus(image->GetHeight());
+        }
 
         ImGui::End();
         ImGui::PopStyleVar();
@@ -283,6 +482,82 @@ public:
         Render();
     }
 
+    // The image is shown upside down, row 0 of the renderer is at the bottom of the viewport
+    void UpdateCrop(uint32_t width, uint32_t height)
+    {
+        const ImVec2 origin = ImGui::GetItemRectMin();
+        const ImVec2 mouse = ImGui::GetMousePos();
+        const float x = glm::clamp(mouse.x - origin.x, 0.0f, (float)width);
+        const float y = glm::clamp(mouse.y - origin.y, 0.0f, (float)height);
+
+        if (ImGui::IsItemHovered() && ImGui::IsMouseClicked(ImGuiMouseButton_Left))
+        {
+            m_CropDragging = true;
+            m_CropStart = ImVec2(x, y);
+        }
+
+        Renderer::Rect& crop = m_Renderer.GetSettings().Crop;
+        if (m_CropDragging)
+        {
+            const float minX = glm::min(m_CropStart.x, x), maxX = glm::max(m_CropStart.x, x);
+            const float minY = glm::min(m_CropStart.y, y), maxY = glm::max(m_CropStart.y, y);
+            ImGui::GetWindowDrawList()->AddRect(ImVec2(origin.x + minX, origin.y + minY),
+                ImVec2(origin.x + maxX, origin.y + maxY), IM_COL32(255, 255, 255, 160));
+
+            if (ImGui::IsMouseReleased(ImGuiMouseButton_Left))
+            {
+                m_CropDragging = false;
+                crop = {};
+                if (maxX - minX >= 4.0f && maxY - minY >= 4.0f)
+                {
+                    crop.X = (uint32_t)minX;
+                    crop.Y = height - (uint32_t)maxY;
+                    crop.Width = (uint32_t)maxX - crop.X;
+                    crop.Height = (uint32_t)maxY - (uint32_t)minY;
+                }
+            }
+        }
+        else if (!crop.IsEmpty())
+        {
+            const float top = (float)height - (float)(crop.Y + crop.Height);
+            ImGui::GetWindowDrawList()->AddRect(ImVec2(origin.x + crop.X, origin.y + top),
+                ImVec2(origin.x + crop.X + crop.Width, origin.y + top + crop.Height), IM_COL32(255, 200, 0, 200));
+        }
+    }
+
+    // Budgeted frames spiral out from the hovered pixel, or the centre
+    void UpdateFocus(uint32_t height)
+    {
+        Renderer::Settings& settings = m_Renderer.GetSettings();
+        settings.FocusX = settings.FocusY = -1;
+        if (!ImGui::IsItemHovered())
+            return;
+
+        const ImVec2 origin = ImGui::GetItemRectMin();
+        const ImVec2 mouse = ImGui::GetMousePos();
+        settings.FocusX = (int32_t)(mouse.x - origin.x);
+        settings.FocusY = (int32_t)height - 1 - (int32_t)(mouse.y - origin.y);
+    }
+
+    void UpdateFrameOutput()
+    {
+        const uint32_t channels = (m_ShareRadiance ? (uint32_t)SharedFrame::Radiance : 0u) | (m_ShareSamples ? (uint32_t)SharedFrame::Samples : 0u);
+        if (m_SharingFrames && m_FrameOutput.Open(FrameOutputName, channels))
+        {
+            m_Renderer.SetFrameOutput(&m_FrameOutput);
+        }
+        else
+        {
+            m_Renderer.SetFrameOutput(nullptr);
+            m_FrameOutput.Close();
+        }
+    }
+
+    bool OpenCheckpoint()
+    {
+        return m_Checkpoint.IsOpen() || m_Checkpoint.Open(CheckpointPath);
+    }
+
     void Render()
     {
         Timer timer;
@@ -290,16 +565,42 @@ public:
         m_Renderer.OnResize(m_ViewportWidth, m_ViewportHeight);
         m_Camera.OnResize(m_ViewportWidth, m_ViewportHeight);
         m_Renderer.Render(m_Scene, m_Camera);
+        m_Renderer.ResolveImage();
 
         m_LastRenderTime = timer.ElapsedMillis();
+
+        if (m_Checkpointing && OpenCheckpoint() && m_Checkpoint.GetAge() >= CheckpointInterval)
+            m_Renderer.WriteCheckpoint(m_Checkpoint, m_Scene, m_Camera);
+
+        // Any input wakes the loop up again, and with it the renderer
+        if (m_Renderer.IsConverged() && !m_CameraMoved && !m_CropDragging)
+            Walnut::Application::Get().SetIdle();
     }
 private:
     Renderer m_Renderer;
     Camera m_Camera;
     Scene m_Scene;
     uint32_t m_ViewportWidth = 0, m_ViewportHeight = 0;
+    bool m_CameraMoved = false;
+    bool m_CropDragging = false;
+    ImVec2 m_CropStart;
 
     float m_LastRenderTime = 0.0f;
+    std::string m_TraceStatus;
+
+    static constexpr const char* CheckpointPath = "Chroma.checkpoint";
+    static constexpr double CheckpointInterval = 30.0;
+    Checkpoint m_Checkpoint;
+    bool m_Checkpointing = false;
+    std::string m_CheckpointStatus;
+
+    static constexpr const char* FrameOutputName = "chroma-frame";
+    FrameOutput m_FrameOutput;
+    bool m_SharingFrames = false;
+    bool m_ShareRadiance = true;
+    bool m_ShareSamples = false;
+
+    char m_TexturePath[256] = {};
 };
 
 Walnut::Application* Walnut::CreateApplication(int argc, char** argv)
@@ -0,0 +1,68 @@
+project "ChromaBench"
+   kind "ConsoleApp"
+   language "C++"
+   cppdialect "C++17"
+   targetdir "bin/%{cfg.buildcfg}"
+   staticruntime "off"
+
+   -- The renderer is compiled in from the Chroma sources, only the application entry point is left out
+   files
+   {
+      "src/**.h",
+      "src/**.cpp",
+
+      "../Chroma/src/**.h",
+      "../Chroma/src/**.cpp",
+   }
+
+   removefiles { "../Chroma/src/WalnutApp.cpp" }
+
+   includedirs
+   {
+      "src",
+      "../Chroma/src",
+
+      "../Walnut/vendor/imgui",
+      "../Walnut/vendor/glfw/include",
+      "../Walnut/vendor/glm",
+      "../Walnut/vendor/stb_image",
+      "../Walnut/vendor/glfw/deps",
+
+      "../Walnut/Walnut/src",
+
+      "%{IncludeDir.VulkanSDK}",
+   }
+
+   links
+   {
+       "Walnut"
+   }
+
+   targetdir ("../bin/" .. outputdir .. "/%{prj.name}")
+   objdir ("../bin-int/" .. outputdir .. "/%{prj.name}")
+
+   -- Kernels of every ISA level, see the root premake5.lua
+   ChromaKernelFlags()
+
+   filter "system:windows"
+      systemversion "latest"
+      defines { "WL_PLATFORM_WINDOWS" }
+
+   filter "configurations:Debug"
+      defines { "WL_DEBUG" }
+      runtime "Debug"
+      symbols "On"
+
+   filter "configurations:Release"
+      defines { "WL_RELEASE" }
+      runtime "Release"
+      optimize "On"
+      symbols "On"
+
+   -- Unlike Chroma and ChromaService, Dist keeps CHROMA_STATS: the per-ray statistics are part of
+   -- every benchmark report
+   filter "configurations:Dist"
+      defines { "WL_DIST" }
+      runtime "Release"
+      optimize "On"
+      symbols "Off"
@@ -0,0 +1,138 @@
+#include "Benchmark.h"
+
+#include "ISA.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+namespace Bench {
+
+    namespace {
+
+        using Clock = std::chrono::steady_clock;
+
+        double TimeBatches(const std::function<void()>& body, uint64_t batches)
+        {
+            Clock::time_point start = Clock::now();
+            for (uint64_t i = 0; i < batches; i++)
+                body();
+            return std::chrono::duration<double>(Clock::now() - start).count();
+        }
+
+        void WriteEscaped(FILE* file, const std::string& text)
+        {
+            for (char c : text)
+            {
+                if (c == '"' || c == '\\')
+                    fputc('\\', file);
+                fputc(c, file);
+            }
+        }
+
+        const char* GetBuildConfiguration()
+        {
+#if defined(WL_DEBUG)
+            return "Debug";
+#elif defined(WL_RELEASE)
+            return "Release";
+#elif defined(WL_DIST)
+            return "Dist";
+#else
+            return "Unknown";
+#endif
+        }
+
+    }
+
+    Runner::Runner(const Options& options)
+        : m_Options(options)
+    {
+    }
+
+    bool Runner::ShouldRun(const std::string& name) const
+    {
+        return m_Options.Filter.empty() || name.find(m_Options.Filter) != std::string::npos;
+    }
+
+    void Runner::Run(const std::string& name, uint64_t opsPerBatch, double raysPerOp, const std::function<void()>& body)
+    {
+        if (!ShouldRun(name))
+            return;
+
+        // Warm up caches and calibrate the number of batches per trial
+        uint64_t batches = 1;
+        for (;;)
+        {
+            double elapsed = TimeBatches(body, batches);
+            if (elapsed >= m_Options.MinTrialTime || batches >= (1ull << 40))
+                break;
+
+            // Aim slightly above the target so the next attempt usually succeeds
+            double scale = elapsed > 0.0 ? m_Options.MinTrialTime * 1.2 / elapsed : 10.0;
+            batches = std::max(batches + 1, (uint64_t)(batches * std::min(scale, 10.0)));
+        }
+
+        std::vector<double> nsPerOp(std::max(m_Options.Trials, 1u));
+        for (double& trial : nsPerOp)
+            trial = TimeBatches(body, batches) * 1e9 / (double)(batches * opsPerBatch);
+        std::sort(nsPerOp.begin(), nsPerOp.end());
+
+        Result result;
+        result.Name = name;
+        result.NsPerOp = nsPerOp[nsPerOp.size() / 2];
+        result.MinNsPerOp = nsPerOp.front();
+        result.RaysPerSecond = raysPerOp > 0.0 ? raysPerOp * 1e9 / result.NsPerOp : 0.0;
+        result.OpsPerTrial = batches * opsPerBatch;
+        result.Trials = (uint32_t)nsPerOp.size();
+        Report(result);
+    }
+
+    void Runner::Report(const Result& result)
+    {
+        if (result.RaysPerSecond > 0.0)
+            printf("%-48s %12.2f ns/op %10.2f Mrays/s\n", result.Name.c_str(), result.NsPerOp, result.RaysPerSecond * 1e-6);
+        else
+            printf("%-48s %12.2f ns/op\n", result.Name.c_str(), result.NsPerOp);
+
+        for (const auto& [name, value] : result.Metrics)
+            printf("    %-44s %12.4f\n", name.c_str(), value);
+        fflush(stdout);
+
+        m_Results.push_back(result);
+    }
+
+    bool Runner::WriteJson(const std::string& path) const
+    {
+        FILE* file = fopen(path.c_str(), "w");
+        if (!file)
+            return false;
+
+        // One benchmark per line with a stable order, so results diff cleanly between commits
+        fprintf(file, "{\n");
+        fprintf(file, "  \"configuration\": \"%s\",\n", GetBuildConfiguration());
+        fprintf(file, "  \"isa\": \"%s\",\n", ISA::GetLevelName(ISA::GetLevel()));
+        fprintf(file, "  \"min_trial_time\": %g,\n", m_Options.MinTrialTime);
+        fprintf(file, "  \"benchmarks\": [\n");
+        for (size_t i = 0; i < m_Results.size(); i++)
+        {
+            const Result& result = m_Results[i];
+            fprintf(file, "    { \"name\": \"");
+            WriteEscaped(file, result.Name);
+            fprintf(file, "\", \"ns_per_op\": %.4f, \"min_ns_per_op\": %.4f, \"rays_per_second\": %.1f, \"ops_per_trial\": %llu, \"trials\": %u",
+                result.NsPerOp, result.MinNsPerOp, result.RaysPerSecond, (unsigned long long)result.OpsPerTrial, result.Trials);
+            for (const auto& [name, value] : result.Metrics)
+            {
+                fprintf(file, ", \"");
+                WriteEscaped(file, name);
+                fprintf(file, "\": %.6g", value);
+            }
+            fprintf(file, " }%s\n", i + 1 < m_Results.size() ? "," : "");
+        }
+        fprintf(file, "  ]\n");
+        fprintf(file, "}\n");
+
+        return fclose(file) == 0;
+    }
+
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "Heatmap.h"
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace Bench {
+
+    struct Options
+    {
+        std::string Filter;         // Only benchmarks whose name contains this run
+        std::string JsonPath;       // Results are written here when not empty
+        double MinTrialTime = 0.05; // In seconds, batches are repeated until a trial takes at least this long
+        uint32_t Trials = 7;
+
+        // Scene suite
+        uint32_t Width = 320, Height = 180;
+        // Only this region of the image is timed and compared when it is not empty
+        uint32_t CropX = 0, CropY = 0, CropWidth = 0, CropHeight = 0;
+        double TimeBudget = 2.0;            // In seconds, every scene is rendered for this long
+        std::string ReferenceDirectory = "references";
+        uint32_t ReferenceFrames = 1024;
+        bool UpdateReferences = false;      // Render and store the references instead of only loading them
+        // Writes a cost heatmap of every scene after its timed run, as raw .pfm and false-colour .ppm
+        Heatmap::Metric Heatmap = Heatmap::Metric::None;
+        std::string HeatmapDirectory = "heatmaps";
+        uint32_t HeatmapFrames = 16;
+        bool PerfCounters = false;          // Adds hardware counter metrics where perf_event_open works
+        uint32_t TextureCacheMB = 64;       // Texture tiles the scene renders keep in memory
+
+        // Scaling suite
+        std::string ScalingScene = "spheres-100k";
+        uint32_t MaxThreads = 0;            // 0 sweeps up to every hardware thread
+        uint32_t ScalingFrames = 16;        // Timed frames per configuration
+
+        // Distributed suite
+        std::string Executable;             // This program, started again for every worker process
+        std::string DistributedScene = "cornell-box";
+        std::string DistributedAddress;     // Empty picks a local socket
+        uint32_t Workers = 4;
+        uint32_t DistributedFrames = 64;
+    };
+
+    struct Result
+    {
+        std::string Name;
+        double NsPerOp = 0.0;       // Median over all trials
+        double MinNsPerOp = 0.0;
+        double RaysPerSecond = 0.0; // 0 for benchmarks that do not trace rays
+        uint64_t OpsPerTrial = 0;
+        uint32_t Trials = 0;
+
+        // Additional named values, written to the JSON object of the benchmark as they are
+        std::vector<std::pair<std::string, double>> Metrics;
+    };
+
+    // Keeps the compiler from optimizing away a value that is otherwise never used
+    template<typename T>
+    inline void DoNotOptimize(const T& value)
+    {
+#ifdef _MSC_VER
+        const volatile char* volatile sink = (const volatile char*)&value;
+        (void)sink;
+        _ReadWriteBarrier();
+#else
+        asm volatile("" : : "r,m"(value) : "memory");
+#endif
+    }
+
+    class Runner
+    {
+    public:
+        explicit Runner(const Options& options);
+
+        // Times body, which performs opsPerBatch operations per call. raysPerOp is the number of
+        // rays an operation traces and is used for the rays/s column, pass 0 when it does not apply.
+        void Run(const std::string& name, uint64_t opsPerBatch, double raysPerOp, const std::function<void()>& body);
+
+        // For benchmarks that do their own timing
+        bool ShouldRun(const std::string& name) const;
+        void Report(const Result& result);
+
+        bool WriteJson(const std::string& path) const;
+
+        const Options& GetOptions() const { return m_Options; }
+        const std::vector<Result>& GetResults() const { return m_Results; }
+    private:
+        Options m_Options;
+        std::vector<Result> m_Results;
+    };
+
+}
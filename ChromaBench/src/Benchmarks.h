@@ -0,0 +1,26 @@
+#pragma once
+
+#include "Benchmark.h"
+
+namespace Bench {
+
+    // Intersection kernels, TraceRay, PerPixel and the random / color helpers in isolation, plus the
+    // ISA dispatched kernels at every level the CPU supports
+    void RunKernelBenchmarks(Runner& runner);
+
+    // Renders the reference scenes headless for the time budget and compares them against stored
+    // high sample count references at equal time. Also checks that a render resumed from a
+    // checkpoint ends on exactly the image of one that never stopped.
+    void RunSceneBenchmarks(Runner& runner);
+
+    // Renders one scene with 1 to N workers, with and without pinning and NUMA-local tiles, and
+    // reports parallel efficiency, per worker busy / idle time and the tile cost spread. Also checks
+    // that a pool stopped and started again still runs every loop index once.
+    void RunScalingBenchmarks(Runner& runner);
+
+    // Renders one scene with worker processes of this program and in process with as many threads,
+    // and reports the speedup, the difference of the images and how often frames were handed out
+    // again. A second run kills one worker halfway through.
+    void RunDistributedBenchmarks(Runner& runner);
+
+}
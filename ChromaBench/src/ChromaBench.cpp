@@ -0,0 +1,205 @@
+#include "Benchmarks.h"
+#include "SceneCases.h"
+
+#include "Walnut/Timer.h"
+
+#include "Distributed.h"
+#include "ISA.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+static void PrintUsage()
+{
+    printf("Usage: ChromaBench [options]\n");
+    printf("  --suite <name>          kernels, scenes, scaling, distributed or all (default kernels)\n");
+    printf("  --filter <text>         Only run benchmarks whose name contains <text>\n");
+    printf("  --json <path>           Write the results as JSON to <path>\n");
+    printf("  --min-time <sec>        Minimum duration of a single kernel trial (default 0.05)\n");
+    printf("  --trials <count>        Number of timed kernel trials, the median is reported (default 7)\n");
+    printf("  --size <w>x<h>          Scene resolution (default 320x180)\n");
+    printf("  --crop <x>,<y>,<w>,<h>  Only render and compare this region of the scene image\n");
+    printf("  --time-budget <sec>     Render time per scene (default 2)\n");
+    printf("  --references <dir>      Directory of the scene references (default references)\n");
+    printf("  --reference-frames <n>  Frames accumulated for a reference (default 1024)\n");
+    printf("  --update-references     Render and store the scene references before comparing\n");
+    printf("  --scaling-scene <name>  Scene of the scaling suite (default spheres-100k)\n");
+    printf("  --max-threads <n>       Largest worker count of the scaling suite (default all)\n");
+    printf("  --scaling-frames <n>    Timed frames per scaling configuration (default 16)\n");
+    printf("  --workers <n>           Worker processes of the distributed suite (default 4)\n");
+    printf("  --distributed-scene <name>  Scene of the distributed suite (default cornell-box)\n");
+    printf("  --distributed-frames <n>    Timed frames of the distributed suite (default 64)\n");
+    printf("  --distributed-address <a>   host:port or unix:<path> the workers connect to\n");
+    printf("  --export-scene <name> <path>  Write a reference scene as a scene file and print its camera\n");
+    printf("  --worker <address>      Render tiles for the coordinator at <address> and exit once it is done\n");
+    printf("  --heatmap <metric>      Also write a tests, steps, bounces or cycles heatmap of every scene\n");
+    printf("  --heatmaps <dir>        Directory of the heatmaps (default heatmaps)\n");
+    printf("  --perf-counters         Report Linux hardware counters of the scene renders\n");
+    printf("  --texture-cache <MB>    Texture tile cache of the scene renders (default 64)\n");
+    printf("  --trace <path>          Capture profiler zones, written as Chrome JSON for .json, else Perfetto\n");
+    printf("  --isa <level>           Kernels to use: generic, sse4.2, avx2 or avx512 (default: best supported)\n");
+}
+
+int main(int argc, char** argv)
+{
+    Bench::Options options;
+    options.Executable = argv[0];
+    std::string suite = "kernels";
+    std::string tracePath;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+
+        if (strcmp(arg, "--suite") == 0 && value)
+            suite = argv[++i];
+        else if (strcmp(arg, "--filter") == 0 && value)
+            options.Filter = argv[++i];
+        else if (strcmp(arg, "--json") == 0 && value)
+            options.JsonPath = argv[++i];
+        else if (strcmp(arg, "--min-time") == 0 && value)
+            options.MinTrialTime = atof(argv[++i]);
+        else if (strcmp(arg, "--trials") == 0 && value)
+            options.Trials = (uint32_t)atoi(argv[++i]);
+        else if (strcmp(arg, "--size") == 0 && value && sscanf(value, "%ux%u", &options.Width, &options.Height) == 2)
+            i++;
+        else if (strcmp(arg, "--crop") == 0 && value && sscanf(value, "%u,%u,%u,%u", &options.CropX, &options.CropY,
+            &options.CropWidth, &options.CropHeight) == 4)
+            i++;
+        else if (strcmp(arg, "--time-budget") == 0 && value)
+            options.TimeBudget = atof(argv[++i]);
+        else if (strcmp(arg, "--references") == 0 && value)
+            options.ReferenceDirectory = argv[++i];
+        else if (strcmp(arg, "--reference-frames") == 0 && value)
+            options.ReferenceFrames = (uint32_t)atoi(argv[++i]);
+        else if (strcmp(arg, "--update-references") == 0)
+            options.UpdateReferences = true;
+        else if (strcmp(arg, "--scaling-scene") == 0 && value)
+            options.ScalingScene = argv[++i];
+        else if (strcmp(arg, "--max-threads") == 0 && value)
+            options.MaxThreads = (uint32_t)atoi(argv[++i]);
+        else if (strcmp(arg, "--heatmap") == 0 && value)
+        {
+            const char* name = argv[++i];
+            for (uint32_t metric = 1; metric < Heatmap::MetricCount; metric++)
+            {
+                if (strcmp(name, Heatmap::GetMetricName((Heatmap::Metric)metric)) == 0)
+                    options.Heatmap = (Heatmap::Metric)metric;
+            }
+            if (options.Heatmap == Heatmap::Metric::None)
+            {
+                PrintUsage();
+                return 1;
+            }
+        }
+        else if (strcmp(arg, "--heatmaps") == 0 && value)
+            options.HeatmapDirectory = argv[++i];
+        else if (strcmp(arg, "--perf-counters") == 0)
+            options.PerfCounters = true;
+        else if (strcmp(arg, "--texture-cache") == 0 && value)
+            options.TextureCacheMB = (uint32_t)atoi(argv[++i]);
+        else if (strcmp(arg, "--trace") == 0 && value)
+            tracePath = argv[++i];
+        else if (strcmp(arg, "--isa") == 0 && value)
+        {
+            ISA::Level level;
+            const char* name = argv[++i];
+            if (!ISA::ParseLevel(name, level))
+            {
+                PrintUsage();
+                return 1;
+            }
+            if (!ISA::SetLevel(level))
+            {
+                fprintf(stderr, "This CPU does not support %s, the best it supports is %s\n", name,
+                    ISA::GetLevelName(ISA::GetSupportedLevel()));
+                return 1;
+            }
+        }
+        else if (strcmp(arg, "--scaling-frames") == 0 && value)
+            options.ScalingFrames = std::max(atoi(argv[++i]), 1);
+        else if (strcmp(arg, "--workers") == 0 && value)
+            options.Workers = (uint32_t)std::max(atoi(argv[++i]), 1);
+        else if (strcmp(arg, "--distributed-scene") == 0 && value)
+            options.DistributedScene = argv[++i];
+        else if (strcmp(arg, "--distributed-frames") == 0 && value)
+            options.DistributedFrames = (uint32_t)std::max(atoi(argv[++i]), 1);
+        else if (strcmp(arg, "--distributed-address") == 0 && value)
+            options.DistributedAddress = argv[++i];
+        else if (strcmp(arg, "--export-scene") == 0 && value && i + 2 < argc)
+        {
+            const Bench::SceneCase* sceneCase = Bench::FindSceneCase(argv[++i]);
+            const char* path = argv[++i];
+            Scene scene;
+            if (!sceneCase)
+            {
+                fprintf(stderr, "Unknown scene %s\n", argv[i - 1]);
+                return 1;
+            }
+            const Scenes::CameraView view = sceneCase->Create(scene);
+            if (!SaveScene(scene, path))
+            {
+                fprintf(stderr, "Failed to write %s\n", path);
+                return 1;
+            }
+            printf("--camera %g,%g,%g,%g,%g,%g\n", view.Position.x, view.Position.y, view.Position.z,
+                view.Target.x, view.Target.y, view.Target.z);
+            return 0;
+        }
+        else if (strcmp(arg, "--worker") == 0 && value)
+            return Distributed::RunWorker(argv[++i]) ? 0 : 1;
+        else
+        {
+            PrintUsage();
+            return strcmp(arg, "--help") == 0 ? 0 : 1;
+        }
+    }
+
+    if (suite != "kernels" && suite != "scenes" && suite != "scaling" && suite != "distributed" && suite != "all")
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    if (!tracePath.empty())
+    {
+        Walnut::Profiler::SetThreadName("Main");
+        Walnut::Profiler::BeginCapture();
+    }
+
+    printf("Kernels: %s (supported: %s)\n", ISA::GetLevelName(ISA::GetLevel()), ISA::GetLevelName(ISA::GetSupportedLevel()));
+
+    Bench::Runner runner(options);
+    if (suite == "kernels" || suite == "all")
+        Bench::RunKernelBenchmarks(runner);
+    if (suite == "scenes" || suite == "all")
+        Bench::RunSceneBenchmarks(runner);
+    if (suite == "scaling" || suite == "all")
+        Bench::RunScalingBenchmarks(runner);
+    if (suite == "distributed" || suite == "all")
+        Bench::RunDistributedBenchmarks(runner);
+
+    if (!tracePath.empty())
+    {
+        Walnut::Profiler::EndCapture();
+
+        bool json = tracePath.size() >= 5 && tracePath.compare(tracePath.size() - 5, 5, ".json") == 0;
+        if (!(json ? Walnut::Profiler::ExportChromeTrace(tracePath) : Walnut::Profiler::ExportPerfettoTrace(tracePath)))
+        {
+            fprintf(stderr, "Failed to write %s\n", tracePath.c_str());
+            return 1;
+        }
+    }
+
+    if (!options.JsonPath.empty() && !runner.WriteJson(options.JsonPath))
+    {
+        fprintf(stderr, "Failed to write %s\n", options.JsonPath.c_str());
+        return 1;
+    }
+
+    return 0;
+}
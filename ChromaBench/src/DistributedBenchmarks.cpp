@@ -0,0 +1,258 @@
+#include "Benchmarks.h"
+#include "SceneCases.h"
+
+#include "Camera.h"
+#include "Distributed.h"
+#include "Renderer.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <signal.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+#endif
+
+namespace Bench {
+
+    namespace {
+
+        // Worker process started from this program with --worker
+        class WorkerProcess
+        {
+        public:
+            WorkerProcess() = default;
+            ~WorkerProcess() { Stop(true); }
+
+            WorkerProcess(const WorkerProcess&) = delete;
+            WorkerProcess& operator=(const WorkerProcess&) = delete;
+
+            bool Start(const std::string& executable, const std::string& address)
+            {
+#ifdef _WIN32
+                std::string commandLine = "\"" + executable + "\" --worker " + address;
+                STARTUPINFOA startup = {};
+                startup.cb = sizeof(startup);
+                PROCESS_INFORMATION info = {};
+                if (!CreateProcessA(executable.c_str(), commandLine.data(), nullptr, nullptr, FALSE, 0, nullptr, nullptr,
+                    &startup, &info))
+                {
+                    return false;
+                }
+                CloseHandle(info.hThread);
+                m_Process = info.hProcess;
+                return true;
+#else
+                std::string workerArg = "--worker";
+                std::string addressArg = address;
+                char* args[] = { (char*)executable.c_str(), workerArg.data(), addressArg.data(), nullptr };
+                return posix_spawnp(&m_Process, executable.c_str(), nullptr, nullptr, args, environ) == 0;
+#endif
+            }
+
+            // Workers end on their own once the coordinator closes the connection
+            void Stop(bool kill)
+            {
+#ifdef _WIN32
+                if (!m_Process)
+                    return;
+                if (kill)
+                    TerminateProcess(m_Process, 1);
+                WaitForSingleObject(m_Process, INFINITE);
+                CloseHandle(m_Process);
+                m_Process = nullptr;
+#else
+                if (m_Process <= 0)
+                    return;
+                if (kill)
+                    ::kill(m_Process, SIGKILL);
+                waitpid(m_Process, nullptr, 0);
+                m_Process = 0;
+#endif
+            }
+        private:
+#ifdef _WIN32
+            HANDLE m_Process = nullptr;
+#else
+            pid_t m_Process = 0;
+#endif
+        };
+
+        std::string GetDefaultAddress()
+        {
+#ifdef _WIN32
+            return "127.0.0.1:" + std::to_string(47000 + GetCurrentProcessId() % 1000);
+#else
+            return "unix:/tmp/chromabench-" + std::to_string(getpid()) + ".sock";
+#endif
+        }
+
+        void SetupRenderer(Renderer& renderer, uint32_t threads, const Options& options)
+        {
+            Renderer::Settings& settings = renderer.GetSettings();
+            settings.SlowRandom = false;
+            settings.ThreadCount = threads;
+            renderer.OnResize(options.Width, options.Height);
+        }
+
+        double RootMeanSquaredError(const std::vector<glm::vec3>& image, const std::vector<glm::vec3>& reference)
+        {
+            double sum = 0.0;
+            for (size_t i = 0; i < image.size(); i++)
+            {
+                const glm::vec3 difference = image[i] - reference[i];
+                sum += glm::dot(difference, difference) / 3.0;
+            }
+            return std::sqrt(sum / (double)image.size());
+        }
+
+        struct DistributedRun
+        {
+            bool Completed = false;
+            double Seconds = 0.0;
+            Distributed::Stats Stats;
+            std::vector<glm::vec3> Image;
+        };
+
+        // killAfter > 0 kills the first worker that many seconds into the timed render
+        DistributedRun RunDistributed(const Scene& scene, const Camera& camera, const Options& options, double killAfter)
+        {
+            DistributedRun run;
+            const std::string address = options.DistributedAddress.empty() ? GetDefaultAddress() : options.DistributedAddress;
+
+            Distributed::Coordinator coordinator;
+            if (!coordinator.Listen(address))
+            {
+                fprintf(stderr, "Failed to listen on %s\n", address.c_str());
+                return run;
+            }
+
+            std::vector<WorkerProcess> workers(options.Workers);
+            for (WorkerProcess& worker : workers)
+            {
+                if (!worker.Start(options.Executable, address))
+                {
+                    fprintf(stderr, "Failed to start %s\n", options.Executable.c_str());
+                    return run;
+                }
+            }
+            if (!coordinator.WaitForWorkers(options.Workers, 10.0))
+            {
+                fprintf(stderr, "Only %u of %u workers connected\n", coordinator.GetWorkerCount(), options.Workers);
+                return run;
+            }
+
+            // The first frame sends the scene and builds every worker's BVH, it is not timed
+            Renderer renderer(true);
+            SetupRenderer(renderer, 1, options);
+            coordinator.Render(renderer, scene, camera, 1);
+
+            std::thread killer;
+            if (killAfter > 0.0)
+            {
+                killer = std::thread([&workers, killAfter]()
+                    {
+                        std::this_thread::sleep_for(std::chrono::duration<double>(killAfter));
+                        workers[0].Stop(true);
+                    });
+            }
+
+            const auto start = std::chrono::steady_clock::now();
+            run.Completed = coordinator.Render(renderer, scene, camera, options.DistributedFrames + 1);
+            run.Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            run.Stats = coordinator.GetStats();
+            renderer.GetAccumulatedImage(run.Image);
+
+            if (killer.joinable())
+                killer.join();
+            coordinator.Close();
+            for (WorkerProcess& worker : workers)
+                worker.Stop(false);
+            return run;
+        }
+
+    }
+
+    void RunDistributedBenchmarks(Runner& runner)
+    {
+        const Options& options = runner.GetOptions();
+
+        const SceneCase* sceneCase = FindSceneCase(options.DistributedScene);
+        if (!sceneCase)
+        {
+            fprintf(stderr, "Unknown scene %s\n", options.DistributedScene.c_str());
+            return;
+        }
+
+        const std::string name = std::string("Distributed/") + sceneCase->Name + "/w" + std::to_string(options.Workers);
+        const std::string killName = name + "/kill";
+        if (!runner.ShouldRun(name) && !runner.ShouldRun(killName))
+            return;
+
+        printf("Distributed %s over %u worker processes\n", sceneCase->Name, options.Workers);
+
+        Scene scene;
+        Scenes::CameraView view = sceneCase->Create(scene);
+
+        Camera camera(45.0f, 0.1f, 100.0f);
+        camera.OnResize(options.Width, options.Height);
+        camera.LookAt(view.Position, view.Target);
+
+        // In process with a thread per worker process, timed over the same frames
+        Renderer local(true);
+        SetupRenderer(local, options.Workers, options);
+        local.Render(scene, camera);
+        const auto start = std::chrono::steady_clock::now();
+        for (uint32_t frame = 0; frame < options.DistributedFrames; frame++)
+            local.Render(scene, camera);
+        const double localSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::vector<glm::vec3> reference;
+        local.GetAccumulatedImage(reference);
+
+        auto report = [&](const std::string& resultName, const DistributedRun& run)
+        {
+            if (!run.Completed)
+            {
+                fprintf(stderr, "%s did not complete\n", resultName.c_str());
+                return;
+            }
+
+            const double paths = (double)options.Width * options.Height;
+            Result result;
+            result.Name = resultName;
+            result.NsPerOp = run.Seconds * 1e9 / (paths * options.DistributedFrames);
+            result.MinNsPerOp = result.NsPerOp;
+            result.OpsPerTrial = (uint64_t)paths * options.DistributedFrames;
+            result.Trials = 1;
+            result.Metrics.push_back({ "workers", (double)options.Workers });
+            result.Metrics.push_back({ "ms_per_frame", run.Seconds * 1e3 / options.DistributedFrames });
+            result.Metrics.push_back({ "local_ms_per_frame", localSeconds * 1e3 / options.DistributedFrames });
+            result.Metrics.push_back({ "speedup_vs_local", localSeconds / run.Seconds });
+            // Float rounding only, merged sums are added in another order than local ones
+            result.Metrics.push_back({ "rmse_vs_local", RootMeanSquaredError(run.Image, reference) });
+            result.Metrics.push_back({ "assignments", (double)run.Stats.Assignments });
+            result.Metrics.push_back({ "reissued", (double)run.Stats.Reissued });
+            result.Metrics.push_back({ "discarded", (double)run.Stats.Discarded });
+            result.Metrics.push_back({ "lost_workers", (double)run.Stats.LostWorkers });
+            runner.Report(result);
+        };
+
+        if (runner.ShouldRun(name))
+            report(name, RunDistributed(scene, camera, options, 0.0));
+        if (runner.ShouldRun(killName) && options.Workers > 1)
+            report(killName, RunDistributed(scene, camera, options, localSeconds * 0.5));
+    }
+
+}
@@ -0,0 +1,286 @@
+#include "Benchmarks.h"
+#include "RayDatasets.h"
+#include "RendererBench.h"
+
+#include "Camera.h"
+#include "ISA.h"
+#include "Resolve.h"
+#include "Scenes.h"
+#include "Utils.h"
+
+#include <limits>
+#include <string>
+
+namespace Bench {
+
+    namespace {
+
+        constexpr RayCase RayCases[] = { RayCase::Hit, RayCase::Miss, RayCase::Grazing };
+
+        // Runs one intersection function over every ray of a set, the hit distances are summed so
+        // that none of the work can be dropped
+        template<typename Primitive, typename Intersect>
+        void RunIntersection(Runner& runner, const char* name, const Primitive& primitive, const std::vector<Ray>& rays,
+            RayCase rayCase, Intersect intersect)
+        {
+            std::string fullName = std::string(name) + "/" + GetRayCaseName(rayCase);
+            runner.Run(fullName, rays.size(), 1.0, [&]()
+                {
+                    float sum = 0.0f;
+                    for (const Ray& ray : rays)
+                    {
+                        float t = 0.0f;
+                        if (intersect(ray, primitive, t))
+                            sum += t;
+                    }
+                    DoNotOptimize(sum);
+                });
+        }
+
+        void RunIntersectionBenchmarks(Runner& runner, const Renderer& renderer)
+        {
+            const Sphere sphere = MakeReferenceSphere();
+            const Plane plane = MakeReferencePlane();
+            const Box box = MakeReferenceBox();
+            const Triangle triangle = MakeReferenceTriangle();
+
+            for (RayCase rayCase : RayCases)
+            {
+                // Each case gets its own seed so the sets do not share origins
+                const uint32_t seed = DatasetSeed + (uint32_t)rayCase;
+
+                RunIntersection(runner, "IntersectSphere", sphere, MakeSphereRays(sphere, rayCase, RaysPerSet, seed), rayCase,
+                    [&](const Ray& ray, const Sphere& s, float& t) { return RendererBench::IntersectSphere(renderer, ray, s, t); });
+                RunIntersection(runner, "IntersectPlane", plane, MakePlaneRays(plane, rayCase, RaysPerSet, seed), rayCase,
+                    [&](const Ray& ray, const Plane& p, float& t) { return RendererBench::IntersectPlane(renderer, ray, p, t); });
+                RunIntersection(runner, "IntersectBox", box, MakeBoxRays(box, rayCase, RaysPerSet, seed), rayCase,
+                    [&](const Ray& ray, const Box& b, float& t) { return RendererBench::IntersectBox(renderer, ray, b, t); });
+                RunIntersection(runner, "IntersectTriangle", triangle, MakeTriangleRays(triangle, rayCase, RaysPerSet, seed), rayCase,
+                    [&](const Ray& ray, const Triangle& tri, float& t)
+                    {
+                        glm::vec3 normal;
+                        return RendererBench::IntersectTriangle(renderer, ray, tri, t, normal);
+                    });
+            }
+        }
+
+        void RunTraceRayBenchmarks(Runner& runner, Renderer& renderer)
+        {
+            struct SceneKind
+            {
+                const char* Name;
+                bool Spheres, Boxes, Triangles;
+            };
+            const SceneKind kinds[] = {
+                { "spheres", true, false, false },
+                { "boxes", false, true, false },
+                { "triangles", false, false, true },
+                { "mixed", true, true, true },
+            };
+            const uint32_t primitiveCounts[] = { 1, 8, 64, 512 };
+
+            const std::vector<Ray> rays = MakeSceneRays(RaysPerSet, DatasetSeed);
+
+            for (const SceneKind& kind : kinds)
+            {
+                for (uint32_t primitiveCount : primitiveCounts)
+                {
+                    Scene scene = MakeRandomScene(primitiveCount, kind.Spheres, kind.Boxes, kind.Triangles, DatasetSeed);
+                    RendererBench::Bind(renderer, scene);
+
+                    std::string name = std::string("TraceRay/") + kind.Name + "/" + std::to_string(primitiveCount);
+                    runner.Run(name, rays.size(), 1.0, [&]()
+                        {
+                            float sum = 0.0f;
+                            for (const Ray& ray : rays)
+                                sum += RendererBench::TraceRay(renderer, ray);
+                            DoNotOptimize(sum);
+                        });
+                }
+            }
+        }
+
+        void RunPerPixelBenchmarks(Runner& runner)
+        {
+            constexpr uint32_t Width = 128, Height = 72;
+
+            Scene scene;
+            Scenes::CreateDefault(scene);
+
+            Camera camera(45.0f, 0.1f, 100.0f);
+            camera.OnResize(Width, Height);
+
+            for (int samples : { 1, 4 })
+            {
+                for (bool slowRandom : { false, true })
+                {
+                    Renderer renderer(true);
+                    renderer.OnResize(Width, Height);
+                    renderer.GetSettings().SamplesPerPixel = samples;
+                    renderer.GetSettings().SlowRandom = slowRandom;
+                    RendererBench::Bind(renderer, scene, &camera);
+
+                    // rays/s counts camera rays, bounces are part of the per-pixel cost
+                    std::string name = std::string("PerPixel/default/spp") + std::to_string(samples) +
+                        (slowRandom ? "/slow-random" : "/fast-random");
+                    runner.Run(name, Width * Height, (double)samples, [&]()
+                        {
+                            glm::vec4 sum(0.0f);
+                            uint32_t rayCount = 0;
+                            for (uint32_t y = 0; y < Height; y++)
+                            {
+                                for (uint32_t x = 0; x < Width; x++)
+                                    sum += RendererBench::PerPixel(renderer, x, y, rayCount);
+                            }
+                            DoNotOptimize(sum);
+                            DoNotOptimize(rayCount);
+                        });
+                }
+            }
+        }
+
+        void RunShadingBenchmarks(Runner& runner, Renderer& renderer)
+        {
+            std::vector<float> cosines(RaysPerSet);
+            std::vector<float> iors(RaysPerSet);
+            uint32_t seed = DatasetSeed;
+            for (uint32_t i = 0; i < RaysPerSet; i++)
+            {
+                cosines[i] = Utils::RandomFloat(seed);
+                iors[i] = 1.0f + Utils::RandomFloat(seed) * 1.5f;
+            }
+
+            runner.Run("CalculateFresnel", RaysPerSet, 0.0, [&]()
+                {
+                    float sum = 0.0f;
+                    for (uint32_t i = 0; i < RaysPerSet; i++)
+                        sum += RendererBench::CalculateFresnel(renderer, cosines[i], iors[i]);
+                    DoNotOptimize(sum);
+                });
+        }
+
+        void RunUtilityBenchmarks(Runner& runner)
+        {
+            constexpr uint32_t BatchSize = 4096;
+
+            // The random helpers are chained through the seed the same way PerPixel uses them
+            runner.Run("Utils::PCG_Hash", BatchSize, 0.0, []()
+                {
+                    uint32_t value = DatasetSeed;
+                    for (uint32_t i = 0; i < BatchSize; i++)
+                        value = Utils::PCG_Hash(value);
+                    DoNotOptimize(value);
+                });
+
+            runner.Run("Utils::RandomFloat", BatchSize, 0.0, []()
+                {
+                    uint32_t seed = DatasetSeed;
+                    float sum = 0.0f;
+                    for (uint32_t i = 0; i < BatchSize; i++)
+                        sum += Utils::RandomFloat(seed);
+                    DoNotOptimize(sum);
+                });
+
+            runner.Run("Utils::InUnitSphere", BatchSize, 0.0, []()
+                {
+                    uint32_t seed = DatasetSeed;
+                    glm::vec3 sum(0.0f);
+                    for (uint32_t i = 0; i < BatchSize; i++)
+                        sum += Utils::InUnitSphere(seed);
+                    DoNotOptimize(sum);
+                });
+
+            std::vector<glm::vec4> colors(BatchSize);
+            uint32_t seed = DatasetSeed;
+            for (glm::vec4& color : colors)
+                color = glm::vec4(Utils::RandomFloat(seed), Utils::RandomFloat(seed), Utils::RandomFloat(seed), 1.0f);
+
+            std::vector<uint32_t> packed(BatchSize);
+            runner.Run("Utils::ConvertToRGBA", BatchSize, 0.0, [&]()
+                {
+                    for (uint32_t i = 0; i < BatchSize; i++)
+                        packed[i] = Utils::ConvertToRGBA(colors[i]);
+                    DoNotOptimize(packed.data());
+                });
+
+            // The resolve that replaced ConvertToRGBA in the renderer, for comparison
+            const Resolve::Params params = Resolve::MakeParams(1, 0.0f, Resolve::Tonemapper::ACES);
+            runner.Run("Resolve::ResolveSpan", BatchSize, 0.0, [&]()
+                {
+                    Resolve::ResolveSpan(colors.data(), packed.data(), BatchSize, params);
+                    DoNotOptimize(packed.data());
+                });
+        }
+
+        // The dispatched kernels at every level the CPU supports, the active level is restored afterwards
+        void RunISABenchmarks(Runner& runner)
+        {
+            constexpr uint32_t BatchSize = 4096;
+            const ISA::Level active = ISA::GetLevel();
+
+            Scene scene;
+            Scenes::CreateCornellBox(scene);
+            ISA::PlaneSet planes;
+            planes.Build(scene.Planes);
+            const std::vector<Ray> rays = MakeSceneRays(RaysPerSet, DatasetSeed);
+
+            std::vector<glm::vec4> colors(BatchSize);
+            uint32_t seed = DatasetSeed;
+            for (glm::vec4& color : colors)
+                color = glm::vec4(Utils::RandomFloat(seed), Utils::RandomFloat(seed), Utils::RandomFloat(seed), 1.0f);
+            std::vector<uint32_t> packed(BatchSize);
+            const Resolve::Params params = Resolve::MakeParams(1, 0.0f, Resolve::Tonemapper::ACES);
+
+            std::vector<uint32_t> seeds(BatchSize);
+            std::vector<float> values(BatchSize);
+
+            for (uint32_t level = 0; level <= (uint32_t)ISA::GetSupportedLevel(); level++)
+            {
+                ISA::SetLevel((ISA::Level)level);
+                const ISA::KernelTable& kernels = ISA::GetKernels();
+                const std::string prefix = std::string("ISA/") + ISA::GetLevelName((ISA::Level)level) + "/";
+
+                runner.Run(prefix + "ResolveSpan", BatchSize, 0.0, [&]()
+                    {
+                        Resolve::ResolveSpan(colors.data(), packed.data(), BatchSize, params);
+                        DoNotOptimize(packed.data());
+                    });
+
+                runner.Run(prefix + "IntersectPlanes/cornell-box", rays.size(), 1.0, [&]()
+                    {
+                        int32_t sum = 0;
+                        for (const Ray& ray : rays)
+                        {
+                            float hitDistance = std::numeric_limits<float>::max();
+                            sum += kernels.IntersectPlanes(ray, planes, hitDistance);
+                        }
+                        DoNotOptimize(sum);
+                    });
+
+                runner.Run(prefix + "RandomFloats", BatchSize, 0.0, [&]()
+                    {
+                        for (uint32_t i = 0; i < BatchSize; i++)
+                            seeds[i] = DatasetSeed + i;
+                        kernels.RandomFloats(seeds.data(), values.data(), BatchSize);
+                        DoNotOptimize(values.data());
+                    });
+            }
+
+            ISA::SetLevel(active);
+        }
+
+    }
+
+    void RunKernelBenchmarks(Runner& runner)
+    {
+        Renderer renderer(true);
+
+        RunIntersectionBenchmarks(runner, renderer);
+        RunTraceRayBenchmarks(runner, renderer);
+        RunPerPixelBenchmarks(runner);
+        RunShadingBenchmarks(runner, renderer);
+        RunUtilityBenchmarks(runner);
+        RunISABenchmarks(runner);
+    }
+
+}
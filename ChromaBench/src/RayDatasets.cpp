@@ -0,0 +1,314 @@
+#include "RayDatasets.h"
+#include "Utils.h"
+
+namespace Bench {
+
+    namespace {
+
+        // Distance of the ray origins from the primitive, relative to its size
+        constexpr float ShellDistance = 10.0f;
+
+        float Uniform(uint32_t& seed, float min, float max)
+        {
+            return min + Utils::RandomFloat(seed) * (max - min);
+        }
+
+        glm::vec3 Perpendicular(const glm::vec3& direction, uint32_t& seed)
+        {
+            glm::vec3 v = Utils::InUnitSphere(seed);
+            v -= direction * glm::dot(v, direction);
+            float length = glm::length(v);
+            if (length < 1e-6f)
+                return glm::abs(direction.x) < 0.9f ? glm::vec3(1, 0, 0) : glm::vec3(0, 1, 0);
+            return v / length;
+        }
+
+        Ray AimAt(const glm::vec3& origin, const glm::vec3& target)
+        {
+            Ray ray;
+            ray.Origin = origin;
+            ray.Direction = glm::normalize(target - origin);
+            return ray;
+        }
+
+        // Picks one of the three rotations of the triangle so edge cases are spread over all edges
+        void RotatedVertices(const Triangle& triangle, uint32_t rotation, glm::vec3& a, glm::vec3& b, glm::vec3& c)
+        {
+            const glm::vec3 vertices[3] = { triangle.v0, triangle.v1, triangle.v2 };
+            a = vertices[rotation % 3];
+            b = vertices[(rotation + 1) % 3];
+            c = vertices[(rotation + 2) % 3];
+        }
+
+    }
+
+    const char* GetRayCaseName(RayCase rayCase)
+    {
+        switch (rayCase)
+        {
+            case RayCase::Hit:     return "hit";
+            case RayCase::Miss:    return "miss";
+            case RayCase::Grazing: return "grazing";
+        }
+        return "unknown";
+    }
+
+    Sphere MakeReferenceSphere()
+    {
+        Sphere sphere;
+        sphere.Position = glm::vec3(0.0f);
+        sphere.Radius = 1.0f;
+        return sphere;
+    }
+
+    Plane MakeReferencePlane()
+    {
+        Plane plane;
+        plane.Normal = glm::vec3(0.0f, 1.0f, 0.0f);
+        plane.Distance = 0.0f;
+        return plane;
+    }
+
+    Box MakeReferenceBox()
+    {
+        Box box;
+        box.Min = glm::vec3(-0.5f);
+        box.Max = glm::vec3(0.5f);
+        return box;
+    }
+
+    Triangle MakeReferenceTriangle()
+    {
+        return Triangle(glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.5f, 0.0f));
+    }
+
+    std::vector<Ray> MakeSphereRays(const Sphere& sphere, RayCase rayCase, uint32_t count, uint32_t seed)
+    {
+        std::vector<Ray> rays;
+        rays.reserve(count);
+
+        for (uint32_t i = 0; i < count; i++)
+        {
+            glm::vec3 origin = sphere.Position + Utils::InUnitSphere(seed) * sphere.Radius * ShellDistance;
+            glm::vec3 toCenter = glm::normalize(sphere.Position - origin);
+
+            // Distance of the ray from the center, relative to the radius
+            float offset = 0.0f;
+            switch (rayCase)
+            {
+                case RayCase::Hit:     offset = Uniform(seed, 0.0f, 0.9f); break;
+                case RayCase::Miss:    offset = Uniform(seed, 1.1f, 3.0f); break;
+                case RayCase::Grazing: offset = Uniform(seed, 1.0f - 1e-3f, 1.0f + 1e-3f); break;
+            }
+
+            glm::vec3 target = sphere.Position + Perpendicular(toCenter, seed) * offset * sphere.Radius;
+            rays.push_back(AimAt(origin, target));
+        }
+
+        return rays;
+    }
+
+    std::vector<Ray> MakePlaneRays(const Plane& plane, RayCase rayCase, uint32_t count, uint32_t seed)
+    {
+        std::vector<Ray> rays;
+        rays.reserve(count);
+
+        // IntersectPlane solves dot(p, normal) + distance = 0
+        const glm::vec3 planePoint = -plane.Normal * plane.Distance;
+
+        for (uint32_t i = 0; i < count; i++)
+        {
+            Ray ray;
+            ray.Origin = planePoint + plane.Normal * Uniform(seed, 1.0f, ShellDistance) +
+                Perpendicular(plane.Normal, seed) * Uniform(seed, 0.0f, ShellDistance);
+
+            glm::vec3 tangent = Perpendicular(plane.Normal, seed);
+            switch (rayCase)
+            {
+                case RayCase::Hit:
+                    ray.Direction = glm::normalize(-plane.Normal + tangent * Uniform(seed, 0.0f, 2.0f));
+                    break;
+                case RayCase::Miss:
+                    ray.Direction = glm::normalize(plane.Normal + tangent * Uniform(seed, 0.0f, 2.0f));
+                    break;
+                case RayCase::Grazing:
+                    // Straddles the parallel rejection epsilon of IntersectPlane
+                    ray.Direction = glm::normalize(tangent + plane.Normal * Uniform(seed, -1e-3f, 1e-3f));
+                    break;
+            }
+
+            rays.push_back(ray);
+        }
+
+        return rays;
+    }
+
+    std::vector<Ray> MakeBoxRays(const Box& box, RayCase rayCase, uint32_t count, uint32_t seed)
+    {
+        std::vector<Ray> rays;
+        rays.reserve(count);
+
+        const glm::vec3 center = (box.Min + box.Max) * 0.5f;
+        const glm::vec3 size = box.Max - box.Min;
+        const float boundingRadius = glm::length(size) * 0.5f;
+
+        for (uint32_t i = 0; i < count; i++)
+        {
+            if (rayCase == RayCase::Grazing)
+            {
+                // Axis aligned rays sliding along a face, these hit the zero direction component branches
+                int axis = i % 3;
+                int along = (axis + 1) % 3;
+                int across = (axis + 2) % 3;
+
+                Ray ray;
+                ray.Origin[axis] = (Utils::RandomFloat(seed) < 0.5f ? box.Min[axis] : box.Max[axis]) + Uniform(seed, -1e-4f, 1e-4f);
+                ray.Origin[along] = box.Min[along] - size[along] * ShellDistance;
+                ray.Origin[across] = Uniform(seed, box.Min[across], box.Max[across]);
+                ray.Direction = glm::vec3(0.0f);
+                ray.Direction[along] = 1.0f;
+                rays.push_back(ray);
+                continue;
+            }
+
+            glm::vec3 origin = center + Utils::InUnitSphere(seed) * boundingRadius * ShellDistance;
+            glm::vec3 target;
+            if (rayCase == RayCase::Hit)
+            {
+                target = center + glm::vec3(
+                    Uniform(seed, -0.45f, 0.45f),
+                    Uniform(seed, -0.45f, 0.45f),
+                    Uniform(seed, -0.45f, 0.45f)) * size;
+            }
+            else
+            {
+                glm::vec3 toCenter = glm::normalize(center - origin);
+                target = center + Perpendicular(toCenter, seed) * Uniform(seed, 1.1f, 3.0f) * boundingRadius;
+            }
+
+            rays.push_back(AimAt(origin, target));
+        }
+
+        return rays;
+    }
+
+    std::vector<Ray> MakeTriangleRays(const Triangle& triangle, RayCase rayCase, uint32_t count, uint32_t seed)
+    {
+        std::vector<Ray> rays;
+        rays.reserve(count);
+
+        const glm::vec3 centroid = (triangle.v0 + triangle.v1 + triangle.v2) / 3.0f;
+        const glm::vec3 normal = glm::normalize(glm::cross(triangle.v1 - triangle.v0, triangle.v2 - triangle.v0));
+        const float extent = glm::max(glm::length(triangle.v0 - centroid),
+            glm::max(glm::length(triangle.v1 - centroid), glm::length(triangle.v2 - centroid)));
+
+        for (uint32_t i = 0; i < count; i++)
+        {
+            glm::vec3 a, b, c;
+            RotatedVertices(triangle, i, a, b, c);
+
+            // Barycentric coordinates of the target relative to b and c
+            float u = 0.0f, v = 0.0f;
+            switch (rayCase)
+            {
+                case RayCase::Hit:
+                    u = Utils::RandomFloat(seed);
+                    v = Utils::RandomFloat(seed);
+                    if (u + v > 1.0f)
+                    {
+                        u = 1.0f - u;
+                        v = 1.0f - v;
+                    }
+                    break;
+                case RayCase::Miss:
+                    u = -Uniform(seed, 0.05f, 1.0f);
+                    v = Uniform(seed, 0.0f, 1.0f);
+                    break;
+                case RayCase::Grazing:
+                    u = Uniform(seed, -1e-4f, 1e-4f);
+                    v = Uniform(seed, 0.0f, 1.0f);
+                    break;
+            }
+            glm::vec3 target = a * (1.0f - u - v) + b * u + c * v;
+
+            // Both sides are intersected, so origins are spread over both half spaces. Half of the
+            // grazing rays come in almost parallel to the triangle to hit the determinant epsilon.
+            float side = Utils::RandomFloat(seed) < 0.5f ? -1.0f : 1.0f;
+            glm::vec3 tangent = Perpendicular(normal, seed);
+            glm::vec3 direction;
+            if (rayCase == RayCase::Grazing && (i & 1))
+                direction = glm::normalize(tangent + normal * Uniform(seed, -1e-3f, 1e-3f));
+            else
+                direction = glm::normalize(normal * side + tangent * Uniform(seed, 0.0f, 1.0f));
+
+            rays.push_back(AimAt(target + direction * extent * ShellDistance, target));
+        }
+
+        return rays;
+    }
+
+    Scene MakeRandomScene(uint32_t primitiveCount, bool spheres, bool boxes, bool triangles, uint32_t seed)
+    {
+        Scene scene;
+
+        Material& material = scene.Materials.emplace_back();
+        material.Albedo = { 0.8f, 0.8f, 0.8f };
+        material.Roughness = 0.5f;
+
+        const bool kinds[3] = { spheres, boxes, triangles };
+        uint32_t kind = 0;
+
+        for (uint32_t i = 0; i < primitiveCount; i++)
+        {
+            while (!kinds[kind % 3])
+                kind++;
+
+            glm::vec3 center(Uniform(seed, -5.0f, 5.0f), Uniform(seed, -5.0f, 5.0f), Uniform(seed, -5.0f, 5.0f));
+            switch (kind % 3)
+            {
+                case 0:
+                {
+                    Sphere& sphere = scene.Spheres.emplace_back();
+                    sphere.Position = center;
+                    sphere.Radius = Uniform(seed, 0.1f, 0.5f);
+                    break;
+                }
+                case 1:
+                {
+                    glm::vec3 halfSize(Uniform(seed, 0.1f, 0.4f), Uniform(seed, 0.1f, 0.4f), Uniform(seed, 0.1f, 0.4f));
+                    Box& box = scene.Boxes.emplace_back();
+                    box.Min = center - halfSize;
+                    box.Max = center + halfSize;
+                    break;
+                }
+                case 2:
+                {
+                    glm::vec3 v0 = center + Utils::InUnitSphere(seed) * 0.5f;
+                    glm::vec3 v1 = center + Utils::InUnitSphere(seed) * 0.5f;
+                    glm::vec3 v2 = center + Utils::InUnitSphere(seed) * 0.5f;
+                    scene.Triangles.emplace_back(v0, v1, v2);
+                    break;
+                }
+            }
+            kind++;
+        }
+
+        return scene;
+    }
+
+    std::vector<Ray> MakeSceneRays(uint32_t count, uint32_t seed)
+    {
+        std::vector<Ray> rays;
+        rays.reserve(count);
+
+        for (uint32_t i = 0; i < count; i++)
+        {
+            glm::vec3 origin = Utils::InUnitSphere(seed) * 15.0f;
+            glm::vec3 target(Uniform(seed, -5.0f, 5.0f), Uniform(seed, -5.0f, 5.0f), Uniform(seed, -5.0f, 5.0f));
+            rays.push_back(AimAt(origin, target));
+        }
+
+        return rays;
+    }
+
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "Ray.h"
+#include "Scene.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace Bench {
+
+    // Every generator is driven by Utils::PCG_Hash from a fixed seed, so the same rays
+    // are produced on every run and every platform
+    constexpr uint32_t DatasetSeed = 0x9e3779b9;
+    constexpr uint32_t RaysPerSet = 4096;
+
+    enum class RayCase
+    {
+        Hit = 0,
+        Miss = 1,
+        Grazing = 2     // Tangent or edge-on rays that stress the epsilon and branch paths
+    };
+
+    const char* GetRayCaseName(RayCase rayCase);
+
+    // Reference primitives the sets below are built around
+    Sphere MakeReferenceSphere();
+    Plane MakeReferencePlane();
+    Box MakeReferenceBox();
+    Triangle MakeReferenceTriangle();
+
+    std::vector<Ray> MakeSphereRays(const Sphere& sphere, RayCase rayCase, uint32_t count, uint32_t seed);
+    std::vector<Ray> MakePlaneRays(const Plane& plane, RayCase rayCase, uint32_t count, uint32_t seed);
+    std::vector<Ray> MakeBoxRays(const Box& box, RayCase rayCase, uint32_t count, uint32_t seed);
+    std::vector<Ray> MakeTriangleRays(const Triangle& triangle, RayCase rayCase, uint32_t count, uint32_t seed);
+
+    // Scatters primitiveCount primitives of the enabled kinds through a 10 unit cube, materials are
+    // added as well so the scene can be traced
+    Scene MakeRandomScene(uint32_t primitiveCount, bool spheres, bool boxes, bool triangles, uint32_t seed);
+
+    // Rays from a shell around the random scene aimed into it, a mix of hits and misses
+    std::vector<Ray> MakeSceneRays(uint32_t count, uint32_t seed);
+
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "Renderer.h"
+
+// Gives the benchmarks access to the kernels Renderer keeps private
+class RendererBench
+{
+public:
+    // Makes the scene current and builds its BVH, the way Render() does
+    static void Bind(Renderer& renderer, const Scene& scene, const Camera* camera = nullptr)
+    {
+        renderer.UpdateScene(scene);
+        renderer.m_ActiveScene = &scene;
+        renderer.m_ActiveCamera = camera;
+        renderer.PrepareKernels();
+    }
+
+    static bool IntersectSphere(const Renderer& renderer, const Ray& ray, const Sphere& sphere, float& hitDistance)
+    {
+        return renderer.IntersectSphere(ray, sphere, hitDistance);
+    }
+
+    static bool IntersectPlane(const Renderer& renderer, const Ray& ray, const Plane& plane, float& hitDistance)
+    {
+        return renderer.IntersectPlane(ray, plane, hitDistance);
+    }
+
+    static bool IntersectBox(const Renderer& renderer, const Ray& ray, const Box& box, float& hitDistance)
+    {
+        return renderer.IntersectBox(ray, box, hitDistance);
+    }
+
+    static bool IntersectTriangle(const Renderer& renderer, const Ray& ray, const Triangle& triangle, float& hitDistance,
+        glm::vec3& normal)
+    {
+        return renderer.IntersectTriangle(ray, triangle, hitDistance, normal);
+    }
+
+    // Returns the hit distance, negative on a miss
+    static float TraceRay(Renderer& renderer, const Ray& ray)
+    {
+        Stats::Counters stats;
+        const Renderer::TraceRayKernel traceRay = Renderer::GetKernels(renderer.m_KernelFeatures).TraceRay;
+        return (renderer.*traceRay)(ray, stats).HitDistance;
+    }
+
+    static glm::vec4 PerPixel(Renderer& renderer, uint32_t x, uint32_t y, uint32_t& rayCount)
+    {
+        Stats::Counters stats;
+        Footprint::Set footprint;
+        footprint.Clear();
+        const Renderer::PerPixelKernel perPixel = Renderer::GetKernels(renderer.m_KernelFeatures).PerPixel;
+        return (renderer.*perPixel)(x, y, renderer.m_FrameIndex, rayCount, stats, footprint);
+    }
+
+    static float CalculateFresnel(Renderer& renderer, float cosTheta, float ior)
+    {
+        return renderer.CalculateFresnel(cosTheta, ior);
+    }
+};
@@ -0,0 +1,251 @@
+#include "Benchmarks.h"
+#include "SceneCases.h"
+
+#include "Camera.h"
+#include "Renderer.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+
+namespace Bench {
+
+    namespace {
+
+        struct ScalingConfig
+        {
+            uint32_t Threads;
+            ThreadAffinity Affinity;
+            bool NUMALocal;
+        };
+
+        struct ScalingSample
+        {
+            double FrameTime = 0.0;     // Mean wall time of a frame, in seconds
+            double BusyMean = 0.0, BusyMin = 0.0, BusyMax = 0.0; // Per worker and frame, in seconds
+            double TileMean = 0.0, TileMax = 0.0, TileDeviation = 0.0;
+            uint64_t Rays = 0;
+        };
+
+        const char* GetAffinityName(ThreadAffinity affinity)
+        {
+            switch (affinity)
+            {
+                case ThreadAffinity::None:    return "none";
+                case ThreadAffinity::Compact: return "compact";
+                case ThreadAffinity::Spread:  return "spread";
+            }
+            return "";
+        }
+
+        // 1, 2, 4, ... and the maximum itself
+        std::vector<uint32_t> GetThreadCounts(uint32_t maxThreads)
+        {
+            std::vector<uint32_t> counts;
+            for (uint32_t count = 1; count < maxThreads; count *= 2)
+                counts.push_back(count);
+            counts.push_back(maxThreads);
+            return counts;
+        }
+
+        ScalingSample Measure(const Scene& scene, const Camera& camera, const ScalingConfig& config, const Options& options)
+        {
+            Renderer renderer(true);
+            Renderer::Settings& settings = renderer.GetSettings();
+            settings.SlowRandom = false;
+            settings.ThreadCount = config.Threads;
+            settings.Affinity = config.Affinity;
+            settings.NUMALocal = config.NUMALocal;
+            renderer.OnResize(options.Width, options.Height);
+
+            // Starts the workers, builds the BVH and lets the tile owners touch their memory
+            renderer.Render(scene, camera);
+            renderer.ResolveImage();
+
+            ScalingSample sample;
+            std::vector<double> busy(config.Threads, 0.0);
+            std::vector<double> tiles;
+
+            for (uint32_t frame = 0; frame < options.ScalingFrames; frame++)
+            {
+                renderer.Render(scene, camera);
+
+                // Only the tile loop is measured, the resolve is a separate, much shorter loop
+                const ThreadPool& pool = renderer.GetThreadPool();
+                const std::vector<ThreadPool::WorkerStats>& stats = pool.GetWorkerStats();
+                for (size_t worker = 0; worker < stats.size() && worker < busy.size(); worker++)
+                    busy[worker] += stats[worker].BusyTime;
+                sample.FrameTime += pool.GetWallTime();
+                sample.Rays += renderer.GetRayCount();
+
+                if (tiles.empty())
+                    tiles.assign(renderer.GetTileTimes().size(), 0.0);
+                for (size_t i = 0; i < tiles.size(); i++)
+                    tiles[i] += renderer.GetTileTimes()[i];
+
+                renderer.ResolveImage();
+            }
+
+            const double frames = (double)options.ScalingFrames;
+            sample.FrameTime /= frames;
+
+            sample.BusyMin = *std::min_element(busy.begin(), busy.end()) / frames;
+            sample.BusyMax = *std::max_element(busy.begin(), busy.end()) / frames;
+            for (double time : busy)
+                sample.BusyMean += time / frames;
+            sample.BusyMean /= (double)busy.size();
+
+            for (double time : tiles)
+            {
+                sample.TileMean += time / frames;
+                sample.TileMax = std::max(sample.TileMax, time / frames);
+            }
+            sample.TileMean /= (double)tiles.size();
+            for (double time : tiles)
+                sample.TileDeviation += (time / frames - sample.TileMean) * (time / frames - sample.TileMean);
+            sample.TileDeviation = std::sqrt(sample.TileDeviation / (double)tiles.size());
+
+            return sample;
+        }
+
+        // Restarts one pool the way the renderer does when its thread settings change, and checks that
+        // every loop after a restart still runs each index exactly once. Returns the seconds per restart.
+        bool MeasureRestarts(uint32_t threads, uint32_t restarts, double& seconds)
+        {
+            constexpr uint32_t Count = 4096;
+            std::unique_ptr<std::atomic<uint32_t>[]> visits(new std::atomic<uint32_t>[Count]);
+            ThreadPool pool;
+
+            auto start = std::chrono::steady_clock::now();
+            for (uint32_t restart = 0; restart < restarts; restart++)
+            {
+                pool.Start(threads, restart % 2 ? ThreadAffinity::Compact : ThreadAffinity::None);
+                for (Schedule schedule : { Schedule::Dynamic, Schedule::Static })
+                {
+                    for (uint32_t i = 0; i < Count; i++)
+                        visits[i].store(0, std::memory_order_relaxed);
+                    pool.ParallelFor(Count, schedule, [&](uint32_t index, uint32_t)
+                        {
+                            visits[index].fetch_add(1, std::memory_order_relaxed);
+                        });
+                    for (uint32_t i = 0; i < Count; i++)
+                    {
+                        if (visits[i].load(std::memory_order_relaxed) != 1)
+                            return false;
+                    }
+                }
+                pool.Stop();
+            }
+            seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / restarts;
+            return true;
+        }
+
+    }
+
+    void RunScalingBenchmarks(Runner& runner)
+    {
+        const Options& options = runner.GetOptions();
+
+        const SceneCase* sceneCase = FindSceneCase(options.ScalingScene);
+        if (!sceneCase)
+        {
+            fprintf(stderr, "Unknown scene %s\n", options.ScalingScene.c_str());
+            return;
+        }
+
+        uint32_t maxThreads = options.MaxThreads;
+        if (maxThreads == 0)
+            maxThreads = std::max((uint32_t)GetProcessorTopology().size(), std::thread::hardware_concurrency());
+        maxThreads = std::max(maxThreads, 1u);
+
+        printf("Scaling %s over 1-%u threads, %u package(s)\n", sceneCase->Name, maxThreads, GetPackageCount());
+
+        Scene scene;
+        Scenes::CameraView view = sceneCase->Create(scene);
+
+        Camera camera(45.0f, 0.1f, 100.0f);
+        camera.OnResize(options.Width, options.Height);
+        camera.LookAt(view.Position, view.Target);
+
+        for (uint32_t threads : GetThreadCounts(maxThreads))
+        {
+            constexpr uint32_t Restarts = 16;
+            std::string name = "Scaling/restart/t" + std::to_string(threads);
+            if (!runner.ShouldRun(name))
+                continue;
+
+            double seconds = 0.0;
+            if (!MeasureRestarts(threads, Restarts, seconds))
+            {
+                fprintf(stderr, "%s: a loop after a restart did not run every index once\n", name.c_str());
+                continue;
+            }
+
+            Result result;
+            result.Name = name;
+            result.NsPerOp = seconds * 1e9;
+            result.MinNsPerOp = result.NsPerOp;
+            result.OpsPerTrial = 1;
+            result.Trials = Restarts;
+            result.Metrics.push_back({ "threads", (double)threads });
+            runner.Report(result);
+        }
+
+        // Speedup and efficiency are relative to a single unpinned worker
+        double baseline = 0.0;
+
+        for (uint32_t threads : GetThreadCounts(maxThreads))
+        {
+            for (ThreadAffinity affinity : { ThreadAffinity::None, ThreadAffinity::Compact, ThreadAffinity::Spread })
+            {
+                for (bool numaLocal : { false, true })
+                {
+                    ScalingConfig config = { threads, affinity, numaLocal };
+
+                    std::string name = std::string("Scaling/") + sceneCase->Name + "/t" + std::to_string(threads) +
+                        "/" + GetAffinityName(affinity) + (numaLocal ? "/numa" : "");
+                    if (!runner.ShouldRun(name) && !(threads == 1 && affinity == ThreadAffinity::None && !numaLocal))
+                        continue;
+
+                    ScalingSample sample = Measure(scene, camera, config, options);
+                    if (baseline == 0.0)
+                        baseline = sample.FrameTime;
+                    if (!runner.ShouldRun(name))
+                        continue;
+
+                    const double paths = (double)options.Width * options.Height;
+                    const double speedup = baseline / sample.FrameTime;
+
+                    Result result;
+                    result.Name = name;
+                    result.NsPerOp = sample.FrameTime * 1e9 / paths;
+                    result.MinNsPerOp = result.NsPerOp;
+                    result.RaysPerSecond = (double)sample.Rays / (sample.FrameTime * options.ScalingFrames);
+                    result.OpsPerTrial = (uint64_t)paths;
+                    result.Trials = options.ScalingFrames;
+                    result.Metrics.push_back({ "threads", (double)threads });
+                    result.Metrics.push_back({ "ms_per_frame", sample.FrameTime * 1e3 });
+                    result.Metrics.push_back({ "speedup", speedup });
+                    result.Metrics.push_back({ "efficiency", speedup / threads });
+                    result.Metrics.push_back({ "busy_mean_ms", sample.BusyMean * 1e3 });
+                    result.Metrics.push_back({ "busy_min_ms", sample.BusyMin * 1e3 });
+                    result.Metrics.push_back({ "busy_max_ms", sample.BusyMax * 1e3 });
+                    result.Metrics.push_back({ "idle_mean_ms", (sample.FrameTime - sample.BusyMean) * 1e3 });
+                    // 1 when every worker is busy for the same time, the slowest worker bounds the frame
+                    result.Metrics.push_back({ "worker_imbalance", sample.BusyMax / sample.BusyMean });
+                    result.Metrics.push_back({ "tile_mean_ms", sample.TileMean * 1e3 });
+                    result.Metrics.push_back({ "tile_max_ms", sample.TileMax * 1e3 });
+                    result.Metrics.push_back({ "tile_cv", sample.TileDeviation / sample.TileMean });
+                    runner.Report(result);
+                }
+            }
+        }
+    }
+
+}
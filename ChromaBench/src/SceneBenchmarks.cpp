@@ -0,0 +1,367 @@
+#include "Benchmarks.h"
+#include "ImageFile.h"
+#include "SceneCases.h"
+
+#include "Camera.h"
+#include "Checkpoint.h"
+#include "Renderer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <string>
+
+namespace Bench {
+
+    namespace {
+
+        using Clock = std::chrono::steady_clock;
+
+        // Seed of the reference renders, keeps their samples independent from the timed run
+        constexpr uint32_t ReferenceSeed = 1;
+
+        double Seconds(Clock::time_point start)
+        {
+            return std::chrono::duration<double>(Clock::now() - start).count();
+        }
+
+        // Renders are compared after tonemapping, so that a few bright fireflies do not dominate the error
+        double MeanSquaredError(const std::vector<glm::vec3>& image, const std::vector<glm::vec3>& reference,
+            uint32_t width, const Renderer::Rect& region, const Resolve::Params& params)
+        {
+            double sum = 0.0;
+            for (uint32_t y = region.Y; y < region.Y + region.Height; y++)
+            {
+                for (uint32_t x = region.X; x < region.X + region.Width; x++)
+                {
+                    const size_t i = (size_t)y * width + x;
+                    glm::vec3 difference = Resolve::Tonemap(image[i], params) - Resolve::Tonemap(reference[i], params);
+                    sum += (double)glm::dot(difference, difference);
+                }
+            }
+            return sum / ((double)region.Width * region.Height * 3);
+        }
+
+        // The crop of the options clamped to the image, the whole image without one
+        Renderer::Rect GetRegion(const Options& options)
+        {
+            Renderer::Rect region = { 0, 0, options.Width, options.Height };
+            if (options.CropWidth > 0 && options.CropHeight > 0 && options.CropX < options.Width && options.CropY < options.Height)
+            {
+                region.X = options.CropX;
+                region.Y = options.CropY;
+                region.Width = std::min(options.CropWidth, options.Width - options.CropX);
+                region.Height = std::min(options.CropHeight, options.Height - options.CropY);
+            }
+            return region;
+        }
+
+        void SetupRenderer(Renderer& renderer, const Options& options)
+        {
+            // The fast random path is deterministic, the references depend on that
+            renderer.GetSettings().SlowRandom = false;
+            renderer.GetSettings().PerfCounters = options.PerfCounters;
+            renderer.GetSettings().TextureCacheSize = (size_t)options.TextureCacheMB << 20;
+            renderer.OnResize(options.Width, options.Height);
+        }
+
+        bool RenderReference(const SceneCase& sceneCase, const Scene& scene, const Camera& camera, const Options& options,
+            const std::string& path)
+        {
+            printf("Rendering reference for %s (%u frames)\n", sceneCase.Name, options.ReferenceFrames);
+            fflush(stdout);
+
+            Renderer renderer(true);
+            SetupRenderer(renderer, options);
+            renderer.GetSettings().Seed = ReferenceSeed;
+
+            for (uint32_t frame = 0; frame < options.ReferenceFrames; frame++)
+                renderer.Render(scene, camera);
+
+            std::vector<glm::vec3> image;
+            renderer.GetAccumulatedImage(image);
+
+            std::filesystem::create_directories(options.ReferenceDirectory);
+            return ImageFile::WritePFM(path, options.Width, options.Height, image);
+        }
+
+        // Per frame counts of every counter the CPU provides, plus IPC and misses per thousand instructions
+        void AddPerfMetrics(Result& result, const std::string& prefix, const PerfCounters::Sample& sample, uint32_t frames)
+        {
+            for (uint32_t i = 0; i < PerfCounters::CounterCount; i++)
+            {
+                const PerfCounters::Counter counter = (PerfCounters::Counter)i;
+                if (sample.Has(counter))
+                    result.Metrics.push_back({ prefix + PerfCounters::GetCounterName(counter), (double)sample.Get(counter) / frames });
+            }
+
+            result.Metrics.push_back({ prefix + "ipc", sample.GetIPC() });
+
+            const double kiloInstructions = sample.Get(PerfCounters::Counter::Instructions) * 1e-3;
+            for (PerfCounters::Counter counter : { PerfCounters::Counter::L1DMisses, PerfCounters::Counter::LLCMisses,
+                PerfCounters::Counter::BranchMisses })
+            {
+                if (sample.Has(counter) && kiloInstructions > 0.0)
+                {
+                    result.Metrics.push_back({ prefix + PerfCounters::GetCounterName(counter) + "_pki",
+                        (double)sample.Get(counter) / kiloInstructions });
+                }
+            }
+        }
+
+        // Separate from the timed run, recording the cost slows rendering down
+        bool RenderHeatmap(const SceneCase& sceneCase, const Scene& scene, const Camera& camera, const Options& options)
+        {
+            Renderer renderer(true);
+            SetupRenderer(renderer, options);
+            renderer.GetSettings().Heatmap = options.Heatmap;
+
+            for (uint32_t frame = 0; frame < options.HeatmapFrames; frame++)
+                renderer.Render(scene, camera);
+            renderer.ResolveImage();
+
+            std::vector<float> cost;
+            renderer.GetCostImage(cost);
+            std::vector<glm::vec3> pixels(cost.begin(), cost.end());
+
+            std::string path = options.HeatmapDirectory + "/" + sceneCase.Name + "_" + Heatmap::GetMetricName(options.Heatmap);
+            std::filesystem::create_directories(options.HeatmapDirectory);
+            printf("    heatmap %s.ppm, red at %.1f, max %.1f %s per pixel\n", path.c_str(),
+                renderer.GetHeatmapScaleTop(), renderer.GetMaxCost(), Heatmap::GetMetricName(options.Heatmap));
+
+            return ImageFile::WritePFM(path + ".pfm", options.Width, options.Height, pixels) &&
+                ImageFile::WritePPM(path + ".ppm", options.Width, options.Height, renderer.GetImageData());
+        }
+
+        void RunScene(Runner& runner, const SceneCase& sceneCase)
+        {
+            const Options& options = runner.GetOptions();
+
+            const Renderer::Rect region = GetRegion(options);
+            const bool cropped = region.Width < options.Width || region.Height < options.Height;
+
+            std::string name = std::string("Scene/") + sceneCase.Name + (cropped ? "/crop" : "");
+            if (!runner.ShouldRun(name))
+                return;
+
+            Scene scene;
+            Scenes::CameraView view = sceneCase.Create(scene);
+
+            Camera camera(45.0f, 0.1f, 100.0f);
+            camera.OnResize(options.Width, options.Height);
+            camera.LookAt(view.Position, view.Target);
+
+            std::string referencePath = options.ReferenceDirectory + "/" + sceneCase.Name + "_" +
+                std::to_string(options.Width) + "x" + std::to_string(options.Height) + ".pfm";
+            if (options.UpdateReferences && !RenderReference(sceneCase, scene, camera, options, referencePath))
+                fprintf(stderr, "Failed to write %s\n", referencePath.c_str());
+
+            // The reference always covers the whole image, the crop is compared against its region
+            Renderer renderer(true);
+            SetupRenderer(renderer, options);
+            if (cropped)
+                renderer.GetSettings().Crop = region;
+
+            Clock::time_point buildStart = Clock::now();
+            renderer.UpdateScene(scene);
+            double buildTime = Seconds(buildStart);
+
+            // Render for the time budget, the accumulated image is then compared at equal time
+            uint32_t frames = 0;
+            uint64_t rays = 0;
+            uint64_t pixels = 0;
+            Stats::Counters counters;
+            PerfCounters::FrameSample perfCounters;
+            Clock::time_point start = Clock::now();
+            double elapsed = 0.0;
+            do
+            {
+                renderer.Render(scene, camera);
+                renderer.ResolveImage();
+                rays += renderer.GetRayCount();
+                pixels += renderer.GetRenderedPixelCount();
+                counters.Add(renderer.GetStats().Totals);
+                perfCounters.Render.Add(renderer.GetPerfCounters().Render);
+                perfCounters.Resolve.Add(renderer.GetPerfCounters().Resolve);
+                frames++;
+                elapsed = Seconds(start);
+            } while (elapsed < options.TimeBudget);
+
+            // Only the tiles under the crop are traced every frame, the rest once
+            const double paths = (double)pixels * renderer.GetSettings().SamplesPerPixel;
+
+            Result result;
+            result.Name = name;
+            result.NsPerOp = elapsed * 1e9 / paths;
+            result.MinNsPerOp = result.NsPerOp;
+            result.RaysPerSecond = (double)rays / elapsed;
+            result.OpsPerTrial = (uint64_t)paths;
+            result.Trials = 1;
+            result.Metrics.push_back({ "frames", (double)frames });
+            result.Metrics.push_back({ "ms_per_frame", elapsed * 1e3 / frames });
+            result.Metrics.push_back({ "paths_per_second", paths / elapsed });
+            result.Metrics.push_back({ "rays_per_path", (double)rays / paths });
+            result.Metrics.push_back({ "bvh_build_ms", buildTime * 1e3 });
+            result.Metrics.push_back({ "bvh_nodes", (double)renderer.GetBVH().GetNodeCount() });
+            if (cropped)
+                result.Metrics.push_back({ "crop_pixels", (double)region.Width * region.Height });
+            if (renderer.GetKernelFeatures() & RenderPolicy::Textures)
+            {
+                // The first frame fills the cache, later ones show whether it holds what a frame reads
+                const TextureCache::Stats textures = renderer.GetTextureCache().GetStats();
+                result.Metrics.push_back({ "texture_hit_rate", textures.GetHitRate() });
+                result.Metrics.push_back({ "texture_lookups_per_path", (double)(textures.Hits + textures.Misses) / paths });
+                result.Metrics.push_back({ "texture_locked_fraction", textures.Hits + textures.Misses > 0
+                    ? (double)textures.Locked / (double)(textures.Hits + textures.Misses) : 0.0 });
+                result.Metrics.push_back({ "texture_evictions_per_frame", (double)textures.Evictions / frames });
+                result.Metrics.push_back({ "texture_cache_mb", (double)textures.ResidentTiles * Texture::TileBytes / (1 << 20) });
+            }
+#if CHROMA_STATS
+            result.Metrics.push_back({ "nodes_per_ray", (double)counters.NodesVisited / (double)rays });
+            uint64_t tests = 0;
+            for (uint64_t count : counters.IntersectionTests)
+                tests += count;
+            result.Metrics.push_back({ "tests_per_ray", (double)tests / (double)rays });
+            result.Metrics.push_back({ "sky_hits_per_path", (double)counters.SkyHits / paths });
+            result.Metrics.push_back({ "emitter_hits_per_ray", (double)counters.EmitterHits / (double)rays });
+            result.Metrics.push_back({ "trace_fraction", counters.TileTicks > 0
+                ? (double)counters.TraceTicks / (double)counters.TileTicks : 0.0 });
+#endif
+
+            if (options.PerfCounters)
+            {
+                if (PerfCounters::IsAvailable())
+                {
+                    AddPerfMetrics(result, "render_", perfCounters.Render, frames);
+                    AddPerfMetrics(result, "resolve_", perfCounters.Resolve, frames);
+                }
+                else
+                {
+                    fprintf(stderr, "Hardware counters unavailable: %s\n", PerfCounters::GetUnavailableReason().c_str());
+                }
+            }
+
+            uint32_t referenceWidth = 0, referenceHeight = 0;
+            std::vector<glm::vec3> reference;
+            if (ImageFile::ReadPFM(referencePath, referenceWidth, referenceHeight, reference) &&
+                referenceWidth == options.Width && referenceHeight == options.Height)
+            {
+                std::vector<glm::vec3> image;
+                renderer.GetAccumulatedImage(image);
+
+                const Resolve::Params params = Resolve::MakeParams(1, renderer.GetSettings().Exposure,
+                    renderer.GetSettings().Tonemap);
+                double mse = MeanSquaredError(image, reference, options.Width, region, params);
+
+                result.Metrics.push_back({ "rmse", std::sqrt(mse) });
+                result.Metrics.push_back({ "psnr", mse > 0.0 ? 10.0 * std::log10(1.0 / mse) : 100.0 });
+            }
+            else
+            {
+                fprintf(stderr, "No reference at %s, run with --update-references to create it\n", referencePath.c_str());
+            }
+
+            runner.Report(result);
+
+            if (options.Heatmap != Heatmap::Metric::None && !RenderHeatmap(sceneCase, scene, camera, options))
+                fprintf(stderr, "Failed to write the %s heatmap\n", sceneCase.Name);
+        }
+
+
+        // Checkpoints a render halfway and resumes it in a renderer with other threads, seed and
+        // camera. The rest of the frames have to end on the bits of the render that never stopped.
+        void RunResume(Runner& runner, const SceneCase& sceneCase)
+        {
+            const Options& options = runner.GetOptions();
+
+            std::string name = std::string("Resume/") + sceneCase.Name;
+            if (!runner.ShouldRun(name))
+                return;
+
+            constexpr uint32_t Frames = 8;
+            const std::string path = (std::filesystem::temp_directory_path() /
+                (std::string("chromabench-") + sceneCase.Name + ".checkpoint")).string();
+            std::filesystem::remove(path);
+
+            Scene scene;
+            Scenes::CameraView view = sceneCase.Create(scene);
+
+            Camera camera(45.0f, 0.1f, 100.0f);
+            camera.OnResize(options.Width, options.Height);
+            camera.LookAt(view.Position, view.Target);
+
+            Renderer renderer(true);
+            SetupRenderer(renderer, options);
+            renderer.GetSettings().Seed = ReferenceSeed;
+            for (uint32_t frame = 0; frame < Frames / 2; frame++)
+                renderer.Render(scene, camera);
+
+            Checkpoint written;
+            Clock::time_point writeStart = Clock::now();
+            const bool saved = written.Open(path) && renderer.WriteCheckpoint(written, scene, camera);
+            written.Close();
+            const double writeTime = Seconds(writeStart);
+
+            for (uint32_t frame = Frames / 2; frame < Frames; frame++)
+                renderer.Render(scene, camera);
+            std::vector<glm::vec3> uninterrupted;
+            renderer.GetAccumulatedImage(uninterrupted);
+
+            Camera resumedCamera(45.0f, 0.1f, 100.0f);
+            resumedCamera.OnResize(options.Width, options.Height);
+            Renderer resumed(true);
+            SetupRenderer(resumed, options);
+            resumed.GetSettings().ThreadCount = 1;
+
+            Checkpoint read;
+            Clock::time_point resumeStart = Clock::now();
+            const bool loaded = saved && read.Open(path) && resumed.ResumeCheckpoint(read, scene, resumedCamera);
+            const double resumeTime = Seconds(resumeStart);
+            read.Close();
+            const uint64_t fileSize = saved ? (uint64_t)std::filesystem::file_size(path) : 0;
+            std::filesystem::remove(path);
+            if (!loaded)
+            {
+                fprintf(stderr, "%s: the checkpoint could not be %s\n", name.c_str(), saved ? "resumed" : "written");
+                return;
+            }
+
+            for (uint32_t frame = Frames / 2; frame < Frames; frame++)
+                resumed.Render(scene, resumedCamera);
+            std::vector<glm::vec3> image;
+            resumed.GetAccumulatedImage(image);
+
+            if (resumed.GetSettings().ThreadCount != 1 || image.size() != uninterrupted.size() ||
+                std::memcmp(image.data(), uninterrupted.data(), image.size() * sizeof(glm::vec3)) != 0)
+            {
+                fprintf(stderr, "%s: the resumed render differs from the uninterrupted one\n", name.c_str());
+                return;
+            }
+
+            Result result;
+            result.Name = name;
+            result.NsPerOp = resumeTime * 1e9;
+            result.MinNsPerOp = result.NsPerOp;
+            result.OpsPerTrial = 1;
+            result.Trials = 1;
+            result.Metrics.push_back({ "write_ms", writeTime * 1e3 });
+            result.Metrics.push_back({ "resume_ms", resumeTime * 1e3 });
+            result.Metrics.push_back({ "checkpoint_mb", (double)fileSize / (1 << 20) });
+            runner.Report(result);
+        }
+
+    }
+
+    void RunSceneBenchmarks(Runner& runner)
+    {
+        for (const SceneCase& sceneCase : GetSceneCases())
+        {
+            RunScene(runner, sceneCase);
+            RunResume(runner, sceneCase);
+        }
+    }
+
+}
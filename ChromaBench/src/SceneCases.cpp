@@ -0,0 +1,35 @@
+#include "SceneCases.h"
+
+#include <filesystem>
+
+namespace Bench {
+
+    const std::vector<SceneCase>& GetSceneCases()
+    {
+        static const std::vector<SceneCase> cases = {
+            { "default", [](Scene& scene) { return Scenes::CreateDefault(scene); } },
+            { "cornell-box", [](Scene& scene) { return Scenes::CreateCornellBox(scene); } },
+            { "spheres-100k", [](Scene& scene) { return Scenes::CreateRandomSpheres(scene, 100000); } },
+            { "mesh-1m", [](Scene& scene) { return Scenes::CreateTriangleMesh(scene, 1000000); } },
+            { "caustics", [](Scene& scene) { return Scenes::CreateCaustics(scene); } },
+            { "textured", [](Scene& scene)
+                {
+                    std::error_code error;
+                    const std::filesystem::path directory = std::filesystem::temp_directory_path(error) / "chroma-scene-textures";
+                    return Scenes::CreateTextured(scene, directory.string());
+                } },
+        };
+        return cases;
+    }
+
+    const SceneCase* FindSceneCase(const std::string& name)
+    {
+        for (const SceneCase& sceneCase : GetSceneCases())
+        {
+            if (name == sceneCase.Name)
+                return &sceneCase;
+        }
+        return nullptr;
+    }
+
+}
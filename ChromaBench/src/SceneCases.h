@@ -0,0 +1,23 @@
+#pragma once
+
+#include "Scene.h"
+#include "Scenes.h"
+
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace Bench {
+
+    struct SceneCase
+    {
+        const char* Name;
+        std::function<Scenes::CameraView(Scene&)> Create;
+    };
+
+    // The reference scenes shared by the scene and scaling suites
+    const std::vector<SceneCase>& GetSceneCases();
+    // nullptr when there is no scene of that name
+    const SceneCase* FindSceneCase(const std::string& name);
+
+}
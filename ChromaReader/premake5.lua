@@ -0,0 +1,53 @@
+project "ChromaReader"
+   kind "ConsoleApp"
+   language "C++"
+   cppdialect "C++17"
+   targetdir "bin/%{cfg.buildcfg}"
+   staticruntime "off"
+
+   -- Only maps the frames a renderer shares, none of the renderer itself is compiled in
+   files
+   {
+      "src/**.h",
+      "src/**.cpp",
+
+      "../Chroma/src/FrameOutput.h",
+      "../Chroma/src/FrameOutput.cpp",
+      "../Chroma/src/ImageFile.h",
+      "../Chroma/src/ImageFile.cpp",
+      "../Chroma/src/Memory.h",
+      "../Chroma/src/Memory.cpp",
+   }
+
+   includedirs
+   {
+      "src",
+      "../Chroma/src",
+
+      "../Walnut/vendor/glm",
+      "../Walnut/vendor/glfw/deps",
+   }
+
+   targetdir ("../bin/" .. outputdir .. "/%{prj.name}")
+   objdir ("../bin-int/" .. outputdir .. "/%{prj.name}")
+
+   filter "system:windows"
+      systemversion "latest"
+      defines { "WL_PLATFORM_WINDOWS" }
+
+   filter "configurations:Debug"
+      defines { "WL_DEBUG" }
+      runtime "Debug"
+      symbols "On"
+
+   filter "configurations:Release"
+      defines { "WL_RELEASE" }
+      runtime "Release"
+      optimize "On"
+      symbols "On"
+
+   filter "configurations:Dist"
+      defines { "WL_DIST" }
+      runtime "Release"
+      optimize "On"
+      symbols "Off"
@@ -0,0 +1,134 @@
+#include "FrameOutput.h"
+#include "ImageFile.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+static void PrintUsage()
+{
+    printf("Usage: ChromaReader [name] [options]\n");
+    printf("  Follows the frames a renderer shares (default name chroma-frame) and prints one line per frame\n");
+    printf("Options:\n");
+    printf("  --frames <n>            Stop after n frames (default: until the renderer goes away)\n");
+    printf("  --timeout <seconds>     Give up waiting for a renderer or a new frame (default 10)\n");
+    printf("  --dump <path>           Write the last frame to <path>.ppm, and <path>.pfm with radiance\n");
+    printf("  --quiet                 Only print the summary\n");
+}
+
+int main(int argc, char** argv)
+{
+    std::string name = "chroma-frame";
+    std::string dumpPath;
+    uint64_t maxFrames = 0;
+    double timeout = 10.0;
+    bool quiet = false;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+
+        if (strcmp(arg, "--frames") == 0 && value)
+            maxFrames = (uint64_t)atoll(argv[++i]);
+        else if (strcmp(arg, "--timeout") == 0 && value)
+            timeout = atof(argv[++i]);
+        else if (strcmp(arg, "--dump") == 0 && value)
+            dumpPath = argv[++i];
+        else if (strcmp(arg, "--quiet") == 0)
+            quiet = true;
+        else if (arg[0] != '-')
+            name = arg;
+        else
+        {
+            PrintUsage();
+            return strcmp(arg, "--help") == 0 ? 0 : 1;
+        }
+    }
+
+    FrameReader reader;
+    FrameReader::View view;
+    uint64_t lastFrame = 0, frames = 0, skipped = 0, torn = 0;
+    std::vector<uint32_t> color;
+    std::vector<glm::vec3> radiance;
+    uint32_t width = 0, height = 0;
+
+    using Clock = std::chrono::steady_clock;
+    Clock::time_point lastProgress = Clock::now();
+    while (maxFrames == 0 || frames < maxFrames)
+    {
+        if (std::chrono::duration<double>(Clock::now() - lastProgress).count() > timeout)
+            break;
+
+        // Resizing the viewport moves the frames to new memory of the same name
+        if (reader.IsClosed())
+        {
+            reader.Close();
+            if (!reader.Open(name))
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                continue;
+            }
+        }
+
+        if (!reader.Acquire(view, lastFrame))
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
+
+        // Straight from the shared memory, only the dumped frame is copied
+        const size_t pixelCount = (size_t)view.Width * view.Height;
+        uint64_t sum = 0;
+        for (size_t i = 0; i < pixelCount; i++)
+            sum += (view.Color[i] & 0xff) + ((view.Color[i] >> 8) & 0xff) + ((view.Color[i] >> 16) & 0xff);
+        if (!dumpPath.empty())
+        {
+            color.assign(view.Color, view.Color + pixelCount);
+            if (view.Radiance)
+                radiance.assign((const glm::vec3*)view.Radiance, (const glm::vec3*)view.Radiance + pixelCount);
+        }
+
+        if (!reader.IsValid(view))
+        {
+            torn++;
+            continue;
+        }
+
+        if (lastFrame != 0 && view.Frame > lastFrame + 1)
+            skipped += view.Frame - lastFrame - 1;
+        lastFrame = view.Frame;
+        frames++;
+        width = view.Width;
+        height = view.Height;
+        lastProgress = Clock::now();
+
+        const double mean = (double)sum / (double)(pixelCount * 3);
+        if (!quiet)
+        {
+            printf("Frame %llu: %ux%u, %u frames, %u spp, %.2fs, mean %.2f\n", (unsigned long long)view.Frame,
+                view.Width, view.Height, view.AccumulatedFrames, view.SamplesPerPixel, view.AccumulationTime, mean);
+            fflush(stdout);
+        }
+    }
+
+    printf("Read %llu frames, %llu skipped, %llu torn reads retried\n", (unsigned long long)frames,
+        (unsigned long long)skipped, (unsigned long long)torn);
+
+    if (!dumpPath.empty() && frames > 0)
+    {
+        bool written = ImageFile::WritePPM(dumpPath + ".ppm", width, height, color.data());
+        if (!radiance.empty())
+            written &= ImageFile::WritePFM(dumpPath + ".pfm", width, height, radiance);
+        if (!written)
+        {
+            fprintf(stderr, "Failed to write %s\n", dumpPath.c_str());
+            return 1;
+        }
+    }
+    return frames > 0 ? 0 : 1;
+}
@@ -0,0 +1,66 @@
+project "ChromaService"
+   kind "ConsoleApp"
+   language "C++"
+   cppdialect "C++17"
+   targetdir "bin/%{cfg.buildcfg}"
+   staticruntime "off"
+
+   -- Headless like ChromaBench, the renderer is compiled in without the application entry point
+   files
+   {
+      "src/**.h",
+      "src/**.cpp",
+
+      "../Chroma/src/**.h",
+      "../Chroma/src/**.cpp",
+   }
+
+   removefiles { "../Chroma/src/WalnutApp.cpp" }
+
+   includedirs
+   {
+      "src",
+      "../Chroma/src",
+
+      "../Walnut/vendor/imgui",
+      "../Walnut/vendor/glfw/include",
+      "../Walnut/vendor/glm",
+      "../Walnut/vendor/stb_image",
+      "../Walnut/vendor/glfw/deps",
+
+      "../Walnut/Walnut/src",
+
+      "%{IncludeDir.VulkanSDK}",
+   }
+
+   links
+   {
+       "Walnut"
+   }
+
+   targetdir ("../bin/" .. outputdir .. "/%{prj.name}")
+   objdir ("../bin-int/" .. outputdir .. "/%{prj.name}")
+
+   -- Kernels of every ISA level, see the root premake5.lua
+   ChromaKernelFlags()
+
+   filter "system:windows"
+      systemversion "latest"
+      defines { "WL_PLATFORM_WINDOWS" }
+
+   filter "configurations:Debug"
+      defines { "WL_DEBUG" }
+      runtime "Debug"
+      symbols "On"
+
+   filter "configurations:Release"
+      defines { "WL_RELEASE" }
+      runtime "Release"
+      optimize "On"
+      symbols "On"
+
+   filter "configurations:Dist"
+      defines { "WL_DIST", "CHROMA_STATS=0" }
+      runtime "Release"
+      optimize "On"
+      symbols "Off"
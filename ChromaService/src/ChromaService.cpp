@@ -0,0 +1,257 @@
+#include "RenderService.h"
+#include "Renderer.h"
+#include "Sequence.h"
+
+#include <algorithm>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+static RenderService::Server* s_Server = nullptr;
+
+static void PrintUsage()
+{
+    printf("Usage: ChromaService <command> [options]\n");
+    printf("  serve                   Render submitted jobs until interrupted\n");
+    printf("  submit <scene> <output> Queue a job, the image is written to <output> as .exr, .pfm, .png or .ppm\n");
+    printf("  watch <id>              Print the progress of a job until it finishes\n");
+    printf("  cancel <id>             Cancel a queued or rendering job\n");
+    printf("  sequence <scene> <output>  Render a camera path or turntable here, without the service. Frames\n");
+    printf("                          go to <output> with # replaced by the frame number, e.g. shot_####.png\n");
+    printf("Options:\n");
+    printf("  --address <address>     host:port or unix:<path> (default %s)\n", RenderService::DefaultAddress);
+    printf("  --cache-size <MB>       Memory for cached scenes and BVHs when serving (default 4096)\n");
+    printf("  --camera <x,y,z,tx,ty,tz>  Camera position and target of a submitted job\n");
+    printf("  --fov <degrees>         Vertical field of view (default 45)\n");
+    printf("  --size <w>x<h>          Image size (default 1280x720)\n");
+    printf("  --samples <n>           Samples per pixel (default 256)\n");
+    printf("  --priority <n>          Higher runs first (default 0)\n");
+    printf("  --wait                  Print the progress of a submitted job until it finishes\n");
+    printf("  --keyframes <file>      Camera and shape keys of a sequence, see Sequence.h for the format\n");
+    printf("  --turntable <x,y,z,radius,height>  Circle the camera around a target instead\n");
+    printf("  --frames <n>            Frames of a sequence (default 120, or as the keyframe file says)\n");
+    printf("  --range <first>-<last>  Only render these frames of a sequence\n");
+}
+
+static void PrintProgress(const RenderService::JobProgress& progress)
+{
+    printf("Job %u %s %u/%u frames %.2fs, load %.3fs%s, build %.3fs%s%s\n", progress.JobId,
+        RenderService::GetStateName(progress.State), progress.Frames, progress.TargetFrames, progress.RenderSeconds,
+        progress.LoadSeconds, progress.CacheHit ? " (cached)" : "", progress.BuildSeconds,
+        progress.Message[0] ? ": " : "", progress.Message);
+    fflush(stdout);
+}
+
+static int RenderSequence(const std::string& scenePath, const std::string& outputPattern, Sequence::Description& description,
+    const RenderService::JobRequest& request, uint32_t firstFrame, uint32_t lastFrame)
+{
+    Scene scene;
+    if (!LoadScene(scenePath, scene))
+    {
+        fprintf(stderr, "Can not load %s\n", scenePath.c_str());
+        return 1;
+    }
+
+    std::string error;
+    if (!Sequence::Validate(description, scene, error))
+    {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+
+    Sequence::Options options;
+    options.OutputPattern = outputPattern;
+    options.Width = request.Width;
+    options.Height = request.Height;
+    options.Samples = request.Samples;
+    options.FirstFrame = firstFrame;
+    options.LastFrame = lastFrame;
+
+    Renderer renderer(true);
+    renderer.GetSettings().SlowRandom = false;
+    renderer.UpdateScene(scene);
+    for (const std::string& textureError : renderer.GetTextureErrors())
+        fprintf(stderr, "Texture %s, rendering without it\n", textureError.c_str());
+    Sequence::Stats stats;
+    const bool written = Sequence::Render(renderer, scene, description, options, stats,
+        [&options](uint32_t frame, const Sequence::Stats& stats)
+        {
+            printf("Frame %u %s, %.1f frames/min\n", frame, Sequence::GetFramePath(options.OutputPattern, frame).c_str(),
+                stats.GetFramesPerMinute());
+            fflush(stdout);
+        });
+
+    printf("%u frames in %.2fs: %.1f frames/min, rendering %.2fs, waited %.3fs for the writer, writer busy %.2fs\n",
+        stats.Frames, stats.Seconds, stats.GetFramesPerMinute(), stats.RenderSeconds, stats.WriterWaitSeconds,
+        stats.WriteSeconds);
+    printf("%u camera cuts, %.1f%% of the tiles kept their samples from the frame before\n", stats.CameraCuts,
+        stats.Tiles > 0 ? 100.0 * stats.KeptTiles / stats.Tiles : 0.0);
+    if (!written)
+    {
+        fprintf(stderr, "%u frames could not be written\n", stats.FailedImages);
+        return 1;
+    }
+    return 0;
+}
+
+static int WatchJob(RenderService::Client& client, uint32_t jobId)
+{
+    RenderService::JobProgress progress;
+    while (client.ReceiveProgress(progress))
+    {
+        if (progress.JobId != jobId)
+            continue;
+        PrintProgress(progress);
+        if (RenderService::IsFinished(progress.State))
+            return progress.State == RenderService::JobState::Done ? 0 : 1;
+    }
+    fprintf(stderr, "Lost the connection to the service\n");
+    return 1;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    const std::string command = argv[1];
+    std::string address = RenderService::DefaultAddress;
+    size_t cacheSize = (size_t)4096 << 20;
+    RenderService::JobRequest request;
+    bool wait = false;
+    std::vector<std::string> positional;
+    std::string keyframePath;
+    Sequence::Turntable orbit;
+    uint32_t frameCount = 0, firstFrame = 0, lastFrame = ~0u;
+    bool fovGiven = false;
+
+    for (int i = 2; i < argc; i++)
+    {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+
+        if (strcmp(arg, "--address") == 0 && value)
+            address = argv[++i];
+        else if (strcmp(arg, "--cache-size") == 0 && value)
+            cacheSize = (size_t)std::max(atoll(argv[++i]), 1ll) << 20;
+        else if (strcmp(arg, "--camera") == 0 && value && sscanf(value, "%f,%f,%f,%f,%f,%f", &request.CameraPosition.x,
+            &request.CameraPosition.y, &request.CameraPosition.z, &request.CameraTarget.x, &request.CameraTarget.y,
+            &request.CameraTarget.z) == 6)
+            i++;
+        else if (strcmp(arg, "--fov") == 0 && value)
+        {
+            request.VerticalFOV = (float)atof(argv[++i]);
+            fovGiven = true;
+        }
+        else if (strcmp(arg, "--size") == 0 && value && sscanf(value, "%ux%u", &request.Width, &request.Height) == 2)
+            i++;
+        else if (strcmp(arg, "--samples") == 0 && value)
+            request.Samples = (uint32_t)std::max(atoi(argv[++i]), 1);
+        else if (strcmp(arg, "--priority") == 0 && value)
+            request.Priority = atoi(argv[++i]);
+        else if (strcmp(arg, "--wait") == 0)
+            wait = true;
+        else if (strcmp(arg, "--keyframes") == 0 && value)
+            keyframePath = argv[++i];
+        else if (strcmp(arg, "--turntable") == 0 && value && sscanf(value, "%f,%f,%f,%f,%f", &orbit.Target.x,
+            &orbit.Target.y, &orbit.Target.z, &orbit.Radius, &orbit.Height) == 5)
+        {
+            orbit.Enabled = true;
+            i++;
+        }
+        else if (strcmp(arg, "--frames") == 0 && value)
+            frameCount = (uint32_t)std::max(atoi(argv[++i]), 1);
+        else if (strcmp(arg, "--range") == 0 && value && sscanf(value, "%u-%u", &firstFrame, &lastFrame) == 2)
+            i++;
+        else if (arg[0] != '-')
+            positional.push_back(arg);
+        else
+        {
+            PrintUsage();
+            return strcmp(arg, "--help") == 0 ? 0 : 1;
+        }
+    }
+
+    if (command == "serve" && positional.empty())
+    {
+        RenderService::Server server(cacheSize);
+        if (!server.Listen(address))
+        {
+            fprintf(stderr, "Failed to listen on %s\n", address.c_str());
+            return 1;
+        }
+
+        s_Server = &server;
+        std::signal(SIGINT, [](int) { s_Server->Stop(); });
+        std::signal(SIGTERM, [](int) { s_Server->Stop(); });
+        printf("Serving on %s\n", address.c_str());
+        server.Run();
+        return 0;
+    }
+
+    if (command == "sequence" && positional.size() == 2)
+    {
+        Sequence::Description description;
+        std::string error;
+        if (!keyframePath.empty() && !Sequence::Load(keyframePath, description, error))
+        {
+            fprintf(stderr, "%s\n", error.c_str());
+            return 1;
+        }
+        if (orbit.Enabled)
+            description.Orbit = orbit;
+        if (frameCount > 0 || description.FrameCount == 0)
+            description.FrameCount = frameCount > 0 ? frameCount : 120;
+        if (keyframePath.empty() || fovGiven)
+            description.VerticalFOV = request.VerticalFOV;
+        return RenderSequence(positional[0], positional[1], description, request, firstFrame, lastFrame);
+    }
+
+    const bool submit = command == "submit" && positional.size() == 2;
+    if (!submit && !((command == "watch" || command == "cancel") && positional.size() == 1))
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    RenderService::Client client;
+    if (!client.Connect(address))
+    {
+        fprintf(stderr, "No service at %s\n", address.c_str());
+        return 1;
+    }
+
+    if (submit)
+    {
+        if (positional[0].size() >= sizeof(request.ScenePath) || positional[1].size() >= sizeof(request.OutputPath))
+        {
+            fprintf(stderr, "Paths are limited to %zu characters\n", sizeof(request.ScenePath) - 1);
+            return 1;
+        }
+        positional[0].copy(request.ScenePath, positional[0].size());
+        positional[1].copy(request.OutputPath, positional[1].size());
+
+        uint32_t jobId = 0;
+        if (!client.Submit(request, jobId))
+        {
+            fprintf(stderr, "Failed to submit the job\n");
+            return 1;
+        }
+        printf("Job %u\n", jobId);
+        return wait ? WatchJob(client, jobId) : 0;
+    }
+
+    const uint32_t jobId = (uint32_t)atoi(positional[0].c_str());
+    if (!(command == "cancel" ? client.Cancel(jobId) : client.Watch(jobId)))
+    {
+        fprintf(stderr, "Lost the connection to the service\n");
+        return 1;
+    }
+    return WatchJob(client, jobId);
+}
@@ -1,4 +1,5 @@
 #include "Application.h"
+#include "Timer.h"
 
 //
 // Adapted from Dear ImGui Vulkan example
@@ -51,6 +52,10 @@ static bool                     g_SwapChainRebuild = false;
 static std::vector<std::vector<VkCommandBuffer>> s_AllocatedCommandBuffers;
 static std::vector<std::vector<std::function<void()>>> s_ResourceFreeQueue;
 
+// Recorded into the next frame's command buffer, see Application::SubmitFrameCommand
+static std::vector<std::function<void(VkCommandBuffer)>> s_FrameCommandQueue;
+static std::vector<VkFence> s_FrameCommandFences;
+
 // Unlike g_MainWindowData.FrameIndex, this is not the the swapchain image index
 // and is always guaranteed to increase (eg. 0, 1, 2, 0, 1, 2)
 static uint32_t s_CurrentFrameIndex = 0;
@@ -270,6 +275,36 @@ static void CleanupVulkanWindow()
 	ImGui_ImplVulkanH_DestroyWindow(g_Instance, g_Device, &g_MainWindowData, g_Allocator);
 }
 
+static void RecordFrameCommands(VkCommandBuffer command_buffer)
+{
+	for (auto& func : s_FrameCommandQueue)
+		func(command_buffer);
+	s_FrameCommandQueue.clear();
+}
+
+static void SignalFrameCommandFences()
+{
+	// An empty submission signals its fence once all previously submitted work has completed
+	for (VkFence fence : s_FrameCommandFences)
+	{
+		VkResult err = vkQueueSubmit(g_Queue, 0, NULL, fence);
+		check_vk_result(err);
+	}
+	s_FrameCommandFences.clear();
+}
+
+// Submits queued frame commands on their own (blocking), so that nobody waits on their fences forever
+static void FlushPendingFrameCommands()
+{
+	if (!s_FrameCommandQueue.empty())
+	{
+		VkCommandBuffer command_buffer = Walnut::Application::GetCommandBuffer(true);
+		RecordFrameCommands(command_buffer);
+		Walnut::Application::FlushCommandBuffer(command_buffer);
+	}
+	SignalFrameCommandFences();
+}
+
 static void FrameRender(ImGui_ImplVulkanH_Window* wd, ImDrawData* draw_data)
 {
 	VkResult err;
@@ -288,6 +323,7 @@ static void FrameRender(ImGui_ImplVulkanH_Window* wd, ImDrawData* draw_data)
 
 	ImGui_ImplVulkanH_Frame* fd = &wd->Frames[wd->FrameIndex];
 	{
+		WL_PROFILE_ZONE("FrameRender: wait for frame fence");
 		err = vkWaitForFences(g_Device, 1, &fd->Fence, VK_TRUE, UINT64_MAX);    // wait indefinitely instead of periodically checking
 		check_vk_result(err);
 
@@ -319,6 +355,10 @@ static void FrameRender(ImGui_ImplVulkanH_Window* wd, ImDrawData* draw_data)
 		err = vkBeginCommandBuffer(fd->CommandBuffer, &info);
 		check_vk_result(err);
 	}
+
+	// Uploads etc. have to be recorded outside of the render pass
+	RecordFrameCommands(fd->CommandBuffer);
+
 	{
 		VkRenderPassBeginInfo info = {};
 		info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
@@ -352,6 +392,8 @@ static void FrameRender(ImGui_ImplVulkanH_Window* wd, ImDrawData* draw_data)
 		check_vk_result(err);
 		err = vkQueueSubmit(g_Queue, 1, &info, fd->Fence);
 		check_vk_result(err);
+
+		SignalFrameCommandFences();
 	}
 }
 
@@ -526,6 +568,9 @@ namespace Walnut {
 
 		m_LayerStack.clear();
 
+		// Run whatever was queued for a frame that never came, resources below may wait on it
+		FlushPendingFrameCommands();
+
 		// Cleanup
 		VkResult err = vkDeviceWaitIdle(g_Device);
 		check_vk_result(err);
@@ -559,18 +604,36 @@ namespace Walnut {
 		ImVec4 clear_color = ImVec4(0.45f, 0.55f, 0.60f, 1.00f);
 		ImGuiIO& io = ImGui::GetIO();
 
+		Profiler::SetThreadName("Main");
+
 		// Main loop
 		while (!glfwWindowShouldClose(m_WindowHandle) && m_Running)
 		{
+			WL_PROFILE_ZONE("Application::Run");
+
 			// Poll and handle events (inputs, window resize, etc.)
 			// You can read the io.WantCaptureMouse, io.WantCaptureKeyboard flags to tell if dear imgui wants to use your inputs.
 			// - When io.WantCaptureMouse is true, do not dispatch mouse input data to your main application.
 			// - When io.WantCaptureKeyboard is true, do not dispatch keyboard input data to your main application.
 			// Generally you may always pass all inputs to dear imgui, and hide them from your application based on those two flags.
-			glfwPollEvents();
+			// Idle or minimized windows wait for input instead, the timeout keeps them ticking slowly.
+			// Minimized windows still update the layers and the platform windows, only the main
+			// viewport is neither drawn nor presented.
+			const bool minimized = glfwGetWindowAttrib(m_WindowHandle, GLFW_ICONIFIED) != 0;
+			const bool focused = glfwGetWindowAttrib(m_WindowHandle, GLFW_FOCUSED) != 0;
+			if (m_Idle)
+				glfwWaitEventsTimeout(focused ? 0.1 : 0.5);
+			else if (minimized)
+				glfwWaitEventsTimeout(0.1);
+			else
+				glfwPollEvents();
+			m_Idle = false;
 
-			for (auto& layer : m_LayerStack)
-				layer->OnUpdate(m_TimeStep);
+			{
+				WL_PROFILE_ZONE("Layer::OnUpdate");
+				for (auto& layer : m_LayerStack)
+					layer->OnUpdate(m_TimeStep);
+			}
 
 			// Resize swap chain?
 			if (g_SwapChainRebuild)
@@ -647,6 +710,7 @@ namespace Walnut {
 					}
 				}
 
+				WL_PROFILE_ZONE("Layer::OnUIRender");
 				for (auto& layer : m_LayerStack)
 					layer->OnUIRender();
 
@@ -662,7 +726,13 @@ namespace Walnut {
 			wd->ClearValue.color.float32[2] = clear_color.z * clear_color.w;
 			wd->ClearValue.color.float32[3] = clear_color.w;
 			if (!main_is_minimized)
+			{
+				WL_PROFILE_ZONE("FrameRender");
 				FrameRender(wd, main_draw_data);
+			}
+
+			// Nothing recorded the frame commands if minimized or the swap chain is out of date
+			FlushPendingFrameCommands();
 
 			// Update and Render additional Platform Windows
 			if (io.ConfigFlags & ImGuiConfigFlags_ViewportsEnable)
@@ -673,7 +743,10 @@ namespace Walnut {
 
 			// Present Main Platform Window
 			if (!main_is_minimized)
+			{
+				WL_PROFILE_ZONE("FramePresent");
 				FramePresent(wd);
+			}
 
 			float time = GetTime();
 			m_FrameTime = time - m_LastFrameTime;
@@ -686,6 +759,7 @@ namespace Walnut {
 	void Application::Close()
 	{
 		m_Running = false;
+		glfwPostEmptyEvent();
 	}
 
 	float Application::GetTime()
@@ -735,6 +809,8 @@ namespace Walnut {
 
 	void Application::FlushCommandBuffer(VkCommandBuffer commandBuffer)
 	{
+		WL_PROFILE_FUNCTION();
+
 		const uint64_t DEFAULT_FENCE_TIMEOUT = 100000000000;
 
 		VkSubmitInfo end_info = {};
@@ -762,6 +838,13 @@ namespace Walnut {
 	}
 
 
+	void Application::SubmitFrameCommand(std::function<void(VkCommandBuffer)>&& func, VkFence signalFence)
+	{
+		s_FrameCommandQueue.emplace_back(std::move(func));
+		if (signalFence != VK_NULL_HANDLE)
+			s_FrameCommandFences.push_back(signalFence);
+	}
+
 	void Application::SubmitResourceFree(std::function<void()>&& func)
 	{
 		s_ResourceFreeQueue[s_CurrentFrameIndex].emplace_back(func);
@@ -45,6 +45,10 @@ namespace Walnut {
 
 		void Close();
 
+		// Set by a layer with nothing left to do, the main loop then sleeps until input arrives
+		// instead of spinning. Cleared again at the start of every frame.
+		void SetIdle() { m_Idle = true; }
+
 		float GetTime();
 		GLFWwindow* GetWindowHandle() const { return m_WindowHandle; }
 
@@ -55,6 +59,10 @@ namespace Walnut {
 		static VkCommandBuffer GetCommandBuffer(bool begin);
 		static void FlushCommandBuffer(VkCommandBuffer commandBuffer);
 
+		// Records func into the current frame's command buffer ahead of the UI render pass,
+		// without blocking. If signalFence is set it gets signaled once that work has executed.
+		static void SubmitFrameCommand(std::function<void(VkCommandBuffer)>&& func, VkFence signalFence = VK_NULL_HANDLE);
+
 		static void SubmitResourceFree(std::function<void()>&& func);
 	private:
 		void Init();
@@ -63,6 +71,7 @@ namespace Walnut {
 		ApplicationSpecification m_Specification;
 		GLFWwindow* m_WindowHandle = nullptr;
 		bool m_Running = false;
+		bool m_Idle = false;
 
 		float m_TimeStep = 0.0f;
 		float m_FrameTime = 0.0f;
@@ -4,6 +4,7 @@
 #include "backends/imgui_impl_vulkan.h"
 
 #include "Application.h"
+#include "Timer.h"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
@@ -35,6 +36,63 @@ namespace Walnut {
 			return 0;
 		}
 		
+		static bool IsFullImage(const std::vector<ImageRegion>& regions, uint32_t width, uint32_t height)
+		{
+			return regions.size() == 1 && regions[0].X == 0 && regions[0].Y == 0 && regions[0].Width == width && regions[0].Height == height;
+		}
+
+		// Records the staging buffer -> image copy along with the layout transitions around it.
+		// The staging buffer has the same layout as the image, one copy region is issued per rectangle.
+		static void RecordUpload(VkCommandBuffer command_buffer, VkBuffer stagingBuffer, VkImage image, uint32_t width, uint32_t bytesPerPixel,
+			const std::vector<ImageRegion>& regions, bool keepContents)
+		{
+			VkImageMemoryBarrier copy_barrier = {};
+			copy_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			copy_barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			copy_barrier.oldLayout = keepContents ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED;
+			copy_barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			copy_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			copy_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			copy_barrier.image = image;
+			copy_barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			copy_barrier.subresourceRange.levelCount = 1;
+			copy_barrier.subresourceRange.layerCount = 1;
+			// Previous frames may still be sampling from the image
+			vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_HOST_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL, 1, &copy_barrier);
+
+			std::vector<VkBufferImageCopy> copies(regions.size());
+			for (size_t i = 0; i < regions.size(); i++)
+			{
+				const ImageRegion& rect = regions[i];
+				VkBufferImageCopy& region = copies[i];
+				region = {};
+				region.bufferOffset = ((uint64_t)rect.Y * width + rect.X) * bytesPerPixel;
+				region.bufferRowLength = width;
+				region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+				region.imageSubresource.layerCount = 1;
+				region.imageOffset.x = (int32_t)rect.X;
+				region.imageOffset.y = (int32_t)rect.Y;
+				region.imageExtent.width = rect.Width;
+				region.imageExtent.height = rect.Height;
+				region.imageExtent.depth = 1;
+			}
+			vkCmdCopyBufferToImage(command_buffer, stagingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, (uint32_t)copies.size(), copies.data());
+
+			VkImageMemoryBarrier use_barrier = {};
+			use_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			use_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			use_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			use_barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			use_barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			use_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			use_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			use_barrier.image = image;
+			use_barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			use_barrier.subresourceRange.levelCount = 1;
+			use_barrier.subresourceRange.layerCount = 1;
+			vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, NULL, 0, NULL, 1, &use_barrier);
+		}
+
 		static VkFormat WalnutFormatToVulkanFormat(ImageFormat format)
 		{
 			switch (format)
@@ -64,8 +122,8 @@ namespace Walnut {
 			m_Format = ImageFormat::RGBA;
 		}
 
-		m_Width = width;
-		m_Height = height;
+		m_Width = m_CapacityWidth = width;
+		m_Height = m_CapacityHeight = height;
 		
 		AllocateMemory(m_Width * m_Height * Utils::BytesPerPixel(m_Format));
 		SetData(data);
@@ -73,7 +131,7 @@ namespace Walnut {
 	}
 
 	Image::Image(uint32_t width, uint32_t height, ImageFormat format, const void* data)
-		: m_Width(width), m_Height(height), m_Format(format)
+		: m_Width(width), m_Height(height), m_CapacityWidth(width), m_CapacityHeight(height), m_Format(format)
 	{
 		AllocateMemory(m_Width * m_Height * Utils::BytesPerPixel(m_Format));
 		if (data)
@@ -99,8 +157,8 @@ namespace Walnut {
 			info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
 			info.imageType = VK_IMAGE_TYPE_2D;
 			info.format = vulkanFormat;
-			info.extent.width = m_Width;
-			info.extent.height = m_Height;
+			info.extent.width = m_CapacityWidth;
+			info.extent.height = m_CapacityHeight;
 			info.extent.depth = 1;
 			info.mipLevels = 1;
 			info.arrayLayers = 1;
@@ -173,16 +231,45 @@ namespace Walnut {
 			vkFreeMemory(device, stagingBufferMemory, nullptr);
 		});
 
+		if (!m_StagingRing.empty())
+		{
+			Application::SubmitResourceFree([stagingRing = std::move(m_StagingRing)]()
+			{
+				VkDevice device = Application::GetDevice();
+
+				for (const StagingSlot& slot : stagingRing)
+				{
+					vkWaitForFences(device, 1, &slot.Fence, VK_TRUE, UINT64_MAX);
+					vkDestroyFence(device, slot.Fence, nullptr);
+					vkUnmapMemory(device, slot.Memory);
+					vkDestroyBuffer(device, slot.Buffer, nullptr);
+					vkFreeMemory(device, slot.Memory, nullptr);
+				}
+			});
+			m_StagingRing.clear();
+		}
+
 		m_Sampler = nullptr;
 		m_ImageView = nullptr;
 		m_Image = nullptr;
 		m_Memory = nullptr;
 		m_StagingBuffer = nullptr;
 		m_StagingBufferMemory = nullptr;
+		m_HasContents = false;
 	}
 
 	void Image::SetData(const void* data)
 	{
+		SetData(data, { { 0, 0, m_Width, m_Height } });
+	}
+
+	void Image::SetData(const void* data, const std::vector<ImageRegion>& regions)
+	{
+		WL_PROFILE_FUNCTION();
+
+		if (regions.empty())
+			return;
+
 		VkDevice device = Application::GetDevice();
 
 		size_t upload_size = m_Width * m_Height * Utils::BytesPerPixel(m_Format);
@@ -195,7 +282,7 @@ namespace Walnut {
 			{
 				VkBufferCreateInfo buffer_info = {};
 				buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-				buffer_info.size = upload_size;
+				buffer_info.size = m_CapacityWidth * m_CapacityHeight * Utils::BytesPerPixel(m_Format);
 				buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
 				buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 				err = vkCreateBuffer(device, &buffer_info, nullptr, &m_StagingBuffer);
@@ -220,7 +307,22 @@ namespace Walnut {
 			char* map = NULL;
 			err = vkMapMemory(device, m_StagingBufferMemory, 0, m_AlignedSize, 0, (void**)(&map));
 			check_vk_result(err);
-			memcpy(map, data, upload_size);
+			uint32_t bytesPerPixel = Utils::BytesPerPixel(m_Format);
+			if (Utils::IsFullImage(regions, m_Width, m_Height))
+			{
+				memcpy(map, data, upload_size);
+			}
+			else
+			{
+				for (const ImageRegion& region : regions)
+				{
+					for (uint32_t y = region.Y; y < region.Y + region.Height; y++)
+					{
+						size_t offset = ((size_t)y * m_Width + region.X) * bytesPerPixel;
+						memcpy(map + offset, (const char*)data + offset, (size_t)region.Width * bytesPerPixel);
+					}
+				}
+			}
 			VkMappedMemoryRange range[1] = {};
 			range[0].sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
 			range[0].memory = m_StagingBufferMemory;
@@ -233,59 +335,156 @@ namespace Walnut {
 
 		// Copy to Image
 		{
+			bool keepContents = m_HasContents && !Utils::IsFullImage(regions, m_Width, m_Height);
 			VkCommandBuffer command_buffer = Application::GetCommandBuffer(true);
+			Utils::RecordUpload(command_buffer, m_StagingBuffer, m_Image, m_Width, Utils::BytesPerPixel(m_Format), regions, keepContents);
+			Application::FlushCommandBuffer(command_buffer);
+			m_HasContents = true;
+		}
+	}
 
-			VkImageMemoryBarrier copy_barrier = {};
-			copy_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-			copy_barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-			copy_barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-			copy_barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-			copy_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-			copy_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-			copy_barrier.image = m_Image;
-			copy_barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			copy_barrier.subresourceRange.levelCount = 1;
-			copy_barrier.subresourceRange.layerCount = 1;
-			vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_HOST_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL, 1, &copy_barrier);
+	void Image::AllocateStagingRing()
+	{
+		VkDevice device = Application::GetDevice();
 
-			VkBufferImageCopy region = {};
-			region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			region.imageSubresource.layerCount = 1;
-			region.imageExtent.width = m_Width;
-			region.imageExtent.height = m_Height;
-			region.imageExtent.depth = 1;
-			vkCmdCopyBufferToImage(command_buffer, m_StagingBuffer, m_Image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+		// Sized for the capacity so that resizing within it keeps the ring
+		size_t upload_size = m_CapacityWidth * m_CapacityHeight * Utils::BytesPerPixel(m_Format);
 
-			VkImageMemoryBarrier use_barrier = {};
-			use_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-			use_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-			use_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-			use_barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-			use_barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-			use_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-			use_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-			use_barrier.image = m_Image;
-			use_barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			use_barrier.subresourceRange.levelCount = 1;
-			use_barrier.subresourceRange.layerCount = 1;
-			vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, NULL, 0, NULL, 1, &use_barrier);
+		VkResult err;
 
-			Application::FlushCommandBuffer(command_buffer);
+		m_StagingRing.resize(StagingRingSize);
+		for (StagingSlot& slot : m_StagingRing)
+		{
+			VkBufferCreateInfo buffer_info = {};
+			buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+			buffer_info.size = upload_size;
+			buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+			buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+			err = vkCreateBuffer(device, &buffer_info, nullptr, &slot.Buffer);
+			check_vk_result(err);
+			VkMemoryRequirements req;
+			vkGetBufferMemoryRequirements(device, slot.Buffer, &req);
+
+			// Coherent memory saves the explicit flush, but only host visible is required
+			uint32_t memoryType = Utils::GetVulkanMemoryType(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, req.memoryTypeBits);
+			m_StagingCoherent = memoryType != 0xffffffff;
+			if (!m_StagingCoherent)
+				memoryType = Utils::GetVulkanMemoryType(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, req.memoryTypeBits);
+
+			VkMemoryAllocateInfo alloc_info = {};
+			alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+			alloc_info.allocationSize = req.size;
+			alloc_info.memoryTypeIndex = memoryType;
+			err = vkAllocateMemory(device, &alloc_info, nullptr, &slot.Memory);
+			check_vk_result(err);
+			err = vkBindBufferMemory(device, slot.Buffer, slot.Memory, 0);
+			check_vk_result(err);
+
+			// Stays mapped until the ring is released
+			err = vkMapMemory(device, slot.Memory, 0, VK_WHOLE_SIZE, 0, &slot.MappedData);
+			check_vk_result(err);
+
+			// Created signaled so that the first BeginUpload() doesn't wait
+			VkFenceCreateInfo fence_info = {};
+			fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+			fence_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+			err = vkCreateFence(device, &fence_info, nullptr, &slot.Fence);
+			check_vk_result(err);
 		}
+
+		m_StagingIndex = 0;
+	}
+
+	void* Image::BeginUpload()
+	{
+		WL_PROFILE_FUNCTION();
+
+		if (m_StagingRing.empty())
+			AllocateStagingRing();
+
+		// Only blocks if the GPU is more than StagingRingSize uploads behind
+		StagingSlot& slot = m_StagingRing[m_StagingIndex];
+		VkResult err = vkWaitForFences(Application::GetDevice(), 1, &slot.Fence, VK_TRUE, UINT64_MAX);
+		check_vk_result(err);
+
+		return slot.MappedData;
+	}
+
+	void Image::EndUpload()
+	{
+		EndUpload({ { 0, 0, m_Width, m_Height } });
+	}
+
+	void Image::EndUpload(const std::vector<ImageRegion>& regions)
+	{
+		WL_PROFILE_FUNCTION();
+
+		if (regions.empty())
+			return;
+
+		VkDevice device = Application::GetDevice();
+
+		StagingSlot& slot = m_StagingRing[m_StagingIndex];
+		m_StagingIndex = (m_StagingIndex + 1) % StagingRingSize;
+
+		VkResult err;
+
+		if (!m_StagingCoherent)
+		{
+			VkMappedMemoryRange range = {};
+			range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+			range.memory = slot.Memory;
+			range.size = VK_WHOLE_SIZE;
+			err = vkFlushMappedMemoryRanges(device, 1, &range);
+			check_vk_result(err);
+		}
+
+		err = vkResetFences(device, 1, &slot.Fence);
+		check_vk_result(err);
+
+		bool keepContents = m_HasContents && !Utils::IsFullImage(regions, m_Width, m_Height);
+		Application::SubmitFrameCommand([stagingBuffer = slot.Buffer, image = m_Image, width = m_Width, bytesPerPixel = Utils::BytesPerPixel(m_Format),
+			regions, keepContents](VkCommandBuffer commandBuffer)
+		{
+			Utils::RecordUpload(commandBuffer, stagingBuffer, image, width, bytesPerPixel, regions, keepContents);
+		}, slot.Fence);
+		m_HasContents = true;
 	}
 
 	void Image::Resize(uint32_t width, uint32_t height)
 	{
-		if (m_Image && m_Width == width && m_Height == height)
+		if (m_Image && m_Width == width && m_Height == height && m_CapacityWidth == width && m_CapacityHeight == height)
 			return;
 
 		// TODO: max size?
 
+		m_Width = m_CapacityWidth = width;
+		m_Height = m_CapacityHeight = height;
+
+		Release();
+		AllocateMemory(m_Width * m_Height * Utils::BytesPerPixel(m_Format));
+	}
+
+	void Image::Resize(uint32_t width, uint32_t height, uint32_t capacityWidth, uint32_t capacityHeight)
+	{
+		if (m_Image && capacityWidth == m_CapacityWidth && capacityHeight == m_CapacityHeight)
+		{
+			// Fits, the image, memory, sampler and descriptor set are all kept. Staging rows are m_Width
+			// pixels apart, contents uploaded at another width are not kept by partial uploads.
+			if (width != m_Width)
+				m_HasContents = false;
+			m_Width = width;
+			m_Height = height;
+			return;
+		}
+
 		m_Width = width;
 		m_Height = height;
+		m_CapacityWidth = capacityWidth;
+		m_CapacityHeight = capacityHeight;
 
 		Release();
-		AllocateMemory(m_Width * m_Height * Utils::BytesPerPixel(m_Format));
+		AllocateMemory(m_CapacityWidth * m_CapacityHeight * Utils::BytesPerPixel(m_Format));
 	}
 
 }
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include <vector>
 
 #include "vulkan/vulkan.h"
 
@@ -13,6 +14,13 @@ namespace Walnut {
 		RGBA32F
 	};
 
+	// Rectangle within an image, in pixels
+	struct ImageRegion
+	{
+		uint32_t X = 0, Y = 0;
+		uint32_t Width = 0, Height = 0;
+	};
+
 	class Image
 	{
 	public:
@@ -21,18 +29,52 @@ namespace Walnut {
 		~Image();
 
 		void SetData(const void* data);
+		// Only uploads the given regions, data still covers the whole image
+		void SetData(const void* data, const std::vector<ImageRegion>& regions);
+
+		// Streaming upload: returns a persistently mapped staging buffer of GetWidth() * GetHeight()
+		// pixels to write the new contents into. EndUpload() records the copy into the current
+		// frame's command buffer instead of waiting for it like SetData() does.
+		void* BeginUpload();
+		void EndUpload();
+		// Only the given regions of the staging buffer are copied, the rest of the image is kept
+		void EndUpload(const std::vector<ImageRegion>& regions);
 
 		VkDescriptorSet GetDescriptorSet() const { return m_DescriptorSet; }
 
 		void Resize(uint32_t width, uint32_t height);
+		// Only the top-left width x height pixels of a capacityWidth x capacityHeight image are used.
+		// GPU resources are only recreated when the capacity changes, display with GetUVMax(). After a
+		// change of width the next upload should cover the whole image.
+		void Resize(uint32_t width, uint32_t height, uint32_t capacityWidth, uint32_t capacityHeight);
 
 		uint32_t GetWidth() const { return m_Width; }
 		uint32_t GetHeight() const { return m_Height; }
+
+		uint32_t GetCapacityWidth() const { return m_CapacityWidth; }
+		uint32_t GetCapacityHeight() const { return m_CapacityHeight; }
+
+		// Texture coordinates of the bottom-right corner of the used area
+		float GetUVMaxX() const { return (float)m_Width / (float)m_CapacityWidth; }
+		float GetUVMaxY() const { return (float)m_Height / (float)m_CapacityHeight; }
 	private:
 		void AllocateMemory(uint64_t size);
+		void AllocateStagingRing();
 		void Release();
 	private:
+		// Slots are recycled once the GPU has signaled the fence of their last copy
+		static constexpr uint32_t StagingRingSize = 3;
+
+		struct StagingSlot
+		{
+			VkBuffer Buffer = nullptr;
+			VkDeviceMemory Memory = nullptr;
+			void* MappedData = nullptr;
+			VkFence Fence = nullptr;
+		};
+
 		uint32_t m_Width = 0, m_Height = 0;
+		uint32_t m_CapacityWidth = 0, m_CapacityHeight = 0;
 
 		VkImage m_Image = nullptr;
 		VkImageView m_ImageView = nullptr;
@@ -46,6 +88,13 @@ namespace Walnut {
 
 		size_t m_AlignedSize = 0;
 
+		// False until the first upload, partial uploads may only keep contents that exist
+		bool m_HasContents = false;
+
+		std::vector<StagingSlot> m_StagingRing;
+		uint32_t m_StagingIndex = 0;
+		bool m_StagingCoherent = false;
+
 		VkDescriptorSet m_DescriptorSet = nullptr;
 
 		std::string m_Filepath;
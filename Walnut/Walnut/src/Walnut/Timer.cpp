@@ -0,0 +1,389 @@
+#include "Timer.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#define WL_PROFILE_TSC 1
+#endif
+
+namespace Walnut {
+
+	namespace {
+
+		// Written by its owning thread only. Head is published with release semantics after the
+		// zone itself, so a reader that acquires Head sees complete zones below it.
+		struct ThreadRing
+		{
+			uint32_t Id = 0;
+			std::string Name;
+			std::unique_ptr<Profiler::Zone[]> Zones;
+			std::atomic<uint64_t> Head{ 0 };
+			bool Released = false; // Its thread exited, guarded by the registry mutex
+		};
+
+		struct Registry
+		{
+			std::mutex Mutex;
+			// Rings outlive their threads, so a finished worker still shows up in the export. Once
+			// none of their zones can be part of a capture anymore they go to the next new thread.
+			std::vector<std::unique_ptr<ThreadRing>> Rings;
+			uint32_t NextId = 1;
+
+			uint64_t BeginTicks = 0, EndTicks = 0;
+			std::chrono::steady_clock::time_point BeginTime, EndTime;
+		};
+
+		Registry& GetRegistry()
+		{
+			static Registry registry;
+			return registry;
+		}
+
+		// Hands the ring back when its thread exits, so restarting a thread pool does not add a ring
+		// per worker every time
+		struct RingOwner
+		{
+			ThreadRing* Ring = nullptr;
+
+			~RingOwner()
+			{
+				if (!Ring)
+					return;
+				std::lock_guard<std::mutex> lock(GetRegistry().Mutex);
+				Ring->Released = true;
+			}
+		};
+
+		thread_local RingOwner t_Ring;
+
+		// Zones are recorded as they end, the last one ended latest. A ring whose zones all ended
+		// before the running or last capture began holds nothing an export would write.
+		bool IsStale(const Registry& registry, const ThreadRing& ring)
+		{
+			const uint64_t head = ring.Head.load(std::memory_order_relaxed);
+			return head == 0 || ring.Zones[(head - 1) % Profiler::ZonesPerThread].End < registry.BeginTicks;
+		}
+
+		ThreadRing& GetThreadRing()
+		{
+			if (!t_Ring.Ring)
+			{
+				Registry& registry = GetRegistry();
+				std::lock_guard<std::mutex> lock(registry.Mutex);
+
+				ThreadRing* ring = nullptr;
+				for (const std::unique_ptr<ThreadRing>& released : registry.Rings)
+				{
+					if (released->Released && IsStale(registry, *released))
+					{
+						ring = released.get();
+						break;
+					}
+				}
+				if (!ring)
+					ring = registry.Rings.emplace_back(std::make_unique<ThreadRing>()).get();
+
+				// A new id, the track of the thread that had the ring before is not continued
+				ring->Id = registry.NextId++;
+				ring->Name = "Thread " + std::to_string(ring->Id);
+				ring->Head.store(0, std::memory_order_relaxed);
+				ring->Released = false;
+				t_Ring.Ring = ring;
+			}
+			return *t_Ring.Ring;
+		}
+
+		struct CapturedZone
+		{
+			uint32_t Thread;
+			const char* Name;
+			uint64_t Begin, End; // Nanoseconds since the start of the capture
+		};
+
+		struct CapturedThread
+		{
+			uint32_t Id;
+			std::string Name;
+		};
+
+		// Copies the zones of the last capture out of the rings, converted to nanoseconds and
+		// sorted so that every parent comes before the zones nested in it
+		void CollectZones(std::vector<CapturedThread>& threads, std::vector<CapturedZone>& zones)
+		{
+			Registry& registry = GetRegistry();
+			std::lock_guard<std::mutex> lock(registry.Mutex);
+
+			const double nanoseconds = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(registry.EndTime - registry.BeginTime).count();
+			const uint64_t ticks = registry.EndTicks - registry.BeginTicks;
+			const double nanosecondsPerTick = ticks > 0 ? nanoseconds / (double)ticks : 1.0;
+
+			for (const std::unique_ptr<ThreadRing>& ring : registry.Rings)
+			{
+				const uint64_t head = ring->Head.load(std::memory_order_acquire);
+				if (!ring->Zones || head == 0)
+					continue;
+
+				threads.push_back({ ring->Id, ring->Name });
+
+				const uint64_t first = head > Profiler::ZonesPerThread ? head - Profiler::ZonesPerThread : 0;
+				for (uint64_t i = first; i < head; i++)
+				{
+					const Profiler::Zone& zone = ring->Zones[i % Profiler::ZonesPerThread];
+					if (zone.Begin < registry.BeginTicks || zone.End > registry.EndTicks)
+						continue;
+
+					zones.push_back({ ring->Id, zone.Name,
+						(uint64_t)((double)(zone.Begin - registry.BeginTicks) * nanosecondsPerTick),
+						(uint64_t)((double)(zone.End - registry.BeginTicks) * nanosecondsPerTick) });
+				}
+			}
+
+			std::sort(zones.begin(), zones.end(), [](const CapturedZone& a, const CapturedZone& b)
+			{
+				if (a.Thread != b.Thread)
+					return a.Thread < b.Thread;
+				if (a.Begin != b.Begin)
+					return a.Begin < b.Begin;
+				return a.End > b.End;
+			});
+		}
+
+		void WriteJsonString(FILE* file, const std::string& text)
+		{
+			fputc('"', file);
+			for (char c : text)
+			{
+				if (c == '"' || c == '\\')
+					fputc('\\', file);
+				fputc((unsigned char)c < 0x20 ? ' ' : c, file);
+			}
+			fputc('"', file);
+		}
+
+		// Minimal protobuf writer for the Perfetto trace format
+		class ProtoWriter
+		{
+		public:
+			void Varint(uint64_t value)
+			{
+				while (value >= 0x80)
+				{
+					m_Data.push_back((uint8_t)(value | 0x80));
+					value >>= 7;
+				}
+				m_Data.push_back((uint8_t)value);
+			}
+
+			void VarintField(uint32_t field, uint64_t value)
+			{
+				Varint((uint64_t)field << 3);
+				Varint(value);
+			}
+
+			void BytesField(uint32_t field, const void* data, size_t size)
+			{
+				Varint(((uint64_t)field << 3) | 2);
+				Varint(size);
+				m_Data.insert(m_Data.end(), (const uint8_t*)data, (const uint8_t*)data + size);
+			}
+
+			void StringField(uint32_t field, const std::string& text) { BytesField(field, text.data(), text.size()); }
+			void MessageField(uint32_t field, const ProtoWriter& message) { BytesField(field, message.m_Data.data(), message.m_Data.size()); }
+
+			const std::vector<uint8_t>& GetData() const { return m_Data; }
+		private:
+			std::vector<uint8_t> m_Data;
+		};
+
+		// Field numbers of perfetto/trace/trace_packet.proto and track_event/*.proto
+		namespace Perfetto {
+			constexpr uint32_t TracePacket = 1;
+
+			constexpr uint32_t PacketTimestamp = 8;
+			constexpr uint32_t PacketSequenceId = 10;
+			constexpr uint32_t PacketTrackEvent = 11;
+			constexpr uint32_t PacketSequenceFlags = 13;
+			constexpr uint32_t PacketTrackDescriptor = 60;
+
+			constexpr uint32_t TrackUuid = 1;
+			constexpr uint32_t TrackThread = 4;
+			constexpr uint32_t ThreadPid = 1;
+			constexpr uint32_t ThreadTid = 2;
+			constexpr uint32_t ThreadName = 5;
+
+			constexpr uint32_t EventType = 9;
+			constexpr uint32_t EventTrackUuid = 11;
+			constexpr uint32_t EventName = 23;
+
+			constexpr uint64_t SliceBegin = 1;
+			constexpr uint64_t SliceEnd = 2;
+			constexpr uint64_t IncrementalStateCleared = 1;
+
+			constexpr uint32_t ProcessId = 1;
+		}
+
+	}
+
+	uint64_t Profiler::ReadTicks()
+	{
+#if WL_PROFILE_TSC
+		return __rdtsc();
+#else
+		return (uint64_t)std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+	}
+
+	void Profiler::BeginCapture()
+	{
+		Registry& registry = GetRegistry();
+		{
+			std::lock_guard<std::mutex> lock(registry.Mutex);
+			registry.BeginTime = std::chrono::steady_clock::now();
+			registry.BeginTicks = ReadTicks();
+		}
+		s_Capturing.store(true, std::memory_order_relaxed);
+	}
+
+	void Profiler::EndCapture()
+	{
+		s_Capturing.store(false, std::memory_order_relaxed);
+
+		Registry& registry = GetRegistry();
+		std::lock_guard<std::mutex> lock(registry.Mutex);
+		registry.EndTime = std::chrono::steady_clock::now();
+		registry.EndTicks = ReadTicks();
+	}
+
+	void Profiler::SetThreadName(const std::string& name)
+	{
+		ThreadRing& ring = GetThreadRing();
+		std::lock_guard<std::mutex> lock(GetRegistry().Mutex);
+		ring.Name = name;
+	}
+
+	void Profiler::Record(const char* name, uint64_t begin, uint64_t end)
+	{
+		ThreadRing& ring = GetThreadRing();
+		if (!ring.Zones)
+			ring.Zones.reset(new Zone[ZonesPerThread]);
+
+		const uint64_t head = ring.Head.load(std::memory_order_relaxed);
+		ring.Zones[head % ZonesPerThread] = { name, begin, end };
+		ring.Head.store(head + 1, std::memory_order_release);
+	}
+
+	bool Profiler::ExportChromeTrace(const std::string& path)
+	{
+		std::vector<CapturedThread> threads;
+		std::vector<CapturedZone> zones;
+		CollectZones(threads, zones);
+
+		FILE* file = fopen(path.c_str(), "wb");
+		if (!file)
+			return false;
+
+		fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+		bool first = true;
+		for (const CapturedThread& thread : threads)
+		{
+			fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%u,\"tid\":%u,\"args\":{\"name\":",
+				first ? "" : ",\n", Perfetto::ProcessId, thread.Id);
+			WriteJsonString(file, thread.Name);
+			fprintf(file, "}}");
+			first = false;
+		}
+
+		// Complete events, timestamps in microseconds
+		for (const CapturedZone& zone : zones)
+		{
+			fprintf(file, "%s{\"name\":", first ? "" : ",\n");
+			WriteJsonString(file, zone.Name);
+			fprintf(file, ",\"ph\":\"X\",\"pid\":%u,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+				Perfetto::ProcessId, zone.Thread, zone.Begin * 1e-3, (zone.End - zone.Begin) * 1e-3);
+			first = false;
+		}
+
+		fprintf(file, "\n]}\n");
+		return fclose(file) == 0;
+	}
+
+	bool Profiler::ExportPerfettoTrace(const std::string& path)
+	{
+		std::vector<CapturedThread> threads;
+		std::vector<CapturedZone> zones;
+		CollectZones(threads, zones);
+
+		ProtoWriter trace;
+
+		// One track and packet sequence per thread, slices are written as begin / end pairs
+		for (const CapturedThread& thread : threads)
+		{
+			ProtoWriter threadDescriptor;
+			threadDescriptor.VarintField(Perfetto::ThreadPid, Perfetto::ProcessId);
+			threadDescriptor.VarintField(Perfetto::ThreadTid, thread.Id);
+			threadDescriptor.StringField(Perfetto::ThreadName, thread.Name);
+
+			ProtoWriter trackDescriptor;
+			trackDescriptor.VarintField(Perfetto::TrackUuid, thread.Id);
+			trackDescriptor.MessageField(Perfetto::TrackThread, threadDescriptor);
+
+			ProtoWriter packet;
+			packet.VarintField(Perfetto::PacketSequenceId, thread.Id);
+			packet.VarintField(Perfetto::PacketSequenceFlags, Perfetto::IncrementalStateCleared);
+			packet.MessageField(Perfetto::PacketTrackDescriptor, trackDescriptor);
+			trace.MessageField(Perfetto::TracePacket, packet);
+		}
+
+		auto writeSlice = [&trace](uint32_t thread, uint64_t timestamp, uint64_t type, const char* name)
+		{
+			ProtoWriter event;
+			event.VarintField(Perfetto::EventType, type);
+			event.VarintField(Perfetto::EventTrackUuid, thread);
+			if (name)
+				event.StringField(Perfetto::EventName, name);
+
+			ProtoWriter packet;
+			packet.VarintField(Perfetto::PacketTimestamp, timestamp);
+			packet.VarintField(Perfetto::PacketSequenceId, thread);
+			packet.MessageField(Perfetto::PacketTrackEvent, event);
+			trace.MessageField(Perfetto::TracePacket, packet);
+		};
+
+		// Zones are sorted by thread and begin, parents first, so a stack of open zones is enough
+		std::vector<const CapturedZone*> open;
+		for (size_t i = 0; i <= zones.size(); i++)
+		{
+			const CapturedZone* zone = i < zones.size() ? &zones[i] : nullptr;
+			while (!open.empty() && (!zone || zone->Thread != open.back()->Thread || open.back()->End <= zone->Begin))
+			{
+				writeSlice(open.back()->Thread, open.back()->End, Perfetto::SliceEnd, nullptr);
+				open.pop_back();
+			}
+
+			if (zone)
+			{
+				writeSlice(zone->Thread, zone->Begin, Perfetto::SliceBegin, zone->Name);
+				open.push_back(zone);
+			}
+		}
+
+		FILE* file = fopen(path.c_str(), "wb");
+		if (!file)
+			return false;
+
+		const std::vector<uint8_t>& data = trace.GetData();
+		size_t written = fwrite(data.data(), 1, data.size(), file);
+		return fclose(file) == 0 && written == data.size();
+	}
+
+}
@@ -3,6 +3,25 @@
 #include <iostream>
 #include <string>
 #include <chrono>
+#include <atomic>
+#include <cstdint>
+
+// Set to 0 to compile the profiler zones out
+#ifndef WL_PROFILE
+#define WL_PROFILE 1
+#endif
+
+#define WL_PROFILE_CONCAT_IMPL(a, b) a##b
+#define WL_PROFILE_CONCAT(a, b) WL_PROFILE_CONCAT_IMPL(a, b)
+
+#if WL_PROFILE
+// name has to be a string literal, it is stored as a pointer
+#define WL_PROFILE_ZONE(name) ::Walnut::ProfileZone WL_PROFILE_CONCAT(wlProfileZone, __LINE__)(name)
+#define WL_PROFILE_FUNCTION() WL_PROFILE_ZONE(__FUNCTION__)
+#else
+#define WL_PROFILE_ZONE(name)
+#define WL_PROFILE_FUNCTION()
+#endif
 
 namespace Walnut {
 
@@ -48,6 +67,56 @@ namespace Walnut {
 		Timer m_Timer;
 	};
 
+	// Zone profiler. While a capture runs, every zone is written to a lock-free ring buffer owned
+	// by the recording thread, with timestamps straight from the CPU's time stamp counter. The
+	// capture can be exported as Chrome trace JSON (chrome://tracing, ui.perfetto.dev) or as a
+	// native Perfetto trace.
+	class Profiler
+	{
+	public:
+		struct Zone
+		{
+			const char* Name;
+			uint64_t Begin, End; // Ticks
+		};
+
+		// Zones older than this are overwritten while the capture is still running
+		static constexpr uint32_t ZonesPerThread = 1 << 16;
+
+		static void BeginCapture();
+		static void EndCapture();
+		static bool IsCapturing() { return s_Capturing.load(std::memory_order_relaxed); }
+
+		// Name of the calling thread's track, copied
+		static void SetThreadName(const std::string& name);
+
+		// Export the last capture, call after EndCapture()
+		static bool ExportChromeTrace(const std::string& path);
+		static bool ExportPerfettoTrace(const std::string& path);
+
+		static uint64_t ReadTicks();
+		static void Record(const char* name, uint64_t begin, uint64_t end);
+	private:
+		static inline std::atomic<bool> s_Capturing{ false };
+	};
+
+	// Records the time between construction and destruction as a zone, when a capture is running
+	class ProfileZone
+	{
+	public:
+		explicit ProfileZone(const char* name)
+			: m_Name(Profiler::IsCapturing() ? name : nullptr), m_Begin(m_Name ? Profiler::ReadTicks() : 0) {}
+		~ProfileZone()
+		{
+			if (m_Name)
+				Profiler::Record(m_Name, m_Begin, Profiler::ReadTicks());
+		}
 
+		ProfileZone(const ProfileZone&) = delete;
+		ProfileZone& operator=(const ProfileZone&) = delete;
+	private:
+		const char* m_Name;
+		uint64_t m_Begin;
+	};
 
 }
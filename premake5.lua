@@ -5,6 +5,31 @@ workspace "Chroma"
    startproject "Chroma"
 
 outputdir = "%{cfg.buildcfg}-%{cfg.system}-%{cfg.architecture}"
+
+-- Build options of the kernels of every ISA level, chosen at runtime (see ISA.h), for each project
+-- compiling the Chroma sources. MSVC accepts the intrinsics anywhere, /arch only lets it use the
+-- wider encodings. Contraction into FMA is kept off (MSVC does not contract under /fp:precise) so
+-- that all levels produce the same bits.
+function ChromaKernelFlags()
+   filter { "files:**ISASSE42.cpp", "toolset:not msc*" }
+      buildoptions { "-msse4.2" }
+
+   filter { "files:**ISAAVX2.cpp", "toolset:msc*" }
+      buildoptions { "/arch:AVX2" }
+   filter { "files:**ISAAVX2.cpp", "toolset:not msc*" }
+      buildoptions { "-mavx2", "-ffp-contract=off" }
+
+   filter { "files:**ISAAVX512.cpp", "toolset:msc*" }
+      buildoptions { "/arch:AVX512" }
+   filter { "files:**ISAAVX512.cpp", "toolset:not msc*" }
+      buildoptions { "-mavx512f", "-ffp-contract=off" }
+
+   filter {}
+end
+
 include "Walnut/WalnutExternal.lua"
 
-include "Chroma"
\ No newline at end of file
+include "Chroma"
+include "ChromaBench"
+include "ChromaService"
+include "ChromaReader"
\ No newline at end of file